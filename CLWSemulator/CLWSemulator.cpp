@@ -16,14 +16,27 @@
 //  a subset of the expected data that is representative of what one expects to see during
 //  a Grip experiment. ALternatively, it can play back packets that have been previously 
 //  stored from a real session of Grip.
+// The constructed packets come from GripPacketGenerator, so the stream is the same from one run
+//  to the next for a given seed. Lost packets, occlusions and LOS gaps can be added at will.
+
+// Normally one client is served at a time, and each gets the packets from the start.
+//  With -fanout, any number of clients can connect at once and they all receive the same
+//  stream of packets from a single source.
+
+// For stress testing the ground monitor client and GripMMI there is also a load generation
+//  mode, in which constructed packets are sent at a configurable rate, possibly in bursts,
+//  to any number of clients at once. Counts of what has been sent, the throughput and the
+//  time spent in send() are reported periodically for each client.
 
 #include "stdafx.h"
-#include "..\Useful\fMessageBox.h"
-#include "..\Useful\fOutputDebugString.h"
-#include "..\Grip\DexAnalogMixin.h"
-#include "..\Grip\GripPackets.h"
-#include "..\GripMMI\GripMMIGlobals.h"
-#include "..\GripMMIVersionControl\GripMMIVersionControl.h"
+#include "../Useful/fMessageBox.h"
+#include "../Useful/fOutputDebugString.h"
+#include "../Grip/DexAnalogMixin.h"
+#include "../Grip/GripPackets.h"
+#include "../Grip/GripPacketGenerator.h"
+#include "../Grip/GripLatency.h"
+#include "../GripMMI/GripMMIGlobals.h"
+#include "../GripMMIVersionControl/GripMMIVersionControl.h"
 
 // Need to link with Ws2_32.lib
 #pragma comment (lib, "Ws2_32.lib")
@@ -46,31 +59,128 @@ const char *DefaultPacketSourceFile = ".\\GripPacketsForSimulator.gpk";
 // The bool verbose determines how much information we send to the console during normal operation.
 bool verbose = false;
 
-void setPacketTime( EPMTelemetryHeaderInfo *header ) {
+// Possible sources of packets.
+typedef enum { RECORDED_PACKETS, CONSTRUCTED_PACKETS, CONSTRUCTED_GRASP, LOAD_PACKETS } PacketSource;
+
+// Serve all clients at once from a single packet source.
+bool fanOut = false;
+
+// Parameters for the load generation mode, set from the command line.
+double	loadRate = 1000.0;			// RT packets per second. 0 means as fast as the connection will take them.
+int		loadBurst = 0;				// Number of RT packets per burst. 0 means a steady stream.
+int		loadBurstPause = 0;			// Milliseconds of silence between bursts.
+int		loadHKInterval = 2;			// One HK packet for this many RT packets. 0 means no HK packets.
+int		loadPacketLimit = 0;		// Number of RT packets to send to each client. 0 means no limit.
+int		loadReportInterval = 1000;	// Milliseconds between reports.
+
+// The source of constructed packets. The seed and the rates of gaps, occlusions and losses
+//  are set from the command line.
+GripPacketGenerator constructedPackets;
+
+// Parameters for the playback of recorded packets, set from the command line.
+double	playbackSpeed = 1.0;		// Multiple of real time. 0 means as fast as the connection will take them.
+double	playbackSeekTime = 0.0;		// Start at the first Grip packet recorded at or after this GPS time (seconds).
+int		playbackSeekPacket = 0;		// Start at this Grip packet in the file, counting from 0.
+
+// A high resolution clock for pacing the packets, in seconds from an arbitrary origin.
+static double packetClock( void ) {
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER now;
+	if ( frequency.QuadPart == 0 ) QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &now );
+	return( (double) now.QuadPart / (double) frequency.QuadPart );
+}
 
-	// Set the time of an EPM telemetry packet.
+// Sleep() only has a resolution of a few milliseconds, so the last bit of waiting is done by yielding.
+static void waitUntil( double instant ) {
+	double remaining;
+	while ( ( remaining = instant - packetClock() ) > 0.0 ) {
+		if ( remaining > 0.003 ) Sleep( (DWORD) ( ( remaining - 0.002 ) * 1000.0 ) );
+		else Sleep( 0 );
+	}
+}
 
-	// Time structure to get the local time for the EPM packet coarse and fine time values.
-	// I am using the 32 bit version because the EPM coarse time is 32 bits.
+// The current time in seconds since midnight Jan. 1 1970 UTC.
+static double unixTime( void ) {
 	struct __timeb32 epmtime;
 	_ftime32_s( &epmtime );
+	return( (double) epmtime.time + (double) epmtime.millitm / 1000.0 );
+}
 
-	// NB EPM uses GPS time (second since midnight Jan 5-6 1980), while 
-	// _ftime_s() uses seconds since midnight Jan. 1 1970 UTC.
-	// UTC takes into account leap seconds, GPS does not.
-	header->coarseTime = epmtime.time 
-		- 315964800 // Offset in seconds between Unix 0 and GPS 0
-		+ 16;		// Offset taking into account leap seconds, as of 1 Jan 2015.
+// The time of an EPM packet, in GPS seconds.
+static double recordedTime( EPMTelemetryHeaderInfo *header ) {
+	return( (double) header->coarseTime + (double) header->fineTime / 10000.0 );
+}
+
+// Set the time of an EPM telemetry packet to the given instant, in seconds since Jan. 1 1970 UTC.
+void setPacketTime( EPMTelemetryHeaderInfo *header, double instant ) {
+
+	double seconds = floor( instant );
+
+	header->coarseTime = (unsigned int) UnixToGPS( seconds );
 
 	// Also, EPM somehow gets time in 10ths of milliseconds and puts that in the header. 
-	// We don't expect to get two packets in a span of less than a millisecond, so I don't worry about it.
-	header->fineTime = epmtime.millitm * 10;
+	header->fineTime = (unsigned short) ( ( instant - seconds ) * 10000.0 );
 
 }
 
+// Set the time of an EPM telemetry packet to the current time.
+void setPacketTime( EPMTelemetryHeaderInfo *header ) {
+	setPacketTime( header, unixTime() );
+}
+
+// In fan-out mode the packet source does not send to a socket of its own. Each packet is 
+//  written once into a ring of slots and each client thread sends it from there, at its own pace.
+// The source never waits for the clients. A client that falls more than half the ring behind 
+//  skips ahead to the newest packet. If the source catches up with a packet while a client is
+//  still sending it, that client may have been sent a corrupted packet and it is disconnected.
+#define BROADCAST_RING_SLOTS	4096
+#define BROADCAST_SOCKET		( (SOCKET) -2 )
+
+typedef struct {
+	volatile LONG		sequence;		// Index in the stream of the packet in the slot, or -1 while it is being written.
+	int					length;
+	EPMTelemetryPacket	packet;
+} BroadcastSlot;
+
+static BroadcastSlot		broadcastRing[BROADCAST_RING_SLOTS];
+static volatile LONG		broadcastCount = 0;		// Number of packets published so far.
+static CRITICAL_SECTION		broadcastLock;
+static CONDITION_VARIABLE	broadcastReady;
+
+static int publishPacket( const char *buffer, int length ) {
+
+	LONG index = broadcastCount;
+	BroadcastSlot *slot = &broadcastRing[index % BROADCAST_RING_SLOTS];
+
+	InterlockedExchange( &slot->sequence, -1 );
+	memcpy( slot->packet.buffer, buffer, length );
+	slot->length = length;
+	InterlockedExchange( &slot->sequence, index );
+
+	EnterCriticalSection( &broadcastLock );
+	broadcastCount = index + 1;
+	LeaveCriticalSection( &broadcastLock );
+	WakeAllConditionVariable( &broadcastReady );
+
+	return( length );
+
+}
+
+// The packet sources send through here, so that they work the same way with one client or many.
+static int sendPacket( SOCKET socket, const char *buffer, int length ) {
+	if ( socket == BROADCAST_SOCKET ) return( publishPacket( buffer, length ) );
+	else return( send( socket, buffer, length, 0 ) );
+}
+
 // This is the routine that sends out packets that were pre-recorded.
 // Takes as its input the socket for outputing packets, the path to the file
 // containing the recorded packets.
+// The packets are sent out with the same spacing as when they were recorded, divided by playbackSpeed.
+// Their timestamps are rewritten to follow on from the start of the playback with the recorded
+//  spacing, whatever the speed, so that the data looks the same downstream as in a real time playback.
+// At any speed other than 1 the timestamps therefore drift away from the clock, and the packet
+//  latencies that the client and the GripMMI compute from them are meaningless.
 int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_packets = 0 ) {
 
 	// Count the total numbe of packets sent on the socket.
@@ -84,6 +194,17 @@ int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_
 	EPMTelemetryHeaderInfo epmPacketHeaderInfo;
 	EPMTelemetryPacket recordedPacket;
 
+	// Where to start in the file. This only applies the first time through.
+	double seek_time = playbackSeekTime;
+	int seek_packet = playbackSeekPacket;
+
+	// The time written into the packets runs on from the start of the playback.
+	// The packets are sent when the clock reaches the corresponding instant, scaled by the playback speed.
+	double playback_start = unixTime();
+	double playback_time = playback_start;
+	double clock_start = packetClock();
+	double next_progress = clock_start + 1.0;
+
 	while ( 1 ) {
 
 		printf( "Sending out recorded packets:\n\n  %s\n\n", PacketSourceFile );
@@ -106,13 +227,30 @@ int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_
 			if ( bytes_read < 0 ) break;
 			skip_packets--;
 		}
+		// Move on to the requested Grip packet or GPS time.
+		if ( seek_time > 0.0 || seek_packet > 0 ) {
+			int grip_packets = 0;
+			do {
+				ExtractEPMTelemetryHeaderInfo( &epmPacketHeaderInfo, &recordedPacket );
+				if ( epmPacketHeaderInfo.epmSyncMarker == EPM_TELEMETRY_SYNC_VALUE && epmPacketHeaderInfo.subsystemID == GRIP_SUBSYSTEM_ID ) {
+					if ( grip_packets >= seek_packet && recordedTime( &epmPacketHeaderInfo ) >= seek_time ) break;
+					grip_packets++;
+				}
+			} while ( ( bytes_read = _read( fid, recordedPacket.buffer, sizeof( recordedPacket.buffer ) ) ) > 0 );
+			if ( bytes_read <= 0 ) {
+				fMessageBox( MB_OK, "CLWSemulator", "No packet found in %s at or after packet %d and GPS time %.3f.", PacketSourceFile, seek_packet, seek_time );
+				exit( -1 );
+			}
+			printf( "Starting from Grip packet %d recorded at GPS time %.3f.\n\n", grip_packets, recordedTime( &epmPacketHeaderInfo ) );
+			seek_time = 0.0;
+			seek_packet = 0;
+		}
 
 		// Extract the EPM header info into a usable form from the packet that is stored in ESA-required byte order.
 		// Here we use it to initialize the record of the time of the previous packet, which is used
 		// later to compute the time between recorded packets and to sleep accordingly.
 		ExtractEPMTelemetryHeaderInfo( &epmPacketHeaderInfo, &recordedPacket );
-		unsigned int previous_coarse_time = epmPacketHeaderInfo.coarseTime;
-		unsigned int previous_fine_time = epmPacketHeaderInfo.fineTime;
+		double previous_recorded_time = recordedTime( &epmPacketHeaderInfo );
 		
 		// Loop to read all of the packets in the file.
 		do {
@@ -130,38 +268,43 @@ int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_
 				if ( epmPacketHeaderInfo.subsystemID != GRIP_SUBSYSTEM_ID ) printf( "." );
 				// If it is a GRIP packet, modify the pre-recorded packet too make it look like it was generated just now.
 				else {
-					// Compute the number of milliseconds between this packet and the previous one.
-					// This will be used further down to sleep the appropriate time to space out the packets.
-					int delta_milliseconds = ((int) epmPacketHeaderInfo.fineTime - (int) previous_fine_time ) / 10;
-					int delta_time = (epmPacketHeaderInfo.coarseTime - previous_coarse_time) * 1000 + delta_milliseconds;
-					// Store the current time as a reference for the next cycle.
-					previous_coarse_time = epmPacketHeaderInfo.coarseTime;
-					previous_fine_time = epmPacketHeaderInfo.fineTime;
-					// Set the timestamp of the packet to be output to the current time.
-					setPacketTime( &epmPacketHeaderInfo );
+					// Compute the time between this packet and the previous one.
+					// If there has been a long real delay, limit it to 30 seconds.
+					double delta_time = recordedTime( &epmPacketHeaderInfo ) - previous_recorded_time;
+					if ( delta_time > 30.0 ) delta_time = 30.0;
+					if ( delta_time < 0.0 ) delta_time = 0.0;
+					// Store the recorded time as a reference for the next cycle.
+					previous_recorded_time = recordedTime( &epmPacketHeaderInfo );
+					// Wait until it is time to send this one. As fast as possible means no waiting.
+					playback_time += delta_time;
+					if ( playbackSpeed > 0.0 ) waitUntil( clock_start + ( playback_time - playback_start ) / playbackSpeed );
+					// Set the timestamp of the packet to be output to the time it would have in a real time playback.
+					setPacketTime( &epmPacketHeaderInfo, playback_time );
 					// Set the packet counter based on a local count.
 					epmPacketHeaderInfo.TMCounter = packetCount++;
 					// Put the new header info back into the packet.
 					InsertEPMTelemetryHeaderInfo( &recordedPacket, &epmPacketHeaderInfo );
 					// Send it out on the socket.
-					iSendResult = send( socket, recordedPacket.buffer, EPM_BUFFER_LENGTH - 1, 0 );
+					iSendResult = sendPacket( socket, recordedPacket.buffer, EPM_BUFFER_LENGTH - 1 );
 					// If we get a socket error it is probably because the client has closed the connection.
 					// So we break out of the loop.
 					if (iSendResult == SOCKET_ERROR) {
 						printf( "Recorded packet send() failed with error: %3d\n", WSAGetLastError());
 						return( packetCount );
 					}
-					// Sleep based on the difference in time between the previousrecorded packet and this one.
-					// If there has been a long real delay, limit it to 30 seconds.
-					delta_time %= 30000;
-					printf( "G%d", delta_time );
-					Sleep( delta_time );
+					// In real time, show the spacing of each packet. Otherwise, just show the progress every second.
+					if ( playbackSpeed == 1.0 ) printf( "G%d", (int) ( delta_time * 1000.0 ) );
+					else if ( packetClock() >= next_progress ) {
+						printf( "\n  %d packets sent, recorded time %.3f, %.1f s of playback.", 
+							packetCount, previous_recorded_time, playback_time - playback_start );
+						next_progress += 1.0;
+					}
 
 				}
 			}
 			
 		// Loop until there are no more bytes to read.
-		} while ( bytes_read = _read( fid, recordedPacket.buffer, sizeof( recordedPacket.buffer ) ) );
+		} while ( ( bytes_read = _read( fid, recordedPacket.buffer, sizeof( recordedPacket.buffer ) ) ) );
 
 		// Try to gracefully close the file.
 		return_code = _close( fid );
@@ -172,7 +315,8 @@ int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_
 
 		// Sleep to simulate a pause in the experiment execution, then start over again.
 		printf( "Playback completed. Will restart in 10 seconds.\n" );
-		Sleep( 10000 );
+		playback_time += 10.0;
+		if ( playbackSpeed > 0.0 ) waitUntil( clock_start + ( playback_time - playback_start ) / playbackSpeed );
 
 	}
 
@@ -180,248 +324,204 @@ int sendRecordedPackets ( SOCKET socket, const char *PacketSourceFile, int skip_
 
 // This is the routine that sends out packets that are constructed here to simulate data.
 // Takes as its only input the socket for outputing packets.
+// The packets come from a copy of constructedPackets, so that each client gets the same stream
+//  (the same for a given seed and settings), starting on a 500 ms boundary as Grip would.
 int sendConstructedPackets ( SOCKET socket ) {
 
+	EPMTelemetryPacket packet;
+	GripPacketGenerator generator = constructedPackets;
+
+	int packet_count = 0;
+    int iSendResult;
+
+	double start = ceil( unixTime() * 2.0 ) / 2.0;
+	double clock_start = packetClock() + ( start - unixTime() );
+	generator.startTime = UnixToGPS( start );
+	generator.Reset();
+
+	// Send packets until the peer shuts down the connection
+	while ( 1 ) {
+
+		int length = generator.NextPacket( &packet );
+
+		// Wait until it is time to send it. The breaks between epochs simulate pauses 
+		//  in GRIP execution on board and the gaps simulate LOS periods.
+		double due = clock_start + ( generator.Time() - generator.startTime );
+		if ( due - packetClock() > 1.0 ) {
+			printf( "\nSimulating a pause of %.1f s.", due - packetClock() );
+			if ( generator.rtLost + generator.hkLost > 0 ) printf( " Packets lost so far: %d RT %d HK.", generator.rtLost, generator.hkLost );
+			printf( "\n\n" );
+		}
+		waitUntil( due );
+
+		iSendResult = sendPacket( socket, packet.buffer, length );
+		// If we get a socket error it is probably because the client has closed the connection.
+		// So we break out of the loop.
+		if (iSendResult == SOCKET_ERROR) {
+			printf( "%s packet send() failed with error: %3d\n", ( length == rtPacketLengthInBytes ? "RT" : "HK" ), WSAGetLastError());
+			return ( packet_count );
+		}
+		packet_count++;
+		printf( "  %s packet %3d Bytes sent: %3d\n", ( length == rtPacketLengthInBytes ? "RT" : "HK" ), packet_count, iSendResult);
+
+	}
+}
+
+// Counters kept for each client in load generation mode.
+// The time spent in each call to send() goes into a histogram with bins that double in width, 
+//  starting at 1 microsecond, so that the percentiles can be estimated without keeping every value.
+#define LOAD_LATENCY_BINS	32
+typedef struct {
+	int		client;
+	int		rt_packets;
+	int		hk_packets;
+	double	bytes;
+	double	send_time;					// Total, in seconds.
+	double	max_send_time;
+	double	max_lateness;				// How far behind schedule a packet was sent.
+	int		latency_histogram[LOAD_LATENCY_BINS];
+	double	start;
+} LoadCounters;
+
+static void countSend( LoadCounters *counters, int bytes, double duration ) {
+	int bin = 0;
+	counters->bytes += bytes;
+	counters->send_time += duration;
+	if ( duration > counters->max_send_time ) counters->max_send_time = duration;
+	for ( double limit = 1.0e-6; duration > limit && bin < LOAD_LATENCY_BINS - 1; limit *= 2.0 ) bin++;
+	counters->latency_histogram[bin]++;
+}
+
+// Upper limit of the bin containing the given fraction of the send() calls.
+static double latencyPercentile( LoadCounters *counters, double fraction ) {
+	int total = 0, count = 0;
+	double limit = 1.0e-6;
+	for ( int bin = 0; bin < LOAD_LATENCY_BINS; bin++ ) total += counters->latency_histogram[bin];
+	for ( int bin = 0; bin < LOAD_LATENCY_BINS; bin++, limit *= 2.0 ) {
+		count += counters->latency_histogram[bin];
+		if ( count >= fraction * total ) break;
+	}
+	return( limit );
+}
+
+static void reportLoad( LoadCounters *counters, LoadCounters *previous, double now, double previous_time ) {
+	double interval = now - previous_time;
+	int packets = counters->rt_packets + counters->hk_packets - previous->rt_packets - previous->hk_packets;
+	int sends = counters->rt_packets + counters->hk_packets;
+	printf( "Client %d: %8d RT %7d HK  %9.1f pkt/s  %7.3f MB/s  send() mean %7.1f p99 < %7.1f max %8.1f us  late max %7.1f ms\n",
+		counters->client, counters->rt_packets, counters->hk_packets,
+		packets / interval, ( counters->bytes - previous->bytes ) / interval / 1.0e6,
+		( sends > 0 ? counters->send_time / sends * 1.0e6 : 0.0 ), latencyPercentile( counters, 0.99 ) * 1.0e6,
+		counters->max_send_time * 1.0e6, counters->max_lateness * 1000.0 );
+}
+
+// This is the routine that sends out packets in load generation mode.
+// The content of the packets is simple, since the aim is to see how fast they can be
+//  handled downstream, but the headers and sequence counts are set as for real packets.
+int sendLoadPackets( SOCKET socket, int client ) {
+
 	EPMTelemetryPacket hkPacket, rtPacket;
 	EPMTelemetryHeaderInfo hkHeaderInfo, rtHeaderInfo;
 	GripHealthAndStatusInfo hkInfo;
 	GripRealtimeDataInfo rtInfo;
-	GripRealtimeDataInfo reverseInfo;
-
-	// Flag values for visible targets, sound generator and cradles.
-	unsigned short vertical_targets = 0;
-	unsigned short horizontal_targets = 0;
-	unsigned char sound_bits = 0;
-	unsigned char cradle_bits = 0;
-	int camera_status = 2;
-	int acquire_status = 2;
 
+	LoadCounters counters, previous;
 	int packet_count = 0;
-	int rt_packet_count = 0;
-	// A flag used to send one housekeeping packet for every two realtime data packets.
-	int send_hk = 1;
-	// A counter to generate simulated occlusions of the manipulandum.
-	int dropout_count = 0;
-
-    int iSendResult;
+	int burst_count = 0;
+	int iSendResult;
 
-	// Prepare the packets by copying constants into local structure.
 	memcpy( &hkHeaderInfo, &hkHeader, sizeof( hkHeaderInfo ) );
 	memcpy( &rtHeaderInfo, &rtHeader, sizeof( rtHeaderInfo ) );
+	memset( &rtInfo, 0, sizeof( rtInfo ) );
+	memset( &hkInfo, 0, sizeof( hkInfo ) );
+	hkInfo.user = 11;
+	hkInfo.protocol = 201;
+	hkInfo.task = 210;
+	hkInfo.step = 10;
+	rtInfo.acquisitionID = client;
+
+	memset( &counters, 0, sizeof( counters ) );
+	counters.client = client;
+	counters.start = packetClock();
+	previous = counters;
+
+	double period = ( loadRate > 0.0 ? 1.0 / loadRate : 0.0 );
+	double due = counters.start;
+	double next_report = counters.start + loadReportInterval / 1000.0;
+	double previous_report = counters.start;
+
+	while ( loadPacketLimit == 0 || counters.rt_packets < loadPacketLimit ) {
+
+		// Wait until the next packet is due. If we have fallen behind, the packets go out
+		//  back to back until we catch up.
+		waitUntil( due );
+		double lateness = packetClock() - due;
+		if ( period > 0.0 && lateness > counters.max_lateness ) counters.max_lateness = lateness;
 
-	// Send packets in short periods that we will call epochs.
-	// Breaks between epochs will simulate pauses in GRIP execution
-	//  on board or LOS periods.
-	int epoch = 0;
-
-	// Send packets until the peer shuts down the connection
-	while ( 1 ) {
-
-		// RT packets get sent out by GRIP twice per second.
-		// This is a trick to avoid drift in the rate.
-		// First, make sure that we sleep enough so as not to repeat.
-		Sleep( 50 );	
-		// Then compute the number of milliseconds to sleep to get back to a 500 ms boundary.
-		struct __timeb32 utctime;
-		_ftime32_s( &utctime );
-		Sleep( (1000 - utctime.millitm ) % 500 );
-
-		// Insert the current packet count and time into the packet.
 		rtHeaderInfo.TMCounter = packet_count++;
 		setPacketTime( &rtHeaderInfo );
 		InsertEPMTelemetryHeaderInfo( &rtPacket, &rtHeaderInfo );
-
-		// Fabricate data values for the real-time packets.
 		rtInfo.packetTimestamp = EPMtoSeconds( &rtHeaderInfo );
-		fOutputDebugString( "Timestamp: %.3f\n",  rtInfo.packetTimestamp );
-		rtInfo.acquisitionID = 0;
-		rtInfo.rtPacketCount = rt_packet_count++;
-
-		// There are RT_SLICES_PER_PACKET slices of data in each packet.
+		rtInfo.rtPacketCount = counters.rt_packets;
 		for ( int slice = 0; slice < RT_SLICES_PER_PACKET; slice++ ) {
-
-			rtInfo.dataSlice[slice].poseTick = rt_packet_count * RT_SLICES_PER_PACKET;
-			rtInfo.dataSlice[slice].analogTick = rt_packet_count * RT_SLICES_PER_PACKET;
-
-			// Initialize to zero position, acceleration and forces and to null orientation.
-			for ( int i = X; i <= Z; i++ ) {
-				rtInfo.dataSlice[slice].position[i] = 0.0f;
-				rtInfo.dataSlice[slice].acceleration[i] = 0.0f;
-				rtInfo.dataSlice[slice].ft[0].force[i] = 0.0f;
-				rtInfo.dataSlice[slice].ft[1].force[i] = 0.0f;
-				rtInfo.dataSlice[slice].ft[0].torque[i] = 0.0f;
-				rtInfo.dataSlice[slice].ft[1].torque[i] = 0.0f;
-				rtInfo.dataSlice[slice].quaternion[i] = 0.0f;
-			}
-			// Finish initializing the null orientation.
+			double t = (double) ( counters.rt_packets * RT_SLICES_PER_PACKET + slice ) * RT_DEFAULT_SECONDS_PER_SLICE;
+			rtInfo.dataSlice[slice].poseTick = rtInfo.dataSlice[slice].analogTick = counters.rt_packets * RT_SLICES_PER_PACKET + slice;
+			rtInfo.dataSlice[slice].position[X] = 300.0 + 300.0 * cos( t * Pi * 2.0 );
+			rtInfo.dataSlice[slice].ft[0].force[X] = - 14.0 + 8.5 * sin( t * Pi * 2.0 );
+			rtInfo.dataSlice[slice].ft[1].force[X] = - rtInfo.dataSlice[slice].ft[0].force[X];
 			rtInfo.dataSlice[slice].quaternion[M] = 1.0f;
-			// Now generate various patterns of movement and forces.
-			// Most are computed from a 1 Hz sinusoid.
-			double t = rtInfo.packetTimestamp + slice * RT_DEFAULT_SECONDS_PER_SLICE;
-			double s = sin( t * Pi * 2.0 );
-			double c = cos( t * Pi * 2.0 );
-			// The pattern changes each epoque, but recycles every 6 epochs.
-			// Note that position, orientation, acceleration and force data are not 
-			//  necessarily coherent with each other. We are just trying to generate
-			//  some data to be plotted by GripMMI.
-			switch ( epoch % 6 ) {
-			case 0: // Oscillating left-right movement.
-				rtInfo.dataSlice[slice].position[X] = 300.0 + 300.0 * c;
-				rtInfo.dataSlice[slice].acceleration[X] = - 300.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
-				rtInfo.dataSlice[slice].ft[0].force[X] = - 14.0 + 8.5 * s;
-				rtInfo.dataSlice[slice].ft[1].force[X] =  - rtInfo.dataSlice[slice].ft[0].force[X];
-				// Wrist and frame visible.
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0x000ff;
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0xf0fff;
-				break;
-			case 1: // Oscillating up-down movement.
-				rtInfo.dataSlice[slice].position[Y] = 300.0 + 300.0 * c;
-				rtInfo.dataSlice[slice].acceleration[Y] = - 300.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
-				rtInfo.dataSlice[slice].ft[0].force[Y] = 2.0 * s;
-				rtInfo.dataSlice[slice].ft[1].force[Y] = 1.8 * s;
-				// Wrist visible, frame occluded.
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0x000ff;
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0x0f0ff;
-				break;
-			case 2: // Oscillating in-out movement.
-				rtInfo.dataSlice[slice].position[Z] = - 300.0 + 200.0 * c;
-				rtInfo.dataSlice[slice].acceleration[Z] = - 200.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
-				rtInfo.dataSlice[slice].ft[0].force[Z] = 3.0 * s;
-				rtInfo.dataSlice[slice].ft[1].force[Z] = 3.2 * s;
-				// Frame visible, wrist occluded.
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0x000ff;
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0x00fff;
-				break;
-			case 3: 
-				// Pitch rotations.
-				rtInfo.dataSlice[slice].quaternion[X] = s / 2.0;
-				rtInfo.dataSlice[slice].quaternion[M] = c / 2.0;
-				// Horizontal sliding CoP.
-				rtInfo.dataSlice[slice].ft[0].force[X] = - 14.0 + 8.5 * s;
-				rtInfo.dataSlice[slice].ft[1].force[X] =  - rtInfo.dataSlice[slice].ft[0].force[X];
-				rtInfo.dataSlice[slice].ft[0].torque[Y] = rtInfo.dataSlice[slice].ft[0].force[X] * 0.01 * s;
-				rtInfo.dataSlice[slice].ft[1].torque[Y] = rtInfo.dataSlice[slice].ft[1].force[X] * 0.011 * s;
-				// Wrist and frame visible.
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0xfffff;
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0xf0f0f;
-				break;
-			case 4: 
-				// Yaw rotations.
-				rtInfo.dataSlice[slice].quaternion[Y] = s / 2.0;
-				rtInfo.dataSlice[slice].quaternion[M] = c / 2.0;
-				// Vertical sliding CoP.
-				rtInfo.dataSlice[slice].ft[0].force[X] = - 14.0 + 8.5 * s;
-				rtInfo.dataSlice[slice].ft[1].force[X] =  - rtInfo.dataSlice[slice].ft[0].force[X];
-				rtInfo.dataSlice[slice].ft[0].torque[Z] = rtInfo.dataSlice[slice].ft[0].force[X] * 0.01 * s;
-				rtInfo.dataSlice[slice].ft[1].torque[Z] = rtInfo.dataSlice[slice].ft[1].force[X] * 0.011 * s;
-				// Wrist and frame visible.
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0xfffff;
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0x0f0f0;
-				break;
-			case 5:
-				// Roll rotations.
-				rtInfo.dataSlice[slice].quaternion[Z] = s / 2.0;
-				rtInfo.dataSlice[slice].quaternion[M] = c / 2.0;
-				// Diagonal sliding CoP.
-				rtInfo.dataSlice[slice].ft[0].force[X] = - 14.0 + 8.5 * s;
-				rtInfo.dataSlice[slice].ft[1].force[X] =  - rtInfo.dataSlice[slice].ft[0].force[X];
-				rtInfo.dataSlice[slice].ft[0].torque[Y] = rtInfo.dataSlice[slice].ft[0].force[X] * 0.01 * s;
-				rtInfo.dataSlice[slice].ft[1].torque[Y] = rtInfo.dataSlice[slice].ft[1].force[X] * 0.011 * s;
-				rtInfo.dataSlice[slice].ft[0].torque[Z] = rtInfo.dataSlice[slice].ft[0].force[X] * 0.01 * s;
-				rtInfo.dataSlice[slice].ft[1].torque[Z] = rtInfo.dataSlice[slice].ft[1].force[X] * 0.011 * s;
-				// Wrist and frame visible.
-				rtInfo.dataSlice[slice].markerVisibility[0] = 0xfffff;
-				rtInfo.dataSlice[slice].markerVisibility[1] = 0xfffff;
-				break;
-			}
-
-			// Simulate occaisional occlusions of the manipulandum.
-			if ( dropout_count == 0 ) {
-				// Note that this simulated value does not take into account 
-				// the values of the individal marker visibility set above.
-				rtInfo.dataSlice[slice].manipulandumVisibility = true;
-				if ( rand() < 1000 ) dropout_count = 10;
-			}
-			else {
-				rtInfo.dataSlice[slice].manipulandumVisibility = false;
-				// Here at least we guarantee that marker and manipulandum 
-				// visibility flags are coherent.
-				rtInfo.dataSlice[slice].markerVisibility[0] &= 0xfff00;
-				rtInfo.dataSlice[slice].markerVisibility[1] &= 0xfff00;
-				dropout_count --;
-			}
-
+			rtInfo.dataSlice[slice].manipulandumVisibility = true;
+			rtInfo.dataSlice[slice].markerVisibility[0] = rtInfo.dataSlice[slice].markerVisibility[1] = 0xfffff;
 		}
 		InsertGripRealtimeDataInfo( &rtPacket, &rtInfo );
-		ExtractGripRealtimeDataInfo( &reverseInfo, &rtPacket );
 
-		// Send out a realtime data packet.
+		double before = packetClock();
 		iSendResult = send( socket, rtPacket.buffer, rtPacketLengthInBytes, 0 );
-		// If we get a socket error it is probably because the client has closed the connection.
-		// So we break out of the loop.
-		if (iSendResult == SOCKET_ERROR) {
-			printf( "RT packet send() failed with error: %3d\n", WSAGetLastError());
-			return ( packet_count );
+		if ( iSendResult == SOCKET_ERROR ) {
+			printf( "Client %d: RT packet send() failed with error: %3d\n", client, WSAGetLastError() );
+			break;
 		}
-		printf( "  RT packet %3d Bytes sent: %3d\n", packet_count, iSendResult);
-
-		// One HK packet gets sent out for every two real-time data packets. 
-		// The BOOL send_hk is used to turn off and on HK output for each RT cycle.
-		if ( send_hk ) {
+		countSend( &counters, iSendResult, packetClock() - before );
+		counters.rt_packets++;
 
-			// Insert the current packet count and time into the packet.
+		if ( loadHKInterval > 0 && counters.rt_packets % loadHKInterval == 0 ) {
 			hkHeaderInfo.TMCounter = packet_count++;
 			setPacketTime( &hkHeaderInfo );
-
-			// Set the state of the script interpreter.
-			// These constant values have been chosen more or less randomly.
-			// I don't make them vary, because they depend on the scripts that are loaded
-			//  and it would be too complicated to check whether they are valid values or not.
-			hkInfo.user = 11;
-			hkInfo.protocol = 201;
-			hkInfo.task = 210;
-			hkInfo.step = 10;
-
-			// Targets, tone and cradle detectors.
-			hkInfo.horizontalTargetFeedback = horizontal_targets;	// Visual targets.
-			hkInfo.verticalTargetFeedback = vertical_targets;		
-			hkInfo.toneFeedback = sound_bits;						// Tone, muted.
-			hkInfo.cradleDetectors = cradle_bits;					// Cradle detectors.
-			// Acquisition state.
-			hkInfo.motionTrackerStatusEnum = acquire_status;
-			hkInfo.crewCameraStatusEnum = camera_status;
-
-			// Insert the housekeeping values into the actual packet and send it out on the socket.
 			InsertEPMTelemetryHeaderInfo( &hkPacket, &hkHeaderInfo );
 			InsertGripHealthAndStatusInfo( &hkPacket, &hkInfo );
+			before = packetClock();
 			iSendResult = send( socket, hkPacket.buffer, hkPacketLengthInBytes, 0 );
-			// If we get a socket error it is probably because the client has closed the connection.
-			// So we break out of the loop.
-			if (iSendResult == SOCKET_ERROR) {
-				printf( "HK send() failed with error: %3d\n", WSAGetLastError());
-				return ( packet_count );
+			if ( iSendResult == SOCKET_ERROR ) {
+				printf( "Client %d: HK packet send() failed with error: %3d\n", client, WSAGetLastError() );
+				break;
 			}
-			printf( "  HK packet %3d Bytes sent: %3d\n", packet_count, iSendResult);
+			countSend( &counters, iSendResult, packetClock() - before );
+			counters.hk_packets++;
+		}
+
+		// Schedule the next packet, leaving a gap at the end of each burst.
+		due += period;
+		if ( loadBurst > 0 && ++burst_count >= loadBurst ) {
+			burst_count = 0;
+			if ( period == 0.0 ) due = packetClock();
+			due += loadBurstPause / 1000.0;
 		}
-		send_hk = !send_hk; // Toggle enable flag so that we do one out of two cycles.
-
-		// Every once in a while, pause a bit to simulate breaks between tasks.
-		if ( (packet_count % 20) == 0 ) {
-			printf( "\nSimulating inter-trial pause.\n\n" );
-			Sleep( 5000 );
-
-			// On each new epoch, fabricate new values
-			// for the visible targets, sound generator, cradles and acquisition state.
-			// These values stay constant over the course of each epoch.
-			vertical_targets = ( 0x01 << ( epoch % N_VERTICAL_TARGETS ) );		// Cycle through vertical targets
-			horizontal_targets = ( 0x01 << ( epoch % N_HORIZONTAL_TARGETS ) );	// Cycle through horizontal targets
-			sound_bits = epoch % 8;	// Cycle through each tone. Every other tone is 'muted' so every other cycle sound should be off.
-			cradle_bits = (epoch % 4) + (((epoch+1) % 4) << 2) + (((epoch+2) % 4) << 4); // Cycle through cradle values, different for each cradle.
-			acquire_status = ( epoch % 3 ? 2 : 0 );	// Status 2 means acquiring. Will be so 2 out of 3 epochs.
-			camera_status = ( epoch % 2 ? 2 : 0 );	// Status 2 means filming. Will be so 1 out of 2 epochs.
-			epoch++;
+
+		double now = packetClock();
+		if ( now >= next_report ) {
+			reportLoad( &counters, &previous, now, previous_report );
+			previous = counters;
+			previous_report = now;
+			next_report = now + loadReportInterval / 1000.0;
 		}
 	}
+
+	// Summary for the whole connection.
+	memset( &previous, 0, sizeof( previous ) );
+	printf( "Client %d finished. Overall:\n", client );
+	reportLoad( &counters, &previous, packetClock(), counters.start );
+	return( packet_count );
+
 }
 
 // Send out packets that could come from GRASP.
@@ -439,7 +539,6 @@ int sendGraspPackets ( SOCKET socket ) {
 	static int state = 20000;
 	static int snapshots = 17;
 
-	static int trials = 7;
 	static int status = 321;
 
 	static int packet_count = 0;
@@ -513,7 +612,7 @@ int sendGraspPackets ( SOCKET socket ) {
 		// Insert the housekeeping values into the actual packet and send it out on the socket.
 		InsertEPMTelemetryHeaderInfo( &hkPacket, &hkHeaderInfo );
 		InsertGripHealthAndStatusInfo( &hkPacket, &hkInfo );
-		iSendResult = send( socket, hkPacket.buffer, hkPacketLengthInBytes, 0 );
+		iSendResult = sendPacket( socket, hkPacket.buffer, hkPacketLengthInBytes );
 		// If we get a socket error it is probably because the client has closed the connection.
 		// So we break out of the loop.
 		if (iSendResult == SOCKET_ERROR) {
@@ -524,6 +623,161 @@ int sendGraspPackets ( SOCKET socket ) {
 	}
 }
 
+// Wait for a 'Connect' command from the client before starting to send packets.
+// Returns the result of the last recv(), which is 0 or less if the connection was lost.
+int waitForConnectCommand( SOCKET socket ) {
+
+	// A place to store raw command packets received from the client.
+	EPMTelemetryPacket inputPacket;
+	// A place to store the pertinent information from a client packet in usable form.
+	EPMTransferFrameHeaderInfo transferFrameInfo;
+
+	int iResult;
+
+	printf( "Waiting for a Connect command ... " );
+	do {
+
+		iResult = recv(socket, inputPacket.buffer, sizeof( inputPacket.buffer ), 0);
+
+		if ( iResult == EPM_BUFFER_LENGTH ) {
+			// If we get a full buffer of data, it probably means that we have fallen behind.
+			// No packets that we expect from GRIP should use the full EPM buffer length.
+			// So just skip this packet and move on to the next.
+			printf("Bytes received: %4d - flushing (overrun).\n", iResult);
+		}
+		else if ( iResult == connectPacketLengthInBytes ) {
+			ExtractEPMTransferFrameHeaderInfo( &transferFrameInfo, &inputPacket );
+			if ( transferFrameInfo.packetType == TRANSFER_FRAME_CONNECT ) {
+				printf("start packet received from ", iResult);
+				if ( transferFrameInfo.softwareUnitID == GRIP_MMI_SOFTWARE_UNIT_ID ) printf( "PRIMARY" );
+				else if ( transferFrameInfo.softwareUnitID == GRIP_MMI_SOFTWARE_ALT_UNIT_ID ) printf( "ALTERNATE" );
+				else printf( "UNRECOGNIZED" );
+				printf( " (%d) software unit ID.\n", transferFrameInfo.softwareUnitID );
+				break;
+			}
+			else {
+				printf( "unexpected packet type (%x) ... ", transferFrameInfo.packetType );
+			}
+		}
+		else printf( "unexpected packet size (%d) ... ", iResult );
+
+	}while ( iResult > 0 );
+
+	return( iResult );
+
+}
+
+// In load generation and fan-out modes each client is served by its own thread, 
+//  so that the main loop can go straight back to listening for the next one.
+typedef struct {
+	SOCKET	socket;
+	int		client;
+} ClientConnection;
+
+static DWORD WINAPI loadClientThread( LPVOID param ) {
+
+	ClientConnection *connection = (ClientConnection *) param;
+
+	if ( waitForConnectCommand( connection->socket ) > 0 ) sendLoadPackets( connection->socket, connection->client );
+	shutdown( connection->socket, SD_SEND );
+	closesocket( connection->socket );
+	free( connection );
+	return( 0 );
+
+}
+
+// What the single packet source is to send in fan-out mode.
+static PacketSource broadcastSource;
+static const char *broadcastSourceFilename;
+static int broadcastSkipPackets;
+static volatile LONG broadcastStarted = 0;
+
+static DWORD WINAPI broadcastSourceThread( LPVOID param ) {
+
+	// The sources only return when a send fails, which does not happen when broadcasting.
+	// But just in case, start over.
+	while ( 1 ) {
+		switch ( broadcastSource ) {
+		case RECORDED_PACKETS:
+			sendRecordedPackets( BROADCAST_SOCKET, broadcastSourceFilename, broadcastSkipPackets );
+			break;
+		case CONSTRUCTED_GRASP:
+			sendGraspPackets( BROADCAST_SOCKET );
+			break;
+		default:
+			sendConstructedPackets( BROADCAST_SOCKET );
+			break;
+		}
+	}
+	return( 0 );
+
+}
+
+static DWORD WINAPI broadcastClientThread( LPVOID param ) {
+
+	ClientConnection *connection = (ClientConnection *) param;
+	int sent = 0;
+	int skipped = 0;
+	bool connected = true;
+
+	if ( waitForConnectCommand( connection->socket ) > 0 ) {
+
+		// The source starts up when the first client is ready for it.
+		if ( InterlockedCompareExchange( &broadcastStarted, 1, 0 ) == 0 ) {
+			HANDLE thread = CreateThread( NULL, 0, broadcastSourceThread, NULL, 0, NULL );
+			if ( !thread ) {
+				fMessageBox( MB_OK, "CLWSemulator", "Could not start the packet source thread." );
+				exit( -1 );
+			}
+			CloseHandle( thread );
+		}
+
+		// Clients join the stream as it is going out.
+		EnterCriticalSection( &broadcastLock );
+		LONG next = broadcastCount;
+		LeaveCriticalSection( &broadcastLock );
+
+		while ( connected ) {
+
+			// Wait for something new to send.
+			EnterCriticalSection( &broadcastLock );
+			while ( broadcastCount == next ) SleepConditionVariableCS( &broadcastReady, &broadcastLock, INFINITE );
+			LONG available = broadcastCount;
+			LeaveCriticalSection( &broadcastLock );
+
+			if ( available - next > BROADCAST_RING_SLOTS / 2 ) {
+				skipped += available - 1 - next;
+				printf( "Client %d fell behind. Skipping %d packets.\n", connection->client, available - 1 - next );
+				next = available - 1;
+			}
+
+			for ( ; next < available; next++ ) {
+				BroadcastSlot *slot = &broadcastRing[next % BROADCAST_RING_SLOTS];
+				// If the slot has already been reused, the next pass will skip ahead.
+				if ( slot->sequence != next ) break;
+				if ( send( connection->socket, slot->packet.buffer, slot->length, 0 ) == SOCKET_ERROR ) {
+					printf( "Client %d: send() failed with error: %3d\n", connection->client, WSAGetLastError() );
+					connected = false;
+					break;
+				}
+				if ( slot->sequence != next ) {
+					printf( "Client %d is too slow. Disconnecting.\n", connection->client );
+					connected = false;
+					break;
+				}
+				sent++;
+			}
+		}
+	}
+
+	printf( "Client %d disconnected. Packets sent: %d skipped: %d\n", connection->client, sent, skipped );
+	shutdown( connection->socket, SD_SEND );
+	closesocket( connection->socket );
+	free( connection );
+	return( 0 );
+
+}
+
 // This is the main routine of the executable.
 // It parses the command line, initializes a socket to create a CLWS-like server 
 // and calls the routine to output packets according to the command line options.
@@ -539,19 +793,16 @@ int _tmain( int argc, char **argv )
 	struct addrinfo *result = NULL;
 	struct addrinfo hints;
 
-	// Two possible sources of packets.
-	enum { RECORDED_PACKETS, CONSTRUCTED_PACKETS, CONSTRUCTED_GRASP } packet_source = RECORDED_PACKETS;
+	// Where the packets come from.
+	PacketSource packet_source = RECORDED_PACKETS;
 	// Path to file containing pre-recorded packets. Not used in 'constructed' mode.
 	const char *packet_source_filename = DefaultPacketSourceFile;
 	// Keep track of how many packets get sent out.
 	int packet_count;
 	// Skip over some initial recorded packets.
 	int skip_packets = 0;
-
-	// A place to store raw command packets received from the client.
-	EPMTelemetryPacket inputPacket;
-	// A place to store the pertinent information from a client packet in usable form.
-	EPMTransferFrameHeaderInfo transferFrameInfo;
+	// Number of clients that have connected, used to tell them apart when several are served at once.
+	int n_clients = 0;
 
 	printf( "CLWS Emulator started.\n%s\n%s\n\n", GripMMIVersion, GripMMIBuildInfo );
 	printf( "This is the EPM/GRIP packet server emulator.\n" );
@@ -574,14 +825,59 @@ int _tmain( int argc, char **argv )
 		// Construct simulated packets.
 		else if ( !strncmp( argv[arg], "-port=", strlen( "-port=" ) ) ) EPMport = argv[arg] + strlen( "-port=" );
 		else if ( !strncmp( argv[arg], "-skip=", strlen( "-skip=" ) ) ) sscanf( argv[arg], "-skip=%d", &skip_packets );
+		// Playback of recorded packets: -speed=<multiple of real time, or max> -seek=<GPS time> -packet=<Grip packet index>
+		else if ( !strcmp( argv[arg], "-speed=max" ) ) playbackSpeed = 0.0;
+		else if ( !strncmp( argv[arg], "-speed=", strlen( "-speed=" ) ) ) sscanf( argv[arg], "-speed=%lf", &playbackSpeed );
+		else if ( !strncmp( argv[arg], "-seek=", strlen( "-seek=" ) ) ) sscanf( argv[arg], "-seek=%lf", &playbackSeekTime );
+		else if ( !strncmp( argv[arg], "-packet=", strlen( "-packet=" ) ) ) sscanf( argv[arg], "-packet=%d", &playbackSeekPacket );
+		// Load generation: -load -rate=<RT packets/s, 0 for line rate> -burst=<packets>:<pause ms> 
+		//  -hk=<RT packets per HK packet> -count=<RT packets per client> -report=<ms>
+		else if ( !strcmp( argv[arg], "-load" ) ) packet_source = LOAD_PACKETS;
+		// Serve several clients at once from the same packets.
+		else if ( !strcmp( argv[arg], "-fanout" ) ) fanOut = true;
+		else if ( !strncmp( argv[arg], "-rate=", strlen( "-rate=" ) ) ) sscanf( argv[arg], "-rate=%lf", &loadRate );
+		else if ( !strncmp( argv[arg], "-burst=", strlen( "-burst=" ) ) ) sscanf( argv[arg], "-burst=%d:%d", &loadBurst, &loadBurstPause );
+		else if ( !strncmp( argv[arg], "-hk=", strlen( "-hk=" ) ) ) sscanf( argv[arg], "-hk=%d", &loadHKInterval );
+		else if ( !strncmp( argv[arg], "-count=", strlen( "-count=" ) ) ) sscanf( argv[arg], "-count=%d", &loadPacketLimit );
+		else if ( !strncmp( argv[arg], "-report=", strlen( "-report=" ) ) ) sscanf( argv[arg], "-report=%d", &loadReportInterval );
+		// Constructed packets: -seed=<n> -loss=<probability per packet> -occlusion=<probability per slice>
+		//  -gap=<probability per RT packet>:<seconds>
+		else if ( !strncmp( argv[arg], "-seed=", strlen( "-seed=" ) ) ) sscanf( argv[arg], "-seed=%u", &constructedPackets.seed );
+		else if ( !strncmp( argv[arg], "-loss=", strlen( "-loss=" ) ) ) sscanf( argv[arg], "-loss=%lf", &constructedPackets.lossRate );
+		else if ( !strncmp( argv[arg], "-occlusion=", strlen( "-occlusion=" ) ) ) sscanf( argv[arg], "-occlusion=%lf", &constructedPackets.occlusionRate );
+		else if ( !strncmp( argv[arg], "-gap=", strlen( "-gap=" ) ) ) sscanf( argv[arg], "-gap=%lf:%lf", &constructedPackets.gapRate, &constructedPackets.gapDuration );
 		else packet_source_filename = argv[arg];
 	}	
 	if ( packet_source == RECORDED_PACKETS ) {
 		printf( "\nSending pre-recorded packets.\n" );
-		printf( "Packet source file: %s\n\n", packet_source_filename );
+		printf( "Packet source file: %s\n", packet_source_filename );
+		if ( playbackSpeed > 0.0 ) printf( "Playback speed: x%.1f\n\n", playbackSpeed );
+		else printf( "Playback speed: as fast as possible\n\n" );
+		if ( playbackSpeed != 1.0 ) {
+			printf( "Warning: the packets are time stamped as if played back in real time.\n" );
+			printf( "Packet latencies measured downstream are only valid at -speed=1.\n\n" );
+		}
 	}
 	else if ( packet_source == CONSTRUCTED_PACKETS ) {
-		printf( "Constructing simulated packets.\n\n" );
+		if ( constructedPackets.lossRate >= 1.0 ) constructedPackets.lossRate = 0.99;
+		printf( "Constructing simulated packets.\n" );
+		printf( "Seed: %u  Loss: %.4f  Occlusion: %.4f  Gaps: %.4f of %.1f s\n\n", constructedPackets.seed,
+			constructedPackets.lossRate, constructedPackets.occlusionRate, constructedPackets.gapRate, constructedPackets.gapDuration );
+	}
+	else if ( packet_source == LOAD_PACKETS ) {
+		if ( loadRate > 0.0 ) printf( "Generating load at %.1f RT packets per second", loadRate );
+		else printf( "Generating load as fast as possible" );
+		if ( loadBurst > 0 ) printf( " in bursts of %d packets every %d ms", loadBurst, loadBurstPause );
+		printf( ".\n\n" );
+	}
+	if ( loadReportInterval <= 0 ) loadReportInterval = 1000;
+	if ( fanOut && packet_source != LOAD_PACKETS ) {
+		printf( "All clients will receive the same packets.\n\n" );
+		InitializeCriticalSection( &broadcastLock );
+		InitializeConditionVariable( &broadcastReady );
+		broadcastSource = packet_source;
+		broadcastSourceFilename = packet_source_filename;
+		broadcastSkipPackets = skip_packets;
 	}
 
 	// Initialize Winsock
@@ -636,7 +932,7 @@ int _tmain( int argc, char **argv )
 	//  then exits. 
 
 	// The only way out is to kill the program (<ctrl-c>).
-	// NB We effectively only allow one client at a time.
+	// NB We effectively only allow one client at a time, except in load generation and fan-out modes.
 
 	while ( 1 ) {
 
@@ -661,36 +957,28 @@ int _tmain( int argc, char **argv )
 		}
 		else if ( _debug ) printf( "accept() OK " );
 		printf( "connected.\n" );
-
-		// Wait for a 'Connect' command to start sending packets.
-		printf( "Waiting for a Connect command ... " );
-		do {
-
-			iResult = recv(ClientSocket, inputPacket.buffer, sizeof( inputPacket.buffer ), 0);
-
-			if ( iResult == EPM_BUFFER_LENGTH ) {
-				// If we get a full buffer of data, it probably means that we have fallen behind.
-				// No packets that we expect from GRIP should use the full EPM buffer length.
-				// So just skip this packet and move on to the next.
-				printf("Bytes received: %4d - flushing (overrun).\n", iResult);
+		n_clients++;
+
+		// In load generation and fan-out modes, hand the client over to a thread of its own and go back to listening.
+		if ( packet_source == LOAD_PACKETS || fanOut ) {
+			ClientConnection *connection = (ClientConnection *) malloc( sizeof( ClientConnection ) );
+			HANDLE thread = NULL;
+			if ( connection ) {
+				connection->socket = ClientSocket;
+				connection->client = n_clients;
+				thread = CreateThread( NULL, 0, ( packet_source == LOAD_PACKETS ? loadClientThread : broadcastClientThread ), connection, 0, NULL );
 			}
-			else if ( iResult == connectPacketLengthInBytes ) {
-				ExtractEPMTransferFrameHeaderInfo( &transferFrameInfo, &inputPacket );
-				if ( transferFrameInfo.packetType == TRANSFER_FRAME_CONNECT ) {
-					printf("start packet received from ", iResult);
-					if ( transferFrameInfo.softwareUnitID == GRIP_MMI_SOFTWARE_UNIT_ID ) printf( "PRIMARY" );
-					else if ( transferFrameInfo.softwareUnitID == GRIP_MMI_SOFTWARE_ALT_UNIT_ID ) printf( "ALTERNATE" );
-					else printf( "UNRECOGNIZED" );
-					printf( " (%d) software unit ID.\n", transferFrameInfo.softwareUnitID );
-					break;
-				}
-				else {
-					printf( "unexpected packet type (%x) ... ", transferFrameInfo.packetType );
-				}
+			if ( thread ) CloseHandle( thread );
+			else {
+				printf( "Could not start a thread for client %d.\n", n_clients );
+				free( connection );
+				closesocket( ClientSocket );
 			}
-			else printf( "unexpected packet size (%d) ... ", iResult );
+			continue;
+		}
 
-		}while ( iResult > 0 );
+		// Wait for a 'Connect' command to start sending packets.
+		waitForConnectCommand( ClientSocket );
 
 		// Send out recorded or artifically constructed packets, depending on a flag set by the command line.
 		// The total number of packets sent so far is stored in local variable packetCount.
@@ -708,6 +996,12 @@ int _tmain( int argc, char **argv )
 			packet_count = sendGraspPackets( ClientSocket );
 			break;
 
+		case LOAD_PACKETS:
+		default:
+			// Load generation clients are served by threads of their own, above, and never get here.
+			packet_count = 0;
+			break;
+
 		}
 
 		// shutdown the connection since we're done
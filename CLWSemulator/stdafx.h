@@ -7,6 +7,7 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
+#ifdef _WIN32
 #include <stdio.h>
 #include <tchar.h>
 #include <winsock2.h>
@@ -17,6 +18,10 @@
 #include <share.h>
 #include <sys\stat.h>
 #include <SYS\timeb.h>
+#else
+// Linux build (see CMakeLists.txt).
+#include "../Useful/Portability.h"
+#endif
 
 
 // TODO: reference additional headers your program requires here
@@ -15,10 +15,14 @@
 ///  for graphical display. 
 
 #include "stdafx.h"
-#include "..\Grip\GripPackets.h"
-#include "..\Useful\fMessageBox.h"
-#include "..\Useful\fOutputDebugString.h"
-#include "..\GripMMIVersionControl\GripMMIVersionControl.h"
+#include <string.h>
+#include "../Grip/GripPackets.h"
+#include "../Grip/GripLatency.h"
+#include "../Grip/GripMetrics.h"
+#include "../Useful/fMessageBox.h"
+#include "../Useful/fOutputDebugString.h"
+#include "../Useful/Trace.h"
+#include "../GripMMIVersionControl/GripMMIVersionControl.h"
 
 // Need to link with Ws2_32.lib
 #pragma comment (lib, "Ws2_32.lib")
@@ -33,12 +37,27 @@ EPMTelemetryHeaderInfo epmPacketHeaderInfo;
 char rtPacketCacheFilePath[1024];
 char hkPacketCacheFilePath[1024];
 char anyPacketCacheFilePath[1024];
+char latencyFilePath[1024];
 
 // Count the number of packets of each type sent to the cache files.
 unsigned long rtCount = 0;
 unsigned long hkCount = 0;
 unsigned long anyCount = 0;
 
+// Latency of the RT packets when they are received and when they have been written to the cache,
+//  counted from their time stamp on board. The times for each packet are also written to the 
+//  latency file, for the GripMMI to complete with the times at which it reads and draws them.
+bool record_latency = true;
+GripLatencyHistogram latency[GRIP_LATENCY_STAGES];
+
+// When the tool is built with GRIP_TRACE, the time spent receiving, decoding and caching
+//  each packet can be written out at the end, in Chrome trace format, with -trace=<file>.
+const char *traceFilePath = NULL;
+
+// Counters for the packets of each type, the anomalies in the stream and the time taken to
+//  write the cache files are written to a file in Prometheus text format with -metrics=<file>.
+const char *metricsFilePath = NULL;
+
 // Controls how much information is output to the console.
 // For the moment it is always true.
 bool	verbose = true;
@@ -51,12 +70,16 @@ bool _debug = true;
 //  another process can read the same file without colliding.
 // Parameters include a pilnter to the packer, the length of the packet in bytes and the 
 //  filename (includding path, if desired) of the cache file to which we wish to write the packet.
-void outputPacket( const EPMTelemetryPacket *packet, const int n_bytes, const char *filename ) {
+// The latency records are written the same way.
+void outputPacket( const void *packet, const int n_bytes, const char *filename ) {
 
 	int		fid;
 	errno_t	return_code;
 	size_t	bytes_written;
+	LARGE_INTEGER start, stop, frequency;
 
+	TRACE_FUNCTION();
+	QueryPerformanceCounter( &start );
 	return_code = _sopen_s( &fid, filename, _O_CREAT | _O_WRONLY | _O_APPEND | _O_BINARY, _SH_DENYWR, _S_IREAD | _S_IWRITE );
 	if ( return_code ) {
 		fMessageBox( MB_OK, "GripGroundMonitorClient", "Error opening %s for binary write.\nError code: %d", filename, return_code );
@@ -72,6 +95,9 @@ void outputPacket( const EPMTelemetryPacket *packet, const int n_bytes, const ch
 		fMessageBox( MB_OK, "GripGroundMonitorClient", "Error closing %s after binary write.\nError code: %d", filename, return_code );
 		exit( return_code );
 	}
+	QueryPerformanceCounter( &stop );
+	QueryPerformanceFrequency( &frequency );
+	GripMetricsCacheWrite( (double) ( stop.QuadPart - start.QuadPart ) / (double) frequency.QuadPart );
 
 }
 
@@ -97,6 +123,195 @@ void outputANY ( EPMTelemetryPacket *packet ) {
 	anyCount++;
 }
 
+// Note the latency of an RT packet that has just been written to the cache.
+// The record goes to the latency file in the same order as the packet went to the RT cache.
+void outputLatency( const EPMTelemetryHeaderInfo *header, double received ) {
+
+	GripLatencyRecord record;
+
+	record.onboard = (double) EPMtoSeconds( (EPMTelemetryHeaderInfo *) header );
+	record.received = received;
+	record.written = GripClockGPS();
+	record.tmCounter = header->TMCounter;
+	record.spare = 0;
+	GripLatencyAdd( &latency[GRIP_LATENCY_RECEIVE], record.received - record.onboard );
+	GripLatencyAdd( &latency[GRIP_LATENCY_CACHE_WRITE], record.written - record.onboard );
+	outputPacket( &record, sizeof( record ), latencyFilePath );
+
+}
+
+// TCP delivers a stream of bytes, not packets. If the packets come in faster than we write
+//  them out, a single recv() can return several packets, or a packet and part of the next.
+// So the incoming bytes are accumulated here and handed out one packet at a time.
+// Each packet starts with the transfer frame sync marker. The length of GRIP packets is known
+//  from their type. For other packets it is taken from the transfer frame header.
+// Anything between the end of one packet and the next sync marker (such as the padding of 
+//  the packets replayed by the CLWSemulator) is skipped.
+#define STREAM_BUFFER_LENGTH	( 16 * EPM_BUFFER_LENGTH )
+unsigned char streamBuffer[STREAM_BUFFER_LENGTH];
+int streamBytes = 0;
+unsigned long skippedBytes = 0;
+
+// The sync marker as it appears in the stream (ESA byte order).
+const unsigned char transferFrameSync[4] = { 0xAA, 0x49, 0xDB, 0xFF };
+
+// Position of the first sync marker at or after 'from', or -1 if there is none yet.
+int findSync( int from ) {
+	for ( int i = from; i + 4 <= streamBytes; i++ ) {
+		if ( !memcmp( streamBuffer + i, transferFrameSync, 4 ) ) return( i );
+	}
+	return( -1 );
+}
+
+// Length of the packet at the start of the stream buffer, or 0 if not enough of it has arrived to tell.
+int streamPacketLength( void ) {
+
+	EPMTelemetryHeaderInfo header;
+	int length;
+
+	if ( streamBytes < EPM_TRANSFER_FRAME_HEADER_LENGTH ) return( 0 );
+	ExtractEPMTransferFrameHeaderInfo( &header.transferFrameInfo, (EPMTelemetryPacket *) streamBuffer );
+	if ( header.transferFrameInfo.packetType == TRANSFER_FRAME_TELEMETRY ) {
+		if ( streamBytes < EPM_TRANSFER_FRAME_HEADER_LENGTH + EPM_TELEMETRY_HEADER_LENGTH ) return( 0 );
+		ExtractEPMTelemetryHeaderInfo( &header, (EPMTelemetryPacket *) streamBuffer );
+		if ( header.epmSyncMarker == EPM_TELEMETRY_SYNC_VALUE && header.subsystemID == GRIP_SUBSYSTEM_ID ) {
+			if ( header.TMIdentifier == GRIP_HK_ID ) return( hkPacketLengthInBytes );
+			if ( header.TMIdentifier == GRIP_RT_ID ) return( rtPacketLengthInBytes );
+		}
+	}
+	length = header.transferFrameInfo.numberOfWords * 2;
+	if ( length >= EPM_TRANSFER_FRAME_HEADER_LENGTH && length <= EPM_BUFFER_LENGTH ) return( length );
+
+	// If the header does not make sense, the packet runs to the next sync marker, within the limit of the buffer.
+	length = findSync( 4 );
+	if ( length > 0 ) return( length );
+	if ( streamBytes >= EPM_BUFFER_LENGTH ) {
+		GripMetricsCount( GRIP_METRIC_OVERRUNS, 1 );
+		return( EPM_BUFFER_LENGTH );
+	}
+	return( 0 );
+
+}
+
+// Get the next complete packet. Returns its length, or the result of recv() if the connection is closed or fails.
+int receivePacket( SOCKET socket, EPMTelemetryPacket *packet ) {
+
+	int start, length, bytes;
+
+	while ( 1 ) {
+		// Drop anything before the sync marker. If there is none, keep the last few bytes
+		//  in case they are the start of one.
+		start = findSync( 0 );
+		if ( start < 0 ) start = ( streamBytes > 3 ? streamBytes - 3 : 0 );
+		if ( start > 0 ) {
+			skippedBytes += start;
+			GripMetricsCount( GRIP_METRIC_SKIPPED_BYTES, start );
+			memmove( streamBuffer, streamBuffer + start, streamBytes - start );
+			streamBytes -= start;
+		}
+		// If we have the whole packet, hand it out.
+		length = streamPacketLength();
+		if ( length > 0 && length <= streamBytes ) {
+			memcpy( packet->buffer, streamBuffer, length );
+			memmove( streamBuffer, streamBuffer + length, streamBytes - length );
+			streamBytes -= length;
+			GripMetricsSetQueueDepth( streamBytes );
+			return( length );
+		}
+		// Otherwise wait for more.
+		TRACE_BEGIN( "recv" );
+		bytes = recv( socket, (char *) streamBuffer + streamBytes, STREAM_BUFFER_LENGTH - streamBytes, 0 );
+		TRACE_END( "recv" );
+		if ( bytes <= 0 ) return( bytes );
+		streamBytes += bytes;
+		GripMetricsSetQueueDepth( streamBytes );
+	}
+
+}
+
+// When the connection to the server is lost, the client connects again, waiting twice as long
+//  after each failed attempt, up to a limit. A connection that is closed before any packet
+//  arrives counts as a failed attempt, so a server that accepts and then drops connections
+//  is not hammered. The delay starts over only once a connection has delivered packets.
+// The files stay the same, so the packets received after the reconnection are appended to
+//  those received before.
+#define RECONNECT_INITIAL_DELAY	250		// milliseconds
+#define RECONNECT_MAX_DELAY		30000	// milliseconds
+
+// Connect to the CLWS server, trying each of the addresses returned by getaddrinfo(), and send 
+//  the EPM Connect command to start the flow of packets. Returns INVALID_SOCKET on failure.
+SOCKET connectToServer( struct addrinfo *address_list ) {
+
+	SOCKET connect_socket = INVALID_SOCKET;
+	struct addrinfo *ptr;
+	int iResult;
+
+	for ( ptr = address_list; ptr != NULL; ptr = ptr->ai_next ) {
+		// Create a SOCKET for connecting to server
+		connect_socket = socket( ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol );
+		if ( connect_socket == INVALID_SOCKET ) {
+			printf( "socket failed with error: %ld\n", WSAGetLastError() );
+			WSACleanup();
+ 			printf( "Unrecoverable error. Press <Return> to exit.\n" );
+			getchar();
+			exit( 104 );
+		}
+		// Try to connect to server. If no error, we got a connection. 
+		if ( connect( connect_socket, ptr->ai_addr, (int) ptr->ai_addrlen ) != SOCKET_ERROR ) break;
+		// Otherwise, try the next element in the list returned by getaddrinfo.
+		closesocket( connect_socket );
+		connect_socket = INVALID_SOCKET;
+	}
+	if ( connect_socket == INVALID_SOCKET ) return( INVALID_SOCKET );
+
+	// We have a connection. Send the EPM 'connect' command to start flow of packets.
+	// The packet connectPacket is a global define by GripPackets.h.
+	printf( "\nConnection established with server.\n" );
+	printf( "Sending EPM Connect command.\n" );
+	InsertEPMTransferFrameHeaderInfo( &epmPacket, &connectPacket );
+	iResult = send( connect_socket, epmPacket.buffer, connectPacketLengthInBytes, 0 );
+	if ( iResult == SOCKET_ERROR ) {
+		printf( "Command packet send() failed with error: %3d\n", WSAGetLastError());
+		closesocket( connect_socket );
+		return( INVALID_SOCKET );
+	}
+	else printf( "Command packet bytes sent: %3d\n\n", iResult);
+	// Now set a timeout for future sends on the connection socket.
+	// This will affect the sending of Alive packets (see below).
+#ifdef _WIN32
+	DWORD timeout_milliseconds = 100;
+	iResult = setsockopt( connect_socket, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout_milliseconds, sizeof( timeout_milliseconds ));
+#else
+	// POSIX sockets take the timeout as a timeval.
+	struct timeval timeout = { 0, 100000 };
+	iResult = setsockopt( connect_socket, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof( timeout ));
+#endif
+	if ( iResult == SOCKET_ERROR ) {
+		printf( "setsockop() failed with error: %3d\n", WSAGetLastError());
+		closesocket( connect_socket );
+		return( INVALID_SOCKET );
+	}
+	return( connect_socket );
+
+}
+
+// Note a loss of the connection in the gap file, with the GPS times at which the connection was
+//  lost and restored and the number of packets in each cache file before the gap.
+char gapFilePath[1024];
+void outputGap( double disconnected, double reconnected ) {
+
+	FILE *fp = fopen( gapFilePath, "a" );
+	if ( !fp ) {
+		fMessageBox( MB_OK, "GripGroundMonitorClient", "Error opening %s to append.", gapFilePath );
+		exit( -1 );
+	}
+	fseek( fp, 0, SEEK_END );
+	if ( ftell( fp ) == 0 ) fprintf( fp, "# disconnected reconnected seconds rt_packets hk_packets any_packets\n" );
+	fprintf( fp, "%.3f %.3f %.3f %lu %lu %lu\n", disconnected, reconnected, reconnected - disconnected, rtCount, hkCount, anyCount );
+	fclose( fp );
+
+}
+
 // The main routine, taking arguments from the command line.
 int __cdecl main(int argc, const char **argv) 
 {
@@ -104,9 +319,16 @@ int __cdecl main(int argc, const char **argv)
 	// Stuff for the socket.
     WSADATA wsaData;
     SOCKET ConnectSocket = INVALID_SOCKET;
-    struct addrinfo *result = NULL, *ptr = NULL, hints;
+    struct addrinfo *result = NULL, hints;
     int iResult, iResult2;
 
+	// Connections to the server, and the time at which the last one was lost.
+	int		connections = 0;
+	int		max_connections = 0;
+	double	disconnected = 0.0;
+	int		delay = RECONNECT_INITIAL_DELAY;
+	unsigned long	connection_packets;
+
 	// Controls sending of Alive EPM packets.
 	struct __timeb32 utctime;
 	long	previous_alive_time = 0;
@@ -141,6 +363,16 @@ int __cdecl main(int argc, const char **argv)
 		// This action can be inhibitedw with the -only flag, causing only HK and RT packets
 		//  to be written to their respective cahce files.
 		else if ( !strcmp( argv[arg], "-only" )) cache_all = false;
+		// By default, the client reconnects to the server whenever the connection is lost.
+		// -connections=<n> makes it stop after the nth connection has been closed.
+		else if ( !strncmp( argv[arg], "-connections=", strlen( "-connections=" ) )) sscanf( argv[arg], "-connections=%d", &max_connections );
+		// The times at which the RT packets are received and cached are written to a latency
+		//  file alongside the cache files. The flag -nolatency turns that off.
+		else if ( !strcmp( argv[arg], "-nolatency" )) record_latency = false;
+		// -trace=<file> writes the trace spans to the given file on exit.
+		else if ( !strncmp( argv[arg], "-trace=", strlen( "-trace=" ) )) traceFilePath = argv[arg] + strlen( "-trace=" );
+		// -metrics=<file> rewrites the metrics file every second.
+		else if ( !strncmp( argv[arg], "-metrics=", strlen( "-metrics=" ) )) metricsFilePath = argv[arg] + strlen( "-metrics=" );
 		// The first argument that is encountered that is not a -flag is the path to the cache file directory.
 		else if ( packetCacheFilenameRoot == NULL ) {
 			packetCacheFilenameRoot = argv[arg];
@@ -204,70 +436,6 @@ int __cdecl main(int argc, const char **argv)
 		return 103;
     }
 
-    // Attempt to connect to the CLWS server until one succeeds.
-	printf( "Waiting for connection with host %s on port %s.\n", server_name, EPMport );
-	printf( "Will wait until connection achieved or <ctrl-C>.\n"  );
-
-	while ( 1 ) {
-		for(ptr=result; ptr != NULL ;ptr=ptr->ai_next) {
-			// Create a SOCKET for connecting to server
-			ConnectSocket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
-			if (ConnectSocket == INVALID_SOCKET) {
-				printf("socket failed with error: %ld\n", WSAGetLastError());
-				WSACleanup();
- 				printf( "Unrecoverable error. Press <Return> to exit.\n" );
-				getchar();
-				return 104;
-			}
-			// Try to connect to server.
-			iResult = connect( ConnectSocket, ptr->ai_addr, (int)ptr->ai_addrlen);
-			// If no error, we got a connection. 
-			// Break out of the loop to use this connection.
-			if (iResult != SOCKET_ERROR) break;
-			// Otherwise, try the next element in the list returned by getaddrinfo.
-			else {
-				closesocket(ConnectSocket);
-				ConnectSocket = INVALID_SOCKET;
-			}
-		}
-		// If we get here, it's either because we managed to connect or
-		//  because there are no more items to try. In the latter case,
-		//  ConnectSocket will have the value INVALID_SOCKET.
-		// If we have a valid connect break out of the loop that is waiting for one.
-		if ( ConnectSocket != INVALID_SOCKET ) break;
-		// Otherwise, show some progress and loop back for another try.
-		else printf( "." );
-	}
-
-	// We have a connection. Send the EPM 'connect' command to start flow of packets.
-	// The packet connectPacket is a global define by GripPackets.h.
-	printf( "\nConnection established with server.\n" );
-	printf( "Sending EPM Connect command.\n" );
-	InsertEPMTransferFrameHeaderInfo( &epmPacket, &connectPacket );
-	iResult = send( ConnectSocket, epmPacket.buffer, connectPacketLengthInBytes, 0 );
-	// If we get a socket error it is probably because the client has closed the connection.
-	// So we break out of the loop.
-	if ( iResult == SOCKET_ERROR ) {
-		printf( "Command packet send() failed with error: %3d\n", WSAGetLastError());
- 		printf( "Unrecoverable error. Press <Return> to exit.\n" );
-		getchar();
-		exit( -100 );
-	}
-	else printf( "Command packet bytes sent: %3d\n\n", iResult);
-	// Now set a timeout for future sends on the connection socket.
-	// This will affect the sending of Alive packets (see below).
-	DWORD timeout_milliseconds = 100;
-	iResult = setsockopt( ConnectSocket, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout_milliseconds, sizeof( timeout_milliseconds ));
-	if ( iResult == SOCKET_ERROR ) {
-		printf( "setsockop() failed with error: %3d\n", WSAGetLastError());
- 		printf( "Unrecoverable error. Press <Return> to exit.\n" );
-		getchar();
-		exit( -110 );
-	}
-	// We no longer need the address info.
-    freeaddrinfo(result);
-
-	// We have a connection and are ready to start receiving packets.
 	// Create the file names that will hold the packets. 
 	// The filenames are based on today's date and the specified path to the cache directory.
 	CreateGripPacketCacheFilename( hkPacketCacheFilePath, sizeof( hkPacketCacheFilePath ), GRIP_HK_BULK_PACKET,    packetCacheFilenameRoot );
@@ -278,147 +446,222 @@ int __cdecl main(int argc, const char **argv)
 		CreateGripPacketCacheFilename( anyPacketCacheFilePath, sizeof( anyPacketCacheFilePath ), GRIP_UNKNOWN_PACKET, packetCacheFilenameRoot );
 		printf( "Output ALL packets to: %s\n", anyPacketCacheFilePath );
 	}
+	if ( record_latency ) {
+		CreateGripLatencyFilename( latencyFilePath, sizeof( latencyFilePath ), packetCacheFilenameRoot );
+		printf( "Output RT packet latencies to: %s\n", latencyFilePath );
+	}
+	CreateGripGapFilename( gapFilePath, sizeof( gapFilePath ), packetCacheFilenameRoot );
+	printf( "Note gaps due to reconnections in: %s\n", gapFilePath );
+	if ( metricsFilePath ) {
+		if ( GripMetricsStartWriter( metricsFilePath, GRIP_METRICS_PERIOD ) ) printf( "Could not start writing metrics to: %s\n", metricsFilePath );
+		else printf( "Output metrics to: %s\n", metricsFilePath );
+	}
 	printf( "\n" );
 
-	// Receive as long as the server stays connected or until <ctrl-C>.
-    do {
+	printf( "Waiting for connection with host %s on port %s.\n", server_name, EPMport );
+	printf( "Will wait until connection achieved or <ctrl-C>.\n"  );
 
-		static int recv_counter = 0;
+	while ( 1 ) {
 
-		if ( _debug ) printf( "Entering recv() #%03d ... ", recv_counter++ );
-		fflush( stdout );
-        iResult = recv(ConnectSocket, epmPacket.buffer, EPM_BUFFER_LENGTH, 0);
-		if ( _debug) printf( "returned.\n" );
+		// Attempt to connect to the CLWS server until one succeeds, backing off between attempts.
+		while ( INVALID_SOCKET == ( ConnectSocket = connectToServer( result ) ) ) {
+			// Show some progress and loop back for another try.
+			printf( "." );
+			fflush( stdout );
+			Sleep( delay );
+			delay *= 2;
+			if ( delay > RECONNECT_MAX_DELAY ) delay = RECONNECT_MAX_DELAY;
+		}
+		connections++;
+		GripMetricsSetConnected( TRUE );
+		if ( connections > 1 ) {
+			GripMetricsCount( GRIP_METRIC_RECONNECTS, 1 );
+			outputGap( disconnected, GripClockGPS() );
+		}
+		// Start over with the Alive packets, in case they were inhibited on the previous connection.
+		send_alives = true;
+		previous_alive_time = 0;
+		connection_packets = 0;
 
-		if ( iResult == EPM_BUFFER_LENGTH ) {
+		// Receive as long as the server stays connected or until <ctrl-C>.
+		do {
 
-			// If we get a full buffer of data, it probably means that we have fallen behind.
-			// No packets that we expect from GRIP should use the full EPM buffer length.
-			// So just skip this packet and move on to the next.
-            printf("Bytes: %4d - flushing (overrun).\n", iResult);
-		}
-        else if ( iResult > 0 ) {
+			static int recv_counter = 0;
+			double received;
 
-			// Unless inhibited by the -only command line flag, write all packets 
-			//  to the .any.gpk cache file, regardless of type.
-			if ( cache_all ) outputANY( &epmPacket );
-			
-			// Now get the EPM header info and process the packet according to the type.
-			// First check for the EPM sync words and discard if not valid.
-			ExtractEPMTelemetryHeaderInfo( &epmPacketHeaderInfo, &epmPacket );
-			if ( epmPacketHeaderInfo.epmSyncMarker != EPM_TELEMETRY_SYNC_VALUE ) {
-				if ( verbose ) printf( "Bytes: %4d (non EPM).\n", iResult ); 
-			}
-			else {
-				// Check that the packet came from GRIP.
-				if ( epmPacketHeaderInfo.subsystemID != GRIP_SUBSYSTEM_ID ) {
-					if ( verbose ) printf( "Bytes: %4d %4d %4d %02x:%02x:%02x TM: 0x%04x %06d (non GRIP).\n",
+			if ( _debug ) printf( "Entering recv() #%03d ... ", recv_counter++ );
+			fflush( stdout );
+			iResult = receivePacket( ConnectSocket, &epmPacket );
+			received = GripClockGPS();
+			if ( _debug) printf( "returned.\n" );
 
-						iResult, 
-						epmPacketHeaderInfo.transferFrameInfo.numberOfWords * 2, 
-						epmPacketHeaderInfo.numberOfWords * 2, 
+			if ( iResult > 0 ) {
 
-						epmPacketHeaderInfo.transferFrameInfo.softwareUnitID,
-						epmPacketHeaderInfo.subsystemID, 
-						epmPacketHeaderInfo.subsystemUnitID, 
+				TRACE_BEGIN( "ProcessPacket" );
+				connection_packets++;
 
-						epmPacketHeaderInfo.TMIdentifier, 
-						epmPacketHeaderInfo.TMCounter
-						);
+				// Unless inhibited by the -only command line flag, write all packets 
+				//  to the .any.gpk cache file, regardless of type.
+				if ( cache_all ) outputANY( &epmPacket );
+			
+				// Now get the EPM header info and process the packet according to the type.
+				// First check for the EPM sync words and discard if not valid.
+				TRACE_BEGIN( "DecodeHeader" );
+				ExtractEPMTelemetryHeaderInfo( &epmPacketHeaderInfo, &epmPacket );
+				TRACE_END( "DecodeHeader" );
+				if ( epmPacketHeaderInfo.epmSyncMarker != EPM_TELEMETRY_SYNC_VALUE ) {
+					if ( verbose ) printf( "Bytes: %4d (non EPM).\n", iResult ); 
+					GripMetricsCount( GRIP_METRIC_NON_EPM, 1 );
 				}
 				else {
-					printf( "Bytes: %4d %4d %4d %02x:%02x:%02x TM: 0x%04x %06d",
+					GripMetricsCountPacket( epmPacketHeaderInfo.TMIdentifier, iResult );
+					// Check that the packet came from GRIP.
+					if ( epmPacketHeaderInfo.subsystemID != GRIP_SUBSYSTEM_ID ) {
+						if ( verbose ) printf( "Bytes: %4d %4d %4d %02x:%02x:%02x TM: 0x%04x %06d (non GRIP).\n",
+
+							iResult, 
+							epmPacketHeaderInfo.transferFrameInfo.numberOfWords * 2, 
+							epmPacketHeaderInfo.numberOfWords * 2, 
+
+							epmPacketHeaderInfo.transferFrameInfo.softwareUnitID,
+							epmPacketHeaderInfo.subsystemID, 
+							epmPacketHeaderInfo.subsystemUnitID, 
+
+							epmPacketHeaderInfo.TMIdentifier, 
+							epmPacketHeaderInfo.TMCounter
+							);
+						GripMetricsCount( GRIP_METRIC_NON_GRIP, 1 );
+					}
+					else {
+						printf( "Bytes: %4d %4d %4d %02x:%02x:%02x TM: 0x%04x %06d",
 						
-						iResult,													// Actual # bytes received.
-						epmPacketHeaderInfo.transferFrameInfo.numberOfWords * 2,	// Bytes supposedly received according to transfer frame header.
-						epmPacketHeaderInfo.numberOfWords * 2,						// Bytes supposedly recieved according to the EPM Telemetry packet, excluding transfer frame info.  
+							iResult,													// Actual # bytes received.
+							epmPacketHeaderInfo.transferFrameInfo.numberOfWords * 2,	// Bytes supposedly received according to transfer frame header.
+							epmPacketHeaderInfo.numberOfWords * 2,						// Bytes supposedly recieved according to the EPM Telemetry packet, excluding transfer frame info.  
 						
-						epmPacketHeaderInfo.transferFrameInfo.softwareUnitID,
-						epmPacketHeaderInfo.subsystemID, 
-						epmPacketHeaderInfo.subsystemUnitID, 
+							epmPacketHeaderInfo.transferFrameInfo.softwareUnitID,
+							epmPacketHeaderInfo.subsystemID, 
+							epmPacketHeaderInfo.subsystemUnitID, 
 						
-						epmPacketHeaderInfo.TMIdentifier,
-						epmPacketHeaderInfo.TMCounter
-					);
-					// Then check the type of EPM packet and sort into appropriate cache files.
-					// We are only concerned with two packet types: 
-					//   0x0301 for housekeeping data and 0x1001 for realtime science data.
-					switch ( epmPacketHeaderInfo.TMIdentifier ) {
-
-					case GRIP_HK_ID:
-						printf( " HK   \n" );
-						outputHK( &epmPacket );
-						break;
-
-					case GRIP_RT_ID:
-						printf( "    RT\n" );
-						outputRT( &epmPacket );
-						break;
-
-					default:
-						// It would be surprising to get here as it would
-						//  mean that GRIP sent an unexpected packet type.
-						printf( " ??????\n" );
-						break;
-
+							epmPacketHeaderInfo.TMIdentifier,
+							epmPacketHeaderInfo.TMCounter
+						);
+						// Then check the type of EPM packet and sort into appropriate cache files.
+						// We are only concerned with two packet types: 
+						//   0x0301 for housekeeping data and 0x1001 for realtime science data.
+						switch ( epmPacketHeaderInfo.TMIdentifier ) {
+
+						case GRIP_HK_ID:
+							printf( " HK   \n" );
+							outputHK( &epmPacket );
+							break;
+
+						case GRIP_RT_ID:
+							printf( "    RT\n" );
+							outputRT( &epmPacket );
+							if ( record_latency ) outputLatency( &epmPacketHeaderInfo, received );
+							break;
+
+						default:
+							// It would be surprising to get here as it would
+							//  mean that GRIP sent an unexpected packet type.
+							printf( " ??????\n" );
+							break;
+
+						}
 					}
 				}
+				TRACE_END( "ProcessPacket" );
 			}
-		}
-		else if ( iResult == 0 ) printf( "Socket closed.\n" );
-		else printf( "Socket error.\n" );
-
-		// Every second or so we should send an Alive command to the server.
-		// The alive packet is defined in GripPackets.h.
-		if ( send_alives ) {
-			_ftime32_s( &utctime );
-			if ( utctime.time > previous_alive_time ) {
-				static int alive_counter = 0;
-				previous_alive_time = utctime.time;
-				// printf( "Sending Alive command.\n" );
-				InsertEPMTransferFrameHeaderInfo( &epmPacket, &alivePacket );
-				if ( _debug ) printf( "Entering send() #%03d ... ", alive_counter++ );
-				iResult2 = send( ConnectSocket, epmPacket.buffer, alivePacketLengthInBytes, 0 );
-				if ( _debug ) printf( "returned.\n" );
-
-				// If we get a socket error it is probably because the client has closed the connection.
-				// So we break out of the loop.
-				if ( iResult2 == SOCKET_ERROR ) {
+			else if ( iResult == 0 ) printf( "Socket closed.\n" );
+			else printf( "Socket error.\n" );
+
+			// Every second or so we should send an Alive command to the server.
+			// The alive packet is defined in GripPackets.h.
+			if ( send_alives ) {
+				_ftime32_s( &utctime );
+				if ( utctime.time > previous_alive_time ) {
+					static int alive_counter = 0;
+					previous_alive_time = utctime.time;
+					// printf( "Sending Alive command.\n" );
+					InsertEPMTransferFrameHeaderInfo( &epmPacket, &alivePacket );
+					if ( _debug ) printf( "Entering send() #%03d ... ", alive_counter++ );
+					iResult2 = send( ConnectSocket, epmPacket.buffer, alivePacketLengthInBytes, 0 );
+					if ( _debug ) printf( "returned.\n" );
+
+					// If we get a socket error it is probably because the client has closed the connection.
+					// So we break out of the loop.
+					if ( iResult2 == SOCKET_ERROR ) {
 					
-					int error_code = WSAGetLastError();
-					printf( "Alive packet send #%d failed with error: %3d\n", alive_counter, error_code );
-					if ( error_code == WSAETIMEDOUT ) {
-						// If the server is not receiving the alive packets, the send() call will timeout, 
-						// thanks to the setsockopt() that was performed just after sending the Connect packet above.
-						// If this happens, we mark the socket as no longer valid which will stop sending Alive packets.
-						// This is implemented because 1) the CLWSEmulator.exe server does not recv() Alive 
-						//  packets and 2) I don't know for sure if the real CLWS Emulator is actively receiving them.
-						// If the real CLWS server is actively receiving them, this will never happen and Alive
-						//  packets will be sent indefinitely.
-						send_alives = false;
-						printf( "Further sending of Alive packets has been inhibited.\n" );
-					}
-					else {
-						// Show any other type of error.
-						printf( "Unrecoverable error. Press <Return> to exit.\n" );
-						getchar();
-						exit( -100 );
+						int error_code = WSAGetLastError();
+						printf( "Alive packet send #%d failed with error: %3d\n", alive_counter, error_code );
+						GripMetricsCount( GRIP_METRIC_ALIVE_FAILURES, 1 );
+						if ( error_code == WSAETIMEDOUT ) {
+							// If the server is not receiving the alive packets, the send() call will timeout, 
+							// thanks to the setsockopt() that was performed just after sending the Connect packet above.
+							// If this happens, we mark the socket as no longer valid which will stop sending Alive packets.
+							// This is implemented because 1) the CLWSEmulator.exe server does not recv() Alive 
+							//  packets and 2) I don't know for sure if the real CLWS Emulator is actively receiving them.
+							// If the real CLWS server is actively receiving them, this will never happen and Alive
+							//  packets will be sent indefinitely.
+							send_alives = false;
+							printf( "Further sending of Alive packets has been inhibited.\n" );
+						}
+						else {
+							// Any other error means that the connection has been lost.
+							printf( "Connection lost.\n" );
+							iResult = SOCKET_ERROR;
+						}
 					}
 				}
 			}
-		}
-		if ( _debug ) printf( "Cycle ended.\n" );
+			if ( _debug ) printf( "Cycle ended.\n" );
 
-	// Keep looping as long as we are receiving packets.
-    } while( iResult > 0 ); // End loop if connection is closed or on error.
+		// Keep looping as long as we are receiving packets.
+		} while( iResult > 0 ); // End loop if connection is closed or on error.
 	
-	// Show what caused us to exit the receiver loop.
-	if ( iResult == 0 )printf("\nConnection closed by host.\n");
-    else printf("\nrecv failed with error: %d\n", WSAGetLastError());
+		// Show what caused us to exit the receiver loop.
+		if ( iResult == 0 )printf("\nConnection closed by host.\n");
+		else printf("\nrecv failed with error: %d\n", WSAGetLastError());
+		disconnected = GripClockGPS();
+		GripMetricsSetConnected( FALSE );
+		closesocket(ConnectSocket);
+		// The part of a packet that was cut off by the disconnection is of no use.
+		if ( streamBytes > 0 ) {
+			skippedBytes += streamBytes;
+			GripMetricsCount( GRIP_METRIC_SKIPPED_BYTES, streamBytes );
+			streamBytes = 0;
+			GripMetricsSetQueueDepth( 0 );
+		}
+		printf( "Packets received: %lu RT %lu HK %lu total. Bytes skipped: %lu\n", rtCount, hkCount, anyCount, skippedBytes );
+
+		// Unless asked to stop after a given number of connections, go back and connect again.
+		if ( max_connections > 0 && connections >= max_connections ) break;
+		// Wait before connecting again, starting over with a short delay only if the server was sending.
+		if ( connection_packets > 0 ) delay = RECONNECT_INITIAL_DELAY;
+		printf( "Reconnecting to host %s on port %s in %d ms.\n", server_name, EPMport, delay );
+		Sleep( delay );
+		delay *= 2;
+		if ( delay > RECONNECT_MAX_DELAY ) delay = RECONNECT_MAX_DELAY;
+	}
+	// We no longer need the address info.
+    freeaddrinfo(result);
+
+	printf( "Connections: %d\n", connections );
+	if ( metricsFilePath && GripMetricsWrite( metricsFilePath ) ) printf( "Error writing metrics to %s.\n", metricsFilePath );
+	if ( record_latency ) {
+		printf( "RT packet latency from the time stamp on board:\n" );
+		GripLatencyPrintSummary( stdout, GripLatencyStageName[GRIP_LATENCY_RECEIVE], &latency[GRIP_LATENCY_RECEIVE] );
+		GripLatencyPrintSummary( stdout, GripLatencyStageName[GRIP_LATENCY_CACHE_WRITE], &latency[GRIP_LATENCY_CACHE_WRITE] );
+	}
+	if ( traceFilePath ) {
+#ifndef GRIP_TRACE
+		printf( "Built without GRIP_TRACE. The trace will be empty.\n" );
+#endif
+		if ( TraceWrite( traceFilePath ) ) printf( "Error writing the trace to %s.\n", traceFilePath );
+		else printf( "Trace written to %s.\n", traceFilePath );
+	}
 
-    // In this version, if the server closes the connection, we quit as well.
-	// In a future versions, we could go back to listen for a connection again.
-    closesocket(ConnectSocket);
     WSACleanup();
 
 	// Make sure that the user sees the final message by requiring a keyboard input.
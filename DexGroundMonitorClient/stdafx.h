@@ -9,6 +9,7 @@
 
 #define WIN32_LEAN_AND_MEAN
 
+#ifdef _WIN32
 #include <windows.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -21,3 +22,8 @@
 #include <share.h>
 #include <sys\stat.h>
 #include <SYS\timeb.h>
+#else
+// Linux build (see CMakeLists.txt).
+#include <stdarg.h>
+#include "../Useful/Portability.h"
+#endif
@@ -10,19 +10,24 @@
 // This code was written when developing and testing the algorithms for the 
 //  DEX (now GRIP) hardware. It has be reused in the devepment of the GripMMI.
 
+#ifdef _WIN32
 #include <windows.h>
 #include <mmsystem.h>
+#include <process.h>
+#else
+#include "../Useful/Portability.h"
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <time.h> 
 #include <memory.h>
-#include <process.h>
 
-#include "..\Useful\fMessageBox.h"
-#include "..\Useful\VectorsMixin.h"
-#include "..\Useful\Useful.h"
+#include "../Useful/fMessageBox.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Useful.h"
+#include "../Useful/Trace.h"
 
 #include "DexAnalogMixin.h"
 
@@ -212,4 +217,207 @@ double DexAnalogMixin::FilterNormalForce( double normal_force, int ati ) {
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Filter bank.
+
+DexFilterBank::DexFilterBank( void ) {
+	ClearChannels();
+	SetFilterConstant( 100.0 );
+}
+
+void DexFilterBank::SetFilterConstant( double filter_constant ) {
+	filterConstant = filter_constant;
+}
+
+double DexFilterBank::GetFilterConstant( void ) {
+	return( filterConstant );
+}
+
+int DexFilterBank::AddChannel( int flags, double *input, double *output, int stride, double *key ) {
+
+	DexFilterChannel *channel;
+
+	if ( flags & DEX_FILTER_VECTOR ) {
+		if ( nVectorChannels >= DEX_FILTER_MAX_CHANNELS ) return( -1 );
+		vectorState[nVectorChannels] = 0.0;
+		channel = &vectorChannel[nVectorChannels++];
+	}
+	else {
+		if ( nScalarChannels >= DEX_FILTER_MAX_CHANNELS ) return( -1 );
+		scalarState[nScalarChannels] = 0.0;
+		channel = &scalarChannel[nScalarChannels++];
+	}
+	channel->input = input;
+	channel->output = output;
+	channel->key = ( key ? key : input );
+	channel->stride = stride;
+	channel->single = ( ( flags & DEX_FILTER_SINGLE ) != 0 );
+	return( nVectorChannels + nScalarChannels - 1 );
+
+}
+
+void DexFilterBank::ClearChannels( void ) {
+	nVectorChannels = 0;
+	nScalarChannels = 0;
+}
+
+void DexFilterBank::ResetState( void ) {
+	for ( int ch = 0; ch < nVectorChannels; ch++ ) vectorState[ch] = 0.0;
+	for ( int ch = 0; ch < nScalarChannels; ch++ ) scalarState[ch] = 0.0;
+}
+
+// Copy a block of frames for a set of channels into a frame-major buffer, 
+//  so that the channels for a given frame lie next to each other in memory.
+static void GatherBlock( DexFilterChannel channel[], int n_channels, int first_frame, int n_frames, 
+						 double sample[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS], 
+						 bool skip[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS] ) {
+	for ( int ch = 0; ch < n_channels; ch++ ) {
+		double *in = channel[ch].input + (size_t) first_frame * channel[ch].stride;
+		double *key = channel[ch].key + (size_t) first_frame * channel[ch].stride;
+		for ( int i = 0; i < n_frames; i++, in += channel[ch].stride, key += channel[ch].stride ) {
+			sample[i][ch] = *in;
+			skip[i][ch] = ( *key == MISSING_DOUBLE || !_finite( *key ) );
+		}
+	}
+}
+
+// Skipped samples are copied as is, so that MISSING_DOUBLE is not lost by rounding to single precision.
+static void ScatterBlock( DexFilterChannel channel[], int n_channels, int first_frame, int n_frames, 
+						  double sample[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS],
+						  bool skip[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS] ) {
+	for ( int ch = 0; ch < n_channels; ch++ ) {
+		double *out = channel[ch].output + (size_t) first_frame * channel[ch].stride;
+		if ( channel[ch].single ) {
+			for ( int i = 0; i < n_frames; i++, out += channel[ch].stride ) *out = ( skip[i][ch] ? sample[i][ch] : (float) sample[i][ch] );
+		}
+		else {
+			for ( int i = 0; i < n_frames; i++, out += channel[ch].stride ) *out = sample[i][ch];
+		}
+	}
+}
+
+// One thread's share of the channels.
+typedef struct {
+	DexFilterChannel	*vector_channel;
+	double				*vector_state;
+	int					n_vector;
+	DexFilterChannel	*scalar_channel;
+	double				*scalar_state;
+	int					n_scalar;
+	int					first_frame;
+	int					last_frame;
+	double				constant;
+} DexFilterJob;
+
+static void FilterChannels( DexFilterJob *job ) {
+
+	// Working storage for one block of frames, frame-major.
+	double	sample[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS];
+	bool	skip[DEX_FILTER_BLOCK][DEX_FILTER_MAX_CHANNELS];
+
+	double k = job->constant;
+	double r = 1.0 / ( 1.0 + job->constant );
+	double d = 1.0 + job->constant;
+
+	double *vector_state = job->vector_state;
+	double *scalar_state = job->scalar_state;
+	int n_vector = job->n_vector;
+	int n_scalar = job->n_scalar;
+
+	TRACE_FUNCTION();
+
+	for ( int block = job->first_frame; block <= job->last_frame; block += DEX_FILTER_BLOCK ) {
+
+		int n = job->last_frame - block + 1;
+		if ( n > DEX_FILTER_BLOCK ) n = DEX_FILTER_BLOCK;
+
+		// Channels from vectors. Same arithmetic as ScaleVector(), AddVectors(), ScaleVector().
+		GatherBlock( job->vector_channel, n_vector, block, n, sample, skip );
+		for ( int i = 0; i < n; i++ ) {
+			double *x = sample[i];
+			bool *s = skip[i];
+			for ( int ch = 0; ch < n_vector; ch++ ) {
+				double y = (double) (float) vector_state[ch] * k;
+				y = y + x[ch];
+				y = (double) (float) y * r;
+				vector_state[ch] = ( s[ch] ? vector_state[ch] : y );
+				x[ch] = ( s[ch] ? x[ch] : y );
+			}
+		}
+		ScatterBlock( job->vector_channel, n_vector, block, n, sample, skip );
+
+		// Scalar channels. Same arithmetic as FilterGripForce() and FilterNormalForce().
+		GatherBlock( job->scalar_channel, n_scalar, block, n, sample, skip );
+		for ( int i = 0; i < n; i++ ) {
+			double *x = sample[i];
+			bool *s = skip[i];
+			for ( int ch = 0; ch < n_scalar; ch++ ) {
+				double y = ( x[ch] + k * scalar_state[ch] ) / d;
+				scalar_state[ch] = ( s[ch] ? scalar_state[ch] : y );
+				x[ch] = ( s[ch] ? x[ch] : y );
+			}
+		}
+		ScatterBlock( job->scalar_channel, n_scalar, block, n, sample, skip );
+
+	}
+}
+
+static DWORD WINAPI FilterWorker( LPVOID param ) {
+	FilterChannels( (DexFilterJob *) param );
+	TRACE_THREAD_END();
+	return( 0 );
+}
+
+// The channels are independent of each other, so they can be divided between threads.
+// If n_threads is 0, one thread is used per processor.
+void DexFilterBank::Filter( int first_frame, int last_frame, int n_threads ) {
+
+	DexFilterJob	job[DEX_FILTER_MAX_THREADS];
+	HANDLE			thread[DEX_FILTER_MAX_THREADS];
+	int				started, w;
+
+	TRACE_FUNCTION();
+	if ( last_frame < first_frame ) return;
+
+	if ( n_threads <= 0 ) {
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		n_threads = info.dwNumberOfProcessors;
+	}
+	if ( n_threads > DEX_FILTER_MAX_THREADS ) n_threads = DEX_FILTER_MAX_THREADS;
+	if ( n_threads > nVectorChannels + nScalarChannels ) n_threads = nVectorChannels + nScalarChannels;
+	// Not worth starting threads for a few frames.
+	if ( last_frame - first_frame < DEX_FILTER_THREAD_FRAMES ) n_threads = 1;
+	if ( n_threads < 1 ) n_threads = 1;
+
+	// Deal out contiguous shares of each kind of channel.
+	for ( w = 0; w < n_threads; w++ ) {
+		int v0 = w * nVectorChannels / n_threads, v1 = ( w + 1 ) * nVectorChannels / n_threads;
+		int s0 = w * nScalarChannels / n_threads, s1 = ( w + 1 ) * nScalarChannels / n_threads;
+		job[w].vector_channel = &vectorChannel[v0];
+		job[w].vector_state = &vectorState[v0];
+		job[w].n_vector = v1 - v0;
+		job[w].scalar_channel = &scalarChannel[s0];
+		job[w].scalar_state = &scalarState[s0];
+		job[w].n_scalar = s1 - s0;
+		job[w].first_frame = first_frame;
+		job[w].last_frame = last_frame;
+		job[w].constant = filterConstant;
+	}
+
+	// The calling thread does its share too. If a thread cannot be started, 
+	//  the caller does that share as well.
+	for ( started = 1; started < n_threads; started++ ) {
+		thread[started] = CreateThread( NULL, 0, FilterWorker, &job[started], 0, NULL );
+		if ( !thread[started] ) break;
+	}
+	for ( w = started; w < n_threads; w++ ) FilterChannels( &job[w] );
+	FilterChannels( &job[0] );
+	for ( w = 1; w < started; w++ ) {
+		WaitForSingleObject( thread[w], INFINITE );
+		CloseHandle( thread[w] );
+	}
+}
+
 
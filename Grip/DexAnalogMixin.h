@@ -7,7 +7,7 @@
 
 #pragma once
 
-#include "..\Useful\VectorsMixin.h"
+#include "../Useful/VectorsMixin.h"
 
 #define N_FORCE_TRANSDUCERS		2
 #define DEFAULT_COP_THRESHOLD	0.25
@@ -73,3 +73,67 @@ public:
 	double FilterAcceleration( Vector3 acceleration );
 
 };
+
+// A bank of the same recursive filters, applied to whole blocks of frames at once.
+// Each channel is one scalar component of a data array (e.g. the Y component of 
+//  the manipulandum position). The channels are stepped together, one frame at a time,
+//  so that the arithmetic for all the channels is done in a single loop that the 
+//  compiler can vectorize. The result is identical to calling the per-sample methods
+//  above frame by frame.
+
+#define DEX_FILTER_MAX_CHANNELS	32
+#define DEX_FILTER_BLOCK		64
+#define DEX_FILTER_MAX_THREADS	8
+// Below this many frames, filtering is done in the calling thread only.
+#define DEX_FILTER_THREAD_FRAMES	20000
+
+// The per-sample vector filters go through ScaleVector(), which rounds the values
+//  to single precision along the way. Channels taken from vectors are flagged so that
+//  the bank does the same. Scalar channels are filtered in double precision.
+#define DEX_FILTER_SCALAR		0x00
+#define DEX_FILTER_VECTOR		0x01
+// The filtered value is rounded to single precision when it is stored.
+#define DEX_FILTER_SINGLE		0x02
+
+typedef struct {
+	double	*input;
+	double	*output;
+	// A frame is skipped, i.e. copied through without changing the state of the filter,
+	//  if the key is MISSING_DOUBLE or not a finite number. By default the key is the input.
+	double	*key;
+	int		stride;		// Distance in doubles from one frame to the next.
+	bool	single;
+} DexFilterChannel;
+
+class DexFilterBank {
+
+public:
+
+	DexFilterBank( void );
+
+	double	filterConstant;
+	void SetFilterConstant( double constant = 0.0 );
+	double GetFilterConstant( void );
+
+	// Define the channels. Output may be the same as the input to filter in place.
+	// Returns the number of the channel, or -1 if there are already too many.
+	int  AddChannel( int flags, double *input, double *output, int stride, double *key = NULL );
+	void ClearChannels( void );
+
+	// Set the state of all the filters back to zero.
+	void ResetState( void );
+
+	// Filter frames first_frame to last_frame, inclusive, carrying the state over from the last call.
+	// The channels can be shared out between n_threads threads. 0 means one per processor.
+	void Filter( int first_frame, int last_frame, int n_threads = 1 );
+
+private:
+
+	int					nVectorChannels;
+	int					nScalarChannels;
+	DexFilterChannel	vectorChannel[DEX_FILTER_MAX_CHANNELS];
+	DexFilterChannel	scalarChannel[DEX_FILTER_MAX_CHANNELS];
+	double				vectorState[DEX_FILTER_MAX_CHANNELS];
+	double				scalarState[DEX_FILTER_MAX_CHANNELS];
+
+};
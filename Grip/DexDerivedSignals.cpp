@@ -0,0 +1,180 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                             DexDerivedSignals.cpp                             */
+/*                                                                               */
+/*********************************************************************************/
+
+// Velocity, jerk and grip force / load force coordination computed from Dex (Grip) data.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#ifndef _WIN32
+#include "../Useful/Portability.h"
+#endif
+#include <limits.h>
+
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Useful.h"
+
+#include "DexDerivedSignals.h"
+
+/***************************************************************************/
+
+DexDerivedSignals::DexDerivedSignals( void ) {
+	memset( &column, 0, sizeof( column ) );
+	samplePeriod = DEX_DERIVED_SAMPLE_PERIOD;
+	SetBreaks( NULL, NULL );
+	Reset();
+}
+
+void DexDerivedSignals::SetColumns( DexDerivedColumns *columns ) {
+	column = *columns;
+	Reset();
+}
+
+void DexDerivedSignals::SetSamplePeriod( double period ) {
+	samplePeriod = period;
+}
+
+void DexDerivedSignals::SetBreaks( const int *break_frame, const int *n_breaks ) {
+	breakFrame = break_frame;
+	nBreaks = n_breaks;
+}
+
+// The first break after the given frame, or INT_MAX if there is none.
+int DexDerivedSignals::NextBreak( int frame ) {
+	if ( !breakFrame || !nBreaks ) return( INT_MAX );
+	int low = 0, high = *nBreaks;
+	while ( low < high ) {
+		int middle = ( low + high ) / 2;
+		if ( breakFrame[middle] <= frame ) low = middle + 1;
+		else high = middle;
+	}
+	return( low < *nBreaks ? breakFrame[low] : INT_MAX );
+}
+
+void DexDerivedSignals::Reset( void ) {
+	originFrame = 0;
+	nextFrame = -1;
+}
+
+static inline bool Available( double value ) {
+	return( value != MISSING_DOUBLE && _finite( value ) != 0 );
+}
+
+// Start the computation over at the given frame.
+void DexDerivedSignals::Restart( int frame ) {
+	originFrame = frame;
+	nextFrame = frame;
+	sinceRefresh = 0;
+	memset( sums, 0, sizeof( sums ) );
+}
+
+// Add (sign = 1) or remove (sign = -1) the pairs of grip and load force samples
+//  for which the later of the two is in the given frame.
+void DexDerivedSignals::Accumulate( int frame, int sign ) {
+
+	for ( int k = - DEX_DERIVED_MAX_LAG; k <= DEX_DERIVED_MAX_LAG; k++ ) {
+
+		int g_frame = ( k >= 0 ? frame : frame + k );
+		int l_frame = ( k >= 0 ? frame - k : frame );
+		if ( g_frame < originFrame || l_frame < originFrame ) continue;
+
+		double g = column.grip_force[g_frame];
+		double l = column.load_force[l_frame];
+		if ( !Available( g ) || !Available( l ) ) continue;
+
+		DexCorrelationSums *s = &sums[k + DEX_DERIVED_MAX_LAG];
+		s->n += sign;
+		s->g += sign * g;
+		s->l += sign * l;
+		s->gg += sign * g * g;
+		s->ll += sign * l * l;
+		s->gl += sign * g * l;
+
+	}
+}
+
+// Adding and removing values from the running sums slowly accumulates rounding errors.
+// Every now and then the sums are recomputed from the frames in the window.
+void DexDerivedSignals::Refresh( int frame ) {
+	memset( sums, 0, sizeof( sums ) );
+	for ( int f = frame - DEX_DERIVED_WINDOW + 1; f <= frame; f++ ) {
+		if ( f >= originFrame ) Accumulate( f, 1 );
+	}
+	sinceRefresh = 0;
+}
+
+void DexDerivedSignals::DeriveFrame( int frame ) {
+
+	int previous = frame - 1;
+	int i;
+
+	// Finite differences with respect to the previous frame.
+	bool have_dt = ( previous >= originFrame && Available( column.time[frame] ) && Available( column.time[previous] )
+						&& column.time[frame] > column.time[previous] );
+	double dt = ( have_dt ? column.time[frame] - column.time[previous] : 1.0 );
+
+	if ( have_dt && Available( column.position[frame][X] ) && Available( column.position[previous][X] ) ) {
+		for ( i = X; i <= Z; i++ ) column.velocity[frame][i] = ( column.position[frame][i] - column.position[previous][i] ) / dt;
+	}
+	else for ( i = X; i <= Z; i++ ) column.velocity[frame][i] = MISSING_DOUBLE;
+
+	if ( have_dt && Available( column.acceleration[frame][X] ) && Available( column.acceleration[previous][X] ) ) {
+		for ( i = X; i <= Z; i++ ) column.jerk[frame][i] = ( column.acceleration[frame][i] - column.acceleration[previous][i] ) / dt;
+	}
+	else for ( i = X; i <= Z; i++ ) column.jerk[frame][i] = MISSING_DOUBLE;
+
+	// The ratio is meaningless when there is (almost) no load.
+	double g = column.grip_force[frame];
+	double l = column.load_force[frame];
+	if ( Available( g ) && Available( l ) && fabs( l ) >= DEX_DERIVED_MIN_LOAD_FORCE ) column.ratio[frame] = g / l;
+	else column.ratio[frame] = MISSING_DOUBLE;
+
+	// Slide the window forward by one frame.
+	if ( ++sinceRefresh >= DEX_DERIVED_REFRESH ) Refresh( frame );
+	else {
+		Accumulate( frame, 1 );
+		if ( frame - DEX_DERIVED_WINDOW >= originFrame ) Accumulate( frame - DEX_DERIVED_WINDOW, -1 );
+	}
+
+	// Find the lag with the highest correlation coefficient.
+	double best = - 2.0;
+	int best_lag = 0;
+	for ( int k = - DEX_DERIVED_MAX_LAG; k <= DEX_DERIVED_MAX_LAG; k++ ) {
+		DexCorrelationSums *s = &sums[k + DEX_DERIVED_MAX_LAG];
+		if ( s->n < DEX_DERIVED_MIN_PAIRS ) continue;
+		double var_g = s->n * s->gg - s->g * s->g;
+		double var_l = s->n * s->ll - s->l * s->l;
+		if ( var_g <= 0.0 || var_l <= 0.0 ) continue;
+		double r = ( s->n * s->gl - s->g * s->l ) / sqrt( var_g * var_l );
+		if ( r > best ) {
+			best = r;
+			best_lag = k;
+		}
+	}
+	column.lag[frame] = ( best > -2.0 ? best_lag * samplePeriod : MISSING_DOUBLE );
+
+}
+
+void DexDerivedSignals::Update( int first_frame, int last_frame ) {
+
+	if ( !column.time || last_frame < first_frame ) return;
+
+	// Carry on from where we left off if we can. Otherwise start over.
+	if ( first_frame != nextFrame ) Restart( first_frame );
+	int next_break = NextBreak( first_frame - 1 );
+	for ( int frame = first_frame; frame <= last_frame; frame++ ) {
+		if ( frame == next_break ) {
+			Restart( frame );
+			next_break = NextBreak( frame );
+		}
+		DeriveFrame( frame );
+	}
+	nextFrame = last_frame + 1;
+
+}
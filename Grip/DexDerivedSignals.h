@@ -0,0 +1,101 @@
+/********************************************************************************/
+
+//
+// DexDerivedSignals.h
+// Signals derived from the filtered Dex (Grip) data.
+//
+
+#pragma once
+
+#include "../Useful/VectorsMixin.h"
+
+// Computes, frame by frame, values that are not measured directly:
+//  - velocity of the manipulandum, by finite differences of the position.
+//  - jerk, by finite differences of the measured acceleration.
+//  - the ratio of grip force to load force.
+//  - the lag between grip force and load force that gives the highest correlation
+//     over a sliding window.
+//
+// The columns are brought up to date as frames are appended. When Update() continues
+//  from the frame where the previous call left off, only the new frames are computed.
+//  The correlation is maintained with running sums over the window, so the cost per frame
+//  does not depend on the length of the window. Otherwise the computation starts over at
+//  the first frame specified, and does not look at the frames that come before it.
+//
+// Values that cannot be computed (missing inputs, load force too small for the ratio,
+//  too few samples in the window for the correlation) are set to MISSING_DOUBLE.
+//
+// At a break in the stream of packets (see SetBreaks()), the computation starts over as well,
+//  so that no differences or correlations are computed across the break.
+
+#define DEX_DERIVED_MIN_LOAD_FORCE	0.5
+#define DEX_DERIVED_WINDOW			40
+#define DEX_DERIVED_MAX_LAG			10
+#define DEX_DERIVED_LAGS			( 2 * DEX_DERIVED_MAX_LAG + 1 )
+#define DEX_DERIVED_MIN_PAIRS		20
+#define DEX_DERIVED_REFRESH			4096
+#define DEX_DERIVED_SAMPLE_PERIOD	0.05
+
+// The arrays from which the signals are derived, and the arrays where they are stored.
+// All are indexed by frame.
+typedef struct {
+	double	*time;
+	Vector3	*position;
+	Vector3	*acceleration;
+	double	*grip_force;
+	double	*load_force;
+	Vector3	*velocity;
+	Vector3	*jerk;
+	double	*ratio;
+	double	*lag;
+} DexDerivedColumns;
+
+// Running sums for the correlation at one lag.
+typedef struct {
+	int		n;
+	double	g, l, gg, ll, gl;
+} DexCorrelationSums;
+
+class DexDerivedSignals : public VectorsMixin {
+
+public:
+
+	DexDerivedSignals( void );
+
+	void SetColumns( DexDerivedColumns *columns );
+
+	// Nominal time between frames, in seconds, used to express the lag in seconds.
+	void SetSamplePeriod( double period );
+
+	// Frames that start a new stretch of data, in increasing order, and how many there are.
+	// The table belongs to the caller and is looked at each time Update() is called.
+	void SetBreaks( const int *break_frame, const int *n_breaks );
+
+	// Compute the derived values for frames first_frame to last_frame, inclusive.
+	void Update( int first_frame, int last_frame );
+
+	// Forget where the last update left off, so that the next one starts over.
+	void Reset( void );
+
+private:
+
+	DexDerivedColumns	column;
+	double				samplePeriod;
+
+	int		originFrame;
+	int		nextFrame;
+	int		sinceRefresh;
+
+	const int	*breakFrame;
+	const int	*nBreaks;
+
+	// Lag k (in frames, positive when the grip force follows the load force) is in element k + DEX_DERIVED_MAX_LAG.
+	DexCorrelationSums	sums[DEX_DERIVED_LAGS];
+
+	void Restart( int frame );
+	int  NextBreak( int frame );
+	void Accumulate( int frame, int sign );
+	void Refresh( int frame );
+	void DeriveFrame( int frame );
+
+};
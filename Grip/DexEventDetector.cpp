@@ -0,0 +1,210 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                              DexEventDetector.cpp                             */
+/*                                                                               */
+/*********************************************************************************/
+
+// Online detection of grip, load, movement, collision and slip events in Dex (Grip) data.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#ifndef _WIN32
+#include "../Useful/Portability.h"
+#endif
+
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Useful.h"
+
+#include "DexAnalogMixin.h"
+#include "DexEventDetector.h"
+
+/***************************************************************************/
+
+DexEventDetector::DexEventDetector( void ) {
+
+	grip.on = DEX_GRIP_ON_THRESHOLD;
+	grip.off = DEX_GRIP_OFF_THRESHOLD;
+	load.on = DEX_LOAD_ON_THRESHOLD;
+	load.off = DEX_LOAD_OFF_THRESHOLD;
+	movement.on = DEX_MOVE_ON_THRESHOLD;
+	movement.off = DEX_MOVE_OFF_THRESHOLD;
+	collision.on = DEX_COLLISION_ON_THRESHOLD;
+	collision.off = DEX_COLLISION_OFF_THRESHOLD;
+	slipThreshold = DEX_SLIP_THRESHOLD;
+
+	Reset();
+
+}
+
+static inline bool Available( double value ) {
+	return( value != MISSING_DOUBLE && _finite( value ) != 0 );
+}
+
+void DexEventDetector::Reset( void ) {
+	for ( int type = 0; type < DEX_EVENT_TYPES; type++ ) nEvents[type] = 0;
+	overflow = false;
+	gripping = loading = moving = colliding = slipping = false;
+	previousFrame = -1;
+	previousTime = MISSING_DOUBLE;
+	positionTime = MISSING_DOUBLE;
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) previousCoP[ati][X] = MISSING_DOUBLE;
+	previousPosition[X] = MISSING_DOUBLE;
+}
+
+void DexEventDetector::AddEvent( int type, int frame, double time, double value ) {
+	if ( nEvents[type] >= DEX_MAX_EVENTS ) {
+		overflow = true;
+		return;
+	}
+	event[type][nEvents[type]].frame = frame;
+	event[type][nEvents[type]].time = time;
+	event[type][nEvents[type]].value = value;
+	nEvents[type]++;
+}
+
+// Switch on when the value goes above the 'on' threshold, and off only when
+//  it drops below the 'off' threshold. Returns the new state.
+bool DexEventDetector::Hysteresis( bool state, DexHysteresis *thresholds, double value, int on_event, int off_event, int frame, double time ) {
+	if ( !Available( value ) ) return( state );
+	if ( !state && value > thresholds->on ) {
+		AddEvent( on_event, frame, time, value );
+		return( true );
+	}
+	if ( state && value < thresholds->off ) {
+		AddEvent( off_event, frame, time, value );
+		return( false );
+	}
+	return( state );
+}
+
+// When there is a break in the data, whatever was going on is considered to have
+//  ended with the last frame before the break.
+void DexEventDetector::EndEpisodes( void ) {
+
+	if ( previousFrame >= 0 ) {
+		if ( gripping ) {
+			AddEvent( DEX_GRIP_OFF, previousFrame, previousTime, MISSING_DOUBLE );
+			AddEvent( DEX_GRIP_PEAK, peak.frame, peak.time, peak.value );
+		}
+		if ( loading ) AddEvent( DEX_LOAD_OFF, previousFrame, previousTime, MISSING_DOUBLE );
+		if ( moving ) AddEvent( DEX_MOVE_OFF, previousFrame, previousTime, MISSING_DOUBLE );
+	}
+	gripping = loading = moving = colliding = slipping = false;
+	previousFrame = -1;
+	previousPosition[X] = MISSING_DOUBLE;
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) previousCoP[ati][X] = MISSING_DOUBLE;
+
+}
+
+void DexEventDetector::Break( void ) {
+	EndEpisodes();
+}
+
+void DexEventDetector::ProcessFrame( int frame, double time, Vector3 position, Vector3 acceleration,
+									  double grip_force, Vector3 load_force, Vector3 cop[N_FORCE_TRANSDUCERS] ) {
+
+	int ati;
+
+	if ( !Available( time ) ) {
+		EndEpisodes();
+		return;
+	}
+
+	// Grip. Keep track of the highest grip force while the object is held.
+	bool was_gripping = gripping;
+	gripping = Hysteresis( gripping, &grip, grip_force, DEX_GRIP_ON, DEX_GRIP_OFF, frame, time );
+	if ( gripping && Available( grip_force ) && ( !was_gripping || grip_force > peak.value ) ) {
+		peak.frame = frame;
+		peak.time = time;
+		peak.value = grip_force;
+	}
+	if ( was_gripping && !gripping ) AddEvent( DEX_GRIP_PEAK, peak.frame, peak.time, peak.value );
+
+	// Load.
+	if ( Available( load_force[X] ) ) loading = Hysteresis( loading, &load, VectorNorm( load_force ), DEX_LOAD_ON, DEX_LOAD_OFF, frame, time );
+
+	// Movement. The speed is computed from the previous frame in which the manipulandum was visible.
+	if ( Available( position[X] ) ) {
+		if ( Available( previousPosition[X] ) && time > positionTime ) {
+			Vector3 delta;
+			SubtractVectors( delta, position, previousPosition );
+			moving = Hysteresis( moving, &movement, VectorNorm( delta ) / ( time - positionTime ), DEX_MOVE_ON, DEX_MOVE_OFF, frame, time );
+		}
+		CopyVector( previousPosition, position );
+		positionTime = time;
+	}
+
+	// Collisions. Only the onset is reported.
+	if ( Available( acceleration[X] ) ) {
+		double magnitude = VectorNorm( acceleration );
+		if ( !colliding && magnitude > collision.on ) {
+			AddEvent( DEX_COLLISION, frame, time, magnitude );
+			colliding = true;
+		}
+		else if ( colliding && magnitude < collision.off ) colliding = false;
+	}
+
+	// Slips. A jump of the center of pressure on either finger while the object is held.
+	// A slip that goes on over several frames is reported once.
+	double jump = 0.0;
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		if ( Available( cop[ati][X] ) && Available( previousCoP[ati][X] ) ) {
+			Vector3 delta;
+			SubtractVectors( delta, cop[ati], previousCoP[ati] );
+			double distance = VectorNorm( delta );
+			if ( distance > jump ) jump = distance;
+		}
+		if ( Available( cop[ati][X] ) ) CopyVector( previousCoP[ati], cop[ati] );
+		else previousCoP[ati][X] = MISSING_DOUBLE;
+	}
+	if ( gripping && jump > slipThreshold ) {
+		if ( !slipping ) AddEvent( DEX_SLIP, frame, time, jump );
+		slipping = true;
+	}
+	else slipping = false;
+
+	// Remember the last frame for EndEpisodes().
+	previousFrame = frame;
+	previousTime = time;
+
+}
+
+int DexEventDetector::Events( int type ) {
+	if ( type < 0 || type >= DEX_EVENT_TYPES ) return( 0 );
+	return( nEvents[type] );
+}
+
+DexEvent *DexEventDetector::Event( int type, int index ) {
+	if ( type < 0 || type >= DEX_EVENT_TYPES || index < 0 || index >= nEvents[type] ) return( NULL );
+	return( &event[type][index] );
+}
+
+bool DexEventDetector::Overflow( void ) {
+	return( overflow );
+}
+
+int DexEventDetector::FindEventAfter( int type, double time ) {
+	if ( type < 0 || type >= DEX_EVENT_TYPES ) return( 0 );
+	int low = 0, high = nEvents[type];
+	while ( low < high ) {
+		int middle = ( low + high ) / 2;
+		if ( event[type][middle].time < time ) low = middle + 1;
+		else high = middle;
+	}
+	return( low );
+}
+
+int DexEventDetector::FindEventBefore( int type, double time ) {
+	if ( type < 0 || type >= DEX_EVENT_TYPES ) return( -1 );
+	int low = 0, high = nEvents[type];
+	while ( low < high ) {
+		int middle = ( low + high ) / 2;
+		if ( event[type][middle].time <= time ) low = middle + 1;
+		else high = middle;
+	}
+	return( low - 1 );
+}
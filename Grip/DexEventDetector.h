@@ -0,0 +1,121 @@
+/********************************************************************************/
+
+//
+// DexEventDetector.h
+// Online detection of events in the Dex (Grip) data.
+//
+
+#pragma once
+
+#include "../Useful/VectorsMixin.h"
+#include "DexAnalogMixin.h"
+
+// Frames are fed to the detector one at a time, as they are decoded, and the events
+//  that are found are added to a table. Each frame takes a fixed amount of work.
+//
+// The events are:
+//  - onset and offset of the grip, of the load and of movements, found by comparing
+//     the grip force, the load force magnitude and the speed of the manipulandum to a pair
+//     of thresholds (hysteresis), so that noise around a single threshold does not produce
+//     a string of events.
+//  - collisions, when the magnitude of the acceleration goes above a threshold (with hysteresis).
+//  - the peak grip force of each grip, reported when the grip ends.
+//  - slips, when the center of pressure on either transducer jumps between two frames
+//     while the object is gripped.
+//
+// The events of each type are kept in a separate list. Since a peak is only known
+//  after the fact, this keeps each list in time order, so that it can be searched
+//  by bisection.
+
+#define DEX_GRIP_ON			0
+#define DEX_GRIP_OFF		1
+#define DEX_GRIP_PEAK		2
+#define DEX_LOAD_ON			3
+#define DEX_LOAD_OFF		4
+#define DEX_MOVE_ON			5
+#define DEX_MOVE_OFF		6
+#define DEX_COLLISION		7
+#define DEX_SLIP			8
+#define DEX_EVENT_TYPES		9
+
+#define DEX_MAX_EVENTS		16384
+
+// Default thresholds (N, N, position units per second, g, m).
+#define DEX_GRIP_ON_THRESHOLD		2.0
+#define DEX_GRIP_OFF_THRESHOLD		1.0
+#define DEX_LOAD_ON_THRESHOLD		1.0
+#define DEX_LOAD_OFF_THRESHOLD		0.5
+#define DEX_MOVE_ON_THRESHOLD		100.0
+#define DEX_MOVE_OFF_THRESHOLD		50.0
+#define DEX_COLLISION_ON_THRESHOLD	1.5
+#define DEX_COLLISION_OFF_THRESHOLD	1.2
+#define DEX_SLIP_THRESHOLD			0.005
+
+typedef struct {
+	int		frame;
+	double	time;
+	double	value;
+} DexEvent;
+
+typedef struct {
+	double	on;
+	double	off;
+} DexHysteresis;
+
+class DexEventDetector : public VectorsMixin {
+
+public:
+
+	DexEventDetector( void );
+
+	DexHysteresis	grip;
+	DexHysteresis	load;
+	DexHysteresis	movement;
+	DexHysteresis	collision;
+	double			slipThreshold;
+
+	// Forget all events and start over.
+	void Reset( void );
+
+	// Process one frame. Values that were not measured are MISSING_DOUBLE. A frame
+	//  without a valid time marks a break in the data. Events in progress are ended.
+	void ProcessFrame( int frame, double time, Vector3 position, Vector3 acceleration,
+						double grip_force, Vector3 load_force, Vector3 cop[N_FORCE_TRANSDUCERS] );
+	// Signal a break in the data between the last frame processed and the next one.
+	void Break( void );
+
+	// Access to the event lists.
+	int  Events( int type );
+	DexEvent *Event( int type, int index );
+	bool Overflow( void );
+
+	// Index of the first event of the given type at or after the given time,
+	//  or Events( type ) if there is none.
+	int  FindEventAfter( int type, double time );
+	// Index of the last event of the given type at or before the given time, or -1.
+	int  FindEventBefore( int type, double time );
+
+private:
+
+	DexEvent	event[DEX_EVENT_TYPES][DEX_MAX_EVENTS];
+	int			nEvents[DEX_EVENT_TYPES];
+	bool		overflow;
+
+	// State carried from one frame to the next.
+	bool		gripping;
+	bool		loading;
+	bool		moving;
+	bool		colliding;
+	DexEvent	peak;
+	int			previousFrame;
+	double		previousTime;
+	Vector3		previousPosition;
+	double		positionTime;
+	Vector3		previousCoP[N_FORCE_TRANSDUCERS];
+	bool		slipping;
+
+	void AddEvent( int type, int frame, double time, double value );
+	bool Hysteresis( bool state, DexHysteresis *thresholds, double value, int on_event, int off_event, int frame, double time );
+	void EndEpisodes( void );
+
+};
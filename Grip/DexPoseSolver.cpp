@@ -0,0 +1,371 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                               DexPoseSolver.cpp                               */
+/*                                                                               */
+/*********************************************************************************/
+
+// Batch reconstruction of rigid body poses from Dex (Grip) marker data.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "../Useful/fMessageBox.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Useful.h"
+
+#include "DexPoseSolver.h"
+
+/***************************************************************************/
+
+DexPoseSolver::DexPoseSolver( void ) {
+	nMarkers = 0;
+}
+
+// If there are more markers than we can handle, only the first ones are used.
+int DexPoseSolver::SetModel( Vector3 model_markers[], int n_markers ) {
+	if ( n_markers > DEX_POSE_MAX_MARKERS ) n_markers = DEX_POSE_MAX_MARKERS;
+	if ( n_markers < 0 ) n_markers = 0;
+	for ( int mrk = 0; mrk < n_markers; mrk++ ) CopyVector( model[mrk], model_markers[mrk] );
+	nMarkers = n_markers;
+	return( nMarkers );
+}
+
+// Find the eigenvector of the symmetric 4x4 matrix n that goes with the largest eigenvalue,
+//  by Jacobi rotations. The matrix is destroyed in the process.
+// A handful of sweeps is enough to converge to machine precision for a 4x4.
+static void LargestEigenvector( double n[4][4], double result[4] ) {
+
+	double v[4][4] = {{1.0, 0.0, 0.0, 0.0}, {0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 1.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+	int p, q, r;
+
+	for ( int sweep = 0; sweep < DEX_POSE_JACOBI_SWEEPS; sweep++ ) {
+
+		double off = 0.0, diagonal = 0.0;
+		for ( p = 0; p < 4; p++ ) {
+			diagonal += n[p][p] * n[p][p];
+			for ( q = p + 1; q < 4; q++ ) off += n[p][q] * n[p][q];
+		}
+		if ( off <= DBL_EPSILON * DBL_EPSILON * diagonal ) break;
+
+		for ( p = 0; p < 3; p++ ) {
+			for ( q = p + 1; q < 4; q++ ) {
+
+				double npq = n[p][q];
+				if ( npq == 0.0 ) continue;
+
+				// Rotation that zeros n[p][q].
+				double theta = ( n[q][q] - n[p][p] ) / ( 2.0 * npq );
+				double t = 1.0 / ( fabs( theta ) + sqrt( theta * theta + 1.0 ) );
+				if ( theta < 0.0 ) t = - t;
+				double c = 1.0 / sqrt( t * t + 1.0 );
+				double s = t * c;
+				double tau = s / ( 1.0 + c );
+
+				n[p][p] -= t * npq;
+				n[q][q] += t * npq;
+				n[p][q] = n[q][p] = 0.0;
+				for ( r = 0; r < 4; r++ ) {
+					if ( r != p && r != q ) {
+						double nrp = n[r][p];
+						double nrq = n[r][q];
+						n[r][p] = n[p][r] = nrp - s * ( nrq + tau * nrp );
+						n[r][q] = n[q][r] = nrq + s * ( nrp - tau * nrq );
+					}
+					double vrp = v[r][p];
+					double vrq = v[r][q];
+					v[r][p] = vrp - s * ( vrq + tau * vrp );
+					v[r][q] = vrq + s * ( vrp - tau * vrq );
+				}
+			}
+		}
+	}
+
+	int largest = 0;
+	for ( p = 1; p < 4; p++ ) if ( n[p][p] > n[largest][largest] ) largest = p;
+	for ( r = 0; r < 4; r++ ) result[r] = v[r][largest];
+
+}
+
+// Determinant of the 3x3 matrix formed by rows r0, r1, r2 and columns c0, c1, c2 of m.
+static inline double Minor( double m[4][4], int r0, int r1, int r2, int c0, int c1, int c2 ) {
+	return( m[r0][c0] * ( m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1] )
+		  - m[r0][c1] * ( m[r1][c0] * m[r2][c2] - m[r1][c2] * m[r2][c0] )
+		  + m[r0][c2] * ( m[r1][c0] * m[r2][c1] - m[r1][c1] * m[r2][c0] ) );
+}
+
+// The same eigenvector, found more quickly in the usual case.
+// The largest eigenvalue is the largest root of the characteristic polynomial, which
+//  Newton's method reaches from above starting from an upper bound (Theobald, Acta Cryst. A, 2005).
+// Any non-zero column of the adjugate of (n - lambda I) is then an eigenvector.
+// If the largest eigenvalue is (nearly) degenerate, as when the markers are collinear,
+//  no column stands out and we fall back on the Jacobi method.
+static void HornEigenvector( double n[4][4], double s[3][3], double upper_bound, double result[4] ) {
+
+	double m[4][4];
+	double adjugate[4][4];
+	int r, c;
+
+	// Coefficients of the characteristic polynomial. There is no cubic term because the trace is zero.
+	double c2 = 0.0;
+	for ( r = 0; r < 3; r++ ) for ( c = 0; c < 3; c++ ) c2 += s[r][c] * s[r][c];
+	c2 *= -2.0;
+	double c1 = -8.0 * ( s[0][0] * ( s[1][1] * s[2][2] - s[1][2] * s[2][1] )
+					   - s[0][1] * ( s[1][0] * s[2][2] - s[1][2] * s[2][0] )
+					   + s[0][2] * ( s[1][0] * s[2][1] - s[1][1] * s[2][0] ) );
+	double c0 = n[0][0] * Minor( n, 1, 2, 3, 1, 2, 3 ) - n[0][1] * Minor( n, 1, 2, 3, 0, 2, 3 )
+			  + n[0][2] * Minor( n, 1, 2, 3, 0, 1, 3 ) - n[0][3] * Minor( n, 1, 2, 3, 0, 1, 2 );
+
+	// The largest eigenvalue is no smaller than any element of the diagonal.
+	double lower_bound = n[0][0];
+	for ( r = 1; r < 4; r++ ) if ( n[r][r] > lower_bound ) lower_bound = n[r][r];
+
+	// From above, Newton's method converges on the largest root without ever passing it.
+	// When the largest root is double, as with collinear markers, the slope vanishes at the
+	//  root and rounding can send a step past it, even onto another root. So we stop as
+	//  soon as the polynomial or its slope stops being positive, or a step would take us
+	//  below the lower bound or to where the slope is not positive.
+	double lambda = upper_bound;
+	for ( int iteration = 0; iteration < DEX_POSE_NEWTON_ITERATIONS; iteration++ ) {
+		double l2 = lambda * lambda;
+		double p = ( ( l2 + c2 ) * lambda + c1 ) * lambda + c0;
+		double dp = ( 4.0 * l2 + 2.0 * c2 ) * lambda + c1;
+		if ( p <= 0.0 || dp <= 0.0 ) break;
+		double step = p / dp;
+		double next = lambda - step;
+		if ( next < lower_bound || ( 4.0 * next * next + 2.0 * c2 ) * next + c1 <= 0.0 ) break;
+		lambda = next;
+		if ( fabs( step ) <= DEX_POSE_NEWTON_TOLERANCE * fabs( lambda ) ) break;
+	}
+
+	for ( r = 0; r < 4; r++ ) {
+		for ( c = 0; c < 4; c++ ) m[r][c] = n[r][c];
+		m[r][r] -= lambda;
+	}
+
+	// Rows and columns left once row or column i is taken away.
+	static const int others[4][3] = {{1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
+
+	// The adjugate of a symmetric matrix is symmetric, so we can work by rows.
+	int best = 0;
+	double best_norm = -1.0;
+	for ( r = 0; r < 4; r++ ) {
+		double norm = 0.0;
+		for ( c = 0; c < 4; c++ ) {
+			adjugate[r][c] = Minor( m, others[r][0], others[r][1], others[r][2], others[c][0], others[c][1], others[c][2] );
+			if ( ( r + c ) & 0x01 ) adjugate[r][c] = - adjugate[r][c];
+			norm += adjugate[r][c] * adjugate[r][c];
+		}
+		if ( norm > best_norm ) {
+			best_norm = norm;
+			best = r;
+		}
+	}
+
+	double scale = upper_bound * upper_bound * upper_bound;
+	if ( best_norm <= DEX_POSE_DEGENERATE * scale * scale ) {
+		LargestEigenvector( n, result );
+	}
+	else {
+		for ( c = 0; c < 4; c++ ) result[c] = adjugate[best][c];
+	}
+
+}
+
+static void SetMissingPose( DexPoseArrays *poses, int frame ) {
+	for ( int i = X; i <= Z; i++ ) poses->position[i][frame] = MISSING_DOUBLE;
+	for ( int i = X; i <= M; i++ ) poses->orientation[i][frame] = MISSING_DOUBLE;
+	poses->residual[frame] = MISSING_DOUBLE;
+}
+
+int DexPoseSolver::SolveFrames( DexMarkerArrays *markers, DexPoseArrays *poses, int first_frame, int last_frame ) {
+
+	int solved = 0;
+
+	for ( int frame = first_frame; frame <= last_frame; frame++ ) {
+
+		bool		visible[DEX_POSE_MAX_MARKERS];
+		Vector3		actual[DEX_POSE_MAX_MARKERS];
+		Vector3		model_centroid, actual_centroid;
+		double		spread;
+		Vector3		position;
+		Matrix3x3	s, rotation;
+		double		n[4][4];
+		double		q[4];
+		int			mrk, i, j, count = 0;
+
+		// Pick out the visible markers and compute the centroids.
+		CopyVector( model_centroid, zeroVector );
+		CopyVector( actual_centroid, zeroVector );
+		for ( mrk = 0; mrk < nMarkers; mrk++ ) {
+			actual[mrk][X] = markers->x[mrk][frame];
+			actual[mrk][Y] = markers->y[mrk][frame];
+			actual[mrk][Z] = markers->z[mrk][frame];
+			visible[mrk] = ( actual[mrk][X] != MISSING_DOUBLE && _finite( actual[mrk][X] )
+							&& _finite( actual[mrk][Y] ) && _finite( actual[mrk][Z] ) );
+			if ( visible[mrk] ) {
+				AddVectors( model_centroid, model_centroid, model[mrk] );
+				AddVectors( actual_centroid, actual_centroid, actual[mrk] );
+				count++;
+			}
+		}
+		if ( poses->visible ) poses->visible[frame] = count;
+		if ( count < DEX_POSE_MIN_MARKERS ) {
+			SetMissingPose( poses, frame );
+			continue;
+		}
+		for ( i = X; i <= Z; i++ ) {
+			model_centroid[i] /= (double) count;
+			actual_centroid[i] /= (double) count;
+		}
+
+		// Cross-covariance of the model and actual marker positions, relative to the centroids.
+		// Half the sum of the squared distances from the centroids is an upper bound on the eigenvalue we want.
+		CopyMatrix( s, zeroMatrix );
+		spread = 0.0;
+		for ( mrk = 0; mrk < nMarkers; mrk++ ) {
+			if ( visible[mrk] ) {
+				Vector3 m, a;
+				SubtractVectors( m, model[mrk], model_centroid );
+				SubtractVectors( a, actual[mrk], actual_centroid );
+				spread += 0.5 * ( DotProduct( m, m ) + DotProduct( a, a ) );
+				for ( i = X; i <= Z; i++ ) {
+					for ( j = X; j <= Z; j++ ) s[i][j] += m[i] * a[j];
+				}
+			}
+		}
+
+		// Horn's matrix, for the quaternion in the order scalar, x, y, z.
+		n[0][0] =   s[X][X] + s[Y][Y] + s[Z][Z];
+		n[1][1] =   s[X][X] - s[Y][Y] - s[Z][Z];
+		n[2][2] = - s[X][X] + s[Y][Y] - s[Z][Z];
+		n[3][3] = - s[X][X] - s[Y][Y] + s[Z][Z];
+		n[0][1] = n[1][0] = s[Y][Z] - s[Z][Y];
+		n[0][2] = n[2][0] = s[Z][X] - s[X][Z];
+		n[0][3] = n[3][0] = s[X][Y] - s[Y][X];
+		n[1][2] = n[2][1] = s[X][Y] + s[Y][X];
+		n[1][3] = n[3][1] = s[Z][X] + s[X][Z];
+		n[2][3] = n[3][2] = s[Y][Z] + s[Z][Y];
+		HornEigenvector( n, s, spread, q );
+
+		// q and -q are the same rotation. Keep the one with a positive scalar part.
+		double sign = ( q[0] < 0.0 ? -1.0 : 1.0 );
+		double norm = sign / sqrt( q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3] );
+		poses->orientation[M][frame] = q[0] * norm;
+		poses->orientation[X][frame] = q[1] * norm;
+		poses->orientation[Y][frame] = q[2] * norm;
+		poses->orientation[Z][frame] = q[3] * norm;
+
+		// Rotation matrix, such that actual = rotation * model + position.
+		double w = poses->orientation[M][frame];
+		double x = poses->orientation[X][frame];
+		double y = poses->orientation[Y][frame];
+		double z = poses->orientation[Z][frame];
+		rotation[X][X] = 1.0 - 2.0 * ( y * y + z * z );
+		rotation[X][Y] = 2.0 * ( x * y - w * z );
+		rotation[X][Z] = 2.0 * ( x * z + w * y );
+		rotation[Y][X] = 2.0 * ( x * y + w * z );
+		rotation[Y][Y] = 1.0 - 2.0 * ( x * x + z * z );
+		rotation[Y][Z] = 2.0 * ( y * z - w * x );
+		rotation[Z][X] = 2.0 * ( x * z - w * y );
+		rotation[Z][Y] = 2.0 * ( y * z + w * x );
+		rotation[Z][Z] = 1.0 - 2.0 * ( x * x + y * y );
+
+		// The position is the displacement of the rotated model centroid, as in ComputeRigidBodyPose().
+		for ( i = X; i <= Z; i++ ) {
+			position[i] = actual_centroid[i]
+				- ( rotation[i][X] * model_centroid[X] + rotation[i][Y] * model_centroid[Y] + rotation[i][Z] * model_centroid[Z] );
+			poses->position[i][frame] = position[i];
+		}
+
+		// RMS distance between where the markers are and where the model says they should be.
+		double sum = 0.0;
+		for ( mrk = 0; mrk < nMarkers; mrk++ ) {
+			if ( visible[mrk] ) {
+				for ( i = X; i <= Z; i++ ) {
+					double d = actual[mrk][i] - position[i]
+						- ( rotation[i][X] * model[mrk][X] + rotation[i][Y] * model[mrk][Y] + rotation[i][Z] * model[mrk][Z] );
+					sum += d * d;
+				}
+			}
+		}
+		poses->residual[frame] = sqrt( sum / (double) count );
+
+		solved++;
+	}
+
+	return( solved );
+}
+
+// One thread's share of the frames.
+typedef struct {
+	DexPoseSolver	*solver;
+	DexMarkerArrays	*markers;
+	DexPoseArrays	*poses;
+	int				first_frame;
+	int				last_frame;
+	int				solved;
+} DexPoseJob;
+
+static DWORD WINAPI PoseWorker( LPVOID param ) {
+	DexPoseJob *job = (DexPoseJob *) param;
+	job->solved = job->solver->SolveFrames( job->markers, job->poses, job->first_frame, job->last_frame );
+	return( 0 );
+}
+
+// Each frame is independent of the others, so the frames are simply dealt out
+//  in contiguous blocks, one per thread. If n_threads is 0, one thread is used per processor.
+int DexPoseSolver::Solve( DexMarkerArrays *markers, DexPoseArrays *poses, int first_frame, int last_frame, int n_threads ) {
+
+	DexPoseJob	job[DEX_POSE_MAX_THREADS];
+	HANDLE		thread[DEX_POSE_MAX_THREADS];
+	int			started, w, solved;
+
+	if ( last_frame < first_frame ) return( 0 );
+
+	if ( n_threads <= 0 ) {
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		n_threads = info.dwNumberOfProcessors;
+	}
+	if ( n_threads > DEX_POSE_MAX_THREADS ) n_threads = DEX_POSE_MAX_THREADS;
+	// Not worth starting threads for a few frames.
+	if ( last_frame - first_frame < DEX_POSE_THREAD_FRAMES ) n_threads = 1;
+	if ( n_threads < 1 ) n_threads = 1;
+
+	int n_frames = last_frame - first_frame + 1;
+	for ( w = 0; w < n_threads; w++ ) {
+		job[w].solver = this;
+		job[w].markers = markers;
+		job[w].poses = poses;
+		job[w].first_frame = first_frame + (int) ( (long long) w * n_frames / n_threads );
+		job[w].last_frame = first_frame + (int) ( (long long) ( w + 1 ) * n_frames / n_threads ) - 1;
+		job[w].solved = 0;
+	}
+
+	// The calling thread does its share too. If a thread cannot be started,
+	//  the caller does that share as well.
+	for ( started = 1; started < n_threads; started++ ) {
+		thread[started] = CreateThread( NULL, 0, PoseWorker, &job[started], 0, NULL );
+		if ( !thread[started] ) break;
+	}
+	for ( w = started; w < n_threads; w++ ) PoseWorker( &job[w] );
+	PoseWorker( &job[0] );
+	for ( w = 1; w < started; w++ ) {
+		WaitForSingleObject( thread[w], INFINITE );
+		CloseHandle( thread[w] );
+	}
+
+	solved = 0;
+	for ( w = 0; w < n_threads; w++ ) solved += job[w].solved;
+	return( solved );
+
+}
@@ -0,0 +1,78 @@
+/********************************************************************************/
+
+//
+// DexPoseSolver.h
+// Reconstruction of rigid body poses from Dex (Grip) marker data, many frames at a time.
+//
+
+#pragma once
+
+#include "../Useful/VectorsMixin.h"
+
+// VectorsMixin::ComputeRigidBodyPose() solves for one frame at a time. When the poses
+//  of the manipulandum or the wrist are to be recomputed from the marker data of a whole
+//  acquisition, this does the same job for a range of frames in one call.
+//
+// The rotation is found with Horn's method (closed-form solution of absolute orientation
+//  using unit quaternions, J. Opt. Soc. Am. A, 1987): it is the eigenvector of a 4x4
+//  symmetric matrix built from the cross-covariance of the model and the actual marker
+//  positions. This gives the least-squares best fit for 3 or more markers, coplanar or not.
+//
+// The marker data and the results are kept in 'structure of arrays' layout, i.e. one
+//  array per coordinate per marker, indexed by frame. The frames are divided between
+//  several threads.
+//
+// Frames with fewer than 3 visible markers have no pose. Their position, orientation
+//  and residual are set to MISSING_DOUBLE.
+
+#define DEX_POSE_MAX_MARKERS		32
+#define DEX_POSE_MIN_MARKERS		3
+#define DEX_POSE_JACOBI_SWEEPS		16
+#define DEX_POSE_NEWTON_ITERATIONS	50
+#define DEX_POSE_NEWTON_TOLERANCE	1.0e-11
+#define DEX_POSE_DEGENERATE			1.0e-16
+#define DEX_POSE_MAX_THREADS		8
+#define DEX_POSE_THREAD_FRAMES		1000
+
+// Marker positions. The coordinates of marker m in frame i are x[m][i], y[m][i] and z[m][i].
+// A marker whose X coordinate is MISSING_DOUBLE or not finite was not visible.
+typedef struct {
+	double	*x[DEX_POSE_MAX_MARKERS];
+	double	*y[DEX_POSE_MAX_MARKERS];
+	double	*z[DEX_POSE_MAX_MARKERS];
+} DexMarkerArrays;
+
+// Computed poses. The values for frame i are position[X][i], orientation[M][i] and so on.
+// The residual is the RMS distance between the actual markers and the model markers
+//  placed at the computed pose, in the units of the marker data.
+// The number of visible markers in each frame is stored in 'visible', unless it is NULL.
+typedef struct {
+	double	*position[3];
+	double	*orientation[4];
+	double	*residual;
+	int		*visible;
+} DexPoseArrays;
+
+class DexPoseSolver : public VectorsMixin {
+
+public:
+
+	DexPoseSolver( void );
+
+	// Marker positions when the rigid body is at the zero position and orientation.
+	int  SetModel( Vector3 model[], int n_markers );
+
+	// Compute the poses for frames first_frame to last_frame, inclusive.
+	// The work is shared out between n_threads threads. 0 means one per processor.
+	// Returns the number of frames for which a pose could be computed.
+	int  Solve( DexMarkerArrays *markers, DexPoseArrays *poses, int first_frame, int last_frame, int n_threads = 0 );
+
+	// One thread's share of the work. Used internally.
+	int  SolveFrames( DexMarkerArrays *markers, DexPoseArrays *poses, int first_frame, int last_frame );
+
+private:
+
+	int		nMarkers;
+	Vector3	model[DEX_POSE_MAX_MARKERS];
+
+};
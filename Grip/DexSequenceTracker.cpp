@@ -0,0 +1,264 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                             DexSequenceTracker.cpp                            */
+/*                                                                               */
+/*********************************************************************************/
+
+// Accounting of lost, repeated and misordered Dex (Grip) realtime packets.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GripPackets.h"
+#include "DexSequenceTracker.h"
+
+/***************************************************************************/
+
+DexSequenceTracker::DexSequenceTracker( void ) {
+	pauseThreshold = PACKET_STREAM_BREAK_THRESHOLD;
+	Reset();
+}
+
+void DexSequenceTracker::Reset( void ) {
+	nGaps = 0;
+	overflow = false;
+	nAcquisitions = 0;
+	current = NULL;
+	highestCount = 0;
+	lowestTracked = 0;
+	memset( seen, 0, sizeof( seen ) );
+	started = false;
+	breakPending = false;
+	previousTMCounter = 0;
+	previousTimestamp = 0.0;
+}
+
+// Find the counts for the given acquisition, adding a new entry if it has not been seen before.
+// If there are too many acquisitions, the last entry takes in all the ones that do not fit.
+DexAcquisitionStatistics *DexSequenceTracker::FindAcquisition( unsigned long acquisition_id ) {
+
+	for ( int i = nAcquisitions - 1; i >= 0; i-- ) {
+		if ( acquisition[i].acquisitionID == acquisition_id ) return( &acquisition[i] );
+	}
+	if ( nAcquisitions >= DEX_SEQUENCE_MAX_ACQUISITIONS ) {
+		overflow = true;
+		return( &acquisition[DEX_SEQUENCE_MAX_ACQUISITIONS - 1] );
+	}
+	DexAcquisitionStatistics *stats = &acquisition[nAcquisitions++];
+	memset( stats, 0, sizeof( *stats ) );
+	stats->acquisitionID = acquisition_id;
+	return( stats );
+
+}
+
+// The window of packet counts that have been seen moves forward with the highest count.
+void DexSequenceTracker::ShiftWindow( unsigned long distance ) {
+
+	const int words = DEX_SEQUENCE_WINDOW / 32;
+
+	if ( distance >= DEX_SEQUENCE_WINDOW ) {
+		memset( seen, 0, sizeof( seen ) );
+		return;
+	}
+	int word_shift = distance / 32;
+	int bit_shift = distance % 32;
+	for ( int w = words - 1; w >= 0; w-- ) {
+		unsigned int value = 0;
+		int from = w - word_shift;
+		if ( from >= 0 ) {
+			value = seen[from] << bit_shift;
+			if ( bit_shift && from > 0 ) value |= seen[from - 1] >> ( 32 - bit_shift );
+		}
+		seen[w] = value;
+	}
+
+}
+
+bool DexSequenceTracker::Seen( unsigned long age ) {
+	return( ( seen[age / 32] & ( 1u << ( age % 32 ) ) ) != 0 );
+}
+
+void DexSequenceTracker::MarkSeen( unsigned long age ) {
+	seen[age / 32] |= ( 1u << ( age % 32 ) );
+}
+
+void DexSequenceTracker::AddGap( int frame, unsigned long acquisition_id, int missing, int cause, double timestamp ) {
+
+	// If no frames were stored since the last break, the two are merged.
+	if ( nGaps > 0 && gapFrame[nGaps - 1] == frame ) {
+		gap[nGaps - 1].missing += missing;
+		gap[nGaps - 1].cause |= cause;
+		gap[nGaps - 1].acquisitionID = acquisition_id;
+		gap[nGaps - 1].after = timestamp;
+		return;
+	}
+	if ( nGaps >= DEX_SEQUENCE_MAX_GAPS ) {
+		overflow = true;
+		return;
+	}
+	gap[nGaps].frame = frame;
+	gap[nGaps].acquisitionID = acquisition_id;
+	gap[nGaps].missing = missing;
+	gap[nGaps].cause = cause;
+	gap[nGaps].before = previousTimestamp;
+	gap[nGaps].after = timestamp;
+	gapFrame[nGaps] = frame;
+	nGaps++;
+
+}
+
+int DexSequenceTracker::Track( unsigned long acquisition_id, unsigned long packet_count, unsigned short tm_counter, double timestamp, int frame ) {
+
+	int cause = 0;
+	int missing = 0;
+
+	// A packet that arrived out of order breaks the stream on both sides.
+	bool follows_out_of_order = breakPending;
+
+	if ( !started || acquisition_id != current->acquisitionID ) {
+
+		// A new acquisition. The TMCounter tells us how many packets went missing since the last one.
+		DexAcquisitionStatistics *stats = FindAcquisition( acquisition_id );
+		if ( started ) {
+			unsigned short skipped = tm_counter - previousTMCounter;
+			if ( skipped > 1 ) {
+				missing = skipped - 1;
+				stats->lost_before += missing;
+			}
+			cause |= DEX_GAP_ACQUISITION;
+		}
+		if ( stats->received == 0 ) stats->first_count = stats->last_count = packet_count;
+		current = stats;
+		highestCount = packet_count;
+		lowestTracked = packet_count;
+		memset( seen, 0, sizeof( seen ) );
+		MarkSeen( 0 );
+		breakPending = false;
+
+	}
+	else {
+
+		long ahead = (long) ( packet_count - highestCount );
+
+		if ( ahead > 0 ) {
+			if ( ahead > 1 ) {
+				missing = ahead - 1;
+				current->dropped += missing;
+				cause |= DEX_GAP_DROPPED;
+			}
+			ShiftWindow( ahead );
+			MarkSeen( 0 );
+			highestCount = packet_count;
+			breakPending = false;
+		}
+		else {
+			unsigned long age = - ahead;
+			if ( age < DEX_SEQUENCE_WINDOW && Seen( age ) ) {
+				// Already have this one. The caller should throw it away.
+				current->duplicates++;
+				return( DEX_SEQUENCE_DUPLICATE );
+			}
+			if ( age < DEX_SEQUENCE_WINDOW ) {
+				MarkSeen( age );
+				// It fills a hole that was counted as dropped, unless it comes from before the
+				//  start of the acquisition, or from before it was taken up again.
+				if ( (long) ( packet_count - lowestTracked ) > 0 ) current->dropped--;
+			}
+			current->out_of_order++;
+			cause |= DEX_GAP_OUT_OF_ORDER;
+			breakPending = true;
+		}
+
+	}
+
+	if ( follows_out_of_order ) cause |= DEX_GAP_OUT_OF_ORDER;
+	if ( started && timestamp - previousTimestamp > pauseThreshold ) cause |= DEX_GAP_PAUSE;
+
+	current->received++;
+	if ( (long) ( packet_count - current->first_count ) < 0 ) current->first_count = packet_count;
+	if ( (long) ( packet_count - current->last_count ) > 0 ) current->last_count = packet_count;
+
+	if ( cause ) AddGap( frame, acquisition_id, missing, cause, timestamp );
+	previousTMCounter = tm_counter;
+	previousTimestamp = timestamp;
+	started = true;
+
+	return( cause ? DEX_SEQUENCE_BREAK : DEX_SEQUENCE_CONTIGUOUS );
+
+}
+
+int DexSequenceTracker::Gaps( void ) {
+	return( nGaps );
+}
+
+DexSequenceGap *DexSequenceTracker::Gap( int index ) {
+	if ( index < 0 || index >= nGaps ) return( NULL );
+	return( &gap[index] );
+}
+
+bool DexSequenceTracker::Overflow( void ) {
+	return( overflow );
+}
+
+const int *DexSequenceTracker::GapFrames( void ) {
+	return( gapFrame );
+}
+
+const int *DexSequenceTracker::GapCount( void ) {
+	return( &nGaps );
+}
+
+int DexSequenceTracker::FindGapAfter( int frame ) {
+	int low = 0, high = nGaps;
+	while ( low < high ) {
+		int middle = ( low + high ) / 2;
+		if ( gapFrame[middle] < frame ) low = middle + 1;
+		else high = middle;
+	}
+	return( low );
+}
+
+bool DexSequenceTracker::BreakBefore( int frame ) {
+	int i = FindGapAfter( frame );
+	return( i < nGaps && gapFrame[i] == frame );
+}
+
+bool DexSequenceTracker::BreakBetween( int first_frame, int last_frame ) {
+	int i = FindGapAfter( first_frame + 1 );
+	return( i < nGaps && gapFrame[i] <= last_frame );
+}
+
+int DexSequenceTracker::Acquisitions( void ) {
+	return( nAcquisitions );
+}
+
+DexAcquisitionStatistics *DexSequenceTracker::Acquisition( int index ) {
+	if ( index < 0 || index >= nAcquisitions ) return( NULL );
+	return( &acquisition[index] );
+}
+
+int DexSequenceTracker::Received( void ) {
+	int total = 0;
+	for ( int i = 0; i < nAcquisitions; i++ ) total += acquisition[i].received;
+	return( total );
+}
+
+int DexSequenceTracker::Dropped( void ) {
+	int total = 0;
+	for ( int i = 0; i < nAcquisitions; i++ ) total += acquisition[i].dropped + acquisition[i].lost_before;
+	return( total );
+}
+
+int DexSequenceTracker::Duplicates( void ) {
+	int total = 0;
+	for ( int i = 0; i < nAcquisitions; i++ ) total += acquisition[i].duplicates;
+	return( total );
+}
+
+int DexSequenceTracker::OutOfOrder( void ) {
+	int total = 0;
+	for ( int i = 0; i < nAcquisitions; i++ ) total += acquisition[i].out_of_order;
+	return( total );
+}
@@ -0,0 +1,135 @@
+/********************************************************************************/
+
+//
+// DexSequenceTracker.h
+// Accounting of lost, repeated and misordered Dex (Grip) realtime packets.
+//
+
+#pragma once
+
+// The realtime packets carry two sequence numbers: the EPM TMCounter, which runs on
+//  from one packet to the next whatever Grip is doing, and the rtPacketCount, which counts
+//  the packets within one acquisition (acquisitionID). Packets are fed to the tracker in the
+//  order in which they were received, and it compares each one to the packets that came before.
+//
+//  - A jump forward in the packet count means that packets were dropped.
+//  - A packet count that has already been seen is a duplicate. The packet should be discarded.
+//  - A packet count that falls in the hole left by an earlier jump arrived out of order.
+//     It is no longer counted as dropped.
+//  - A new acquisitionID starts a new count. The packets lost in between can only be
+//     estimated from the TMCounter.
+//
+// Packet counts are remembered for the last DEX_SEQUENCE_WINDOW packets, so duplicates and
+//  late packets are classified exactly within that window. A packet that comes back from
+//  even further in the past is counted as out of order.
+//
+// Each time the stream is broken, because of lost or misordered packets, a new acquisition
+//  or a pause in the arrival of the packets, an entry is added to the gap table. The entry
+//  gives the first frame after the break, so the table can be used to avoid drawing or
+//  computing across the break without storing anything in the data buffers themselves.
+
+#define DEX_SEQUENCE_WINDOW			256
+#define DEX_SEQUENCE_MAX_GAPS		65536
+#define DEX_SEQUENCE_MAX_ACQUISITIONS	1024
+
+// Return values of Track().
+#define DEX_SEQUENCE_CONTIGUOUS		0
+#define DEX_SEQUENCE_BREAK			1
+#define DEX_SEQUENCE_DUPLICATE		2
+
+// Reasons for a break, combined in the cause field of a gap.
+#define DEX_GAP_DROPPED				0x01
+#define DEX_GAP_OUT_OF_ORDER		0x02
+#define DEX_GAP_ACQUISITION			0x04
+#define DEX_GAP_PAUSE				0x08
+
+typedef struct {
+	int				frame;			// First frame after the break.
+	unsigned long	acquisitionID;	// Acquisition of the packet after the break.
+	int				missing;		// Number of packets dropped in the break, as far as is known.
+	int				cause;
+	double			before;			// Timestamps of the packets on either side of the break.
+	double			after;
+} DexSequenceGap;
+
+typedef struct {
+	unsigned long	acquisitionID;
+	unsigned long	first_count;	// Lowest and highest packet counts seen.
+	unsigned long	last_count;
+	int				received;		// Packets accepted (duplicates are not included).
+	int				dropped;
+	int				duplicates;
+	int				out_of_order;
+	int				lost_before;	// Packets lost before the start of the acquisition, according to the TMCounter.
+} DexAcquisitionStatistics;
+
+class DexSequenceTracker {
+
+public:
+
+	DexSequenceTracker( void );
+
+	// Time between packets, in seconds, beyond which the stream is considered to be broken.
+	double	pauseThreshold;
+
+	// Forget everything and start over.
+	void Reset( void );
+
+	// Process the next packet. The frame is the index in the data buffers where the packet
+	//  will be stored if it is kept. Returns one of DEX_SEQUENCE_CONTIGUOUS, DEX_SEQUENCE_BREAK
+	//  (the packet is to be kept, but the stream is broken before it) or DEX_SEQUENCE_DUPLICATE.
+	int Track( unsigned long acquisition_id, unsigned long packet_count, unsigned short tm_counter, double timestamp, int frame );
+
+	// The gap table, in order of frames.
+	int  Gaps( void );
+	DexSequenceGap *Gap( int index );
+	bool Overflow( void );
+	// The frames at which the breaks occur, for those who do not need the rest.
+	// The pointers stay valid for the lifetime of the tracker.
+	const int *GapFrames( void );
+	const int *GapCount( void );
+	// Is there a break just before this frame? Is there one between these two frames?
+	bool BreakBefore( int frame );
+	bool BreakBetween( int first_frame, int last_frame );
+	// Index of the first gap at or after the given frame, or Gaps() if there is none.
+	int  FindGapAfter( int frame );
+
+	// Counts per acquisition, in the order in which they were first seen.
+	int  Acquisitions( void );
+	DexAcquisitionStatistics *Acquisition( int index );
+
+	// Totals over all the acquisitions.
+	int  Received( void );
+	int  Dropped( void );
+	int  Duplicates( void );
+	int  OutOfOrder( void );
+
+private:
+
+	DexSequenceGap	gap[DEX_SEQUENCE_MAX_GAPS];
+	int				gapFrame[DEX_SEQUENCE_MAX_GAPS];
+	int				nGaps;
+	bool			overflow;
+
+	DexAcquisitionStatistics	acquisition[DEX_SEQUENCE_MAX_ACQUISITIONS];
+	int				nAcquisitions;
+
+	// State of the current acquisition.
+	DexAcquisitionStatistics	*current;
+	unsigned long	highestCount;
+	// Packet count at which the current acquisition was taken up. Holes below it were never counted as dropped.
+	unsigned long	lowestTracked;
+	// Bit i of the window is set if packet count highestCount - i has been seen.
+	unsigned int	seen[DEX_SEQUENCE_WINDOW / 32];
+	bool			started;
+	bool			breakPending;
+	unsigned short	previousTMCounter;
+	double			previousTimestamp;
+
+	DexAcquisitionStatistics *FindAcquisition( unsigned long acquisition_id );
+	void ShiftWindow( unsigned long distance );
+	bool Seen( unsigned long age );
+	void MarkSeen( unsigned long age );
+	void AddGap( int frame, unsigned long acquisition_id, int missing, int cause, double timestamp );
+
+};
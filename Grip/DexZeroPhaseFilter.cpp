@@ -0,0 +1,325 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                             DexZeroPhaseFilter.cpp                            */
+/*                                                                               */
+/*********************************************************************************/
+
+// Non-causal filtering of recorded Dex (Grip) data, i.e. without phase lag.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+// Pi is defined in Useful.h from M_PI.
+#define _USE_MATH_DEFINES
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include "../Useful/fMessageBox.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Useful.h"
+
+#include "DexAnalogMixin.h"
+#include "DexZeroPhaseFilter.h"
+
+/***************************************************************************/
+
+DexZeroPhaseFilter::DexZeroPhaseFilter( void ) {
+	ClearChannels();
+	SetBreaks( NULL, NULL );
+	SetRecursive( DEFAULT_FILTER_CONSTANT );
+}
+
+// Number of samples it takes for the response of a filter whose slowest pole has
+//  the given magnitude to decay below the tolerance.
+static int DecayLength( double pole ) {
+	if ( pole <= 0.0 ) return( 0 );
+	if ( pole >= 1.0 ) return( DEX_ZERO_PHASE_MAX_OVERLAP );
+	double length = ceil( log( DEX_ZERO_PHASE_TOLERANCE ) / log( pole ) );
+	if ( length > DEX_ZERO_PHASE_MAX_OVERLAP ) return( DEX_ZERO_PHASE_MAX_OVERLAP );
+	return( (int) length );
+}
+
+// Same filter as DexAnalogMixin: y = ( x + k * y ) / ( 1 + k ).
+void DexZeroPhaseFilter::SetRecursive( double filter_constant ) {
+	if ( filter_constant < 0.0 ) filter_constant = 0.0;
+	type = DEX_ZERO_PHASE_RECURSIVE;
+	recursiveA = filter_constant / ( 1.0 + filter_constant );
+	recursiveB = 1.0 / ( 1.0 + filter_constant );
+	overlap = DecayLength( recursiveA );
+}
+
+// Second-order Butterworth low-pass filter, from the bilinear transform.
+// Run forward and backward, the gain is -6 dB at the cut-off frequency.
+void DexZeroPhaseFilter::SetButterworth( double cutoff, double sample_rate ) {
+
+	// Keep the cut-off below the Nyquist frequency.
+	if ( cutoff > 0.45 * sample_rate ) cutoff = 0.45 * sample_rate;
+	if ( cutoff <= 0.0 ) cutoff = 0.001 * sample_rate;
+
+	double k = tan( Pi * cutoff / sample_rate );
+	double norm = 1.0 / ( 1.0 + sqrt( 2.0 ) * k + k * k );
+
+	type = DEX_ZERO_PHASE_BUTTERWORTH;
+	butterworthB[0] = k * k * norm;
+	butterworthB[1] = 2.0 * butterworthB[0];
+	butterworthB[2] = butterworthB[0];
+	butterworthA[0] = 1.0;
+	butterworthA[1] = 2.0 * ( k * k - 1.0 ) * norm;
+	butterworthA[2] = ( 1.0 - sqrt( 2.0 ) * k + k * k ) * norm;
+	// The poles are complex conjugates, with magnitude sqrt( a2 ).
+	overlap = DecayLength( sqrt( butterworthA[2] ) );
+
+}
+
+void DexZeroPhaseFilter::SetSavitzkyGolay( int half_width ) {
+	if ( half_width < 0 ) half_width = 0;
+	if ( half_width > DEX_ZERO_PHASE_MAX_OVERLAP ) half_width = DEX_ZERO_PHASE_MAX_OVERLAP;
+	type = DEX_ZERO_PHASE_SAVITZKY_GOLAY;
+	halfWidth = half_width;
+	overlap = half_width;
+}
+
+int DexZeroPhaseFilter::GetType( void ) {
+	return( type );
+}
+
+int DexZeroPhaseFilter::Overlap( void ) {
+	return( overlap );
+}
+
+int DexZeroPhaseFilter::AddChannel( int flags, double *input, double *output, int stride, double *key ) {
+	if ( nChannels >= DEX_FILTER_MAX_CHANNELS ) return( -1 );
+	channel[nChannels].input = input;
+	channel[nChannels].output = output;
+	channel[nChannels].key = ( key ? key : input );
+	channel[nChannels].stride = stride;
+	channel[nChannels].single = ( ( flags & DEX_FILTER_SINGLE ) != 0 );
+	return( nChannels++ );
+}
+
+void DexZeroPhaseFilter::ClearChannels( void ) {
+	nChannels = 0;
+}
+
+/***************************************************************************/
+
+// Filter a run of valid samples in place, forward and then backward.
+// Each pass starts as if the signal had been constant at its first value for ever,
+//  so that there is no transient at the ends of the run.
+void DexZeroPhaseFilter::ForwardBackward( double *data, int n ) {
+
+	int i;
+
+	if ( type == DEX_ZERO_PHASE_RECURSIVE ) {
+		double a = recursiveA, b = recursiveB, y;
+		y = data[0];
+		for ( i = 0; i < n; i++ ) data[i] = y = b * data[i] + a * y;
+		y = data[n - 1];
+		for ( i = n - 1; i >= 0; i-- ) data[i] = y = b * data[i] + a * y;
+	}
+	else {
+		double b0 = butterworthB[0], b1 = butterworthB[1], b2 = butterworthB[2];
+		double a1 = butterworthA[1], a2 = butterworthA[2];
+		double x, y, z1, z2;
+		// Steady state of the delays for a constant input (the gain at DC is 1).
+		z2 = ( b2 - a2 ) * data[0];
+		z1 = ( b1 - a1 ) * data[0] + z2;
+		for ( i = 0; i < n; i++ ) {
+			x = data[i];
+			y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			data[i] = y;
+		}
+		z2 = ( b2 - a2 ) * data[n - 1];
+		z1 = ( b1 - a1 ) * data[n - 1] + z2;
+		for ( i = n - 1; i >= 0; i-- ) {
+			x = data[i];
+			y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			data[i] = y;
+		}
+	}
+}
+
+// Quadratic Savitzky-Golay smoothing of samples first to last of a run of n valid samples.
+// Near the ends of the run the window is narrowed so that it stays centered.
+void DexZeroPhaseFilter::SavitzkyGolay( double *in, double *out, int n, int first, int last ) {
+
+	for ( int i = first; i <= last; i++ ) {
+		int m = halfWidth;
+		if ( m > i ) m = i;
+		if ( m > n - 1 - i ) m = n - 1 - i;
+		if ( m == 0 ) {
+			out[i] = in[i];
+			continue;
+		}
+		// Smoothing weights for a quadratic (or cubic) fit:
+		//  c[j] = ( 3 * ( 3m^2 + 3m - 1 ) - 15 j^2 ) / ( ( 2m + 3 ) ( 2m + 1 ) ( 2m - 1 ) )
+		double m2 = (double) m * m;
+		double norm = ( 2.0 * m + 3.0 ) * ( 2.0 * m + 1.0 ) * ( 2.0 * m - 1.0 );
+		double c0 = 3.0 * ( 3.0 * m2 + 3.0 * m - 1.0 );
+		double sum = c0 * in[i];
+		for ( int j = 1; j <= m; j++ ) sum += ( c0 - 15.0 * j * j ) * ( in[i - j] + in[i + j] );
+		out[i] = sum / norm;
+	}
+}
+
+void DexZeroPhaseFilter::SetBreaks( const int *break_frame, const int *n_breaks ) {
+	breakFrame = break_frame;
+	nBreaks = n_breaks;
+}
+
+// The first break after the given frame, or INT_MAX if there is none.
+int DexZeroPhaseFilter::NextBreak( int frame ) {
+	if ( !breakFrame || !nBreaks ) return( INT_MAX );
+	int low = 0, high = *nBreaks;
+	while ( low < high ) {
+		int middle = ( low + high ) / 2;
+		if ( breakFrame[middle] <= frame ) low = middle + 1;
+		else high = middle;
+	}
+	return( low < *nBreaks ? breakFrame[low] : INT_MAX );
+}
+
+// Filter frames first_frame to last_frame of one channel.
+// Frames up to Overlap() away on either side, if they exist, are used as context.
+void DexZeroPhaseFilter::FilterChunk( int ch, int first_frame, int last_frame, int n_frames ) {
+
+	DexFilterChannel *chan = &channel[ch];
+	int lo, hi, n, i, run;
+	double *x, *y;
+	bool *valid;
+
+	lo = first_frame - overlap;
+	if ( lo < 0 ) lo = 0;
+	hi = last_frame + overlap;
+	if ( hi > n_frames - 1 ) hi = n_frames - 1;
+	n = hi - lo + 1;
+
+	x = (double *) malloc( n * sizeof( double ) );
+	y = (double *) malloc( n * sizeof( double ) );
+	valid = (bool *) malloc( n * sizeof( bool ) );
+	if ( !x || !y || !valid ) {
+		fMessageBox( MB_OK | MB_ICONERROR, "DexZeroPhaseFilter", "Error allocating memory for %d frames.", n );
+		exit( -1 );
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		double key = chan->key[(size_t) ( lo + i ) * chan->stride];
+		x[i] = chan->input[(size_t) ( lo + i ) * chan->stride];
+		valid[i] = ( key != MISSING_DOUBLE && _finite( key ) );
+	}
+
+	// Filter each run of valid samples that reaches into the frames to be output.
+	for ( i = 0; i < n; i = run ) {
+		if ( !valid[i] ) {
+			y[i] = x[i];
+			run = i + 1;
+			continue;
+		}
+		int limit = NextBreak( lo + i );
+		for ( run = i; run < n && lo + run < limit && valid[run]; run++ );
+		if ( lo + run - 1 < first_frame || lo + i > last_frame ) continue;
+		if ( type == DEX_ZERO_PHASE_SAVITZKY_GOLAY ) {
+			int from = first_frame - lo - i, to = last_frame - lo - i;
+			if ( from < 0 ) from = 0;
+			if ( to > run - i - 1 ) to = run - i - 1;
+			SavitzkyGolay( x + i, y + i, run - i, from, to );
+		}
+		else {
+			memcpy( y + i, x + i, ( run - i ) * sizeof( double ) );
+			ForwardBackward( y + i, run - i );
+		}
+	}
+
+	for ( i = first_frame - lo; i <= last_frame - lo; i++ ) {
+		double *out = chan->output + (size_t) ( lo + i ) * chan->stride;
+		if ( valid[i] && chan->single ) *out = (float) y[i];
+		else *out = y[i];
+	}
+
+	free( x );
+	free( y );
+	free( valid );
+
+}
+
+/***************************************************************************/
+
+// The work is cut into pieces, one chunk of frames of one channel each, that
+//  the threads take one after the other until there are none left.
+typedef struct {
+	DexZeroPhaseFilter	*filter;
+	int					first_frame;
+	int					n_frames;
+	int					n_chunks;
+	int					n_pieces;
+	int					chunk_frames;
+	int					last_frame;
+	volatile LONG		next;
+} DexZeroPhaseWork;
+
+static DWORD WINAPI ZeroPhaseWorker( LPVOID param ) {
+	DexZeroPhaseWork *work = (DexZeroPhaseWork *) param;
+	int piece;
+	while ( ( piece = InterlockedIncrement( &work->next ) - 1 ) < work->n_pieces ) {
+		int chunk = piece % work->n_chunks;
+		int first = work->first_frame + chunk * work->chunk_frames;
+		int last = first + work->chunk_frames - 1;
+		if ( last > work->last_frame ) last = work->last_frame;
+		work->filter->FilterChunk( piece / work->n_chunks, first, last, work->n_frames );
+	}
+	return( 0 );
+}
+
+void DexZeroPhaseFilter::Filter( int first_frame, int last_frame, int n_frames, int n_threads ) {
+
+	DexZeroPhaseWork	work;
+	HANDLE				thread[DEX_ZERO_PHASE_MAX_THREADS];
+	int					started, w;
+
+	if ( first_frame < 0 ) first_frame = 0;
+	if ( last_frame > n_frames - 1 ) last_frame = n_frames - 1;
+	if ( last_frame < first_frame || nChannels == 0 ) return;
+
+	// Chunks much shorter than the overlap would spend most of the time on the context.
+	work.filter = this;
+	work.first_frame = first_frame;
+	work.last_frame = last_frame;
+	work.n_frames = n_frames;
+	work.chunk_frames = DEX_ZERO_PHASE_CHUNK;
+	if ( work.chunk_frames < 4 * overlap ) work.chunk_frames = 4 * overlap;
+	work.n_chunks = ( last_frame - first_frame ) / work.chunk_frames + 1;
+	work.n_pieces = work.n_chunks * nChannels;
+	work.next = 0;
+
+	if ( n_threads <= 0 ) {
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		n_threads = info.dwNumberOfProcessors;
+	}
+	if ( n_threads > DEX_ZERO_PHASE_MAX_THREADS ) n_threads = DEX_ZERO_PHASE_MAX_THREADS;
+	if ( n_threads > work.n_pieces ) n_threads = work.n_pieces;
+
+	// The calling thread works too. If a thread cannot be started, the others take up the slack.
+	for ( started = 1; started < n_threads; started++ ) {
+		thread[started] = CreateThread( NULL, 0, ZeroPhaseWorker, &work, 0, NULL );
+		if ( !thread[started] ) break;
+	}
+	ZeroPhaseWorker( &work );
+	for ( w = 1; w < started; w++ ) {
+		WaitForSingleObject( thread[w], INFINITE );
+		CloseHandle( thread[w] );
+	}
+
+}
@@ -0,0 +1,100 @@
+/********************************************************************************/
+
+//
+// DexZeroPhaseFilter.h
+// Non-causal smoothing of recorded Dex (Grip) data.
+//
+
+#pragma once
+
+#include "DexAnalogMixin.h"
+
+// The recursive filter in DexAnalogMixin only looks at past samples, so the filtered
+//  traces lag behind the real ones. When reviewing data that has already been recorded
+//  we can also look at the samples that come after, and smooth without any lag.
+//
+// Three kinds of filter are available:
+//  - The same first-order recursive filter as DexAnalogMixin, run forward and then backward.
+//  - A second-order Butterworth low-pass filter, also run forward and then backward.
+//  - A Savitzky-Golay filter (least-squares fit of a quadratic over a moving window).
+//
+// The frames to be filtered are cut into chunks that are filtered in parallel. Each chunk
+//  is extended on both sides by enough frames for the response of the filter to the edge
+//  to die out (to a fraction DEX_ZERO_PHASE_TOLERANCE of the size of the signal for the
+//  recursive filters, completely for Savitzky-Golay), so the result does not depend on 
+//  where the cuts are made.
+//
+// Samples whose key is MISSING_DOUBLE or not finite split the data into separate runs,
+//  which are filtered independently. Such samples are copied to the output unchanged.
+// The runs are also split at the breaks in the stream of packets given to SetBreaks().
+
+#define DEX_ZERO_PHASE_RECURSIVE		0
+#define DEX_ZERO_PHASE_BUTTERWORTH		1
+#define DEX_ZERO_PHASE_SAVITZKY_GOLAY	2
+
+#define DEX_ZERO_PHASE_TOLERANCE		1.0e-6
+#define DEX_ZERO_PHASE_CHUNK			16384
+#define DEX_ZERO_PHASE_MAX_OVERLAP		100000
+#define DEX_ZERO_PHASE_MAX_THREADS		8
+
+class DexZeroPhaseFilter {
+
+public:
+
+	DexZeroPhaseFilter( void );
+
+	// Select the filter.
+	// The recursive filter uses the same constant as DexAnalogMixin::SetFilterConstant().
+	// The Butterworth cut-off frequency and the sample rate are in Hz.
+	// The Savitzky-Golay window is 2 * half_width + 1 frames.
+	void SetRecursive( double filter_constant );
+	void SetButterworth( double cutoff, double sample_rate );
+	void SetSavitzkyGolay( int half_width );
+	int  GetType( void );
+
+	// Define the channels, as for DexFilterBank.
+	int  AddChannel( int flags, double *input, double *output, int stride, double *key = NULL );
+	void ClearChannels( void );
+
+	// Number of frames on either side of a frame that affect its filtered value.
+	int  Overlap( void );
+
+	// Frames that start a new stretch of data, in increasing order, and how many there are.
+	// The table belongs to the caller and is looked at each time the data is filtered.
+	void SetBreaks( const int *break_frame, const int *n_breaks );
+
+	// Filter frames first_frame to last_frame, inclusive, using frames 0 to n_frames - 1 as context.
+	// The work is shared out between n_threads threads. 0 means one per processor.
+	void Filter( int first_frame, int last_frame, int n_frames, int n_threads = 0 );
+
+	// The pieces of work that are shared out between the threads. Used internally.
+	void FilterChunk( int channel, int first_frame, int last_frame, int n_frames );
+
+private:
+
+	int		type;
+
+	// First-order recursive filter: y[i] = b * x[i] + a * y[i-1].
+	double	recursiveA;
+	double	recursiveB;
+
+	// Second-order Butterworth, direct form II transposed.
+	double	butterworthB[3];
+	double	butterworthA[3];
+
+	// Savitzky-Golay.
+	int		halfWidth;
+
+	int		overlap;
+
+	int					nChannels;
+	DexFilterChannel	channel[DEX_FILTER_MAX_CHANNELS];
+
+	const int	*breakFrame;
+	const int	*nBreaks;
+	int  NextBreak( int frame );
+
+	void ForwardBackward( double *data, int n );
+	void SavitzkyGolay( double *in, double *out, int n, int first, int last );
+
+};
@@ -0,0 +1,139 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                                 GripLatency.c                                 */
+/*                                                                               */
+/*********************************************************************************/
+//
+// Latency histograms for Grip packets, from the time stamp on board to the screen.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <sys/timeb.h>
+#include <Windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include "../Useful/fMessageBox.h"
+#include "../Useful/Useful.h"
+
+#include "GripLatency.h"
+
+const char *GripLatencyStageName[GRIP_LATENCY_STAGES] = { "receive", "cache_write", "ingest", "draw" };
+
+double UnixToGPS( double instant ) {
+	// NB EPM uses GPS time (second since midnight Jan 5-6 1980), while
+	// _ftime_s() uses seconds since midnight Jan. 1 1970 UTC.
+	// UTC takes into account leap seconds, GPS does not.
+	return( instant
+		- 315964800 // Offset in seconds between Unix 0 and GPS 0
+		+ 16 );		// Offset taking into account leap seconds, as of 1 Jan 2015.
+}
+
+double GripClockGPS( void ) {
+	struct __timeb32 utc;
+	_ftime32_s( &utc );
+	return( UnixToGPS( (double) utc.time + (double) utc.millitm / 1000.0 ) );
+}
+
+/***********************************************************************************/
+
+void GripLatencyReset( GripLatencyHistogram *histogram ) {
+	memset( histogram, 0, sizeof( *histogram ) );
+}
+
+// Bin 0 holds the values below GRIP_LATENCY_MIN (including negative ones, if the clocks
+//  disagree) and the last bin holds the values beyond the top of the scale.
+static int LatencyBin( double latency ) {
+	int bin;
+	if ( latency < GRIP_LATENCY_MIN ) return( 0 );
+	bin = 1 + (int) floor( log10( latency / GRIP_LATENCY_MIN ) * GRIP_LATENCY_BINS_PER_DECADE );
+	if ( bin > GRIP_LATENCY_BINS - 1 ) bin = GRIP_LATENCY_BINS - 1;
+	return( bin );
+}
+
+// Lower edge of a bin, in seconds.
+static double LatencyBinEdge( int bin ) {
+	if ( bin <= 0 ) return( 0.0 );
+	return( GRIP_LATENCY_MIN * pow( 10.0, (double) ( bin - 1 ) / GRIP_LATENCY_BINS_PER_DECADE ) );
+}
+
+void GripLatencyAdd( GripLatencyHistogram *histogram, double latency ) {
+	histogram->count[ LatencyBin( latency ) ]++;
+	if ( histogram->n == 0 || latency < histogram->min ) histogram->min = latency;
+	if ( histogram->n == 0 || latency > histogram->max ) histogram->max = latency;
+	histogram->sum += latency;
+	histogram->n++;
+}
+
+double GripLatencyPercentile( const GripLatencyHistogram *histogram, double percent ) {
+
+	unsigned long rank, seen = 0;
+	double value;
+	int bin;
+
+	if ( histogram->n == 0 ) return( 0.0 );
+	rank = (unsigned long) ceil( percent / 100.0 * histogram->n );
+	if ( rank < 1 ) rank = 1;
+	for ( bin = 0; bin < GRIP_LATENCY_BINS - 1; bin++ ) {
+		seen += histogram->count[bin];
+		if ( seen >= rank ) break;
+	}
+	// Take the middle of the bin, on the log scale, but stay within the values actually seen.
+	if ( bin == 0 ) value = histogram->min;
+	else if ( bin == GRIP_LATENCY_BINS - 1 ) value = histogram->max;
+	else value = sqrt( LatencyBinEdge( bin ) * LatencyBinEdge( bin + 1 ) );
+	if ( value < histogram->min ) value = histogram->min;
+	if ( value > histogram->max ) value = histogram->max;
+	return( value );
+
+}
+
+void GripLatencyPrintSummary( FILE *fp, const char *name, const GripLatencyHistogram *histogram ) {
+	fprintf( fp, "%-12s n %8lu  p50 %10.1f ms  p99 %10.1f ms  max %10.1f ms\n", name, histogram->n,
+		GripLatencyPercentile( histogram, 50.0 ) * 1000.0, GripLatencyPercentile( histogram, 99.0 ) * 1000.0, histogram->max * 1000.0 );
+}
+
+int GripLatencyWriteReport( const char *filename, const GripLatencyHistogram histogram[GRIP_LATENCY_STAGES] ) {
+
+	FILE *fp;
+	int stage, bin;
+
+	fp = fopen( filename, "w" );
+	if ( !fp ) return( -1 );
+	fprintf( fp, "# Latency from the time stamp on board, in milliseconds.\n" );
+	for ( stage = 0; stage < GRIP_LATENCY_STAGES; stage++ ) {
+		if ( histogram[stage].n == 0 ) continue;
+		GripLatencyPrintSummary( fp, GripLatencyStageName[stage], &histogram[stage] );
+	}
+	fprintf( fp, "# Histograms: stage, lower edge of the bin (ms), count.\n" );
+	for ( stage = 0; stage < GRIP_LATENCY_STAGES; stage++ ) {
+		for ( bin = 0; bin < GRIP_LATENCY_BINS; bin++ ) {
+			if ( histogram[stage].count[bin] ) fprintf( fp, "%s %.3f %lu\n", GripLatencyStageName[stage], LatencyBinEdge( bin ) * 1000.0, histogram[stage].count[bin] );
+		}
+	}
+	return( fclose( fp ) ? -1 : 0 );
+
+}
+
+static void CreateLatencyFilename( char *filename, int max_characters, const char *root, const char *extension ) {
+	int bytes_written = sprintf( filename, "%s%s", root, extension );
+	if ( bytes_written < 0 || bytes_written > max_characters ) {
+			fMessageBox( MB_OK, "Grip", "Error in sprintf()." );
+			exit( -1 );
+	}
+}
+
+void CreateGripLatencyFilename( char *filename, int max_characters, const char *root ) {
+	CreateLatencyFilename( filename, max_characters, root, ".rt.lat" );
+}
+
+void CreateGripLatencyReportFilename( char *filename, int max_characters, const char *root ) {
+	CreateLatencyFilename( filename, max_characters, root, ".latency.txt" );
+}
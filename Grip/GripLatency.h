@@ -0,0 +1,88 @@
+/********************************************************************************/
+
+//
+// GripLatency.h
+// Measurement of how long it takes for a packet to get from GRIP to the screen.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include "GripPackets.h"
+
+// Each RT packet is stamped on board (the EPM coarse and fine time). On the ground it is
+//  received by GripGroundMonitorClient and written to the RT cache file, then the GripMMI
+//  reads it in on one of its refresh cycles and draws it. The latency at each stage is the
+//  time elapsed since the packet was stamped on board.
+//
+// The ground times come from the clock of the computer, converted to GPS time. Any offset
+//  between that clock and the one on board is included in all of the latencies, but not in
+//  the differences between stages.
+//
+// GripGroundMonitorClient writes a GripLatencyRecord with its two times for every RT packet
+//  that it caches, to a latency file that runs parallel to the RT cache file. The GripMMI adds
+//  its own two times to the same packets and accumulates the four latencies in histograms.
+
+typedef enum {
+	GRIP_LATENCY_RECEIVE,
+	GRIP_LATENCY_CACHE_WRITE,
+	GRIP_LATENCY_INGEST,
+	GRIP_LATENCY_DRAW,
+	GRIP_LATENCY_STAGES
+} GripLatencyStage;
+
+// The record in the latency file for the Nth RT packet in the cache file.
+// Times are in GPS seconds.
+typedef struct {
+	double			onboard;
+	double			received;
+	double			written;
+	unsigned int	tmCounter;
+	unsigned int	spare;
+} GripLatencyRecord;
+
+// Histograms have bins of equal width on a log scale, from GRIP_LATENCY_MIN seconds up to
+//  GRIP_LATENCY_DECADES decades above, plus one bin for anything below and one for anything above.
+#define GRIP_LATENCY_MIN				0.0001
+#define GRIP_LATENCY_DECADES			8
+#define GRIP_LATENCY_BINS_PER_DECADE	20
+#define GRIP_LATENCY_BINS				( GRIP_LATENCY_DECADES * GRIP_LATENCY_BINS_PER_DECADE + 2 )
+
+typedef struct {
+	unsigned long	count[GRIP_LATENCY_BINS];
+	unsigned long	n;
+	double			sum;
+	double			min;
+	double			max;
+} GripLatencyHistogram;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const char *GripLatencyStageName[GRIP_LATENCY_STAGES];
+
+// Convert an instant in seconds since Jan. 1 1970 UTC to GPS time.
+double UnixToGPS( double instant );
+// The current time in GPS seconds, to the millisecond.
+double GripClockGPS( void );
+
+void   GripLatencyReset( GripLatencyHistogram *histogram );
+void   GripLatencyAdd( GripLatencyHistogram *histogram, double latency );
+// Latency below which the given percentage of the values fall, to within the width of a bin.
+double GripLatencyPercentile( const GripLatencyHistogram *histogram, double percent );
+
+// Print a line with the count, p50, p99 and maximum, in milliseconds.
+void GripLatencyPrintSummary( FILE *fp, const char *name, const GripLatencyHistogram *histogram );
+// Write the summaries and the non-empty bins of the histograms for all the stages.
+// Stages with no values are left out. Returns 0 on success.
+int  GripLatencyWriteReport( const char *filename, const GripLatencyHistogram histogram[GRIP_LATENCY_STAGES] );
+
+// The latency file that goes with the cache files with the given root,
+//  and the report written by the GripMMI from it.
+void CreateGripLatencyFilename( char *filename, int max_characters, const char *root );
+void CreateGripLatencyReportFilename( char *filename, int max_characters, const char *root );
+
+#ifdef __cplusplus
+}
+#endif
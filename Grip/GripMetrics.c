@@ -0,0 +1,187 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                                 GripMetrics.c                                 */
+/*                                                                               */
+/*********************************************************************************/
+//
+// Metrics of the packet stream received by GripGroundMonitorClient, in Prometheus text format.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include "GripMetrics.h"
+
+static const char *counterName[GRIP_METRIC_COUNTERS] = {
+	"grip_receiver_non_epm_packets_total",
+	"grip_receiver_non_grip_packets_total",
+	"grip_receiver_overruns_total",
+	"grip_receiver_skipped_bytes_total",
+	"grip_receiver_reconnects_total",
+	"grip_receiver_alive_send_failures_total"
+};
+static const char *counterHelp[GRIP_METRIC_COUNTERS] = {
+	"Packets without the EPM telemetry sync marker.",
+	"EPM packets from subsystems other than GRIP.",
+	"Packets cut off at the maximum EPM packet length because their length was unknown.",
+	"Bytes dropped while looking for a transfer frame sync marker.",
+	"Connections to the server after the first one.",
+	"Alive packets that could not be sent."
+};
+
+static const double writeBucket[GRIP_METRICS_WRITE_BUCKETS] = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0
+};
+
+// A slot holds the TM identifier + 1, so that 0 means that it is free.
+// The extra slot at the end takes the identifiers that did not get one.
+static volatile LONG		identifierSlot[GRIP_METRICS_MAX_IDENTIFIERS];
+static volatile LONGLONG	identifierPackets[GRIP_METRICS_MAX_IDENTIFIERS + 1];
+static volatile LONGLONG	identifierBytes[GRIP_METRICS_MAX_IDENTIFIERS + 1];
+
+static volatile LONGLONG	counter[GRIP_METRIC_COUNTERS];
+static volatile LONGLONG	queueDepth = 0;
+static volatile LONGLONG	connected = 0;
+
+// Counts per bucket, not yet cumulative, plus one for anything above the last bound.
+static volatile LONGLONG	writeCount[GRIP_METRICS_WRITE_BUCKETS + 1];
+static volatile LONGLONG	writeMicroseconds = 0;
+
+static char	writerFilename[1024];
+static int	writerPeriod = GRIP_METRICS_PERIOD;
+
+static LONGLONG ReadMetric( volatile LONGLONG *metric ) {
+	return( InterlockedCompareExchange64( metric, 0, 0 ) );
+}
+
+static int IdentifierSlot( unsigned short tm_identifier ) {
+
+	LONG key = (LONG) tm_identifier + 1;
+	LONG previous;
+	int slot;
+
+	for ( slot = 0; slot < GRIP_METRICS_MAX_IDENTIFIERS; slot++ ) {
+		if ( identifierSlot[slot] == key ) return( slot );
+		if ( identifierSlot[slot] == 0 ) {
+			previous = InterlockedCompareExchange( &identifierSlot[slot], key, 0 );
+			if ( previous == 0 || previous == key ) return( slot );
+		}
+	}
+	return( GRIP_METRICS_MAX_IDENTIFIERS );
+
+}
+
+void GripMetricsCountPacket( unsigned short tm_identifier, int bytes ) {
+	int slot = IdentifierSlot( tm_identifier );
+	InterlockedExchangeAdd64( &identifierPackets[slot], 1 );
+	InterlockedExchangeAdd64( &identifierBytes[slot], bytes );
+}
+
+void GripMetricsCount( GripMetricCounter which, long long n ) {
+	InterlockedExchangeAdd64( &counter[which], n );
+}
+
+void GripMetricsSetQueueDepth( int bytes ) {
+	InterlockedExchange64( &queueDepth, bytes );
+}
+
+void GripMetricsSetConnected( int is_connected ) {
+	InterlockedExchange64( &connected, is_connected ? 1 : 0 );
+}
+
+void GripMetricsCacheWrite( double seconds ) {
+	int bucket;
+	for ( bucket = 0; bucket < GRIP_METRICS_WRITE_BUCKETS; bucket++ ) {
+		if ( seconds <= writeBucket[bucket] ) break;
+	}
+	InterlockedExchangeAdd64( &writeCount[bucket], 1 );
+	InterlockedExchangeAdd64( &writeMicroseconds, (LONGLONG) ( seconds * 1000000.0 ) );
+}
+
+/***********************************************************************************/
+
+int GripMetricsWrite( const char *filename ) {
+
+	FILE *fp;
+	char temporary[sizeof( writerFilename ) + 16];
+	LONGLONG cumulative;
+	int i;
+
+	// The final write from the main thread may overlap with one from the writer thread.
+	sprintf( temporary, "%.*s.%u.tmp", (int) sizeof( writerFilename ) - 1, filename, (unsigned int) GetCurrentThreadId() );
+	fp = fopen( temporary, "w" );
+	if ( !fp ) return( -1 );
+
+	fprintf( fp, "# HELP grip_receiver_packets_total EPM packets received, by TM identifier.\n" );
+	fprintf( fp, "# TYPE grip_receiver_packets_total counter\n" );
+	for ( i = 0; i < GRIP_METRICS_MAX_IDENTIFIERS && identifierSlot[i]; i++ ) {
+		fprintf( fp, "grip_receiver_packets_total{tm_identifier=\"0x%04x\"} %lld\n", (unsigned int) identifierSlot[i] - 1, ReadMetric( &identifierPackets[i] ) );
+	}
+	fprintf( fp, "grip_receiver_packets_total{tm_identifier=\"other\"} %lld\n", ReadMetric( &identifierPackets[GRIP_METRICS_MAX_IDENTIFIERS] ) );
+	fprintf( fp, "# HELP grip_receiver_bytes_total Bytes in the EPM packets received, by TM identifier.\n" );
+	fprintf( fp, "# TYPE grip_receiver_bytes_total counter\n" );
+	for ( i = 0; i < GRIP_METRICS_MAX_IDENTIFIERS && identifierSlot[i]; i++ ) {
+		fprintf( fp, "grip_receiver_bytes_total{tm_identifier=\"0x%04x\"} %lld\n", (unsigned int) identifierSlot[i] - 1, ReadMetric( &identifierBytes[i] ) );
+	}
+	fprintf( fp, "grip_receiver_bytes_total{tm_identifier=\"other\"} %lld\n", ReadMetric( &identifierBytes[GRIP_METRICS_MAX_IDENTIFIERS] ) );
+
+	for ( i = 0; i < GRIP_METRIC_COUNTERS; i++ ) {
+		fprintf( fp, "# HELP %s %s\n", counterName[i], counterHelp[i] );
+		fprintf( fp, "# TYPE %s counter\n", counterName[i] );
+		fprintf( fp, "%s %lld\n", counterName[i], ReadMetric( &counter[i] ) );
+	}
+
+	fprintf( fp, "# HELP grip_receiver_queue_depth_bytes Bytes received but not yet handed out as packets.\n" );
+	fprintf( fp, "# TYPE grip_receiver_queue_depth_bytes gauge\n" );
+	fprintf( fp, "grip_receiver_queue_depth_bytes %lld\n", ReadMetric( &queueDepth ) );
+	fprintf( fp, "# HELP grip_receiver_connected Whether the receiver is connected to the server.\n" );
+	fprintf( fp, "# TYPE grip_receiver_connected gauge\n" );
+	fprintf( fp, "grip_receiver_connected %lld\n", ReadMetric( &connected ) );
+
+	fprintf( fp, "# HELP grip_receiver_cache_write_seconds Time to write a packet to a cache file.\n" );
+	fprintf( fp, "# TYPE grip_receiver_cache_write_seconds histogram\n" );
+	cumulative = 0;
+	for ( i = 0; i < GRIP_METRICS_WRITE_BUCKETS; i++ ) {
+		cumulative += ReadMetric( &writeCount[i] );
+		fprintf( fp, "grip_receiver_cache_write_seconds_bucket{le=\"%g\"} %lld\n", writeBucket[i], cumulative );
+	}
+	cumulative += ReadMetric( &writeCount[GRIP_METRICS_WRITE_BUCKETS] );
+	fprintf( fp, "grip_receiver_cache_write_seconds_bucket{le=\"+Inf\"} %lld\n", cumulative );
+	fprintf( fp, "grip_receiver_cache_write_seconds_sum %.6f\n", (double) ReadMetric( &writeMicroseconds ) / 1000000.0 );
+	fprintf( fp, "grip_receiver_cache_write_seconds_count %lld\n", cumulative );
+
+	if ( fclose( fp ) ) return( -1 );
+	if ( !MoveFileExA( temporary, filename, MOVEFILE_REPLACE_EXISTING ) ) return( -1 );
+	return( 0 );
+
+}
+
+static DWORD WINAPI MetricsWriter( LPVOID param ) {
+	while ( 1 ) {
+		Sleep( writerPeriod );
+		GripMetricsWrite( writerFilename );
+	}
+	return( 0 );
+}
+
+int GripMetricsStartWriter( const char *filename, int period ) {
+
+	HANDLE thread;
+
+	strncpy( writerFilename, filename, sizeof( writerFilename ) - 1 );
+	writerPeriod = period;
+	if ( GripMetricsWrite( writerFilename ) ) return( -1 );
+	thread = CreateThread( NULL, 0, MetricsWriter, NULL, 0, NULL );
+	if ( !thread ) return( -1 );
+	CloseHandle( thread );
+	return( 0 );
+
+}
@@ -0,0 +1,56 @@
+/********************************************************************************/
+
+//
+// GripMetrics.h
+// Counters and gauges describing the packet stream handled by GripGroundMonitorClient.
+//
+
+#pragma once
+
+// The metrics are written in the Prometheus text exposition format to a file that is
+//  rewritten periodically, for instance into the directory watched by the textfile collector
+//  of node_exporter. The file is written under a temporary name and then renamed, so that
+//  a reader never sees it half written.
+//
+// Every update is a single interlocked operation, so the receive loop never waits on the
+//  thread that writes the file.
+
+typedef enum {
+	GRIP_METRIC_NON_EPM,			// Packets without the EPM telemetry sync marker.
+	GRIP_METRIC_NON_GRIP,			// EPM packets from other subsystems.
+	GRIP_METRIC_OVERRUNS,			// Packets cut off at the maximum EPM packet length because no length could be found.
+	GRIP_METRIC_SKIPPED_BYTES,		// Bytes dropped while looking for the next sync marker.
+	GRIP_METRIC_RECONNECTS,			// Connections to the server after the first one.
+	GRIP_METRIC_ALIVE_FAILURES,		// Alive packets that could not be sent.
+	GRIP_METRIC_COUNTERS
+} GripMetricCounter;
+
+// Packets are counted for up to this many different TM identifiers. Any others are counted together.
+#define GRIP_METRICS_MAX_IDENTIFIERS	32
+
+// Upper bounds, in seconds, of the buckets for the time taken to write a packet to a cache file.
+#define GRIP_METRICS_WRITE_BUCKETS		13
+
+// Default period for rewriting the metrics file.
+#define GRIP_METRICS_PERIOD				1000	// milliseconds
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Count an EPM packet of the given type and length.
+void GripMetricsCountPacket( unsigned short tm_identifier, int bytes );
+void GripMetricsCount( GripMetricCounter which, long long n );
+// Bytes received but not yet handed out as packets.
+void GripMetricsSetQueueDepth( int bytes );
+void GripMetricsSetConnected( int is_connected );
+void GripMetricsCacheWrite( double seconds );
+
+// Write the current values of all the metrics. Returns 0 on success.
+int GripMetricsWrite( const char *filename );
+// Start a thread that rewrites the file every 'period' milliseconds. Returns 0 on success.
+int GripMetricsStartWriter( const char *filename, int period );
+
+#ifdef __cplusplus
+}
+#endif
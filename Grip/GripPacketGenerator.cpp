@@ -0,0 +1,374 @@
+/*********************************************************************************/
+/*                                                                               */
+/*                             GripPacketGenerator.cpp                           */
+/*                                                                               */
+/*********************************************************************************/
+
+// Reproducible streams of synthetic Grip realtime and housekeeping packets.
+// Copyright (c) 2015 PsyPhy Consulting. All rights reserved.
+
+// Disable warnings about unsafe functions.
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include "../Useful/fMessageBox.h"
+#include "GripPackets.h"
+#include "GripPacketGenerator.h"
+
+// Numbers of visual targets, as in GripMMIGlobals.h.
+#ifndef N_VERTICAL_TARGETS
+#define N_VERTICAL_TARGETS		13
+#define N_HORIZONTAL_TARGETS	10
+#endif
+
+/***************************************************************************/
+
+GripPacketGenerator::GripPacketGenerator( unsigned int seed ) {
+
+	this->seed = seed;
+	startTime = GRIP_GENERATOR_DEFAULT_START;
+
+	// One HK packet for two RT packets, as on board, and a short pause every 6 seconds or so.
+	hkInterval = 2;
+	epochPackets = 12;
+	epochPause = 5.0;
+
+	// Occasional occlusions of the manipulandum, but otherwise a clean stream.
+	gapRate = 0.0;
+	gapDuration = 10.0;
+	occlusionRate = 0.03;
+	occlusionSlices = 10;
+	lossRate = 0.0;
+
+	Reset();
+
+}
+
+void GripPacketGenerator::Reset( void ) {
+
+	// Spread the bits of the seed over the whole state (splitmix64), so that
+	//  neighbouring seeds give unrelated streams and a seed of 0 works too.
+	unsigned long long z = (unsigned long long) seed + 0x9E3779B97F4A7C15ULL;
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	randomState = ( z ^ ( z >> 31 ) );
+	if ( randomState == 0 ) randomState = 1;
+
+	time = startTime;
+	tmCounter = 0;
+	epoch = 0;
+	epochCount = 0;
+	rtPacketCount = 0;
+	occludedSlices = 0;
+	hkPending = false;
+	started = false;
+
+	rtPackets = hkPackets = 0;
+	rtLost = hkLost = 0;
+	gaps = occlusions = 0;
+
+}
+
+// Uniformly distributed in [0, 1), from a xorshift64* generator.
+// rand() is not used because its sequence differs from one C library to the next.
+double GripPacketGenerator::Random( void ) {
+	randomState ^= randomState >> 12;
+	randomState ^= randomState << 25;
+	randomState ^= randomState >> 27;
+	return( (double) ( ( randomState * 2685821657736338717ULL ) >> 11 ) / 9007199254740992.0 );
+}
+
+double GripPacketGenerator::Time( void ) {
+	return( time );
+}
+
+void GripPacketGenerator::SetTime( EPMTelemetryHeaderInfo *header ) {
+	double seconds = floor( time );
+	header->coarseTime = (unsigned long) seconds;
+	header->fineTime = (unsigned short) ( ( time - seconds ) * 10000.0 );
+}
+
+/***************************************************************************/
+
+// Fabricate data values for a realtime packet.
+// Note that position, orientation, acceleration and force data are not necessarily
+//  coherent with each other. We are just trying to generate some data to be plotted.
+void GripPacketGenerator::FillRealtime( GripRealtimeDataInfo *rt, EPMTelemetryHeaderInfo *header ) {
+
+	memset( rt, 0, sizeof( *rt ) );
+	rt->packetTimestamp = EPMtoSeconds( header );
+	rt->acquisitionID = epoch;
+	rt->rtPacketCount = rtPacketCount;
+
+	for ( int slice = 0; slice < RT_SLICES_PER_PACKET; slice++ ) {
+
+		ManipulandumPacket *data = &rt->dataSlice[slice];
+
+		// The last slice was taken at the time of the packet, as assumed by ExtractGripRealtimeDataInfo().
+		double instant = (double) rt->packetTimestamp - ( RT_SLICES_PER_PACKET - 1 - slice ) * RT_DEFAULT_SECONDS_PER_SLICE;
+		data->bestGuessPoseTimestamp = data->bestGuessAnalogTimestamp = instant;
+		data->poseTick = data->analogTick = (unsigned long) floor( ( instant - startTime ) / RT_SECONDS_PER_TICK + 0.5 );
+
+		// Null orientation unless the pattern says otherwise.
+		data->quaternion[M] = 1.0;
+
+		// Most of the patterns are computed from a 1 Hz sinusoid.
+		double t = instant - startTime;
+		double s = sin( t * Pi * 2.0 );
+		double c = cos( t * Pi * 2.0 );
+
+		// The pattern changes each epoch, but recycles every 6 epochs.
+		switch ( epoch % 6 ) {
+		case 0: // Oscillating left-right movement.
+			data->position[X] = 300.0 + 300.0 * c;
+			data->acceleration[X] = - 300.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
+			data->ft[0].force[X] = - 14.0 + 8.5 * s;
+			data->ft[1].force[X] = - data->ft[0].force[X];
+			// Wrist and frame visible.
+			data->markerVisibility[0] = 0x000ff;
+			data->markerVisibility[1] = 0xf0fff;
+			break;
+		case 1: // Oscillating up-down movement.
+			data->position[Y] = 300.0 + 300.0 * c;
+			data->acceleration[Y] = - 300.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
+			data->ft[0].force[Y] = 2.0 * s;
+			data->ft[1].force[Y] = 1.8 * s;
+			// Wrist visible, frame occluded.
+			data->markerVisibility[0] = 0x000ff;
+			data->markerVisibility[1] = 0x0f0ff;
+			break;
+		case 2: // Oscillating in-out movement.
+			data->position[Z] = - 300.0 + 200.0 * c;
+			data->acceleration[Z] = - 200.0 * c * RT_DEFAULT_SECONDS_PER_SLICE * RT_DEFAULT_SECONDS_PER_SLICE;
+			data->ft[0].force[Z] = 3.0 * s;
+			data->ft[1].force[Z] = 3.2 * s;
+			// Frame visible, wrist occluded.
+			data->markerVisibility[1] = 0x000ff;
+			data->markerVisibility[0] = 0x00fff;
+			break;
+		case 3:
+			// Pitch rotations.
+			data->quaternion[X] = s / 2.0;
+			data->quaternion[M] = c / 2.0;
+			// Horizontal sliding CoP.
+			data->ft[0].force[X] = - 14.0 + 8.5 * s;
+			data->ft[1].force[X] = - data->ft[0].force[X];
+			data->ft[0].torque[Y] = data->ft[0].force[X] * 0.01 * s;
+			data->ft[1].torque[Y] = data->ft[1].force[X] * 0.011 * s;
+			// Wrist and frame visible.
+			data->markerVisibility[1] = 0xfffff;
+			data->markerVisibility[0] = 0xf0f0f;
+			break;
+		case 4:
+			// Yaw rotations.
+			data->quaternion[Y] = s / 2.0;
+			data->quaternion[M] = c / 2.0;
+			// Vertical sliding CoP.
+			data->ft[0].force[X] = - 14.0 + 8.5 * s;
+			data->ft[1].force[X] = - data->ft[0].force[X];
+			data->ft[0].torque[Z] = data->ft[0].force[X] * 0.01 * s;
+			data->ft[1].torque[Z] = data->ft[1].force[X] * 0.011 * s;
+			// Wrist and frame visible.
+			data->markerVisibility[1] = 0xfffff;
+			data->markerVisibility[0] = 0x0f0f0;
+			break;
+		case 5:
+			// Roll rotations.
+			data->quaternion[Z] = s / 2.0;
+			data->quaternion[M] = c / 2.0;
+			// Diagonal sliding CoP.
+			data->ft[0].force[X] = - 14.0 + 8.5 * s;
+			data->ft[1].force[X] = - data->ft[0].force[X];
+			data->ft[0].torque[Y] = data->ft[0].force[X] * 0.01 * s;
+			data->ft[1].torque[Y] = data->ft[1].force[X] * 0.011 * s;
+			data->ft[0].torque[Z] = data->ft[0].force[X] * 0.01 * s;
+			data->ft[1].torque[Z] = data->ft[1].force[X] * 0.011 * s;
+			// Wrist and frame visible.
+			data->markerVisibility[0] = 0xfffff;
+			data->markerVisibility[1] = 0xfffff;
+			break;
+		}
+
+		// Simulate occasional occlusions of the manipulandum. An occlusion
+		//  hides the manipulandum markers as seen from both codas.
+		if ( occludedSlices == 0 ) {
+			data->manipulandumVisibility = true;
+			if ( occlusionRate > 0.0 && Random() < occlusionRate ) {
+				occludedSlices = occlusionSlices;
+				occlusions++;
+			}
+		}
+		else {
+			data->manipulandumVisibility = false;
+			data->markerVisibility[0] &= 0xfff00;
+			data->markerVisibility[1] &= 0xfff00;
+			occludedSlices--;
+		}
+
+	}
+
+}
+
+// Fabricate the housekeeping values.
+// The visible targets, sound generator, cradles and acquisition state stay
+//  constant over the course of each epoch and cycle from one epoch to the next.
+void GripPacketGenerator::FillHealthAndStatus( GripHealthAndStatusInfo *hk ) {
+
+	memset( hk, 0, sizeof( *hk ) );
+
+	// The state of the script interpreter does not vary, because valid values depend on
+	//  the scripts that are loaded and it would be too complicated to keep them coherent.
+	hk->user = 11;
+	hk->protocol = 201;
+	hk->task = 210;
+	hk->step = 10;
+
+	hk->verticalTargetFeedback = ( 0x01 << ( epoch % N_VERTICAL_TARGETS ) );
+	hk->horizontalTargetFeedback = ( 0x01 << ( epoch % N_HORIZONTAL_TARGETS ) );
+	// Every other tone is 'muted', so every other epoch the sound should be off.
+	hk->toneFeedback = epoch % 8;
+	// Different for each cradle.
+	hk->cradleDetectors = ( epoch % 4 ) + ( ( ( epoch + 1 ) % 4 ) << 2 ) + ( ( ( epoch + 2 ) % 4 ) << 4 );
+	// Status 2 means acquiring (2 epochs out of 3) or filming (1 out of 2).
+	hk->motionTrackerStatusEnum = ( epoch % 3 ? 2 : 0 );
+	hk->crewCameraStatusEnum = ( epoch % 2 ? 2 : 0 );
+
+}
+
+/***************************************************************************/
+
+int GripPacketGenerator::Next( EPMTelemetryHeaderInfo *header, GripRealtimeDataInfo *rt, GripHealthAndStatusInfo *hk ) {
+
+	GripRealtimeDataInfo	unwanted_rt;
+	GripHealthAndStatusInfo	unwanted_hk;
+	if ( !rt ) rt = &unwanted_rt;
+	if ( !hk ) hk = &unwanted_hk;
+
+	// Keep going until a packet gets through.
+	while ( 1 ) {
+
+		int id;
+
+		if ( hkPending ) {
+			// HK packets go out at the same time as the RT packet that they follow.
+			memcpy( header, &hkHeader, sizeof( *header ) );
+			SetTime( header );
+			FillHealthAndStatus( hk );
+			hkPending = false;
+			id = GRIP_HK_ID;
+		}
+		else {
+			// Move on to the time of the next RT packet, after a pause if need be.
+			if ( started ) {
+				time += RT_SLICES_PER_PACKET * RT_DEFAULT_SECONDS_PER_SLICE;
+				if ( epochPackets > 0 && epochCount >= epochPackets ) {
+					time += epochPause;
+					epoch++;
+					epochCount = 0;
+					rtPacketCount = 0;
+				}
+				if ( gapRate > 0.0 && Random() < gapRate ) {
+					time += gapDuration;
+					gaps++;
+				}
+			}
+			started = true;
+			memcpy( header, &rtHeader, sizeof( *header ) );
+			SetTime( header );
+			FillRealtime( rt, header );
+			rtPacketCount++;
+			epochCount++;
+			id = GRIP_RT_ID;
+		}
+
+		header->TMCounter = tmCounter++;
+
+		bool lost = ( lossRate > 0.0 && Random() < lossRate );
+		if ( id == GRIP_RT_ID ) {
+			if ( lost ) rtLost++;
+			else rtPackets++;
+			if ( hkInterval > 0 && ( rtPackets + rtLost ) % hkInterval == 0 ) hkPending = true;
+		}
+		else {
+			if ( lost ) hkLost++;
+			else hkPackets++;
+		}
+		if ( !lost ) return( id );
+
+	}
+
+}
+
+int GripPacketGenerator::NextPacket( EPMTelemetryPacket *packet ) {
+
+	EPMTelemetryHeaderInfo	header;
+	GripRealtimeDataInfo	rt;
+	GripHealthAndStatusInfo	hk;
+
+	// Anything beyond the end of the packet is left empty, for those that store the whole buffer.
+	memset( packet, 0, sizeof( *packet ) );
+	if ( Next( &header, &rt, &hk ) == GRIP_RT_ID ) {
+		InsertEPMTelemetryHeaderInfo( packet, &header );
+		InsertGripRealtimeDataInfo( packet, &rt );
+		return( rtPacketLengthInBytes );
+	}
+	else {
+		InsertEPMTelemetryHeaderInfo( packet, &header );
+		InsertGripHealthAndStatusInfo( packet, &hk );
+		return( hkPacketLengthInBytes );
+	}
+
+}
+
+int GripPacketGenerator::WriteCacheFiles( const char *root, double duration ) {
+
+	// The RT and HK files hold packets of their own type back to back. The third one holds
+	//  both, each in a record of EPM_BUFFER_LENGTH bytes, which is also what the CLWSemulator
+	//  expects for the playback of recorded packets.
+	GripPacketType	type[3] = { GRIP_RT_SCIENCE_PACKET, GRIP_HK_BULK_PACKET, GRIP_UNKNOWN_PACKET };
+	FILE			*fp[3];
+	char			filename[3][MAX_PATHLENGTH];
+
+	EPMTelemetryPacket packet;
+	int written = 0;
+
+	for ( int i = 0; i < 3; i++ ) {
+		CreateGripPacketCacheFilename( filename[i], sizeof( filename[i] ), type[i], root );
+		fp[i] = fopen( filename[i], "wb" );
+		if ( !fp[i] ) {
+			fMessageBox( MB_OK, "GripPacketGenerator", "Error opening %s for binary write.", filename[i] );
+			exit( -1 );
+		}
+	}
+
+	Reset();
+	while ( 1 ) {
+		int length = NextPacket( &packet );
+		if ( time - startTime > duration ) break;
+		FILE *cache = ( length == rtPacketLengthInBytes ? fp[0] : fp[1] );
+		if ( fwrite( packet.buffer, 1, length, cache ) != (size_t) length
+			|| fwrite( packet.buffer, 1, EPM_BUFFER_LENGTH, fp[2] ) != EPM_BUFFER_LENGTH ) {
+			fMessageBox( MB_OK, "GripPacketGenerator", "Error writing cache files %s.*.gpk.", root );
+			exit( -1 );
+		}
+		if ( length == rtPacketLengthInBytes ) written++;
+	}
+
+	for ( int i = 0; i < 3; i++ ) {
+		if ( fclose( fp[i] ) ) {
+			fMessageBox( MB_OK, "GripPacketGenerator", "Error closing %s after binary write.", filename[i] );
+			exit( -1 );
+		}
+	}
+	return( written );
+
+}
@@ -0,0 +1,102 @@
+/********************************************************************************/
+
+//
+// GripPacketGenerator.h
+// Reproducible streams of synthetic Grip realtime and housekeeping packets.
+//
+
+#pragma once
+
+#include "GripPackets.h"
+
+// The generator produces the packets that Grip would send during a session, in the order
+//  in which they would be sent, with headers, sequence counts and timestamps filled in.
+//  The content is not meant to be realistic, just representative of what the GripMMI plots.
+//
+// The session is divided into epochs of epochPackets RT packets. Each epoch is a new
+//  acquisition, with its own pattern of movement and forces and its own target, tone and
+//  cradle states in the HK packets, and epochs are separated by a pause of epochPause seconds.
+//  Within an epoch, RT packets follow each other every RT_SLICES_PER_PACKET slices and an HK
+//  packet follows every hkInterval RT packets.
+//
+// On top of that, the generator can degrade the stream:
+//  - gapRate is the probability, for each RT packet, that a break of gapDuration seconds
+//     (loss of signal, say) comes before it.
+//  - occlusionRate is the probability, for each slice in which the manipulandum is visible,
+//     that it becomes hidden for the next occlusionSlices slices.
+//  - lossRate is the probability that a packet is lost on the way down. A lost packet uses
+//     up its place in the TMCounter and rtPacketCount sequences but is never returned.
+//
+// All the random choices come from a generator of our own, seeded by 'seed', so the same
+//  parameters give the same packets, byte for byte, on any machine. Time is simulated, so
+//  hours of packets can be produced in a few seconds.
+
+// Instant at which a generated session starts unless told otherwise, in GPS seconds (1 Jan 2015).
+#define GRIP_GENERATOR_DEFAULT_START	1104105616.0
+
+class GripPacketGenerator {
+
+public:
+
+	GripPacketGenerator( unsigned int seed = 1 );
+
+	// Parameters. They take effect from the next packet, but to reproduce a stream
+	//  they must be set before Reset() and left alone afterwards.
+	unsigned int	seed;
+	double			startTime;			// GPS time of the first packet, in seconds.
+	int				hkInterval;			// One HK packet for this many RT packets. 0 means no HK packets.
+	int				epochPackets;		// RT packets in each epoch. 0 means a single epoch.
+	double			epochPause;			// Seconds between epochs.
+	double			gapRate;
+	double			gapDuration;		// Seconds.
+	double			occlusionRate;
+	int				occlusionSlices;
+	double			lossRate;			// Must be less than 1.
+
+	// Start the stream over from the beginning.
+	void Reset( void );
+
+	// Generate the next packet of the stream. The header is filled in, along with either the
+	//  realtime data or the housekeeping values, depending on the type of packet, which is
+	//  returned (GRIP_RT_ID or GRIP_HK_ID). Either of the two pointers may be NULL if the
+	//  caller does not want that type of packet, but the packet is generated all the same.
+	int Next( EPMTelemetryHeaderInfo *header, GripRealtimeDataInfo *rt, GripHealthAndStatusInfo *hk );
+	// The same, as a packet ready to be sent or stored. Returns the length of the packet in bytes.
+	int NextPacket( EPMTelemetryPacket *packet );
+
+	// Start over and write the packets generated over the given number of seconds of simulated
+	//  time to a set of cache files with the given root, as GripGroundMonitorClient would have
+	//  written them. Existing files are overwritten. Returns the number of RT packets written.
+	int WriteCacheFiles( const char *root, double duration );
+
+	// GPS time of the last packet that was generated, in seconds.
+	double Time( void );
+
+	// What has been generated so far.
+	int		rtPackets;
+	int		hkPackets;
+	int		rtLost;
+	int		hkLost;
+	int		gaps;
+	int		occlusions;
+
+private:
+
+	unsigned long long	randomState;
+	double				Random( void );
+
+	// State of the stream.
+	double			time;
+	unsigned short	tmCounter;
+	int				epoch;
+	int				epochCount;			// RT packets, lost or not, since the start of the epoch.
+	unsigned long	rtPacketCount;
+	int				occludedSlices;		// Slices of the current occlusion still to come.
+	bool			hkPending;
+	bool			started;
+
+	void FillRealtime( GripRealtimeDataInfo *rt, EPMTelemetryHeaderInfo *header );
+	void FillHealthAndStatus( GripHealthAndStatusInfo *hk );
+	void SetTime( EPMTelemetryHeaderInfo *header );
+
+};
@@ -13,15 +13,20 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <io.h>
 #include <fcntl.h>
-#include <share.h>
 #include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
 #include <Windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
 
-#include "..\Useful\fMessageBox.h"
-#include "..\Useful\fOutputDebugString.h"
-#include "..\Useful\Useful.h"
+#include "../Useful/fMessageBox.h"
+#include "../Useful/fOutputDebugString.h"
+#include "../Useful/Useful.h"
+#include "../Useful/Trace.h"
 
 #include "GripPackets.h"
 
@@ -29,6 +34,8 @@
 // These are useful when inserting or extracting data from an EPM packet
 // because the packets are encoded in ESA-specified byte order, while
 // Windows / Intel use a different byte order.
+// NB The 'long' values in the packets are 32 bits. That is the size of a long in Visual C++,
+//  but not in 64 bit Linux, so the routines below use int for them.
 
 unsigned short swapbytes_short( unsigned short input ) {
 	union {
@@ -41,9 +48,9 @@ unsigned short swapbytes_short( unsigned short input ) {
 	return( out.value );
 }
 
-unsigned long swapbytes_long( unsigned long input ) {
+unsigned int swapbytes_long( unsigned int input ) {
 	union {
-		unsigned long value;
+		unsigned int value;
 		unsigned char  byte[4];
 	} in, out;
 	in.value = input;
@@ -78,9 +85,9 @@ short extract_reversed_short( const unsigned char bytes[2] ) {
 	return( out.value );
 }
 
-long extract_reversed_long( const unsigned char bytes[4] ) {
+unsigned int extract_reversed_long( const unsigned char bytes[4] ) {
 	union {
-		long			value;
+		unsigned int	value;
 		unsigned char	byte[4];
 	} out;
 	out.byte[0] = bytes[3];
@@ -109,51 +116,56 @@ float extract_reversed_float( const unsigned char bytes[4] ) {
 // 'if' or 'for' statement, i.e. "for ( i = X; i <= Z; i++ ) position[i] = ExtractShort( ptr );"
 #define ExtractShort( ptr ) extract_short( ptr ), ptr += sizeof( short ) 
 #define ExtractReversedShort( ptr ) extract_reversed_short( ptr ), ptr += sizeof( short ) 
-#define ExtractReversedLong( ptr ) extract_reversed_long( ptr ), ptr += sizeof( long ) 
+#define ExtractReversedLong( ptr ) extract_reversed_long( ptr ), ptr += sizeof( int ) 
 #define ExtractReversedFloat( ptr ) extract_reversed_float( ptr ), ptr += sizeof( float ) 
 #define ExtractChar( ptr ) (*ptr++)
 
-union {
+// The union is local to each routine so that packets can be built on several threads at once.
+typedef union {
 	float	float_value;
-	long	long_value;
-	unsigned long	ulong_value;
+	int		long_value;
+	unsigned int	ulong_value;
 	short	short_value;
 	unsigned short	ushort_value;
 	char  bytes[16]; // More bytes than we need.
-} __item;
+} InsertItem;
 
 int insert_float( char *ptr, float value ) {
 	int i;
-	__item.float_value = value;
+	InsertItem item;
+	item.float_value = value;
 	for (i = sizeof( float ) - 1; i >= 0; i-- ) {
-		*ptr = __item.bytes[i]; 
+		*ptr = item.bytes[i]; 
 		ptr++;
 	}
 	return( sizeof( float ) );
 }
 int insert_long( char *ptr, long value ) {
 	int i;
-	__item.long_value = value;
-	for (i = sizeof( long ) - 1; i >= 0; i-- ) {
-		*ptr = __item.bytes[i]; 
+	InsertItem item;
+	item.long_value = (int) value;
+	for (i = sizeof( int ) - 1; i >= 0; i-- ) {
+		*ptr = item.bytes[i]; 
 		ptr++;
 	}
-	return( sizeof( long ) );
+	return( sizeof( int ) );
 }
 int insert_ulong( char *ptr, unsigned long value ) {
 	int i;
-	__item.ulong_value = value;
-	for (i = sizeof( unsigned long ) - 1; i >= 0; i-- ) {
-		*ptr = __item.bytes[i]; 
+	InsertItem item;
+	item.ulong_value = (unsigned int) value;
+	for (i = sizeof( unsigned int ) - 1; i >= 0; i-- ) {
+		*ptr = item.bytes[i]; 
 		ptr++;
 	}
-	return( sizeof( unsigned long ) );
+	return( sizeof( unsigned int ) );
 }
 int insert_short( char *ptr, short value ) {
 	int i;
-	__item.short_value = value;
+	InsertItem item;
+	item.short_value = value;
 	for (i = sizeof( short ) - 1; i >= 0; i-- ) {
-		*ptr = __item.bytes[i]; 
+		*ptr = item.bytes[i]; 
 		ptr++;
 	}
 	return( sizeof( short ) );
@@ -186,7 +198,7 @@ void ExtractEPMTransferFrameHeaderInfo ( EPMTransferFrameHeaderInfo *header, con
 int InsertEPMTransferFrameHeaderInfo ( EPMTelemetryPacket *epm_packet, const EPMTransferFrameHeaderInfo *header  ) {
 	unsigned char *ptr = ((unsigned char *) epm_packet); 
 	unsigned int  bytes_inserted = 0;
-	*((long *)ptr)= swapbytes_long( header->epmLanSyncMarker ); ptr += sizeof( unsigned long ); bytes_inserted += sizeof( unsigned long);
+	*((unsigned int *)ptr)= swapbytes_long( header->epmLanSyncMarker ); ptr += sizeof( unsigned int ); bytes_inserted += sizeof( unsigned int );
 	*ptr =  header->spare1; ptr++; bytes_inserted++;
 	*ptr = header->softwareUnitID; ptr++; bytes_inserted++;
 	*((unsigned short *)ptr) = swapbytes_short( header->packetType ); ptr += sizeof( unsigned short ); bytes_inserted += sizeof( unsigned short);
@@ -207,7 +219,7 @@ int InsertEPMTelemetryHeaderInfo ( EPMTelemetryPacket *epm_packet, const EPMTele
 	bytes_inserted = InsertEPMTransferFrameHeaderInfo ( epm_packet, &header->transferFrameInfo );
 	ptr += bytes_inserted;
 
-	*((long *)ptr)= swapbytes_long( header->epmSyncMarker ); ptr += sizeof( unsigned long ); bytes_inserted += sizeof( unsigned long );
+	*((unsigned int *)ptr)= swapbytes_long( header->epmSyncMarker ); ptr += sizeof( unsigned int ); bytes_inserted += sizeof( unsigned int );
 	*ptr = header->subsystemMode; ptr++; bytes_inserted++;
 	*ptr = header->subsystemID; ptr++; bytes_inserted++;
 	*ptr = header->destination; ptr++; bytes_inserted++;
@@ -217,7 +229,7 @@ int InsertEPMTelemetryHeaderInfo ( EPMTelemetryPacket *epm_packet, const EPMTele
 	*ptr = header->model; ptr++; bytes_inserted++;
 	*ptr = header->taskID; ptr++; bytes_inserted++;
 	*((unsigned short *)ptr) = swapbytes_short( header->subsystemUnitVersion ); ptr += sizeof( unsigned short ); bytes_inserted += sizeof( unsigned short );
-	*((unsigned long  *)ptr) = swapbytes_long( header->coarseTime ); ptr += sizeof( unsigned long ); bytes_inserted += sizeof( unsigned long );
+	*((unsigned int *)ptr) = swapbytes_long( header->coarseTime ); ptr += sizeof( unsigned int ); bytes_inserted += sizeof( unsigned int );
 	*((unsigned short *)ptr) = swapbytes_short( header->fineTime ); ptr += sizeof( unsigned short ); bytes_inserted += sizeof( unsigned short );
 	*ptr = header->timerStatus; ptr++; bytes_inserted++;
 	*ptr = header->experimentMode; ptr++; bytes_inserted++;
@@ -272,6 +284,7 @@ void ExtractGripRealtimeDataInfo( GripRealtimeDataInfo *realtime_packet, const E
 	EPMTelemetryHeaderInfo telemetry_header;
 	long double timestamp;
 
+	TRACE_BEGIN( "ExtractGripRealtimeDataInfo" );
 	// Point to the actual data in the packet.
 	ptr = epm_packet->sections.rawData;
 	// Get the acquisition ID and packet count for that acquisition.
@@ -297,7 +310,7 @@ void ExtractGripRealtimeDataInfo( GripRealtimeDataInfo *realtime_packet, const E
 			}
 		}
 		for ( i = X; i <= Z; i++ ) {
-			lvalue = ExtractReversedLong( ptr );
+			lvalue = (int) ExtractReversedLong( ptr );
 			realtime_packet->dataSlice[slice].acceleration[i] = ((double) lvalue) / 1000.0 / 9.8;
 		}
 	}
@@ -355,6 +368,7 @@ void ExtractGripRealtimeDataInfo( GripRealtimeDataInfo *realtime_packet, const E
 			realtime_packet->dataSlice[slice+1].bestGuessAnalogTimestamp - RT_DEFAULT_SECONDS_PER_SLICE;
 #endif
 	}
+	TRACE_END( "ExtractGripRealtimeDataInfo" );
 }
 
 
@@ -395,6 +409,7 @@ void ExtractGripHealthAndStatusInfo( GripHealthAndStatusInfo *health_packet, con
 
 	const char *ptr;
 
+	TRACE_BEGIN( "ExtractGripHealthAndStatusInfo" );
 	// Point to the actual data in the packet.
 	ptr = epm_packet->sections.rawData;
 
@@ -432,7 +447,8 @@ void ExtractGripHealthAndStatusInfo( GripHealthAndStatusInfo *health_packet, con
 	health_packet->freeDiskSpaceE = ExtractReversedLong( ptr );
 
 	health_packet->crc = ExtractReversedShort( ptr );
-	
+
+	TRACE_END( "ExtractGripHealthAndStatusInfo" );
 }
 
 // Insert data destined for a Grip housekeeping packet into an EPM packet.
@@ -473,9 +489,9 @@ void InsertGripHealthAndStatusInfo( EPMTelemetryPacket *epm_packet, const GripHe
 	*((unsigned short *)ptr) = swapbytes_short( health_packet->cpuUsage ); ptr += sizeof( unsigned short );
 	*((unsigned short *)ptr) = swapbytes_short( health_packet->memoryUsage ); ptr += sizeof( unsigned short );
 
-	*((unsigned long *)ptr) = swapbytes_long( health_packet->freeDiskSpaceC ); ptr += sizeof( unsigned long );
-	*((unsigned long *)ptr) = swapbytes_long( health_packet->freeDiskSpaceD ); ptr += sizeof( unsigned long );
-	*((unsigned long *)ptr) = swapbytes_long( health_packet->freeDiskSpaceE ); ptr += sizeof( unsigned long );
+	*((unsigned int *)ptr) = swapbytes_long( health_packet->freeDiskSpaceC ); ptr += sizeof( unsigned int );
+	*((unsigned int *)ptr) = swapbytes_long( health_packet->freeDiskSpaceD ); ptr += sizeof( unsigned int );
+	*((unsigned int *)ptr) = swapbytes_long( health_packet->freeDiskSpaceE ); ptr += sizeof( unsigned int );
 
 	*((unsigned short *)ptr) = swapbytes_short( health_packet->crc ); ptr += sizeof( unsigned short );
 	
@@ -513,6 +529,14 @@ void CreateGripPacketCacheFilename( char *filename, int max_characters, const Gr
 
 }
 
+void CreateGripGapFilename( char *filename, int max_characters, const char *root ) {
+	int bytes_written = sprintf( filename, "%s.gaps.txt", root );
+	if ( bytes_written < 0 || bytes_written > max_characters ) {
+			fMessageBox( MB_OK, "Grip", "Error in sprintf()." );
+			exit( -1 );
+	}
+}
+
 
 /// Read housekeeping cache, taking just the most recent value.
 /// The path to the cache file is presumed to be set in global variable 'packetBufferPathRoot'.
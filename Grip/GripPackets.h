@@ -3,7 +3,7 @@
 //
 #pragma once
 
-#include "..\Useful\Useful.h"
+#include "../Useful/Useful.h"
 
 // The port number used to access EPM servers.
 // EPM-OHB-SP-0005 says:
@@ -246,6 +246,8 @@ void ExtractGripHealthAndStatusInfo( GripHealthAndStatusInfo *health_packet, con
 void InsertGripHealthAndStatusInfo( EPMTelemetryPacket *epm_packet, const GripHealthAndStatusInfo *health_packet );
 
 void CreateGripPacketCacheFilename( char *filename, int max_characters, const GripPacketType type, const char *root );
+// Text file listing the gaps in the cache files left by losses of the connection to the server.
+void CreateGripGapFilename( char *filename, int max_characters, const char *root );
 int GetLastPacketHK( EPMTelemetryHeaderInfo *epmHeader, GripHealthAndStatusInfo *hk, char *filename_root );
 
 #ifdef __cplusplus
@@ -0,0 +1,296 @@
+///
+/// Module:	GripMMI
+/// 
+///	Author:					J. McIntyre, PsyPhy Consulting
+/// Initial release:		18 December 2014
+/// Modification History:	see https://github.com/PsyPhy/GripMMI
+///
+/// Copyright (c) 2014, 2015 PsyPhy Consulting
+///
+
+/// Filling of the data buffers from the realtime data packets.
+/// None of this depends on the GUI, so that the benchmarks go through exactly the same code.
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Useful/Trace.h"
+#include "../Grip/GripPackets.h"
+#include "../Grip/DexAnalogMixin.h"
+
+#include "GripMMIGlobals.h"
+#include "GripMMIBuffers.h"
+
+// Grip force threshold for a valid CoP.
+#define COP_MIN_GRIP	0.5
+
+///
+/// Show the data buffers as empty.
+///
+void ResetBuffers( void ){
+	nFrames = 0;
+	ResetVisibilityRuns();
+	ResetTimeIndex();
+	eventDetector.Reset();
+	sequenceTracker.Reset();
+}
+
+///
+/// Maintain the run-length encoded copies of the visibility arrays.
+///
+void ResetVisibilityRuns( void ) {
+
+	VisibilityRuns *runs[CODA_MARKERS + 4] = { &ManipulandumVisibilityRuns, &FrameVisibilityRuns, &WristVisibilityRuns, &PacketReceivedRuns };
+	for ( int mrk = 0; mrk < CODA_MARKERS; mrk++ ) runs[mrk + 4] = &MarkerVisibilityRuns[mrk];
+	// The space already allocated for the runs is kept for the new ones.
+	for ( int i = 0; i < CODA_MARKERS + 4; i++ ) {
+		runs[i]->n_runs = 0;
+		runs[i]->overflow = false;
+	}
+
+}
+
+// Extend the last run if this frame follows directly after it, otherwise start a new one.
+// A run does not extend across a break in the stream of packets.
+// Frames are expected to arrive in order.
+static void AppendVisibility( VisibilityRuns *runs, unsigned int frame, double value, bool contiguous ) {
+
+	if ( value == MISSING_DOUBLE ) return;
+	runs->value = value;
+	if ( contiguous && runs->n_runs > 0 && runs->run[runs->n_runs - 1][1] == (int) frame - 1 ) {
+		runs->run[runs->n_runs - 1][1] = frame;
+		return;
+	}
+	if ( runs->n_runs >= runs->allocated ) {
+		// Double the space each time, up to the limit.
+		int allocated = ( runs->allocated ? 2 * runs->allocated : VISIBILITY_RUNS_ALLOCATION );
+		int (*run)[2] = NULL;
+		if ( allocated > MAX_VISIBILITY_RUNS ) allocated = MAX_VISIBILITY_RUNS;
+		if ( allocated > runs->allocated ) run = (int (*)[2]) realloc( runs->run, allocated * sizeof( *run ) );
+		if ( !run ) {
+			runs->overflow = true;
+			return;
+		}
+		runs->run = run;
+		runs->allocated = allocated;
+	}
+	runs->run[runs->n_runs][0] = runs->run[runs->n_runs][1] = frame;
+	runs->n_runs++;
+
+}
+
+// Call this once the visibility arrays have been filled for the given frame.
+void UpdateVisibilityRuns( unsigned int frame ) {
+
+	bool contiguous = !sequenceTracker.BreakBefore( frame );
+	for ( int mrk = 0; mrk < CODA_MARKERS; mrk++ ) AppendVisibility( &MarkerVisibilityRuns[mrk], frame, MarkerVisibility[frame][mrk], contiguous );
+	AppendVisibility( &ManipulandumVisibilityRuns, frame, ManipulandumVisibility[frame], contiguous );
+	AppendVisibility( &FrameVisibilityRuns, frame, FrameVisibility[frame], contiguous );
+	AppendVisibility( &WristVisibilityRuns, frame, WristVisibility[frame], contiguous );
+	AppendVisibility( &PacketReceivedRuns, frame, PacketReceived[frame], contiguous );
+
+}
+
+///
+/// Maintain the index used to find the frames corresponding to an instant in time.
+///
+void ResetTimeIndex( void ) {
+	MarkerTimeIndex.n_frames = 0;
+	MarkerTimeIndex.first_valid = -1;
+	MarkerTimeIndex.last_valid = -1;
+	MarkerTimeIndex.n_gaps = 0;
+	MarkerTimeIndex.overflow = false;
+}
+
+// Call this once RealMarkerTime[] has been filled for the given frame.
+// Frames are expected to arrive in order, starting from 0 after a reset.
+void UpdateTimeIndex( unsigned int frame ) {
+
+	TimeIndex *index = &MarkerTimeIndex;
+	int chunk = frame / TIME_INDEX_CHUNK;
+	double instant = RealMarkerTime[frame];
+
+	// Each new chunk starts out with what was known at the end of the previous one.
+	if ( frame % TIME_INDEX_CHUNK == 0 ) {
+		index->max_time[chunk] = ( chunk > 0 ? index->max_time[chunk - 1] : - HUGE_VAL );
+		index->last_frame[chunk] = ( chunk > 0 ? index->last_frame[chunk - 1] : -1 );
+	}
+	index->n_frames = frame + 1;
+
+	if ( instant == MISSING_DOUBLE ) {
+		if ( index->n_gaps > 0 && index->gap[index->n_gaps - 1][1] == (int) frame - 1 ) index->gap[index->n_gaps - 1][1] = frame;
+		else if ( index->n_gaps < MAX_TIME_GAPS ) {
+			index->gap[index->n_gaps][0] = index->gap[index->n_gaps][1] = frame;
+			index->n_gaps++;
+		}
+		else index->overflow = true;
+		return;
+	}
+
+	if ( index->first_valid < 0 ) {
+		index->first_valid = frame;
+		index->earliest = instant;
+		index->latest = instant;
+	}
+	// The time stamps are supposed to increase. If one steps back, keep the index
+	//  monotonic so that bisection still works.
+	if ( instant > index->latest ) index->latest = instant;
+	index->last_valid = frame;
+	index->max_time[chunk] = index->latest;
+	index->last_frame[chunk] = frame;
+
+}
+
+// Find the last frame with a valid time before the given instant (or at the instant if inclusive).
+// Returns -1 if there is no such frame.
+// Bisection over the chunks locates the first chunk that reaches past the instant, so only the 
+//  frames of that one chunk have to be examined.
+int FindFrameBefore( double instant, bool inclusive ) {
+
+	TimeIndex *index = &MarkerTimeIndex;
+	int low, high, mid, frame, stop;
+
+	if ( index->last_valid < 0 ) return( -1 );
+	if ( inclusive ? index->latest <= instant : index->latest < instant ) return( index->last_valid );
+
+	low = 0;
+	high = ( index->n_frames - 1 ) / TIME_INDEX_CHUNK;
+	while ( low < high ) {
+		mid = ( low + high ) / 2;
+		if ( inclusive ? index->max_time[mid] > instant : index->max_time[mid] >= instant ) high = mid;
+		else low = mid + 1;
+	}
+
+	frame = ( low + 1 ) * TIME_INDEX_CHUNK - 1;
+	if ( frame >= (int) index->n_frames ) frame = index->n_frames - 1;
+	stop = low * TIME_INDEX_CHUNK;
+	for ( ; frame >= stop; frame-- ) {
+		double t = RealMarkerTime[frame];
+		if ( t != MISSING_DOUBLE && ( inclusive ? t <= instant : t < instant ) ) return( frame );
+	}
+	return( low > 0 ? index->last_frame[low - 1] : -1 );
+
+}
+
+///
+/// Look for events in the frames as they are decoded.
+///
+// Call this once the Raw* buffers have been filled for the given frame.
+// Frames are expected to arrive in order, starting from 0 after a reset.
+void DetectEvents( unsigned int frame ) {
+	Vector3 cop[N_FORCE_TRANSDUCERS];
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) dex.CopyVector( cop[ati], RawCenterOfPressure[ati][frame] );
+	eventDetector.ProcessFrame( frame, RealMarkerTime[frame], RawManipulandumPosition[frame], RawAcceleration[frame], 
+								RawGripForce[frame], RawLoadForce[frame], cop );
+}
+
+///
+/// Unpack the slices of a realtime data packet into the data buffers, starting at frame nFrames.
+/// The TM counter comes from the EPM header of the packet.
+///
+void StoreGripRT( GripRealtimeDataInfo *rt, unsigned short tm_counter ) {
+
+	int mrk, count;
+
+	TRACE_FUNCTION();
+
+	// Check the sequence numbers. Duplicate packets are thrown away. If packets were lost or
+	//  arrived out of order, or if there was a pause in their arrival, the tracker notes a break 
+	//  before the first frame of this packet. The graphs are broken there, without having to
+	//  insert blank frames into the data buffers.
+	int sequence = sequenceTracker.Track( rt->acquisitionID, rt->rtPacketCount, tm_counter, rt->packetTimestamp, nFrames );
+	if ( sequence == DEX_SEQUENCE_DUPLICATE ) return;
+	if ( sequence == DEX_SEQUENCE_BREAK ) eventDetector.Break();
+
+	for ( int slice = 0; slice < RT_SLICES_PER_PACKET && nFrames < MAX_FRAMES; slice++ ) {
+		// Get the time of the slice.
+		RealMarkerTime[nFrames] = rt->dataSlice[slice].bestGuessPoseTimestamp;
+		RealAnalogTime[nFrames] = rt->dataSlice[slice].bestGuessAnalogTimestamp;
+		if ( rt->dataSlice[slice].manipulandumVisibility ) {
+			// Retrieve the position and convert to mm.
+			RawManipulandumPosition[nFrames][X] = rt->dataSlice[slice].position[X] / 10.0;
+			RawManipulandumPosition[nFrames][Y] = rt->dataSlice[slice].position[Y] / 10.0;
+			RawManipulandumPosition[nFrames][Z] = rt->dataSlice[slice].position[Z] / 10.0;
+			// Keep the quaternion. It is converted to a form that is easier to understand
+			//  in graphs below, once all the packets have been read.
+			dex.CopyQuaternion( RawManipulandumQuaternion[nFrames], rt->dataSlice[slice].quaternion );
+		}
+		else {
+			// Manipulandum was not visible, so record as missing data.
+			RawManipulandumPosition[nFrames][X] = MISSING_DOUBLE;
+			RawManipulandumPosition[nFrames][Y] = MISSING_DOUBLE;
+			RawManipulandumPosition[nFrames][Z] = MISSING_DOUBLE;
+			RawManipulandumQuaternion[nFrames][X] = MISSING_DOUBLE;
+		}
+		// The GRIP ICD does not say what is the reference frame for the force data.
+		// I'm pretty sure that this is right.
+		RawGripForce[nFrames] = (float) dex.ComputeGripForce( rt->dataSlice[slice].ft[LEFT_ATI].force, rt->dataSlice[slice].ft[RIGHT_ATI].force );
+		// It is useful to plot the normal force from each ATI sensor. They should be very similar unless
+		//  the subject is touching the manipulandum outside the ATI sensor surfaces.
+		RawNormalForce[LEFT_ATI][nFrames] = - (float) rt->dataSlice[slice].ft[LEFT_ATI].force[X];
+		RawNormalForce[RIGHT_ATI][nFrames] = (float) rt->dataSlice[slice].ft[RIGHT_ATI].force[X];
+		// Compute the acceleration, load force and center-of-pressures.
+		// These, the forces and the manipulandum pose are filtered by FilterBuffers() when they are needed.
+		dex.ComputeLoadForce( RawLoadForce[nFrames], rt->dataSlice[slice].ft[0].force, rt->dataSlice[slice].ft[1].force );
+		for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+			// CoP is set to MISSING_DOUBLE if it cannot be computed.
+			dex.ComputeCoP( RawCenterOfPressure[ati][nFrames], rt->dataSlice[slice].ft[ati].force, rt->dataSlice[slice].ft[ati].torque, COP_MIN_GRIP );
+		}
+		RawAcceleration[nFrames][X] = (float) rt->dataSlice[slice].acceleration[X];
+		RawAcceleration[nFrames][Y] = (float) rt->dataSlice[slice].acceleration[Y];
+		RawAcceleration[nFrames][Z] = (float) rt->dataSlice[slice].acceleration[Z];
+
+		// Fill some data arrays to show when each marker is visible.
+		// We consider a marker visible if it is seen by either coda.
+		// Set a non-zero value if it is visible, MISSING if it is obscured.
+		// The non-zero values that are set when the marker is visible are a convenient
+		//  trick to make it easy to plot the traces for all markers in one graph.
+		for ( mrk = MANIPULANDUM_FIRST_MARKER; mrk <= MANIPULANDUM_LAST_MARKER; mrk++ ) {
+			unsigned long bit = 0x01 << mrk;
+			if ( rt->dataSlice[slice].markerVisibility[0] & bit || rt->dataSlice[slice].markerVisibility[1] & bit ) MarkerVisibility[nFrames][mrk] = mrk + 1;
+			else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
+		}
+		if (  (rt->dataSlice[slice].manipulandumVisibility & 0x01) ) ManipulandumVisibility[nFrames] = 10;
+		else ManipulandumVisibility[nFrames] = MISSING_DOUBLE;
+		for ( mrk = FRAME_FIRST_MARKER, count = 0; mrk <= FRAME_LAST_MARKER; mrk++ ) {
+			unsigned long bit = 0x01 << mrk;
+			if ( rt->dataSlice[slice].markerVisibility[0] & bit || rt->dataSlice[slice].markerVisibility[1] & bit ) {
+				MarkerVisibility[nFrames][mrk] = mrk + 3;
+				count++;
+			}
+			else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
+		}
+		if ( count == 4 ) FrameVisibility[nFrames] = 30;
+		else FrameVisibility[nFrames] = MISSING_DOUBLE;
+
+		for ( mrk = WRIST_FIRST_MARKER, count = 0; mrk <= WRIST_LAST_MARKER; mrk++ ) {
+			unsigned long bit = 0x01 << mrk;
+			if ( rt->dataSlice[slice].markerVisibility[0] & bit || rt->dataSlice[slice].markerVisibility[1] & bit ) {
+				MarkerVisibility[nFrames][mrk] = mrk + 5;
+				count++;
+			}
+			else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
+		}
+		if ( count >= 3 ) WristVisibility[nFrames] = 50;
+		else WristVisibility[nFrames] = MISSING_DOUBLE;
+		// Indicate that for this instant in time we received a data packet.
+		PacketReceived[nFrames] = -10.0;
+		UpdateVisibilityRuns( nFrames );
+		UpdateTimeIndex( nFrames );
+		DetectEvents( nFrames );
+
+		// Count the number of frames.
+		nFrames++;
+	}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+///
+/// Module:	GripMMI
+/// 
+///	Author:					J. McIntyre, PsyPhy Consulting
+/// Initial release:		18 December 2014
+/// Modification History:	see https://github.com/PsyPhy/GripMMI
+///
+/// Copyright (c) 2014, 2015 PsyPhy Consulting
+///
+
+/// Filling of the data buffers declared in GripMMIGlobals.h from the realtime data packets,
+///  along with the visibility runs, the time index and the event detector that are kept up
+///  to date as the frames are stored. These do not depend on the GUI and are shared with
+///  the benchmarks.
+
+#include "../Grip/GripPackets.h"
+
+// Show the data buffers as empty.
+void ResetBuffers( void );
+// Unpack the slices of a realtime data packet into the data buffers, starting at frame nFrames.
+void StoreGripRT( GripRealtimeDataInfo *rt, unsigned short tm_counter );
+
+void ResetVisibilityRuns( void );
+void UpdateVisibilityRuns( unsigned int frame );
+void ResetTimeIndex( void );
+void UpdateTimeIndex( unsigned int frame );
+int  FindFrameBefore( double instant, bool inclusive );
+void DetectEvents( unsigned int frame );
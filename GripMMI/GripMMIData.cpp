@@ -29,8 +29,14 @@
 #include "..\Useful\VectorsMixin.h"
 #include "..\Useful\fMessageBox.h"
 #include "..\Useful\fOutputDebugString.h"
+#include "..\Useful\Trace.h"
 #include "..\Grip\GripPackets.h"
 #include "..\Grip\DexAnalogMixin.h"
+#include "..\Grip\DexDerivedSignals.h"
+#include "..\Grip\DexEventDetector.h"
+#include "..\Grip\DexSequenceTracker.h"
+#include "..\Grip\GripPacketGenerator.h"
+#include "..\Grip\GripLatency.h"
 
 using namespace GripMMI;
 
@@ -44,18 +50,228 @@ char packetBufferPathRoot[MAX_PATHLENGTH] = "";
 #define RETRY_PAUSE	20		
 // Error code to return if the cache file cannot be opened.
 #define ERROR_CACHE_NOT_FOUND	-1000
-// Grip force threshold for a valid CoP.
-#define COP_MIN_GRIP	0.5
 
 // A hint about restarting that may resolve certain intermittant (and hopefully, rare) error conditions.
 const char *restart_hint = 
 	"This is a fatal error.\n\nTry restarting just the graphical interface using the RestartGripMMI.YYYY.MM.DD.bat file\nthat has been createdd in the cache or executables directory.\n\nIf that fails, kill GripGroundMonitorClient.exe, rename or copy to a safe location the cache files\nand execute RunGripMMI.bat again to restart.\n";
 
 ///
-/// Show the data buffers as empty.
+/// Apply the recursive filters to the data buffers.
+/// The values decoded from the packets are kept, unfiltered, in the Raw* buffers.
+/// The filtered buffers that are plotted are computed from them on demand, so that
+///  changing the filter does not require reading the packets again.
 ///
-void GripMMIDesktop::ResetBuffers( void ){
-	nFrames = 0;
+// The same channels are filtered by the causal filter bank and by the zero-phase filter.
+static void AddFilterChannel( int flags, double *input, double *output, int stride, double *key = NULL ) {
+	filterBank.AddChannel( flags, input, output, stride, key );
+	zeroPhaseFilter.AddChannel( flags, input, output, stride, key );
+}
+
+void GripMMIDesktop::InitializeFilterBank( void ) {
+
+	int i, ati;
+
+	filterBank.ClearChannels();
+	zeroPhaseFilter.ClearChannels();
+	// Position is MISSING_DOUBLE when the manipulandum is not visible, so those frames are skipped.
+	for ( i = X; i <= Z; i++ ) AddFilterChannel( DEX_FILTER_VECTOR, &RawManipulandumPosition[0][i], &ManipulandumPosition[0][i], 3 );
+	// Orientation is filtered only when the X component is valid, as it was when filtered sample by sample.
+	for ( i = X; i <= Z; i++ ) AddFilterChannel( DEX_FILTER_VECTOR, &RawManipulandumRotations[0][i], &ManipulandumRotations[0][i], 3, &RawManipulandumRotations[0][X] );
+	for ( i = X; i <= Z; i++ ) AddFilterChannel( DEX_FILTER_VECTOR, &RawLoadForce[0][i], &LoadForce[0][i], 3 );
+	for ( i = X; i <= Z; i++ ) AddFilterChannel( DEX_FILTER_VECTOR, &RawAcceleration[0][i], &Acceleration[0][i], 3 );
+	// CoP is MISSING_DOUBLE when the grip is too light to compute it.
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		for ( i = X; i <= Z; i++ ) AddFilterChannel( DEX_FILTER_VECTOR, &RawCenterOfPressure[ati][0][i], &CenterOfPressure[ati][0][i], 3 );
+	}
+	// The forces are stored in single precision.
+	AddFilterChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &RawGripForce[0], &GripForce[0], 1 );
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		AddFilterChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &RawNormalForce[ati][0], &NormalForce[ati][0], 1 );
+	}
+
+	// The derived signals are computed from the filtered buffers.
+	DexDerivedColumns columns;
+	columns.time = RealMarkerTime;
+	columns.position = ManipulandumPosition;
+	columns.acceleration = Acceleration;
+	columns.grip_force = GripForce;
+	columns.load_force = LoadForceMagnitude;
+	columns.velocity = ManipulandumVelocity;
+	columns.jerk = Jerk;
+	columns.ratio = GripLoadRatio;
+	columns.lag = GripLoadLag;
+	derivedSignals.SetColumns( &columns );
+	derivedSignals.SetSamplePeriod( RT_DEFAULT_SECONDS_PER_SLICE );
+
+	// Neither the zero-phase filters nor the derived signals should reach across a break in the data.
+	zeroPhaseFilter.SetBreaks( sequenceTracker.GapFrames(), sequenceTracker.GapCount() );
+	derivedSignals.SetBreaks( sequenceTracker.GapFrames(), sequenceTracker.GapCount() );
+
+	InvalidateFilteredBuffers();
+
+}
+
+// With the causal filter, the filtered buffers hold valid values for frames 0 to filteredFrames - 1, 
+//  computed with filteredConstant. The packet cache only grows, so the frames that have been filtered
+//  stay valid when it is read again.
+static unsigned int filteredFrames = 0;
+static double filteredConstant = 0.0;
+
+// With the zero-phase filters, every frame depends on the frames that follow it as well, and 
+//  there is no point in filtering from the start. So only the frames from zeroPhaseFirst to 
+//  zeroPhaseLast are valid. They were computed when there were zeroPhaseFrames frames, so the 
+//  last few may change as new frames arrive.
+static int zeroPhaseFirst = 0;
+static int zeroPhaseLast = -1;
+static unsigned int zeroPhaseFrames = 0;
+static int zeroPhaseType = CAUSAL_FILTER;
+static double zeroPhaseParameter = 0.0;
+
+// Discard the filtered values so that they will be computed again.
+void GripMMIDesktop::InvalidateFilteredBuffers( void ) {
+	filteredFrames = 0;
+	filteredConstant = dex.GetFilterConstant();
+	filterBank.ResetState();
+	zeroPhaseLast = -1;
+	derivedSignals.Reset();
+	// Frames that have been counted into the density maps will be filtered again.
+	ClearDensityMaps();
+}
+
+static void ComputeLoadForceMagnitude( unsigned int first_frame, unsigned int last_frame ) {
+	// The magnitude of the load force is computed from the filtered vector.
+	for ( unsigned int frame = first_frame; frame <= last_frame; frame++ ) {
+		if ( LoadForce[frame][X] == MISSING_DOUBLE ) LoadForceMagnitude[frame] = MISSING_DOUBLE;
+		else LoadForceMagnitude[frame] = dex.VectorNorm( LoadForce[frame] );
+	}
+}
+
+// Make sure that the filtered buffers are up to date for the specified frames.
+void GripMMIDesktop::FilterBuffers( unsigned int first_frame, unsigned int last_frame ) {
+
+	// The filter constant is set on the 'dex' object by the GUI. It is 0 if filtering is off.
+	double parameter = dex.GetFilterConstant();
+
+	TRACE_FUNCTION();
+	if ( nFrames == 0 ) return;
+	if ( last_frame >= nFrames ) last_frame = nFrames - 1;
+	if ( first_frame > last_frame ) first_frame = last_frame;
+
+	if ( filterType == CAUSAL_FILTER || parameter == 0.0 ) {
+
+		// The causal filter is recursive, so all of the preceding frames are filtered as well. Frames after 
+		//  the last one specified are left for later, so that the data that is on the screen is available
+		//  as soon as possible.
+		if ( parameter != filteredConstant || filteredFrames > nFrames || zeroPhaseLast >= 0 ) InvalidateFilteredBuffers();
+		if ( last_frame < filteredFrames ) return;
+
+		filterBank.SetFilterConstant( filteredConstant );
+		// Let the filter bank share the channels out between all the processors.
+		filterBank.Filter( filteredFrames, last_frame, 0 );
+		ComputeLoadForceMagnitude( filteredFrames, last_frame );
+		// This carries on from the previous update, since the filtered frames are contiguous.
+		derivedSignals.Update( filteredFrames, last_frame );
+		filteredFrames = last_frame + 1;
+
+	}
+	else {
+
+		int overlap;
+
+		if ( filterType != zeroPhaseType || parameter != zeroPhaseParameter ) zeroPhaseLast = -1;
+		if ( filterType == ZERO_PHASE_FILTER ) zeroPhaseFilter.SetRecursive( parameter );
+		else if ( filterType == BUTTERWORTH_FILTER ) zeroPhaseFilter.SetButterworth( parameter, 1.0 / RT_DEFAULT_SECONDS_PER_SLICE );
+		else zeroPhaseFilter.SetSavitzkyGolay( (int) parameter );
+		overlap = zeroPhaseFilter.Overlap();
+
+		// Nothing to do if the frames were already filtered and the frames that could affect them have not changed.
+		if ( (int) first_frame >= zeroPhaseFirst && (int) last_frame <= zeroPhaseLast 
+			 && ( nFrames == zeroPhaseFrames || (int) last_frame + overlap < (int) zeroPhaseFrames ) ) return;
+
+		// The zero-phase filter writes to the same buffers as the causal one.
+		filteredFrames = 0;
+		filterBank.ResetState();
+
+		zeroPhaseFilter.Filter( first_frame, last_frame, nFrames, 0 );
+		// The frames already counted into the density maps may have come out differently this time.
+		ClearDensityMaps();
+		ComputeLoadForceMagnitude( first_frame, last_frame );
+		// The frames before first_frame have not been filtered, so this starts over at first_frame.
+		derivedSignals.Reset();
+		derivedSignals.Update( first_frame, last_frame );
+		zeroPhaseFirst = first_frame;
+		zeroPhaseLast = last_frame;
+		zeroPhaseFrames = nFrames;
+		zeroPhaseType = filterType;
+		zeroPhaseParameter = parameter;
+
+	}
+}
+
+///
+/// Maintain the index of the trial segments defined by the HK packets.
+///
+void GripMMIDesktop::ResetTrialIndex( void ) {
+	StepTrialIndex.n_segments = 0;
+	StepTrialIndex.overflow = false;
+}
+
+// Call this for each HK packet, in order, with the time stamp of the packet.
+// The last segment is extended if the IDs are unchanged. Otherwise it ends here and a new one starts.
+void GripMMIDesktop::UpdateTrialIndex( GripHealthAndStatusInfo *hk, double instant ) {
+
+	TrialIndex *index = &StepTrialIndex;
+	TrialSegment *last = ( index->n_segments > 0 ? &index->segment[index->n_segments - 1] : NULL );
+
+	if ( last ) {
+		last->stop_time = instant;
+		if ( last->user == hk->user && last->protocol == hk->protocol && last->task == hk->task && last->step == hk->step ) return;
+	}
+	if ( index->n_segments >= MAX_TRIAL_SEGMENTS ) {
+		index->overflow = true;
+		return;
+	}
+	TrialSegment *segment = &index->segment[index->n_segments++];
+	segment->user = hk->user;
+	segment->protocol = hk->protocol;
+	segment->task = hk->task;
+	segment->step = hk->step;
+	segment->start_time = segment->stop_time = instant;
+	segment->first_frame = segment->last_frame = -1;
+
+}
+
+// Find the frames that fall within each segment. A segment runs up to, but does not include, the start
+//  of the next one. The last one takes in all the RT frames that come after it, since the HK and RT
+//  packets do not arrive together. This has to be redone when either the HK index or the RT buffers change,
+//  but it takes only two bisections of the time index per segment.
+void GripMMIDesktop::MapTrialIndex( void ) {
+
+	TrialIndex *index = &StepTrialIndex;
+
+	for ( int i = 0; i < index->n_segments; i++ ) {
+		TrialSegment *segment = &index->segment[i];
+		int first = FindFrameBefore( segment->start_time, false ) + 1;
+		int last = ( i < index->n_segments - 1 ? FindFrameBefore( index->segment[i + 1].start_time, false ) : MarkerTimeIndex.last_valid );
+		if ( last < first ) first = last = -1;
+		segment->first_frame = first;
+		segment->last_frame = last;
+	}
+
+}
+
+// Find the most recent segment with the specified protocol, task and step IDs that has frames in the RT buffers.
+// Returns -1 if there is none.
+int GripMMIDesktop::FindTrialSegment( int protocol_id, int task_id, int step_id ) {
+
+	TrialIndex *index = &StepTrialIndex;
+
+	for ( int i = index->n_segments - 1; i >= 0; i-- ) {
+		TrialSegment *segment = &index->segment[i];
+		if ( segment->protocol == protocol_id && segment->task == task_id && segment->step == step_id && segment->first_frame >= 0 ) return( i );
+	}
+	return( -1 );
+
 }
 
 /// Read in the cached realtime data packets.
@@ -63,15 +279,19 @@ void GripMMIDesktop::ResetBuffers( void ){
 /// The data is stored in the global arrays found in GripMMIGlobals.cpp.
 /// TRUE is returned if there are new packets since the last call.
 
+/// The cache only grows, so only the packets that were added since the last call are read
+/// and appended to the buffers. If the file is found to be shorter than what has already been
+/// read, it has been replaced and the buffers are filled again from the start.
+
 /// Note that if in a previous call the buffers were filled to the maximum, this
 /// routine will simply return FALSE, leaving the buffers in their former state.
 
 /// Note also that if the buffers reach their maximum, the 'live' mode for RT packets will be disabled.
 int GripMMIDesktop::GetGripRT( void ) {
 
-	// Keep track of the last packet TM counter from previous call.
-	// This is how we know if new data has arrived.
-	static unsigned short previousTMCounter = 0;
+	// Number of packets from the cache file that are already in the buffers.
+	// The next call starts reading right after them.
+	static int cachedPackets = 0;
 
 	// Keep track of whether we have already seen that the buffers are full.
 	static bool buffers_full_alert = false;
@@ -90,7 +310,11 @@ int GripMMIDesktop::GetGripRT( void ) {
 	int bytes_read;
 	int packets_read;
 	int return_code;
-	int mrk, coda, count;
+	int mrk, coda;
+	unsigned int first_new_frame;
+	long offset;
+
+	TRACE_FUNCTION();
 
 	// If buffers were full the last time through, then don't fill them again.
 	// Just leave the buffers in their previous state and return saying that
@@ -106,9 +330,6 @@ int GripMMIDesktop::GetGripRT( void ) {
 	// The global variable 'packetBufferPathRoot' has been initialized elsewhere.
 	CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_RT_SCIENCE_PACKET, packetBufferPathRoot );
 
-	// Empty the data buffers.
-	ResetBuffers();
-
 	// Attempt to open the packet cache to read the accumulated packets.
 	// If it is not immediately available, keep trying for a few seconds.
 	for ( int retry_count = 0; retry_count  < MAX_OPEN_CACHE_RETRIES; retry_count ++ ) {
@@ -127,17 +348,32 @@ int GripMMIDesktop::GetGripRT( void ) {
 			exit( -1 );
 	}
 
-	// Prepare for reading in packets. This is used to calculate the elapsed time between two packets.
-	// By setting it to zero here, the first packet read will be signaled as having arrived after a long delay.
-	double previous_packet_timestamp = 0.0;
+	// Start with empty buffers the first time, and start over if the file is shorter than
+	//  what was read before. The frames that were filtered before are not those that will be read now.
+	offset = (long) cachedPackets * rtPacketLengthInBytes;
+	if ( cachedPackets == 0 || _lseek( fid, 0, SEEK_END ) < offset ) {
+		ResetBuffers();
+		InvalidateFilteredBuffers();
+		cachedPackets = 0;
+		offset = 0;
+	}
+	// Skip over the packets that are already in the buffers.
+	// A packet that was only partly written the last time is read again from its start.
+	if ( _lseek( fid, offset, SEEK_SET ) != offset ) {
+		fMessageBox( MB_OK, "GripMMI", "Error positioning in %s.\n\n%s", filename, restart_hint );
+		exit( -1 );
+	}
 
-	// Read in all of the data packets in the file.
+	// Read in the data packets that were added to the file since the last time.
 	// Be careful not to overrun the data buffers.
 	packets_read = 0;
+	first_new_frame = nFrames;
 	while ( nFrames < MAX_FRAMES ) {
 
 		// Attempt to read next packet. Any error is terminal.
+		TRACE_BEGIN( "ReadRTCache" );
 		bytes_read = _read( fid, &packet, rtPacketLengthInBytes );
+		TRACE_END( "ReadRTCache" );
 		if ( bytes_read < 0 ) {
 			fMessageBox( MB_OK, "GripMMI", "Error reading from %s.\n\n%s", filename, restart_hint );
 			exit( -1 );
@@ -159,127 +395,10 @@ int GripMMIDesktop::GetGripRT( void ) {
 			
 		// Packets are stings of bytes. Extract the data values into a more usable form.
 		ExtractGripRealtimeDataInfo( &rt, &packet );
-
-		// If there has been a break in the arrival of the packets, insert
-		//  a blank frame into the data buffer. This will cause breaks in
-		//  the traces in the data graphs.
-		if ( (rt.packetTimestamp - previous_packet_timestamp) > PACKET_STREAM_BREAK_THRESHOLD ) {
-			// Subsampling in graphs will be used when the data record is very long.
-			// Insert enough points so that we see the break even if we are sub-sampling in the graphs.
-			// MAX_PLOT_STEP defines the maximum number of frames that will be skipped when plotting.
-			for ( int count = 0; count < MAX_PLOT_STEP && nFrames < MAX_FRAMES - 1; count++ ) {
-				ManipulandumPosition[nFrames][X] = MISSING_DOUBLE;
-				ManipulandumPosition[nFrames][Y] = MISSING_DOUBLE;
-				ManipulandumPosition[nFrames][Z] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][X] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][Y] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][Z] = MISSING_DOUBLE;
-				GripForce[nFrames] = MISSING_DOUBLE;
-				GripForce[nFrames] = MISSING_DOUBLE;
-				NormalForce[LEFT_ATI][nFrames] = MISSING_DOUBLE;
-				NormalForce[LEFT_ATI][nFrames] = MISSING_DOUBLE;
-				NormalForce[RIGHT_ATI][nFrames] = MISSING_DOUBLE;
-				NormalForce[RIGHT_ATI][nFrames] = MISSING_DOUBLE;
-				Acceleration[nFrames][X] = MISSING_DOUBLE;
-				Acceleration[nFrames][Y] = MISSING_DOUBLE;
-				Acceleration[nFrames][Z] = MISSING_DOUBLE;
-				for ( mrk = 0; mrk < CODA_MARKERS; mrk++ ) MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
-				ManipulandumVisibility[nFrames] = MISSING_DOUBLE;
-				FrameVisibility[nFrames] = MISSING_DOUBLE;
-				WristVisibility[nFrames] = MISSING_DOUBLE;
-				PacketReceived[nFrames] = MISSING_DOUBLE;
-				RealMarkerTime[nFrames] = MISSING_DOUBLE;
-				nFrames++;
-			}
-		}
-		previous_packet_timestamp = rt.packetTimestamp;
-
-		for ( int slice = 0; slice < RT_SLICES_PER_PACKET && nFrames < MAX_FRAMES; slice++ ) {
-			// Get the time of the slice.
-			RealMarkerTime[nFrames] = rt.dataSlice[slice].bestGuessPoseTimestamp;
-			RealAnalogTime[nFrames] = rt.dataSlice[slice].bestGuessAnalogTimestamp;
-			if ( rt.dataSlice[slice].manipulandumVisibility ) {
-				// Retrieve the position and convert to mm.
-				ManipulandumPosition[nFrames][X] = rt.dataSlice[slice].position[X] / 10.0;
-				ManipulandumPosition[nFrames][Y] = rt.dataSlice[slice].position[Y] / 10.0;
-				ManipulandumPosition[nFrames][Z] = rt.dataSlice[slice].position[Z] / 10.0;
-				// Convert quaternion to a form that is easier to understand in graphs.
-				dex.QuaternionToCannonicalRotations( ManipulandumRotations[nFrames], rt.dataSlice[slice].quaternion );
-				// Apply recursive filter to position data for this slice.
-				dex.FilterManipulandumPosition( ManipulandumPosition[nFrames] );
-				// If the orientation is available, filter it as well.
-				if ( _finite( ManipulandumRotations[nFrames][X] ) ) dex.FilterManipulandumRotations( ManipulandumRotations[nFrames] );
-			}
-			else {
-				// Manipulandum was not visible, so record as missing data.
-				ManipulandumPosition[nFrames][X] = MISSING_DOUBLE;
-				ManipulandumPosition[nFrames][Y] = MISSING_DOUBLE;
-				ManipulandumPosition[nFrames][Z] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][X] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][Y] = MISSING_DOUBLE;
-				ManipulandumRotations[nFrames][Z] = MISSING_DOUBLE;
-			}
-			// The GRIP ICD does not say what is the reference frame for the force data.
-			// I'm pretty sure that this is right.
-			GripForce[nFrames] = (float) dex.ComputeGripForce( rt.dataSlice[slice].ft[LEFT_ATI].force, rt.dataSlice[slice].ft[RIGHT_ATI].force );
-			GripForce[nFrames] = (float) dex.FilterGripForce( GripForce[nFrames] );
-			// It is useful to plot the normal force from each ATI sensor. They should be very similar unless
-			//  the subject is touching the manipulandum outside the ATI sensor surfaces.
-			NormalForce[LEFT_ATI][nFrames] = - (float) rt.dataSlice[slice].ft[LEFT_ATI].force[X];
-			NormalForce[LEFT_ATI][nFrames] = (float) dex.FilterNormalForce( NormalForce[LEFT_ATI][nFrames], LEFT_ATI );
-			NormalForce[RIGHT_ATI][nFrames] = (float) rt.dataSlice[slice].ft[RIGHT_ATI].force[X];
-			NormalForce[RIGHT_ATI][nFrames] = (float) dex.FilterNormalForce( NormalForce[RIGHT_ATI][nFrames], RIGHT_ATI );
-			// Compute the acceleration, load force, load force magnitude and center-of-pressures, and filter appropriately.
-			dex.ComputeLoadForce( LoadForce[nFrames], rt.dataSlice[slice].ft[0].force, rt.dataSlice[slice].ft[1].force );
-			LoadForceMagnitude[nFrames] = dex.FilterLoadForce( LoadForce[nFrames] );
-			for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
-				double cop_distance = dex.ComputeCoP( CenterOfPressure[ati][nFrames], rt.dataSlice[slice].ft[ati].force, rt.dataSlice[slice].ft[ati].torque, COP_MIN_GRIP );
-				if ( cop_distance >= 0.0 ) dex.FilterCoP( ati, CenterOfPressure[ati][nFrames] );
-			}
-			Acceleration[nFrames][X] = (float) rt.dataSlice[slice].acceleration[X];
-			Acceleration[nFrames][Y] = (float) rt.dataSlice[slice].acceleration[Y];
-			Acceleration[nFrames][Z] = (float) rt.dataSlice[slice].acceleration[Z];
-			dex.FilterAcceleration( Acceleration[nFrames] );
-
-			// Fill some data arrays to show when each marker is visible.
-			// We consider a marker visible if it is seen by either coda.
-			// Set a non-zero value if it is visible, MISSING if it is obscured.
-			// The non-zero values that are set when the marker is visible are a convenient
-			//  trick to make it easy to plot the traces for all markers in one graph.
-			for ( mrk = MANIPULANDUM_FIRST_MARKER; mrk <= MANIPULANDUM_LAST_MARKER; mrk++ ) {
-				unsigned long bit = 0x01 << mrk;
-				if ( rt.dataSlice[slice].markerVisibility[0] & bit || rt.dataSlice[slice].markerVisibility[1] & bit ) MarkerVisibility[nFrames][mrk] = mrk + 1;
-				else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
-			}
-			if (  (rt.dataSlice[slice].manipulandumVisibility & 0x01) ) ManipulandumVisibility[nFrames] = 10;
-			else ManipulandumVisibility[nFrames] = MISSING_DOUBLE;
-			for ( mrk = FRAME_FIRST_MARKER, count = 0; mrk <= FRAME_LAST_MARKER; mrk++ ) {
-				unsigned long bit = 0x01 << mrk;
-				if ( rt.dataSlice[slice].markerVisibility[0] & bit || rt.dataSlice[slice].markerVisibility[1] & bit ) {
-					MarkerVisibility[nFrames][mrk] = mrk + 3;
-					count++;
-				}
-				else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
-			}
-			if ( count == 4 ) FrameVisibility[nFrames] = 30;
-			else FrameVisibility[nFrames] = MISSING_DOUBLE;
-
-			for ( mrk = WRIST_FIRST_MARKER, count = 0; mrk <= WRIST_LAST_MARKER; mrk++ ) {
-				unsigned long bit = 0x01 << mrk;
-				if ( rt.dataSlice[slice].markerVisibility[0] & bit || rt.dataSlice[slice].markerVisibility[1] & bit ) {
-					MarkerVisibility[nFrames][mrk] = mrk + 5;
-					count++;
-				}
-				else MarkerVisibility[nFrames][mrk] = MISSING_DOUBLE;
-			}
-			if ( count >= 3 ) WristVisibility[nFrames] = 50;
-			else WristVisibility[nFrames] = MISSING_DOUBLE;
-			// Indicate that for this instant in time we received a data packet.
-			PacketReceived[nFrames] = -10.0;
-
-			// Count the number of frames.
-			nFrames++;
-		}
+		// And store them in the data buffers.
+		StoreGripRT( &rt, epmHeader.TMCounter );
+		// Note the time stamps of the packets that arrived since the last time, to measure their latency.
+		NoteLatency( cachedPackets + packets_read - 1, &epmHeader );
 
 	}
 	// Finished reading. Close the file and check for errors.
@@ -288,17 +407,29 @@ int GripMMIDesktop::GetGripRT( void ) {
 		fMessageBox( MB_OK, "GripMMI", "Error closing %s after binary read.\nError code: %s\n\n%s", filename, return_code, restart_hint );
 		exit( return_code );
 	}
+	cachedPackets += packets_read;
+	// Convert the quaternions of the new frames to rotations in one go. Missing quaternions give missing rotations.
+	dex.QuaternionsToCannonicalRotations( &RawManipulandumRotations[first_new_frame], &RawManipulandumQuaternion[first_new_frame], nFrames - first_new_frame );
+	// The new packets are now in the buffers.
+	RecordIngestLatency( cachedPackets );
+	// Locate the trial segments in the new set of frames.
+	MapTrialIndex();
 	// Compute the visibility strings for the markers from the last frame.
-	for (coda = 0; coda < CODA_UNITS; coda++ ) {
-		strcpy( markerVisibilityString[coda], "" );
-		for ( mrk = 0; mrk < CODA_MARKERS; mrk++ ) {
-			unsigned long bit = 0x01 << mrk;
-			if ( mrk == 8 || mrk == 12 ) strcat( markerVisibilityString[coda], "  " );
-			if ( rt.dataSlice[RT_SLICES_PER_PACKET - 1].markerVisibility[coda] & bit ) strcat( markerVisibilityString[coda], "u" );
-			else strcat( markerVisibilityString[coda], "m" );
+	// If nothing new was read, they still hold those of the last frame from before.
+	if ( packets_read > 0 ) {
+		for (coda = 0; coda < CODA_UNITS; coda++ ) {
+			strcpy( markerVisibilityString[coda], "" );
+			for ( mrk = 0; mrk < CODA_MARKERS; mrk++ ) {
+				unsigned long bit = 0x01 << mrk;
+				if ( mrk == 8 || mrk == 12 ) strcat( markerVisibilityString[coda], "  " );
+				if ( rt.dataSlice[RT_SLICES_PER_PACKET - 1].markerVisibility[coda] & bit ) strcat( markerVisibilityString[coda], "u" );
+				else strcat( markerVisibilityString[coda], "m" );
+			}
 		}
 	}
 	fOutputDebugString( "Acquired Frames (max %d): %d\n", MAX_FRAMES, nFrames );
+	fOutputDebugString( "Packets: %d received %d dropped %d duplicated %d out of order %d breaks\n", 
+		sequenceTracker.Received(), sequenceTracker.Dropped(), sequenceTracker.Duplicates(), sequenceTracker.OutOfOrder(), sequenceTracker.Gaps() );
 	if ( nFrames >= MAX_FRAMES ) {
 		char filename2[MAX_PATHLENGTH];
 		CreateGripPacketCacheFilename( filename2, sizeof( filename ), GRIP_HK_BULK_PACKET, packetBufferPathRoot );
@@ -310,12 +441,138 @@ int GripMMIDesktop::GetGripRT( void ) {
 	}
 	// Check if there were new packets since the last time we read the cache.
 	// Return TRUE if yes, FALSE if no.
-	if ( previousTMCounter != epmHeader.TMCounter ) {
-		previousTMCounter = epmHeader.TMCounter;
-		return( TRUE );
-	}
+	if ( packets_read > 0 ) return( TRUE );
 	else return ( FALSE );
 }
+///
+/// Measure the latency of the RT packets, from their time stamp on board to the screen.
+/// GripGroundMonitorClient writes the times at which it received and cached each packet to the latency 
+///  file. The times at which the packets are read in and drawn here complete the picture (see GripLatency.h).
+/// Only the packets that arrive while the GripMMI is running are counted. Those that were already in the 
+///  cache when it started would only measure how long the GripMMI had not been running.
+///
+
+// Packets in the RT cache the last time that it was read. -1 until it has been read once.
+static int latencyPackets = -1;
+// Time stamps of the new packets that have been read in but not yet drawn.
+// At the usual rate there are only a few. If there are more, only the first ones are counted.
+#define LATENCY_MAX_PENDING	1024
+static double pendingOnboard[LATENCY_MAX_PENDING];
+static int nPending = 0;
+static GripLatencyHistogram latencyHistogram[GRIP_LATENCY_STAGES];
+// Time stamps of the most recent packet that has been read in and of the most recent one that has been drawn.
+static double latestReadOnboard = 0.0;
+static double latestDrawnOnboard = 0.0;
+// The report is written every so many refreshes in which new packets were drawn.
+#define LATENCY_REPORT_INTERVAL	20
+static int drawsSinceReport = 0;
+
+void GripMMIDesktop::NoteLatency( int packet, EPMTelemetryHeaderInfo *header ) {
+	double onboard = (double) EPMtoSeconds( header );
+	if ( onboard > latestReadOnboard ) latestReadOnboard = onboard;
+	if ( latencyPackets < 0 || packet < latencyPackets ) return;
+	if ( packet - latencyPackets < LATENCY_MAX_PENDING ) pendingOnboard[packet - latencyPackets] = onboard;
+}
+
+void GripMMIDesktop::RecordIngestLatency( int packets ) {
+
+	double ingested = GripClockGPS();
+	char filename[MAX_PATHLENGTH];
+	GripLatencyRecord record;
+	int new_packets, fid;
+
+	if ( latencyPackets < 0 || packets <= latencyPackets ) {
+		latencyPackets = packets;
+		return;
+	}
+	new_packets = packets - latencyPackets;
+	if ( new_packets > LATENCY_MAX_PENDING ) new_packets = LATENCY_MAX_PENDING;
+	for ( int i = 0; i < new_packets; i++ ) GripLatencyAdd( &latencyHistogram[GRIP_LATENCY_INGEST], ingested - pendingOnboard[i] );
+
+	// The latency file has one record per packet in the RT cache, in the same order. 
+	// It may not be there if the client was told not to write it, and the last records may not
+	//  have been written yet. Those packets are only counted in the later stages.
+	CreateGripLatencyFilename( filename, sizeof( filename ), packetBufferPathRoot );
+	fid = _sopen( filename, _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IWRITE | _S_IREAD  );
+	if ( fid >= 0 ) {
+		if ( _lseek( fid, latencyPackets * (long) sizeof( record ), SEEK_SET ) >= 0 ) {
+			for ( int i = 0; i < new_packets; i++ ) {
+				if ( _read( fid, &record, sizeof( record ) ) != sizeof( record ) ) break;
+				if ( record.onboard != pendingOnboard[i] ) continue;
+				GripLatencyAdd( &latencyHistogram[GRIP_LATENCY_RECEIVE], record.received - record.onboard );
+				GripLatencyAdd( &latencyHistogram[GRIP_LATENCY_CACHE_WRITE], record.written - record.onboard );
+			}
+		}
+		_close( fid );
+	}
+
+	nPending = new_packets;
+	latencyPackets = packets;
+
+}
+
+/// 'live' says that the plots were just redrawn to show the latest data. Otherwise the new packets
+///  are not on the screen, or not yet, and they are left out rather than counted late.
+void GripMMIDesktop::RecordDrawLatency( bool live ) {
+
+	double drawn = GripClockGPS();
+	char filename[MAX_PATHLENGTH];
+
+	if ( !live ) {
+		nPending = 0;
+		return;
+	}
+	// Everything read in so far is now on the screen, including what was read while not live.
+	latestDrawnOnboard = latestReadOnboard;
+	if ( nPending == 0 ) return;
+	for ( int i = 0; i < nPending; i++ ) GripLatencyAdd( &latencyHistogram[GRIP_LATENCY_DRAW], drawn - pendingOnboard[i] );
+	nPending = 0;
+
+	if ( ++drawsSinceReport >= LATENCY_REPORT_INTERVAL ) {
+		CreateGripLatencyReportFilename( filename, sizeof( filename ), packetBufferPathRoot );
+		if ( GripLatencyWriteReport( filename, latencyHistogram ) ) fOutputDebugString( "Error writing %s.\n", filename );
+		drawsSinceReport = 0;
+	}
+
+}
+
+/// Show how old the most recent data on the screen is, i.e. how long ago it was stamped on board.
+/// The indicator turns orange, then red, as the data goes stale.
+#define STALENESS_WARNING	( 5.0 * PACKET_STREAM_BREAK_THRESHOLD )
+#define STALENESS_ALARM		60.0
+void GripMMIDesktop::UpdateStalenessIndicator( void ) {
+
+	char staleness_string[32];
+	double age;
+
+	// When not live, the plots show older data on purpose and the age means nothing.
+	if ( latestDrawnOnboard == 0.0 || !dataLiveCheckbox->Checked ) {
+		stalenessLabel->Text = "Age --";
+		stalenessLabel->ForeColor = System::Drawing::Color::Gray;
+		return;
+	}
+	age = GripClockGPS() - latestDrawnOnboard;
+	if ( age < 60.0 ) sprintf( staleness_string, "Age %.1fs", age );
+	else if ( age < 3600.0 ) sprintf( staleness_string, "Age %.0fm", age / 60.0 );
+	else sprintf( staleness_string, "Age %.0fh", age / 3600.0 );
+	stalenessLabel->Text = gcnew String( staleness_string );
+	if ( age > STALENESS_ALARM ) stalenessLabel->ForeColor = System::Drawing::Color::Red;
+	else if ( age > STALENESS_WARNING ) stalenessLabel->ForeColor = System::Drawing::Color::DarkOrange;
+	else stalenessLabel->ForeColor = System::Drawing::Color::Green;
+
+}
+
+/// When built with GRIP_TRACE, write the trace spans recorded during the session
+/// alongside the cache files, in Chrome trace format.
+void GripMMIDesktop::WriteTrace( void ) {
+#ifdef GRIP_TRACE
+	char filename[MAX_PATHLENGTH];
+	_snprintf( filename, sizeof( filename ), "%s.trace.json", packetBufferPathRoot );
+	filename[sizeof( filename ) - 1] = 0;
+	if ( TraceWrite( filename ) ) fOutputDebugString( "Error writing %s.\n", filename );
+#endif
+}
+
 /// Simulate a set of realtime data packets.
 /// This is not an option that is available at run time. It can only be used by modifying the code
 ///  to call this routine instead of GetGripRT().
@@ -324,66 +581,49 @@ void GripMMIDesktop::SimulateGripRT ( void ) {
 	// Simulate some data to test memory limites and graphics functions.
 	// Each time through it adds more data to the buffers, so as to 
 	//  simulate the progressive arrival of real-time data packets.
-
-	int i, mrk;
+	// The packets come from a generator with a fixed seed, so each time through the
+	//  same packets are generated again, followed by new ones. They go through the same
+	//  path as the packets read from the cache, including a few that are lost on the way.
 
 	static int count = 0;
 
+	GripPacketGenerator		generator( 1 );
+	EPMTelemetryPacket		packet;
+	EPMTelemetryHeaderInfo	epmHeader;
+	GripRealtimeDataInfo	rt;
+
 	fOutputDebugString( "Start SimulateGripRT().\n" );
 	count++;
 	unsigned int fill_frames = 60 * 20 * count;
-	for ( nFrames = 0; nFrames <= fill_frames && nFrames < MAX_FRAMES; nFrames++ ) {
-
-		RealMarkerTime[nFrames] = (float) nFrames * 0.05f;
-		ManipulandumPosition[nFrames][X] = 30.0 * sin( RealMarkerTime[nFrames] * Pi * 2.0 / 30.0 );
-		ManipulandumPosition[nFrames][Y] = 300.0 * cos( RealMarkerTime[nFrames] * Pi * 2.0 / 30.0 ) + 200.0;
-		ManipulandumPosition[nFrames][Z] = -75.0 * sin( RealMarkerTime[nFrames] * Pi * 2.0 / 155.0 ) - 300.0;
-
-		GripForce[nFrames] = (float) abs( -5.0 * sin( RealMarkerTime[nFrames] * Pi * 2.0 / 155.0 )  );
-		for ( i = X; i <= Z; i++ ) {
-			LoadForce[nFrames][i] = ManipulandumPosition[nFrames][ (i+2) % 3] / 200.0;
-		}
-
-		for ( mrk = 0; mrk <CODA_MARKERS; mrk++ ) {
-
-			int grp = ( mrk >= 8 ? ( mrk >= 16 ? mrk + 20 : mrk + 10 ) : mrk ) + 35;
-			if ( nFrames == 0 ) MarkerVisibility[nFrames][mrk] = grp;
-			else {
-				if ( MarkerVisibility[nFrames-1][mrk] != MISSING_CHAR ) {
-					if ( rand() % 1000 < 1 ) MarkerVisibility[nFrames][mrk] = MISSING_CHAR;
-					else MarkerVisibility[nFrames][mrk] = grp;
-				}
-				else {
-					if ( rand() % 1000 < 1 ) MarkerVisibility[nFrames][mrk] = grp;
-					else MarkerVisibility[nFrames][mrk] = MISSING_CHAR;
-				}
-			}
-		}
-			
-		ManipulandumVisibility[nFrames] = 0;
-		for ( mrk = MANIPULANDUM_FIRST_MARKER; mrk <= MANIPULANDUM_LAST_MARKER; mrk++ ) {
-			if ( MarkerVisibility[nFrames][mrk] != MISSING_CHAR ) ManipulandumVisibility[nFrames]++;
-		}
-		if ( ManipulandumVisibility[nFrames] < 3 ) ManipulandumPosition[nFrames][X] = ManipulandumPosition[nFrames][Y] = ManipulandumPosition[nFrames][Z] = MISSING_DOUBLE;
-		ManipulandumVisibility[nFrames] *= 3;
-
+	generator.hkInterval = 0;
+	generator.lossRate = 0.001;
+	generator.Reset();
+	ResetBuffers();
+	// The simulated data may have changed, so frames that were filtered before have to be filtered again.
+	InvalidateFilteredBuffers();
+	while ( nFrames < fill_frames && nFrames < MAX_FRAMES ) {
+		generator.NextPacket( &packet );
+		ExtractEPMTelemetryHeaderInfo( &epmHeader, &packet );
+		ExtractGripRealtimeDataInfo( &rt, &packet );
+		StoreGripRT( &rt, epmHeader.TMCounter );
 	}
+	dex.QuaternionsToCannonicalRotations( RawManipulandumRotations, RawManipulandumQuaternion, nFrames );
+	MapTrialIndex();
 	fOutputDebugString( "End SimulateGripRT().\n" );
-	fOutputDebugString( "nFrames: %d %d\n", nFrames, MAX_FRAMES );
+	fOutputDebugString( "nFrames: %d %d  Packets lost: %d\n", nFrames, MAX_FRAMES, generator.rtLost );
 }
 
 /// Read housekeeping cache, taking just the most recent value.
 /// The path to the cache file is presumed to be set in global variable 'packetBufferPathRoot'.
 /// The contents of the latest HK packet are returned in the structure pointed to by parameter 'hk'.
-int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
-
-	static int count = 0;
+/// The index of trial segments is rebuilt along the way from the IDs in all the packets.
+/// Returns the TM counter of the latest packet.
+unsigned short GripMMIDesktop::ReadGripHK( GripHealthAndStatusInfo *hk ) {
 
 	int  fid;
 	int packets_read = 0;
 	int bytes_read;
 	int return_code;
-	static unsigned short previousTMCounter = 0;
 	unsigned long bit = 0;
 	int retry_count;
 
@@ -392,6 +632,8 @@ int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
 
 	char filename[1024];
 
+	TRACE_FUNCTION();
+
 	// Create the path to the housekeeping packet file, based on the root and the packet type.
 	// The global variable 'packetBufferPathRoot' has been initialized elsewhere.
 	CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_HK_BULK_PACKET, packetBufferPathRoot );
@@ -416,8 +658,11 @@ int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
 
 	// Read in all of the data packets in the file.
 	packets_read = 0;
+	ResetTrialIndex();
 	while ( true ) {
+		TRACE_BEGIN( "ReadHKCache" );
 		bytes_read = _read( fid, &packet, hkPacketLengthInBytes );
+		TRACE_END( "ReadHKCache" );
 		// Return less than zero means read error.
 		if ( bytes_read < 0 ) {
 			fMessageBox( MB_OK, "GripMMI", "Error reading from %s.\n\n%s", filename, restart_hint );
@@ -435,6 +680,7 @@ int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
 		}
 		// Extract the interesting info in proper byte order.
 		ExtractGripHealthAndStatusInfo( hk, &packet );
+		UpdateTrialIndex( hk, EPMtoSeconds( &epmHeader ) );
 	}
 	// Finished reading. Close the file and check for errors.
 	return_code = _close( fid );
@@ -442,12 +688,24 @@ int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
 		fMessageBox( MB_OK, "GripMMI", "Error closing %s after binary read.\nError code: %s\n\n%s", filename, return_code, restart_hint );
 		exit( return_code );
 	}
+	// Locate the trial segments in the frames that have already been read.
+	MapTrialIndex();
+
+	return( epmHeader.TMCounter );
+}
+
+/// Read the housekeeping cache as above and say whether there is anything new.
+/// The structure pointed to by 'hk' contains the data from the last valid packet that was read from the cache file.
+int GripMMIDesktop::GetLatestGripHK( GripHealthAndStatusInfo *hk ) {
+
+	static unsigned short previousTMCounter = 0;
+
+	unsigned short tm_counter = ReadGripHK( hk );
 
-	// The structure pointed to by 'hk' contains the data from the last valid packet that was read from the cache file.
 	// Check if there were new packets since the last time we read the cache.
 	// Return TRUE if yes, FALSE if no.
-	if ( previousTMCounter != epmHeader.TMCounter ) {
-		previousTMCounter = epmHeader.TMCounter;
+	if ( previousTMCounter != tm_counter ) {
+		previousTMCounter = tm_counter;
 		return( TRUE );
 	}
 	else return ( FALSE );
@@ -468,6 +726,8 @@ void GripMMIDesktop::UpdateStatus( bool force ) {
 
 	int return_code;
 
+	TRACE_FUNCTION();
+
 	// Get the latest hk packet info.
 	return_code = GetLatestGripHK( &hk_info );
 	if ( ERROR_CACHE_NOT_FOUND == return_code ) {
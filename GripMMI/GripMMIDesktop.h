@@ -34,13 +34,20 @@
 #include <Windows.h>
 
 #include "..\Useful\fOutputDebugString.h"
+#include "..\Useful\fMessageBox.h"
+#include "..\Useful\Trace.h"
 #include "..\PsyPhy2dGraphicsLib\Displays.h"
 #include "..\PsyPhy2dGraphicsLib\Views.h"
 #include "..\PsyPhy2dGraphicsLib\Layouts.h"
 #include "..\Grip\DexAnalogMixin.h"
+#include "..\Grip\DexZeroPhaseFilter.h"
+#include "..\Grip\DexDerivedSignals.h"
+#include "..\Grip\DexEventDetector.h"
+#include "..\Grip\DexSequenceTracker.h"
 #include "..\Grip\GripPackets.h"
 
 #include "GripMMIGlobals.h"
+#include "GripMMIBuffers.h"
 
 // Time in milliseconds between screen refreshes.
 #define REFRESH_TIMEOUT	500
@@ -161,8 +168,11 @@ namespace GripMMI {
 	private: System::Windows::Forms::TextBox^  acquisitionTextBox;
 	private: System::Windows::Forms::Label^  label5;
 	private: System::Windows::Forms::CheckBox^  autoscaleCheckBox;
+	private: System::Windows::Forms::CheckBox^  densityCheckBox;
+	private: System::Windows::Forms::ComboBox^  filterTypeComboBox;
 	private: System::Windows::Forms::ComboBox^  graphCollectionComboBox;
 	private: System::Windows::Forms::Label^  Spans;
+	private: System::Windows::Forms::Label^  stalenessLabel;
 	private: System::Windows::Forms::TextBox^  earliestTextBox;
 	private: System::Windows::Forms::TextBox^  latestTextBox;
 	private: System::Windows::Forms::TextBox^  rightLimitTextBox;
@@ -178,6 +188,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 
 			// Set up graphs.
 			InitializeGraphics();
+			// Set up the filters that are applied to the data buffers.
+			InitializeFilterBank();
 			AdjustScrollSpan();
 
 			// Construct the path to the root script and intialize the crawler menus.
@@ -199,6 +211,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 				// This does a ForceUdate as a side effect, which requires that the refresh timer
 				//  be created already. That is why CreateRefreshTimer() is performed first in this else clause.
 				graphCollectionComboBox->SelectedIndex = 0;
+				// Show the default filter type.
+				filterTypeComboBox->SelectedIndex = filterType;
 				// The next time that the refresh timer goes off, plot the data regardless of 
 				//  whether there is new data or not. This draws the data plots, even if empty.
 				// ForceUpdate() is a side effect of changing the graph collection,
@@ -235,6 +249,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 		// This is what we do when the timer goes off.
 		void OnTimerElapsed( System::Object^ source, System::EventArgs ^ e ) {
 			int new_data;
+			bool refreshed;
+			TRACE_FUNCTION();
 			// Stop the timer so that it does not retrigger until we are done refreshing.
 			StopRefreshTimer();
 			fOutputDebugString( "\n" );
@@ -249,7 +265,12 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			if ( dataLiveCheckbox->Checked ) MoveToLatest();
 			// If we have received new data, or if another function has requested a forced update,
 			//  replot all of the strip charts and scatter plots.
-			if ( new_data || forceUpdate ) RefreshGraphics();
+			refreshed = ( new_data || forceUpdate );
+			if ( refreshed ) RefreshGraphics();
+			// Note when the new packets made it to the screen and show how old the latest data is.
+			// This only counts if the plots were redrawn and are showing the latest data.
+			RecordDrawLatency( refreshed && dataLiveCheckbox->Checked );
+			UpdateStalenessIndicator();
 			// Handle HK packets and the script crawler display.
 			if ( scriptLiveCheckbox->Checked ) {
 				fOutputDebugString( "UpdateStatus.\n" );
@@ -272,6 +293,9 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 		void ImpedeUpdate( void ) {
 			StopRefreshTimer();
 		}
+		// Draw one of the strip charts of a collection. The strip charts are drawn in parallel
+		//  by RefreshGraphics() and this is called back from the rendering threads.
+		void GraphStripChart( int collection, int chart, ::View view );
 
 	private: 
 
@@ -287,14 +311,25 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 		::View		xy_view;
 		::View		zy_view;
 		::View		cop_view;
+		// What RefreshGraphics() is plotting, as seen by GraphStripChart(). The rendering threads
+		//  must not read the controls of the form, so the autoscale setting is copied here too.
+		int		plotCollection;
+		double	plotFirstInstant;
+		double	plotLastInstant;
+		int		plotFirstSample;
+		int		plotLastSample;
+		int		plotStep;
+		bool	autoscale;
 
 		// GripMMIGraphics.cpp
 
 		void InitializeGraphics( void );
 		void RefreshGraphics( void );
+		bool ExportStripCharts( char *filename );
 		void KillGraphics( void );
 		void AdjustScrollSpan( void );
 		void MoveToLatest( void );
+		bool MoveToTrial( int protocol_id, int task_id, int step_id );
 
 		void GraphManipulandumPosition( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
 		void GraphManipulandumRotations( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
@@ -306,15 +341,35 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 		void GraphVisibilityDetails( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip ) ;
 		void GraphCoP( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
 		void PlotCoP( double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void SetDensityGrid( ::DensityMap map, ::View view );
+		void ClearDensityMaps( void );
+		void PlotVisibilityRuns( ::View view, VisibilityRuns *runs, double *visibility, unsigned int size, int start_frame, int stop_frame, int skip );
 
 		void GraphManipulandumPositionComponent( int component, ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
 		void GraphAccelerationComponent( int component, ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void GraphVelocity( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void GraphJerk( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void GraphGripLoadRatio( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void GraphGripLoadLag( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int skip );
+		void MarkEvents( ::View view, int type, int color, int symbol, double start_instant, double stop_instant );
 
 		// GripMMIData.cpp
 
-		void ResetBuffers( void );
+		void InitializeFilterBank( void );
+		void InvalidateFilteredBuffers( void );
+		void FilterBuffers( unsigned int first_frame, unsigned int last_frame );
+		void ResetTrialIndex( void );
+		void UpdateTrialIndex( GripHealthAndStatusInfo *hk, double instant );
+		void MapTrialIndex( void );
+		int  FindTrialSegment( int protocol_id, int task_id, int step_id );
 		int  GetGripRT( void );
 		void SimulateGripRT ( void ); // For testing only.
+		void NoteLatency( int packet, EPMTelemetryHeaderInfo *header );
+		void RecordIngestLatency( int packets );
+		void RecordDrawLatency( bool live );
+		void UpdateStalenessIndicator( void );
+		void WriteTrace( void );
+		unsigned short ReadGripHK( GripHealthAndStatusInfo *hk );
 		int	 GetLatestGripHK( GripHealthAndStatusInfo *hk );
 		void UpdateStatus( bool force );
 
@@ -358,12 +413,15 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->leftLimitTextBox = (gcnew System::Windows::Forms::TextBox());
 			this->graphCollectionComboBox = (gcnew System::Windows::Forms::ComboBox());
 			this->autoscaleCheckBox = (gcnew System::Windows::Forms::CheckBox());
+			this->densityCheckBox = (gcnew System::Windows::Forms::CheckBox());
 			this->StripCharts = (gcnew System::Windows::Forms::PictureBox());
 			this->filterCheckbox = (gcnew System::Windows::Forms::CheckBox());
+			this->filterTypeComboBox = (gcnew System::Windows::Forms::ComboBox());
 			this->groupBox5 = (gcnew System::Windows::Forms::GroupBox());
 			this->latestTextBox = (gcnew System::Windows::Forms::TextBox());
 			this->earliestTextBox = (gcnew System::Windows::Forms::TextBox());
 			this->Spans = (gcnew System::Windows::Forms::Label());
+			this->stalenessLabel = (gcnew System::Windows::Forms::Label());
 			this->scrollBar = (gcnew System::Windows::Forms::HScrollBar());
 			this->spanSelector = (gcnew System::Windows::Forms::TrackBar());
 			this->dataLiveCheckbox = (gcnew System::Windows::Forms::CheckBox());
@@ -492,6 +550,7 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			// 
 			// groupBox3
 			// 
+			this->groupBox3->Controls->Add(this->densityCheckBox);
 			this->groupBox3->Controls->Add(this->CoPPlot);
 			this->groupBox3->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 12, System::Drawing::FontStyle::Regular, System::Drawing::GraphicsUnit::Point, 
 				static_cast<System::Byte>(0)));
@@ -502,6 +561,20 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->groupBox3->TabStop = false;
 			this->groupBox3->Text = L"CoP";
 			// 
+			// densityCheckBox
+			// 
+			this->densityCheckBox->AutoSize = true;
+			this->densityCheckBox->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 10, System::Drawing::FontStyle::Regular, System::Drawing::GraphicsUnit::Point, 
+				static_cast<System::Byte>(0)));
+			this->densityCheckBox->Location = System::Drawing::Point(196, 1);
+			this->densityCheckBox->Name = L"densityCheckBox";
+			this->densityCheckBox->RightToLeft = System::Windows::Forms::RightToLeft::Yes;
+			this->densityCheckBox->Size = System::Drawing::Size(75, 21);
+			this->densityCheckBox->TabIndex = 3;
+			this->densityCheckBox->Text = L"Density";
+			this->densityCheckBox->UseVisualStyleBackColor = true;
+			this->densityCheckBox->CheckedChanged += gcnew System::EventHandler(this, &GripMMIDesktop::densityCheckBox_CheckedChanged);
+			// 
 			// CoPPlot
 			// 
 			this->CoPPlot->BackColor = System::Drawing::Color::Maroon;
@@ -521,6 +594,7 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->groupBox4->Controls->Add(this->autoscaleCheckBox);
 			this->groupBox4->Controls->Add(this->StripCharts);
 			this->groupBox4->Controls->Add(this->filterCheckbox);
+			this->groupBox4->Controls->Add(this->filterTypeComboBox);
 			this->groupBox4->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 12, System::Drawing::FontStyle::Regular, System::Drawing::GraphicsUnit::Point, 
 				static_cast<System::Byte>(0)));
 			this->groupBox4->Location = System::Drawing::Point(4, 322);
@@ -576,7 +650,7 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->graphCollectionComboBox->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 9, System::Drawing::FontStyle::Regular, 
 				System::Drawing::GraphicsUnit::Point, static_cast<System::Byte>(0)));
 			this->graphCollectionComboBox->FormattingEnabled = true;
-			this->graphCollectionComboBox->Items->AddRange(gcnew cli::array< System::Object^  >(3) {L"Summary", L"Kinematics", L"Visibility"});
+			this->graphCollectionComboBox->Items->AddRange(gcnew cli::array< System::Object^  >(4) {L"Summary", L"Kinematics", L"Visibility", L"Derived"});
 			this->graphCollectionComboBox->Location = System::Drawing::Point(704, 0);
 			this->graphCollectionComboBox->Name = L"graphCollectionComboBox";
 			this->graphCollectionComboBox->Size = System::Drawing::Size(142, 23);
@@ -622,6 +696,19 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->filterCheckbox->UseVisualStyleBackColor = true;
 			this->filterCheckbox->CheckedChanged += gcnew System::EventHandler(this, &GripMMIDesktop::filterCheckbox_CheckedChanged);
 			// 
+			// filterTypeComboBox
+			// 
+			this->filterTypeComboBox->DropDownStyle = System::Windows::Forms::ComboBoxStyle::DropDownList;
+			this->filterTypeComboBox->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 9, System::Drawing::FontStyle::Regular, 
+				System::Drawing::GraphicsUnit::Point, static_cast<System::Byte>(0)));
+			this->filterTypeComboBox->FormattingEnabled = true;
+			this->filterTypeComboBox->Items->AddRange(gcnew cli::array< System::Object^  >(4) {L"Causal", L"Zero Phase", L"Butterworth", L"Savitzky-Golay"});
+			this->filterTypeComboBox->Location = System::Drawing::Point(570, 0);
+			this->filterTypeComboBox->Name = L"filterTypeComboBox";
+			this->filterTypeComboBox->Size = System::Drawing::Size(122, 23);
+			this->filterTypeComboBox->TabIndex = 27;
+			this->filterTypeComboBox->SelectedIndexChanged += gcnew System::EventHandler(this, &GripMMIDesktop::filterTypeComboBox_SelectedIndexChanged);
+			// 
 			// groupBox5
 			// 
 			this->groupBox5->BackColor = System::Drawing::Color::Transparent;
@@ -631,6 +718,7 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->groupBox5->Controls->Add(this->scrollBar);
 			this->groupBox5->Controls->Add(this->spanSelector);
 			this->groupBox5->Controls->Add(this->dataLiveCheckbox);
+			this->groupBox5->Controls->Add(this->stalenessLabel);
 			this->groupBox5->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 12, System::Drawing::FontStyle::Regular, System::Drawing::GraphicsUnit::Point, 
 				static_cast<System::Byte>(0)));
 			this->groupBox5->Location = System::Drawing::Point(4, 242);
@@ -675,6 +763,17 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 			this->Spans->TabIndex = 12;
 			this->Spans->Text = L"12h  4h  1h  30m 10m 5m 60s 30s";
 			// 
+			// stalenessLabel
+			// 
+			this->stalenessLabel->Font = (gcnew System::Drawing::Font(L"Microsoft Sans Serif", 10, System::Drawing::FontStyle::Regular, System::Drawing::GraphicsUnit::Point, 
+				static_cast<System::Byte>(0)));
+			this->stalenessLabel->ForeColor = System::Drawing::Color::Gray;
+			this->stalenessLabel->Location = System::Drawing::Point(1012, 52);
+			this->stalenessLabel->Name = L"stalenessLabel";
+			this->stalenessLabel->Size = System::Drawing::Size(72, 17);
+			this->stalenessLabel->TabIndex = 15;
+			this->stalenessLabel->Text = L"Age --";
+			// 
 			// scrollBar
 			// 
 			this->scrollBar->LargeChange = 100000;
@@ -1307,6 +1406,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 	private: System::Void GripMMIDesktop_FormClosing(System::Object^  sender, System::Windows::Forms::FormClosingEventArgs^  e) {
 				 // Free resources allocated by the PsyPhy graphics routines.
 				 KillGraphics();
+				 // Write out the trace spans, if tracing was compiled in.
+				 WriteTrace();
 			 }
 	private: System::Void spanSelector_ValueChanged(System::Object^  sender, System::EventArgs^  e) {
 				 // When the user selects a different span with the slider, update the parameters
@@ -1445,6 +1546,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 				 }
 
 				 GoToSpecifiedIDs( subject_id, protocol_id, task_id, step_id );
+				 // Also show the data recorded during that step, if any.
+				 if ( MoveToTrial( protocol_id, task_id, step_id ) ) dataLiveCheckbox->Checked = false;
 				 ForceUpdate();
 
 			 }
@@ -1580,7 +1683,21 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 				}
 				 if ( filterCheckbox->Checked ) dex.SetFilterConstant( filter_constant );
 				 else dex.SetFilterConstant( 0.0 );
-				 ForceUpdate();
+				 // The data will change, so the density maps have to be built again.
+				 ClearDensityMaps();
+				 // The unfiltered data is still in memory, so redraw right away. RefreshGraphics() 
+				 //  filters the data that it needs to show. There is no need to wait for the next
+				 //  refresh cycle to read the packets again.
+				 RefreshGraphics();
+				 StartRefreshTimer();
+			 }
+	// The meaning of the filter constant depends on the type of filter, so when the type 
+	//  is changed the constant is set to a sensible value for the new type.
+	private: System::Void filterTypeComboBox_SelectedIndexChanged(System::Object^  sender, System::EventArgs^  e) {
+				 if ( filterTypeComboBox->SelectedIndex < 0 || filterTypeComboBox->SelectedIndex == filterType ) return;
+				 filterType = filterTypeComboBox->SelectedIndex;
+				 filterConstantTextBox->Text = gcnew String( defaultFilterParameter[filterType] );
+				 filterCheckbox_CheckedChanged( sender, e );
 			 }
 	private: System::Void scriptLiveCheckbox_CheckedChanged(System::Object^  sender, System::EventArgs^  e) {
 				 // Check the new state of the checkbox after the state change.
@@ -1597,6 +1714,9 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 	private: System::Void autoscaleCheckBox_CheckedChanged(System::Object^  sender, System::EventArgs^  e) {
 				 ForceUpdate();
 			 }
+	private: System::Void densityCheckBox_CheckedChanged(System::Object^  sender, System::EventArgs^  e) {
+				 ForceUpdate();
+			 }
 	private: System::Void graphCollectionComboBox_SelectedIndexChanged(System::Object^  sender, System::EventArgs^  e) {
 				 ForceUpdate();
 			 }
@@ -1629,6 +1749,8 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 	
 	// Add an 'About ...' item to the system menu. 
 	#define SYSMENU_ABOUT_ID 0x01
+	// And one to save the strip charts to a file.
+	#define SYSMENU_EXPORT_ID 0x02
 
 	protected:  virtual void OnHandleCreated( System::EventArgs^ e) override {	
 
@@ -1643,9 +1765,21 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 					AppendMenu(hSysMenu, MF_SEPARATOR, 0, "" );
 					// Add the About menu item
 					AppendMenu(hSysMenu, MF_STRING, SYSMENU_ABOUT_ID, "&About ");
+					AppendMenu(hSysMenu, MF_STRING, SYSMENU_EXPORT_ID, "&Export Strip Charts ");
 
 				}
 
+	private: void ExportStripChartsDialog( void ) {
+					 char filename[MAX_PATH];
+					 SaveFileDialog^ dialog = gcnew SaveFileDialog();
+					 dialog->Filter = "SVG files (*.svg)|*.svg|PDF files (*.pdf)|*.pdf";
+					 dialog->Title = "Export Strip Charts";
+					 if ( dialog->ShowDialog() != System::Windows::Forms::DialogResult::OK ) return;
+					 pin_ptr<const wchar_t> pinchars = PtrToStringChars( dialog->FileName );
+					 if ( wcstombs_s( NULL, filename, sizeof( filename ), pinchars, _TRUNCATE ) ) return;
+					 if ( !ExportStripCharts( filename ) ) fMessageBox( MB_OK, "GripMMI", "Error writing the strip charts to %s.", filename );
+				 }
+
 	protected:  virtual void WndProc(System::Windows::Forms::Message% m) override {	
 					// Test if the About item was selected from the system menu
 					if ((m.Msg == WM_SYSCOMMAND) && ((int)m.WParam == SYSMENU_ABOUT_ID))
@@ -1653,6 +1787,12 @@ private: System::Windows::Forms::TextBox^  filterConstantTextBox;
 						aboutForm->ShowDialog();
 						return;
 					}
+					// Or the item to save the strip charts.
+					if ((m.Msg == WM_SYSCOMMAND) && ((int)m.WParam == SYSMENU_EXPORT_ID))
+					{
+						ExportStripChartsDialog();
+						return;
+					}
 					// Do what one would normally do.
 					Form::WndProc( m );
 				}
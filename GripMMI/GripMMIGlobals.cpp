@@ -14,9 +14,13 @@
 // VC 2010 doesn't allow 'mixed' types in Forms objects. So here I define a number of global variables to 
 //  replace the arrays that I was using previously. It's ugly, but this was an unexpected 'feature' of VC2010.
 
-#include "StdAfx.h"
-#include "..\Grip\DexAnalogMixin.h"
-#include "..\Grip\GripPackets.h"
+#include "stdafx.h"
+#include "../Grip/DexAnalogMixin.h"
+#include "../Grip/DexZeroPhaseFilter.h"
+#include "../Grip/DexDerivedSignals.h"
+#include "../Grip/DexEventDetector.h"
+#include "../Grip/DexSequenceTracker.h"
+#include "../Grip/GripPackets.h"
 #include "GripMMIGlobals.h"
 
 // Time span in seconds for each position of the span selector.
@@ -66,11 +70,30 @@ double RealMarkerTime[MAX_FRAMES];
 double CompressedMarkerTime[MAX_FRAMES];
 double RealAnalogTime[MAX_FRAMES];
 double CompressedAnalogTime[MAX_FRAMES];
+Quaternion RawManipulandumQuaternion[MAX_FRAMES];
+Vector3 RawManipulandumRotations[MAX_FRAMES];
+Vector3 RawManipulandumPosition[MAX_FRAMES];
+Vector3 RawAcceleration[MAX_FRAMES];
+double RawGripForce[MAX_FRAMES];
+Vector3 RawLoadForce[MAX_FRAMES];
+double RawNormalForce[N_FORCE_TRANSDUCERS][MAX_FRAMES];
+Vector3 RawCenterOfPressure[N_FORCE_TRANSDUCERS][MAX_FRAMES];
+Vector3 ManipulandumVelocity[MAX_FRAMES];
+Vector3 Jerk[MAX_FRAMES];
+double GripLoadRatio[MAX_FRAMES];
+double GripLoadLag[MAX_FRAMES];
 double  MarkerVisibility[MAX_FRAMES][CODA_MARKERS];
 double  ManipulandumVisibility[MAX_FRAMES];
 double  FrameVisibility[MAX_FRAMES];
 double  WristVisibility[MAX_FRAMES];
 double  PacketReceived[MAX_FRAMES];
+VisibilityRuns MarkerVisibilityRuns[CODA_MARKERS];
+VisibilityRuns ManipulandumVisibilityRuns;
+VisibilityRuns FrameVisibilityRuns;
+VisibilityRuns WristVisibilityRuns;
+VisibilityRuns PacketReceivedRuns;
+TimeIndex MarkerTimeIndex;
+TrialIndex StepTrialIndex;
 char markerVisibilityString[CODA_UNITS][32];
 unsigned int nFrames = 0;
 
@@ -81,4 +104,11 @@ unsigned int nFrames = 0;
 int TimebaseOffset = -16;
 
 // A helper object
-DexAnalogMixin	dex;
\ No newline at end of file
+DexAnalogMixin	dex;
+DexFilterBank	filterBank;
+DexZeroPhaseFilter	zeroPhaseFilter;
+DexDerivedSignals	derivedSignals;
+DexEventDetector	eventDetector;
+DexSequenceTracker	sequenceTracker;
+int filterType = CAUSAL_FILTER;
+char *defaultFilterParameter[FILTER_TYPES] = { "2.0", "2.0", "2.0", "10" };
\ No newline at end of file
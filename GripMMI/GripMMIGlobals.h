@@ -12,6 +12,11 @@
 
 /// Definition of preprocessor constants and global variables for GripMMI.
 
+#include "../Grip/DexZeroPhaseFilter.h"
+#include "../Grip/DexDerivedSignals.h"
+#include "../Grip/DexEventDetector.h"
+#include "../Grip/DexSequenceTracker.h"
+
 /// <summary>
 /// Buffers to hold the GRIP data.
 /// The reason that all of these are doubles (or vectors of doubles) is because
@@ -39,6 +44,21 @@ extern double RealMarkerTime[MAX_FRAMES];
 extern double CompressedMarkerTime[MAX_FRAMES];
 extern double RealAnalogTime[MAX_FRAMES];
 extern double CompressedAnalogTime[MAX_FRAMES];
+// Unfiltered values, as decoded from the packets. The buffers above that are filtered are 
+//  computed from these, so that the filtering can be changed without reading the packets again.
+extern Quaternion RawManipulandumQuaternion[MAX_FRAMES];
+extern Vector3 RawManipulandumRotations[MAX_FRAMES];
+extern Vector3 RawManipulandumPosition[MAX_FRAMES];
+extern Vector3 RawAcceleration[MAX_FRAMES];
+extern double RawGripForce[MAX_FRAMES];
+extern Vector3 RawLoadForce[MAX_FRAMES];
+extern double RawNormalForce[N_FORCE_TRANSDUCERS][MAX_FRAMES];
+extern Vector3 RawCenterOfPressure[N_FORCE_TRANSDUCERS][MAX_FRAMES];
+// Values derived from the filtered buffers (see DexDerivedSignals).
+extern Vector3 ManipulandumVelocity[MAX_FRAMES];
+extern Vector3 Jerk[MAX_FRAMES];
+extern double GripLoadRatio[MAX_FRAMES];
+extern double GripLoadLag[MAX_FRAMES];
 extern double  MarkerVisibility[MAX_FRAMES][CODA_MARKERS];
 #define MANIPULANDUM_FIRST_MARKER 0
 #define MANIPULANDUM_LAST_MARKER  7
@@ -50,6 +70,67 @@ extern double  ManipulandumVisibility[MAX_FRAMES];
 extern double  FrameVisibility[MAX_FRAMES];
 extern double  WristVisibility[MAX_FRAMES];
 extern double  PacketReceived[MAX_FRAMES];
+// Visibility changes rarely, so it is also kept as runs of consecutive frames
+//  during which a marker or a group of markers is visible. Plotting one bar per
+//  run is much faster than plotting a symbol for every frame.
+// The array of runs is allocated as it fills up, since most records need only a few.
+#define MAX_VISIBILITY_RUNS	65536
+#define VISIBILITY_RUNS_ALLOCATION	256
+typedef struct {
+	double	value;							// The value stored in the frames, which sets the height of the plot.
+	int		n_runs;
+	int		allocated;						// Number of runs that 'run' can hold.
+	bool	overflow;						// Set if there are too many runs to store. Plot the frames instead.
+	int		(*run)[2];						// First and last frame of each run.
+} VisibilityRuns;
+extern VisibilityRuns MarkerVisibilityRuns[CODA_MARKERS];
+extern VisibilityRuns ManipulandumVisibilityRuns;
+extern VisibilityRuns FrameVisibilityRuns;
+extern VisibilityRuns WristVisibilityRuns;
+extern VisibilityRuns PacketReceivedRuns;
+// Frames are appended in time order, so finding the frames that fall in a time window
+//  can be done by bisection rather than by walking back from the end of the buffers.
+// The index keeps, for each chunk of frames, the latest time and the last frame with a
+//  valid time seen up to the end of that chunk. Gap frames (MISSING_DOUBLE) are skipped
+//  and their positions are recorded in the gap table.
+#define TIME_INDEX_CHUNK	256
+#define TIME_INDEX_CHUNKS	(MAX_FRAMES / TIME_INDEX_CHUNK + 1)
+#define MAX_TIME_GAPS		65536
+typedef struct {
+	unsigned int	n_frames;						// Number of frames that have been indexed.
+	int		first_valid;							// First and last frames with a valid time, or -1 if there are none.
+	int		last_valid;
+	double	earliest;								// Times of those frames.
+	double	latest;
+	double	max_time[TIME_INDEX_CHUNKS];			// Latest time up to and including each chunk.
+	int		last_frame[TIME_INDEX_CHUNKS];			// Last frame with a valid time up to and including each chunk.
+	int		n_gaps;
+	bool	overflow;
+	int		gap[MAX_TIME_GAPS][2];					// First and last frame of each run of frames without a time.
+} TimeIndex;
+extern TimeIndex MarkerTimeIndex;
+// The HK packets report which user, protocol, task and step the script engine is at.
+// Each change of those IDs starts a new segment, which lasts until the next change.
+// The segments are mapped onto the frames of the RT buffers, so that the data recorded
+//  during a given step can be found directly, rather than by scrolling through the data.
+// A step that is performed more than once gives one segment for each repetition.
+#define MAX_TRIAL_SEGMENTS	65536
+typedef struct {
+	unsigned short	user;
+	unsigned short	protocol;
+	unsigned short	task;
+	unsigned short	step;
+	double	start_time;								// Time of the first HK packet reporting these IDs.
+	double	stop_time;								// Time of the first HK packet reporting different IDs, or of the latest HK packet.
+	int		first_frame;							// First and last frames of the RT buffers within the segment, or -1 if there are none.
+	int		last_frame;
+} TrialSegment;
+typedef struct {
+	int		n_segments;
+	bool	overflow;
+	TrialSegment	segment[MAX_TRIAL_SEGMENTS];
+} TrialIndex;
+extern TrialIndex StepTrialIndex;
 extern char markerVisibilityString[CODA_UNITS][32];
 extern unsigned int nFrames;
 /// <summary>
@@ -100,4 +181,23 @@ extern char *massDecoder[4];
 /// A helper object for performing vector ops and DEX data ops.
 /// </summary>
 extern DexAnalogMixin	dex;
+// Applies the same filters as 'dex' to whole blocks of frames in the data buffers.
+extern DexFilterBank	filterBank;
+// For reviewing recorded data, the filtering can also be done without phase lag.
+// The filter constant entered in the GUI is a cut-off frequency in Hz for the Butterworth
+//  filter, and the half-width of the window in frames for the Savitzky-Golay filter.
+#define CAUSAL_FILTER			0
+#define ZERO_PHASE_FILTER		1
+#define BUTTERWORTH_FILTER		2
+#define SAVITZKY_GOLAY_FILTER	3
+#define FILTER_TYPES			4
+extern DexZeroPhaseFilter	zeroPhaseFilter;
+extern int filterType;
+extern char *defaultFilterParameter[FILTER_TYPES];
+// Velocity, jerk and grip force / load force coordination, computed as the buffers are filtered.
+extern DexDerivedSignals	derivedSignals;
+// Grip, load, movement, collision and slip events, detected as the frames are decoded.
+extern DexEventDetector	eventDetector;
+// Lost, duplicated and misordered RT packets, and the table of breaks in the data buffers.
+extern DexSequenceTracker	sequenceTracker;
 extern int TimebaseOffset;
\ No newline at end of file
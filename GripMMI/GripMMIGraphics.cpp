@@ -18,6 +18,7 @@
 #include "..\Useful\Useful.h"
 #include "..\Useful\fOutputDebugString.h"
 #include "..\Useful\fMessageBox.h"
+#include "..\Useful\Trace.h"
 
 // We make use of a package of plotting routines that I have had around for decades.
 #include "..\PsyPhy2dGraphicsLib\OglDisplayInterface.h"
@@ -25,6 +26,9 @@
 #include "..\PsyPhy2dGraphicsLib\Graphics.h"
 #include "..\PsyPhy2dGraphicsLib\Views.h"
 #include "..\PsyPhy2dGraphicsLib\Layouts.h"
+#include "..\PsyPhy2dGraphicsLib\SoftDisplay.h"
+#include "..\PsyPhy2dGraphicsLib\SoftTiles.h"
+#include "..\PsyPhy2dGraphicsLib\VectorDisplay.h"
 
 // Some of the raw data needs to be processed in the same way as the GRIP hardware does it.
 #include "..\Grip\DexAnalogMixin.h"
@@ -54,6 +58,18 @@ double	upperGripLimit =  40.0;
 double	lowerCopLimit =  -0.030;
 double	upperCopLimit =   0.030;
 
+double	lowerVelocityLimit = -1000.0;
+double	upperVelocityLimit =  1000.0;
+
+double	lowerJerkLimit = -50.0;
+double	upperJerkLimit =  50.0;
+
+double	lowerRatioLimit = 0.0;
+double	upperRatioLimit = 5.0;
+
+double	lowerLagLimit = - DEX_DERIVED_MAX_LAG * RT_DEFAULT_SECONDS_PER_SLICE;
+double	upperLagLimit =   DEX_DERIVED_MAX_LAG * RT_DEFAULT_SECONDS_PER_SLICE;
+
 // It is convenient to have an array of position ranges
 //  that are specific to X, Y and Z.
 // These are initialized by GripMMIDesktop::InitializeGraphics().
@@ -67,11 +83,43 @@ static struct {
 } pair[PHASEPLOTS] = { {X,Y}, {Z,Y}, {X,Z} };
 
 static int  atiColorMap[N_FORCE_TRANSDUCERS] = { CYAN, MAGENTA };
+// The same colors, for the density maps of the CoP, which are drawn in shades of each.
+static float atiDensityRGB[N_FORCE_TRANSDUCERS][3] = { { 0.0, 1.0, 1.0 }, { 1.0, 0.0, 1.0 } };
 
 //  It is useful to group the phase plots into arrays so that they can be processed in a loop.
 ::View phase_view[PHASEPLOTS];
 ::Display phase_display[PHASEPLOTS];
 
+// Histograms of the samples in the phase plots, used when the density mode is selected.
+// The VC2010 Forms classes cannot hold native arrays, so these are global as well.
+::DensityMap phase_density[PHASEPLOTS - 1];
+::DensityMap cop_density[N_FORCE_TRANSDUCERS];
+// Size of the density map bins, in screen pixels.
+#define DENSITY_BIN_PIXELS 2
+
+// The strip charts are drawn in parallel, each on its own tile of an image in memory (see SoftTiles.h).
+// There is a set of tiles for each of the collections of strip charts that can be selected.
+// Each tile has a private SoftDisplay, so the OpenGL context of the window is only used
+//  to copy the finished image to the screen, on the GUI thread.
+#define STRIPCHART_COLLECTIONS 4
+::Display stripchart_image;
+::SoftTile stripchart_tile[STRIPCHART_COLLECTIONS][STRIPCHARTS + 1];
+int stripchart_tiles[STRIPCHART_COLLECTIONS];
+typedef struct {
+	int collection;
+	int chart;
+} StripChartTile;
+StripChartTile stripchart_tile_chart[STRIPCHART_COLLECTIONS][STRIPCHARTS + 1];
+// The tile renderer calls a plain function, which calls back into the form.
+static gcroot<GripMMIDesktop ^> stripchartDesktop;
+static void DrawStripChartTile( ::View view, void *data ) {
+	StripChartTile *tile = (StripChartTile *) data;
+	stripchartDesktop->GraphStripChart( tile->collection, tile->chart, view );
+}
+// The strip charts can also be written to an SVG or PDF file, with the same layout.
+::Display stripchart_vector;
+::View stripchart_vector_view[STRIPCHART_COLLECTIONS][STRIPCHARTS + 1];
+
 // Initialize the objects used to plot the data on the screen.
 void GripMMIDesktop::InitializeGraphics( void ) {
 
@@ -161,6 +209,39 @@ void GripMMIDesktop::InitializeGraphics( void ) {
 	detailed_visibility_layout = CreateLayout( stripchart_display, 4, 1 );
 	LayoutSetDisplayEdgesRelative( detailed_visibility_layout, 0.0, 0.065, 1.0, 1.0 );
 
+	// The strip charts are drawn into an image of the same size, one tile per View.
+	stripchart_image = CreateSoftDisplay();
+	DisplaySetSizePixels( stripchart_image, StripCharts->Size.Width, StripCharts->Size.Height );
+	DisplayInit( stripchart_image );
+	DisplayFreeCache( stripchart_image );
+	for ( int collection = 0; collection < STRIPCHART_COLLECTIONS; collection++ ) {
+		::Layout layout = ( collection == 2 ? detailed_visibility_layout : stripchart_layout );
+		int charts = LayoutViews( layout );
+		for ( int chart = 0; chart <= charts; chart++ ) {
+			stripchart_tile_chart[collection][chart].collection = collection;
+			stripchart_tile_chart[collection][chart].chart = ( chart == charts ? STRIPCHARTS : chart );
+			SoftTileFromView( &stripchart_tile[collection][chart], ( chart == charts ? visibility_view : LayoutViewN( layout, chart ) ),
+								DrawStripChartTile, &stripchart_tile_chart[collection][chart] );
+		}
+		stripchart_tiles[collection] = charts + 1;
+	}
+
+	// A page of the same size, with a View in the same place as each of the tiles.
+	stripchart_vector = CreateVectorDisplay();
+	DisplaySetSizePixels( stripchart_vector, StripCharts->Size.Width, StripCharts->Size.Height );
+	DisplayInit( stripchart_vector );
+	for ( int collection = 0; collection < STRIPCHART_COLLECTIONS; collection++ ) {
+		for ( int chart = 0; chart < stripchart_tiles[collection]; chart++ ) {
+			::SoftTile *tile = &stripchart_tile[collection][chart];
+			stripchart_vector_view[collection][chart] = CreateView( stripchart_vector );
+			ViewSetDisplayEdgesRelative( stripchart_vector_view[collection][chart], tile->left, tile->bottom, tile->right, tile->top );
+		}
+	}
+
+	// Histograms for the density plots. The bins are set up the first time that they are used.
+	for ( int i = 0; i < PHASEPLOTS - 1; i++ ) phase_density[i] = CreateDensityMap();
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) cop_density[ati] = CreateDensityMap();
+
 }
 
 // The GUI has a scroll bar allowing one to look back at different parts of the data and
@@ -172,26 +253,19 @@ void GripMMIDesktop::AdjustScrollSpan( void ) {
 	int since_midnight, hour, minute, second;
 	int day_last, day_first;
 	char label[32], modifier[32];
-	unsigned long	i;
 
 	// The time span of data to plot is determined by the slider.
 	double span = windowSpanSeconds[spanSelector->Value];
 
 	// Find the time window of the available data packets.
-	// The global array RealMarkerTime[] has been filled previously.
-	min = 0.0;
-	for ( i = 0; i < nFrames; i++ ) {
-		if ( RealMarkerTime[i] != MISSING_DOUBLE ) {
-			min = RealMarkerTime[i];
-			break;
-		}
+	// The time index is kept up to date as RealMarkerTime[] is filled.
+	if ( MarkerTimeIndex.first_valid >= 0 ) {
+		min = MarkerTimeIndex.earliest;
+		max = MarkerTimeIndex.latest;
 	}
-	max = span;
-	for ( i = nFrames - 1; i >= 0; i-- ) {
-		if ( RealMarkerTime[i] != MISSING_DOUBLE ) {
-			max = RealMarkerTime[i];
-			break;
-		}
+	else {
+		min = 0.0;
+		max = span;
 	}
 	// Adjust the behavior of the scroll bar depending on the selected 
 	// time span of the data window. A large step moves a full window
@@ -232,20 +306,45 @@ void GripMMIDesktop::AdjustScrollSpan( void ) {
 // When the display is 'live' we want to be able to automatically position the scroll bar 
 // so as to display the most recent data.
 void GripMMIDesktop::MoveToLatest( void ) {
-	double latest;
-	for ( int i = nFrames - 1; i >= 0; i-- ) {
-		if ( RealMarkerTime[i] != MISSING_DOUBLE ) {
-			latest = RealMarkerTime[i];
-			break;
-		}
-	}
-	scrollBar->Value = ceil( latest );
+	if ( MarkerTimeIndex.last_valid < 0 ) return;
+	scrollBar->Value = ceil( MarkerTimeIndex.latest );
+}
+
+// Position the scroll bar so as to display the data recorded during the most recent 
+//  occurrence of the specified step. If the step fits in the data window it is centered,
+//  otherwise the window shows its beginning. Returns false if no such data was found.
+bool GripMMIDesktop::MoveToTrial( int protocol_id, int task_id, int step_id ) {
+
+	GripHealthAndStatusInfo hk;
+
+	// Make sure that the index includes the latest HK packets, even if the script crawler is not live.
+	// GetLatestGripHK() would do that too, but it would also take the new packets for itself and
+	//  the next UpdateStatus() would not show them.
+	ReadGripHK( &hk );
+	int i = FindTrialSegment( protocol_id, task_id, step_id );
+	if ( i < 0 ) return( false );
+	TrialSegment *segment = &StepTrialIndex.segment[i];
+
+	double span = windowSpanSeconds[spanSelector->Value];
+	double start = RealMarkerTime[segment->first_frame];
+	double stop = RealMarkerTime[segment->last_frame];
+	if ( start == MISSING_DOUBLE ) start = segment->start_time;
+	double right = ( stop - start < span ? stop + ( span - ( stop - start ) ) / 2.0 : start + span );
+
+	AdjustScrollSpan();
+	int value = (int) ceil( right );
+	if ( value > scrollBar->Maximum ) value = scrollBar->Maximum;
+	if ( value < scrollBar->Minimum ) value = scrollBar->Minimum;
+	scrollBar->Value = value;
+	return( true );
+
 }
 
 // Here we do the actual work of plotting the strip charts and phase plots.
 // It is assumed that the global data arrays have been filled. The time span
 // of the plots is determined by the scroll bar and span slider.
 void GripMMIDesktop::RefreshGraphics( void ) {
+	TRACE_FUNCTION();
 		
 	int since_midnight, hour, minute, second;
 	int day_last, day_first;
@@ -253,7 +352,7 @@ void GripMMIDesktop::RefreshGraphics( void ) {
 
 	unsigned long first_sample;
 	unsigned long last_sample;
-	unsigned long index;
+	int index;
 
 	fOutputDebugString( "Start RefreshGraphics().\n" );
 	DisplayActivate( stripchart_display );
@@ -284,14 +383,14 @@ void GripMMIDesktop::RefreshGraphics( void ) {
 	leftLimitTextBox->Text = gcnew String( label );
 
 	// Find the indices into the arrays that correspond to the time window.
-	for ( index = nFrames - 1; index > 0; index -- ) {
-		if ( RealMarkerTime[index] != MISSING_DOUBLE && RealMarkerTime[index] <= last_instant ) break;
-	}
-	last_sample = index;
-	for ( index = index; index > 0; index -- ) {
-		if ( RealMarkerTime[index] != MISSING_DOUBLE && RealMarkerTime[index] < first_instant ) break;
-	}
+	// The last sample is the last one at or before the end of the window and
+	//  the first sample is the one just after the last one before the start.
+	index = FindFrameBefore( last_instant, true );
+	last_sample = ( index < 0 ? 0 : index );
+	index = FindFrameBefore( first_instant, false );
 	first_sample = index + 1;
+	// Bring the filtered data up to date for the frames that will be shown.
+	FilterBuffers( first_sample, last_sample );
 	// fOutputDebugString( "Data: %d to %d Graph: %lf to %lf Indices: %d to %d (%d)\n", scrollBar->Minimum, scrollBar->Maximum, first_instant, last_instant, first_sample, last_sample, (last_sample - first_sample) );
 
 	// Subsample the data if there is a lot to be plotted.
@@ -300,56 +399,123 @@ void GripMMIDesktop::RefreshGraphics( void ) {
 	// fOutputDebugString( "Plot step: %d\n", step );
 
 	// The user can select different combinations of strip charts to plot by making a selection in a pull-down list.
-	// The following code generates the different plots depending on the selection.
-	switch ( graphCollectionComboBox->SelectedIndex ) {
+	// Each strip chart of the selection is drawn on its own tile of an image in memory, all in parallel,
+	//  and the image is then copied to the screen. See GraphStripChart() for the contents of each.
+	int collection = graphCollectionComboBox->SelectedIndex;
+	if ( collection < 0 || collection >= STRIPCHART_COLLECTIONS ) collection = 0;
+	plotCollection = collection;
+	plotFirstInstant = first_instant;
+	plotLastInstant = last_instant;
+	plotFirstSample = first_sample;
+	plotLastSample = last_sample;
+	plotStep = step;
+	autoscale = autoscaleCheckBox->Checked;
+	stripchartDesktop = this;
+	// Follow the size of the strip chart area, so that the charts are drawn at the resolution of the screen.
+	// The tiles follow the size of the image by themselves.
+	if ( SoftDisplayWidth( stripchart_image ) != StripCharts->Size.Width || SoftDisplayHeight( stripchart_image ) != StripCharts->Size.Height ) {
+		DisplaySetSizePixels( stripchart_image, StripCharts->Size.Width, StripCharts->Size.Height );
+		DisplayInit( stripchart_image );
+		DisplayFreeCache( stripchart_image );
+	}
+	Erase( stripchart_image );
+	SoftRenderTiles( stripchart_image, stripchart_tile[collection], stripchart_tiles[collection], 0 );
+	OglDrawImage( stripchart_display, SoftDisplayPixels( stripchart_image ), SoftDisplayWidth( stripchart_image ), SoftDisplayHeight( stripchart_image ) );
+	// The Views code requires a display swap to make the plots visible.
+	OglSwap( stripchart_display );
+
+	// Generate the phase plots.
+	PlotManipulandumPosition( first_instant, last_instant, first_sample, last_sample, step );
+	PlotCoP( first_instant, last_instant, first_sample, last_sample, step );
+
+	fOutputDebugString( "Finish RefreshGraphics().\n" );
+
+}
+
+// Write the strip charts that were last drawn on the screen to an SVG or PDF file, according to the
+//  extension of the filename. The Graph* routines draw straight into the VectorDisplay, which 
+//  merges and decimates the traces as it writes them, so the size of the file depends on the 
+//  width of the charts rather than on the number of samples in the window.
+bool GripMMIDesktop::ExportStripCharts( char *filename ) {
+	TRACE_FUNCTION();
+
+	int collection = plotCollection;
+
+	if ( VectorDisplayOpen( stripchart_vector, filename ) != SUCCESS ) return( false );
+	DisplaySetDefaults( stripchart_vector );
+	Erase( stripchart_vector );
+	for ( int chart = 0; chart < stripchart_tiles[collection]; chart++ ) {
+		GraphStripChart( collection, stripchart_tile_chart[collection][chart].chart, stripchart_vector_view[collection][chart] );
+	}
+	VectorDisplayFinish( stripchart_vector );
+	return( true );
+
+}
+
+// Draw one of the strip charts of a collection of them, as selected in the pull-down list, for the
+//  time window set by RefreshGraphics(). Chart number STRIPCHARTS is the visibility bar along
+//  the bottom, which is shown with all of the collections.
+void GripMMIDesktop::GraphStripChart( int collection, int chart, ::View view ) {
+
+	double first_instant = plotFirstInstant;
+	double last_instant = plotLastInstant;
+	int first_sample = plotFirstSample;
+	int last_sample = plotLastSample;
+	int step = plotStep;
+
+	if ( chart == STRIPCHARTS ) {
+		GraphVisibility( view, first_instant, last_instant, first_sample, last_sample, step );
+		return;
+	}
+	switch ( collection ) {
+	// Derived Signals Plot
+	case 3:
+		switch ( chart ) {
+		case 0: GraphVelocity( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 1: GraphJerk( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 2: GraphGripForce( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 3: GraphLoadForce( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 4: GraphGripLoadRatio( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 5: GraphGripLoadLag( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		}
+		break;
 	// Marker Visibility Plot
 	case 2:
-		GraphManipulandumPositionComponent( X, LayoutViewN( detailed_visibility_layout, 0 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphManipulandumPositionComponent( Y, LayoutViewN( detailed_visibility_layout, 1 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphManipulandumPositionComponent( Z, LayoutViewN( detailed_visibility_layout, 2 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphVisibilityDetails( LayoutViewN( detailed_visibility_layout, 3 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphVisibility( visibility_view, first_instant, last_instant, first_sample, last_sample, step );
+		if ( chart < 3 ) GraphManipulandumPositionComponent( X + chart, view, first_instant, last_instant, first_sample, last_sample, step );
+		else GraphVisibilityDetails( view, first_instant, last_instant, first_sample, last_sample, step );
 		break;
 	// Kinematics Plot
 	case 1:
-		GraphManipulandumPositionComponent( X, LayoutViewN( stripchart_layout, 0 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphManipulandumPositionComponent( Y, LayoutViewN( stripchart_layout, 1 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphManipulandumPositionComponent( Z, LayoutViewN( stripchart_layout, 2 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphAccelerationComponent( X, LayoutViewN( stripchart_layout, 3 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphAccelerationComponent( Y, LayoutViewN( stripchart_layout, 4 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphAccelerationComponent( Z, LayoutViewN( stripchart_layout, 5 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphVisibility( visibility_view, first_instant, last_instant, first_sample, last_sample, step );
+		if ( chart < 3 ) GraphManipulandumPositionComponent( X + chart, view, first_instant, last_instant, first_sample, last_sample, step );
+		else GraphAccelerationComponent( X + chart - 3, view, first_instant, last_instant, first_sample, last_sample, step );
 		break;
 	// Summary Plot
 	case 0:
 	default:
-		GraphManipulandumPosition( LayoutViewN( stripchart_layout, 0 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphManipulandumRotations( LayoutViewN( stripchart_layout, 1 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphAcceleration( LayoutViewN( stripchart_layout, 2 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphGripForce( LayoutViewN( stripchart_layout, 3 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphLoadForce( LayoutViewN( stripchart_layout, 4 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphCoP( LayoutViewN( stripchart_layout, 5 ), first_instant, last_instant, first_sample, last_sample, step );
-		GraphVisibility( visibility_view, first_instant, last_instant, first_sample, last_sample, step );
+		switch ( chart ) {
+		case 0: GraphManipulandumPosition( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 1: GraphManipulandumRotations( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 2: GraphAcceleration( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 3: GraphGripForce( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 4: GraphLoadForce( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		case 5: GraphCoP( view, first_instant, last_instant, first_sample, last_sample, step ); break;
+		}
 		break;
 	}
-	// The Views code requires a display swap to make the plots visible.
-	OglSwap( stripchart_display );
-
-	// Generate the phase plots.
-	PlotManipulandumPosition( first_instant, last_instant, first_sample, last_sample, step );
-	PlotCoP( first_instant, last_instant, first_sample, last_sample, step );
-
-	fOutputDebugString( "Finish RefreshGraphics().\n" );
 
 }
 
 // Clean up resources allocated by the Views system.
 void GripMMIDesktop::KillGraphics( void ) {
 
+	for ( int i = 0; i < PHASEPLOTS - 1; i++ ) DestroyDensityMap( phase_density[i] );
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) DestroyDensityMap( cop_density[ati] );
 	Close( cop_display );
 	Close( xy_display );
 	Close( zy_display );
 	Close( stripchart_display );
+	Close( stripchart_image );
+	Close( stripchart_vector );
 
 }
 
@@ -370,11 +536,32 @@ void GripMMIDesktop::KillGraphics( void ) {
 // of vectors. The sizeof() macro is used to compute the distance in bytes between elements in the array.
 
 // The plotting routines also take a "missing value" flag. Data that is set to this value will not be plotted. This
-//  is used to mark breaks in the data stream.
+//  is used to mark values that were not measured, for instance when the manipulandum is hidden.
 
 // In the following method names, 'Graph...' refers to a stripchart, while 'Plot...' refers to a phase plot.
 
+// The data buffers hold the frames from all the packets back to back. Where the stream of packets 
+//  was broken, the sequence tracker has a note of the first frame after the break. Each stretch of 
+//  frames between two breaks is plotted separately, so that no line is drawn across a break, whatever
+//  the subsampling. 
+typedef void (*XYPlotFunction)( ::View view, double *xarray, double *yarray, int start, int end, int step, unsigned xsize, unsigned ysize, double na );
+static void PlotBetweenBreaks( XYPlotFunction plot, ::View view, double *xarray, double *yarray, int start_frame, int stop_frame, int step, unsigned xsize, unsigned ysize ) {
+	TRACE_FUNCTION();
+
+	const int *break_frame = sequenceTracker.GapFrames();
+	int n_breaks = sequenceTracker.Gaps();
+	int first = start_frame;
+
+	for ( int i = sequenceTracker.FindGapAfter( start_frame + 1 ); i < n_breaks && break_frame[i] <= stop_frame; i++ ) {
+		plot( view, xarray, yarray, first, break_frame[i] - 1, step, xsize, ysize, MISSING_DOUBLE );
+		first = break_frame[i];
+	}
+	plot( view, xarray, yarray, first, stop_frame, step, xsize, ysize, MISSING_DOUBLE );
+
+}
+
 void GripMMIDesktop::GraphManipulandumPosition( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 			
 	double range;
 
@@ -388,7 +575,8 @@ void GripMMIDesktop::GraphManipulandumPosition( ::View view, double start_instan
 	//  but I want the range of values to be common to all three so that magnitudes of movement
 	//  can be compared between X, Y and Z.
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		// Find the common range.
 		range = 0.0;
 		for ( int i = X; i <= Z; i++ ) {
@@ -400,7 +588,8 @@ void GripMMIDesktop::GraphManipulandumPosition( ::View view, double start_instan
 	ViewAxes( view );
 	for ( int i = X; i <= Z; i++ ) {
 		ViewSelectColor( view, i );
-		if ( autoscaleCheckBox->Checked ) {
+		if ( autoscale ) {
+			TRACE_SCOPE( "AutoScale" );
 			// Autoscale each component to center each trace on its respective mean.
 			ViewAutoScaleInit( view );
 			ViewAutoScaleAvailableDoubles( view, &ManipulandumPosition[0][i], start_frame, stop_frame, sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
@@ -412,12 +601,15 @@ void GripMMIDesktop::GraphManipulandumPosition( ::View view, double start_instan
 			ViewSetYLimits( view, lowerPositionLimit, upperPositionLimit );
 		}
 		// Actually plot the data.
-		ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &ManipulandumPosition[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &ManipulandumPosition[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumPosition ) );
 	}
+	// Show the start of each movement.
+	MarkEvents( view, DEX_MOVE_ON, GREY4, -1, start_instant, stop_instant );
 
 }
 
 void GripMMIDesktop::GraphManipulandumPositionComponent( int component, ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 			
 	char *title;
 
@@ -432,17 +624,19 @@ void GripMMIDesktop::GraphManipulandumPositionComponent( int component, ::View v
 	}
 	ViewTitle( view, title, INSIDE_RIGHT, INSIDE_TOP, 0.0 );
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		ViewAutoScaleAvailableDoubles( view, &ManipulandumPosition[0][component], start_frame, stop_frame, sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
 	}
 	else ViewSetYLimits( view, lowerPositionLimit, upperPositionLimit );
 	ViewAxes( view );
 	ViewSelectColor( view, component );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &ManipulandumPosition[0][component], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &ManipulandumPosition[0][component], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumPosition ) );
 }
 
 void GripMMIDesktop::GraphAccelerationComponent( int component, ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 			
 	char *title;
 
@@ -458,17 +652,112 @@ void GripMMIDesktop::GraphAccelerationComponent( int component, ::View view, dou
 	ViewTitle( view, title, INSIDE_RIGHT, INSIDE_TOP, 0.0 );
 
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		ViewAutoScaleAvailableDoubles( view, &Acceleration[0][component], start_frame, stop_frame, sizeof( *Acceleration ), MISSING_DOUBLE );
 	}
 	else ViewSetYLimits( view, lowerAccelerationLimit, upperAccelerationLimit );
 	ViewAxes( view );
 	ViewSelectColor( view, component );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &Acceleration[0][component], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *Acceleration ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &Acceleration[0][component], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *Acceleration ) );
+}
+
+void GripMMIDesktop::GraphVelocity( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
+
+	ViewColor( view, GREY6 );
+	ViewBox( view );
+	ViewColor( view, BLACK );
+	ViewTitle( view, "Manipulandum Velocity ", INSIDE_RIGHT, INSIDE_TOP, 0.0 );
+
+	// Plot all 3 components of the velocity in a single view;
+	ViewSetXLimits( view, start_instant, stop_instant );
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
+		ViewAutoScaleInit( view );
+		for ( int i = X; i <= Z; i++ ) ViewAutoScaleAvailableDoubles( view, &ManipulandumVelocity[0][i], start_frame, stop_frame, sizeof( *ManipulandumVelocity ), MISSING_DOUBLE );
+		ViewAutoScaleExpand( view, 0.01 );
+	}
+	else ViewSetYLimits( view, lowerVelocityLimit, upperVelocityLimit );
+	ViewAxes( view );
+	ViewHorizontalLine( view, 0.0 );
+	for ( int i = X; i <= Z; i++ ) {
+		ViewSelectColor( view, i );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &ManipulandumVelocity[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumVelocity ) );
+	}
+}
+
+void GripMMIDesktop::GraphJerk( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
+
+	ViewColor( view, GREY6 );
+	ViewBox( view );
+	ViewColor( view, BLACK );
+	ViewTitle( view, "Jerk ", INSIDE_RIGHT, INSIDE_TOP, 0.0 );
+
+	// Plot all 3 components of the jerk in a single view;
+	ViewSetXLimits( view, start_instant, stop_instant );
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
+		ViewAutoScaleInit( view );
+		for ( int i = X; i <= Z; i++ ) ViewAutoScaleAvailableDoubles( view, &Jerk[0][i], start_frame, stop_frame, sizeof( *Jerk ), MISSING_DOUBLE );
+		ViewAutoScaleExpand( view, 0.01 );
+	}
+	else ViewSetYLimits( view, lowerJerkLimit, upperJerkLimit );
+	ViewAxes( view );
+	ViewHorizontalLine( view, 0.0 );
+	for ( int i = X; i <= Z; i++ ) {
+		ViewSelectColor( view, i );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &Jerk[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *Jerk ) );
+	}
+}
+
+void GripMMIDesktop::GraphGripLoadRatio( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
+
+	ViewColor( view, GREY6 );
+	ViewBox( view );
+	ViewColor( view, BLACK );
+	ViewTitle( view, "GF/LF Ratio ", INSIDE_RIGHT, INSIDE_TOP, 0.0 );
+
+	ViewSetXLimits( view, start_instant, stop_instant );
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
+		ViewAutoScaleInit( view );
+		ViewAutoScaleAvailableDoubles( view, &GripLoadRatio[0], start_frame, stop_frame, sizeof( *GripLoadRatio ), MISSING_DOUBLE );
+		ViewAutoScaleExpand( view, 0.01 );
+	}
+	else ViewSetYLimits( view, lowerRatioLimit, upperRatioLimit );
+	ViewAxes( view );
+	// Ratio of 1 for reference.
+	if ( view->user_top > 1.0 && view->user_bottom < 1.0 ) ViewHorizontalLine( view, 1.0 );
+	ViewColor( view, GREEN );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &GripLoadRatio[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *GripLoadRatio ) );
+
+}
+
+// The lag is positive when changes in grip force follow changes in load force.
+void GripMMIDesktop::GraphGripLoadLag( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
+
+	ViewColor( view, GREY6 );
+	ViewBox( view );
+	ViewColor( view, BLACK );
+	ViewTitle( view, "GF/LF Lag (s) ", INSIDE_RIGHT, INSIDE_TOP, 0.0 );
+
+	// The range of possible lags is known, so there is no need to autoscale.
+	ViewSetXLimits( view, start_instant, stop_instant );
+	ViewSetYLimits( view, lowerLagLimit, upperLagLimit );
+	ViewAxes( view );
+	ViewHorizontalLine( view, 0.0 );
+	ViewColor( view, MAGENTA );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &GripLoadLag[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *GripLoadLag ) );
+
 }
 
 void GripMMIDesktop::GraphManipulandumRotations( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 
 	ViewColor( view, GREY6 );
 	ViewBox( view );
@@ -477,7 +766,8 @@ void GripMMIDesktop::GraphManipulandumRotations( ::View view, double start_insta
 
 	// Plot all 3 components of the manipulandum rotation in the same view;
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		for ( int i = X; i <= Z; i++ ) ViewAutoScaleAvailableDoubles( view, &ManipulandumRotations[0][i], start_frame, stop_frame, sizeof( *ManipulandumRotations ), MISSING_DOUBLE );
 		ViewAutoScaleExpand( view, 0.01 );
@@ -486,12 +776,13 @@ void GripMMIDesktop::GraphManipulandumRotations( ::View view, double start_insta
 	ViewAxes( view );
 	for ( int i = X; i <= Z; i++ ) {
 		ViewSelectColor( view, i );
-		ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &ManipulandumRotations[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumRotations ), MISSING_DOUBLE );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &ManipulandumRotations[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumRotations ) );
 	}
 }
 
 
 void GripMMIDesktop::GraphLoadForce( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
 	
 	int i;
 	
@@ -502,7 +793,8 @@ void GripMMIDesktop::GraphLoadForce( ::View view, double start_instant, double s
 
 	// Plot all 3 components of the load force in the same view;
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		for ( int i = X; i <= Z; i++ ) ViewAutoScaleAvailableDoubles( view, &LoadForce[0][i], start_frame, stop_frame, sizeof( *LoadForce ), MISSING_DOUBLE );
 		ViewAutoScaleAvailableDoubles( view, &LoadForceMagnitude[0], start_frame, stop_frame, sizeof( *LoadForceMagnitude ), MISSING_DOUBLE );
@@ -516,13 +808,14 @@ void GripMMIDesktop::GraphLoadForce( ::View view, double start_instant, double s
 	if ( view->user_bottom < -4.0 ) ViewHorizontalLine( view, -4.0 );
 	for ( i = X; i <= Z; i++ ) {
 		ViewSelectColor( view, i );
-		ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &LoadForce[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *LoadForce ), MISSING_DOUBLE );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &LoadForce[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *LoadForce ) );
 	}
 	ViewSelectColor( view, i );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &LoadForceMagnitude[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *LoadForceMagnitude ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &LoadForceMagnitude[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *LoadForceMagnitude ) );
 
 }
 void GripMMIDesktop::GraphAcceleration( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
 
 	ViewColor( view, GREY6 );
 	ViewBox( view );
@@ -531,7 +824,8 @@ void GripMMIDesktop::GraphAcceleration( ::View view, double start_instant, doubl
 
 	// Plot all 3 components of the acceleration in a single view;
 	ViewSetXLimits( view, start_instant, stop_instant );
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		for ( int i = X; i <= Z; i++ ) ViewAutoScaleAvailableDoubles( view, &Acceleration[0][i], start_frame, stop_frame, sizeof( *Acceleration ), MISSING_DOUBLE );
 		ViewAutoScaleExpand( view, 0.01 );
@@ -540,11 +834,14 @@ void GripMMIDesktop::GraphAcceleration( ::View view, double start_instant, doubl
 	ViewAxes( view );	
 	for ( int i = 0; i < 3; i++ ) {
 		ViewSelectColor( view, i );
-		ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &Acceleration[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *Acceleration ), MISSING_DOUBLE );
+		PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &Acceleration[0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *Acceleration ) );
 	}
+	// Show possible collisions.
+	MarkEvents( view, DEX_COLLISION, RED, -1, start_instant, stop_instant );
 }
 
 void GripMMIDesktop::GraphGripForce( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
 
 	ViewColor( view, GREY6 );
 	ViewBox( view );
@@ -555,7 +852,8 @@ void GripMMIDesktop::GraphGripForce( ::View view, double start_instant, double s
 	ViewSetYLimits( view, lowerGripLimit, upperGripLimit );
 	ViewAxes( view );
 
-	if ( autoscaleCheckBox->Checked ) {
+	if ( autoscale ) {
+		TRACE_SCOPE( "AutoScale" );
 		ViewAutoScaleInit( view );
 		ViewAutoScaleAvailableDoubles( view, &GripForce[0], start_frame, stop_frame, sizeof( *GripForce ), MISSING_DOUBLE );
 		ViewAutoScaleAvailableDoubles( view, &NormalForce[LEFT_ATI][0], start_frame, stop_frame, sizeof( *NormalForce[LEFT_ATI] ), MISSING_DOUBLE );
@@ -564,15 +862,39 @@ void GripMMIDesktop::GraphGripForce( ::View view, double start_instant, double s
 	}
 
 	ViewColor( view, atiColorMap[LEFT_ATI] );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &NormalForce[LEFT_ATI][0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *NormalForce[LEFT_ATI] ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &NormalForce[LEFT_ATI][0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *NormalForce[LEFT_ATI] ) );
 	ViewColor( view, atiColorMap[RIGHT_ATI] );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &NormalForce[RIGHT_ATI][0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *NormalForce[LEFT_ATI] ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &NormalForce[RIGHT_ATI][0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *NormalForce[LEFT_ATI] ) );
 	ViewColor( view, GREEN );
-	ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &GripForce[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *GripForce ), MISSING_DOUBLE );
+	PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &RealMarkerTime[0], &GripForce[0], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *GripForce ) );
+
+	// Show where the object was grasped and released, the peak of each grip and any slips.
+	MarkEvents( view, DEX_GRIP_ON, GREY4, -1, start_instant, stop_instant );
+	MarkEvents( view, DEX_GRIP_OFF, GREY6, -1, start_instant, stop_instant );
+	MarkEvents( view, DEX_GRIP_PEAK, RED, SYMBOL_X, start_instant, stop_instant );
+	MarkEvents( view, DEX_SLIP, MAGENTA, SYMBOL_STAR, start_instant, stop_instant );
+
+}
+
+// Mark the events of one type that fall in the time window, either with a vertical line
+//  (symbol < 0) or with a symbol at the height of the value associated with the event.
+// The events are found by bisection in the event list, so this does not depend on how
+//  much data there is.
+void GripMMIDesktop::MarkEvents( ::View view, int type, int color, int symbol, double start_instant, double stop_instant ) {
+	TRACE_FUNCTION();
+
+	ViewColor( view, color );
+	for ( int i = eventDetector.FindEventAfter( type, start_instant ); i < eventDetector.Events( type ); i++ ) {
+		DexEvent *event = eventDetector.Event( type, i );
+		if ( event->time > stop_instant ) break;
+		if ( symbol < 0 ) ViewVerticalLine( view, event->time );
+		else if ( event->value != MISSING_DOUBLE ) ViewSymbol( view, event->time, event->value, symbol );
+	}
 
 }
 
 void GripMMIDesktop::GraphVisibility( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
 
 	ViewColor( view, GREY6 );
 	ViewBox( view );
@@ -583,17 +905,18 @@ void GripMMIDesktop::GraphVisibility( ::View view, double start_instant, double
 	ViewSetYLimits( view, lowerVisibilityLimit, upperVisibilityLimit );
 
 	ViewColor( view, BLACK );
-	ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], &PacketReceived[0],  start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *PacketReceived ), MISSING_DOUBLE );
+	PlotVisibilityRuns( view, &PacketReceivedRuns, &PacketReceived[0], sizeof( *PacketReceived ), start_frame, stop_frame, step );
 	ViewColor( view, RED );
-	ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], &ManipulandumVisibility[0],  start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *ManipulandumVisibility ), MISSING_DOUBLE );
+	PlotVisibilityRuns( view, &ManipulandumVisibilityRuns, &ManipulandumVisibility[0], sizeof( *ManipulandumVisibility ), start_frame, stop_frame, step );
 	ViewColor( view, GREEN );
-	ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], &FrameVisibility[0],  start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *FrameVisibility ), MISSING_DOUBLE );
+	PlotVisibilityRuns( view, &FrameVisibilityRuns, &FrameVisibility[0], sizeof( *FrameVisibility ), start_frame, stop_frame, step );
 	ViewColor( view, BLUE );
-	ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], &WristVisibility[0],  start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *WristVisibility ), MISSING_DOUBLE );
+	PlotVisibilityRuns( view, &WristVisibilityRuns, &WristVisibility[0], sizeof( *WristVisibility ), start_frame, stop_frame, step );
 
 }
 
 void GripMMIDesktop::GraphVisibilityDetails( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
 
 	int mrk;
 
@@ -615,11 +938,25 @@ void GripMMIDesktop::GraphVisibilityDetails( ::View view, double start_instant,
 	//  such that the traces are spread out and grouped in the view.
 	for ( mrk = 0; mrk < CODA_MARKERS; mrk++ ) {
 		ViewSelectColor( view, mrk );
-		ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], &MarkerVisibility[0][mrk], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *MarkerVisibility ), MISSING_DOUBLE );
+		PlotVisibilityRuns( view, &MarkerVisibilityRuns[mrk], &MarkerVisibility[0][mrk], sizeof( *MarkerVisibility ), start_frame, stop_frame, step );
 	}
 }
 
+// Plot one bar for each run of frames where the visibility flag is set.
+// This looks the same as a square at each frame, but costs almost nothing
+//  because visibility does not change very often. Runs are drawn in full,
+//  so a short dropout is visible even when the other plots are subsampled.
+// If there were too many runs to store, fall back to plotting the frames.
+void GripMMIDesktop::PlotVisibilityRuns( ::View view, VisibilityRuns *runs, double *visibility, unsigned int size, int start_frame, int stop_frame, int step ) {
+	TRACE_FUNCTION();
+
+	if ( runs->overflow ) ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &RealMarkerTime[0], visibility, start_frame, stop_frame, step, sizeof( *RealMarkerTime ), size, MISSING_DOUBLE );
+	else ViewPlotRuns( view, &RealMarkerTime[0], sizeof( *RealMarkerTime ), runs->run, runs->n_runs, runs->value, start_frame, stop_frame );
+
+}
+
 void GripMMIDesktop::GraphCoP( ::View view, double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 
 	ViewColor( view, GREY6 );
 	ViewBox( view );
@@ -635,13 +972,14 @@ void GripMMIDesktop::GraphCoP( ::View view, double start_instant, double stop_in
 	for ( int ati = 0; ati < 2; ati++ ) {
 		for ( int i = X; i <= Z; i++ ) {
 			ViewSelectColor( view, 3 * ati + i );
-			ViewXYPlotClippedDoubles( view, &RealMarkerTime[0], &CenterOfPressure[ati][0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *CenterOfPressure[ati] ), MISSING_DOUBLE );
+			PlotBetweenBreaks( ViewXYPlotClippedDoubles, view, &RealMarkerTime[0], &CenterOfPressure[ati][0][i], start_frame, stop_frame, step, sizeof( *RealMarkerTime ), sizeof( *CenterOfPressure[ati] ) );
 		}
 	}
 }
 
 // Phase plots of Manipulandum position data.
 void GripMMIDesktop::PlotManipulandumPosition( double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 
 	::View view;
 
@@ -655,13 +993,38 @@ void GripMMIDesktop::PlotManipulandumPosition( double start_instant, double stop
 		ViewMakeSquare( view );
 		ViewSelectColor( view, i );
 		// ViewBox( view );
-		if ( stop_frame > start_frame ) ViewXYPlotAvailableDoubles( view, &ManipulandumPosition[0][pair[i].abscissa], &ManipulandumPosition[0][pair[i].ordinate], start_frame, stop_frame, step, sizeof( *ManipulandumPosition ), sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
+		if ( stop_frame > start_frame ) {
+			if ( densityCheckBox->Checked ) {
+				// Count the samples into bins rather than drawing each one.
+				// Only the frames that have entered or left the window since the last time are processed.
+				SetDensityGrid( phase_density[i], view );
+				DensityMapTrackDoubles( phase_density[i], &ManipulandumPosition[0][pair[i].abscissa], &ManipulandumPosition[0][pair[i].ordinate], start_frame, stop_frame, sizeof( *ManipulandumPosition ), sizeof( *ManipulandumPosition ), MISSING_DOUBLE );
+				ViewPlotDensityMap( view, phase_density[i] );
+			}
+			else PlotBetweenBreaks( ViewXYPlotAvailableDoubles, view, &ManipulandumPosition[0][pair[i].abscissa], &ManipulandumPosition[0][pair[i].ordinate], start_frame, stop_frame, step, sizeof( *ManipulandumPosition ), sizeof( *ManipulandumPosition ) );
+		}
 		OglSwap( phase_display[i] );
 	}
 }
 
+// Set the bins of a density map to cover the view at DENSITY_BIN_PIXELS per bin.
+// If the view has changed, the map is emptied and will be filled again from scratch.
+void GripMMIDesktop::SetDensityGrid( ::DensityMap map, ::View view ) {
+	int x_bins = (int) fabs( view->display_right - view->display_left ) / DENSITY_BIN_PIXELS;
+	int y_bins = (int) fabs( view->display_top - view->display_bottom ) / DENSITY_BIN_PIXELS;
+	DensityMapSetGrid( map, x_bins, y_bins, view->user_left, view->user_bottom, view->user_right, view->user_top );
+}
+
+// The maps assume that the data in the frames that they have already counted does not change.
+// Call this when it does, for instance when FilterBuffers() filters frames over again.
+void GripMMIDesktop::ClearDensityMaps( void ) {
+	for ( int i = 0; i < PHASEPLOTS - 1; i++ ) if ( phase_density[i] ) DensityMapClear( phase_density[i] );
+	for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) if ( cop_density[ati] ) DensityMapClear( cop_density[ati] );
+}
+
 // Phase plots of center-of-pressure data.
 void GripMMIDesktop::PlotCoP( double start_instant, double stop_instant, int start_frame, int stop_frame, int step ){
+	TRACE_FUNCTION();
 
 	::View view;
 
@@ -673,7 +1036,15 @@ void GripMMIDesktop::PlotCoP( double start_instant, double stop_instant, int sta
 	ViewMakeSquare( view );
 
 	// Plot the history of CoPs within the selected time window.
-	if ( stop_frame > start_frame ) {
+	if ( stop_frame > start_frame && densityCheckBox->Checked ) {
+		for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+			SetDensityGrid( cop_density[ati], view );
+			DensityMapTrackDoubles( cop_density[ati], &CenterOfPressure[ati][0][Z], &CenterOfPressure[ati][0][Y], start_frame, stop_frame, sizeof( *CenterOfPressure[ati] ), sizeof( *CenterOfPressure[ati] ), MISSING_FLOAT );
+			// Each ATI in its own color, so that the two can be told apart where they overlap.
+			ViewPlotDensityMapRGB( view, cop_density[ati], atiDensityRGB[ati][0], atiDensityRGB[ati][1], atiDensityRGB[ati][2] );
+		}
+	}
+	else if ( stop_frame > start_frame ) {
 		ViewColor( view, atiColorMap[RIGHT_ATI] );
 		ViewScatterPlotAvailableDoubles( view, SYMBOL_FILLED_SQUARE, &CenterOfPressure[RIGHT_ATI][0][Z], &CenterOfPressure[RIGHT_ATI][0][Y], start_frame, stop_frame, step, sizeof( *CenterOfPressure[RIGHT_ATI] ), sizeof( *CenterOfPressure[RIGHT_ATI] ), MISSING_FLOAT );
 		ViewColor( view, atiColorMap[LEFT_ATI] );
@@ -16,6 +16,10 @@
 
 #include "..\Grip\GripPackets.h"
 #include "..\Grip\DexAnalogMixin.h"
+#include "..\Grip\DexZeroPhaseFilter.h"
+#include "..\Grip\DexDerivedSignals.h"
+#include "..\Grip\DexEventDetector.h"
+#include "..\Grip\DexSequenceTracker.h"
 #include "GripMMIGlobals.h"
 #include "GripMMIStartup.h"
 
@@ -0,0 +1,663 @@
+///
+/// Module:	GripMMIBenchmarks (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Benchmarks of the code paths that limit how fast the GripMMI can keep up with the data:
+///  encoding and decoding of the packets, reading the whole packet cache into the data buffers
+///  as GetGripRT() does, filtering the buffers and plotting them.
+///
+/// The packets come from GripPacketGenerator, so every run sees the same data. The plots are
+///  drawn into a SoftDisplay, so no window is needed.
+///
+/// The command line and the output follow the conventions of Google Benchmark, so that the
+///  results can be compared and tracked across commits with the same tools:
+///
+///  --benchmark_filter=<text>		Run only the benchmarks whose name contains <text>.
+///  --benchmark_min_time=<s>		Repeat each benchmark for at least this many seconds (default 0.5).
+///  --benchmark_out=<file>			Also write the results to <file>.
+///  --benchmark_out_format=json	Format of that file. JSON is the only format.
+///  --benchmark_format=console|json	Format of the results on stdout.
+///  --benchmark_list_tests			List the benchmarks without running them.
+///  --benchmark_cache=<root>		Root of the packet cache files generated for the ingest benchmarks.
+///									They are deleted at the end.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include "../Useful/Portability.h"
+#endif
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/GripPackets.h"
+#include "../Grip/GripPacketGenerator.h"
+#include "../Grip/DexAnalogMixin.h"
+#include "../Grip/DexSequenceTracker.h"
+#include "../Grip/DexZeroPhaseFilter.h"
+#include "../Grip/DexDerivedSignals.h"
+#include "../Grip/DexEventDetector.h"
+#include "../GripMMI/GripMMIGlobals.h"
+#include "../GripMMI/GripMMIBuffers.h"
+#include "../GripMMIVersionControl/GripMMIVersionControl.h"
+
+#include "../PsyPhy2dGraphicsLib/Graphics.h"
+#include "../PsyPhy2dGraphicsLib/Displays.h"
+#include "../PsyPhy2dGraphicsLib/Views.h"
+#include "../PsyPhy2dGraphicsLib/SoftDisplay.h"
+
+// Size of the strip charts in the GripMMI, more or less.
+#define PLOT_WIDTH		1200
+#define PLOT_HEIGHT		300
+
+// Number of packets encoded or decoded in each iteration of the packet benchmarks.
+#define PACKET_BATCH	1024
+
+/*********************************************************************************/
+
+// What a benchmark routine needs to know and what it reports back.
+// The routine sets up what it needs, then brackets the loop over the iterations with
+//  BenchmarkStart() and BenchmarkStop(), so that only the loop is timed.
+typedef struct {
+	int			iterations;
+	int			arg;
+	double		items;		// Items and bytes processed over all the iterations, if it makes sense.
+	double		bytes;
+	LARGE_INTEGER	realStart;
+	clock_t		cpuStart;
+	double		realTime;	// Seconds.
+	double		cpuTime;
+} BenchmarkState;
+
+typedef void ( *BenchmarkRoutine )( BenchmarkState *state );
+
+typedef struct {
+	const char			*name;
+	BenchmarkRoutine	routine;
+	int					arg;
+	bool				hasArg;
+	const char			*unit;		// Time unit in which the results are shown: ns, us or ms.
+} Benchmark;
+
+static double performanceFrequency = 0.0;
+
+void BenchmarkStart( BenchmarkState *state ) {
+	state->cpuStart = clock();
+	QueryPerformanceCounter( &state->realStart );
+}
+
+void BenchmarkStop( BenchmarkState *state ) {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+	state->cpuTime = (double) ( clock() - state->cpuStart ) / (double) CLOCKS_PER_SEC;
+	state->realTime = (double) ( now.QuadPart - state->realStart.QuadPart ) / performanceFrequency;
+}
+
+/*********************************************************************************/
+
+// Packets to be decoded, or decoded values to be encoded, shared by the packet benchmarks.
+static EPMTelemetryPacket		rtPackets[PACKET_BATCH];
+static GripRealtimeDataInfo		rtValues[PACKET_BATCH];
+static EPMTelemetryPacket		hkPackets[PACKET_BATCH];
+static GripHealthAndStatusInfo	hkValues[PACKET_BATCH];
+static bool						packetsGenerated = false;
+
+static void GeneratePackets( void ) {
+
+	GripPacketGenerator generator( 1 );
+	EPMTelemetryHeaderInfo header;
+	GripRealtimeDataInfo rt;
+	GripHealthAndStatusInfo hk;
+	int n_rt = 0, n_hk = 0;
+
+	if ( packetsGenerated ) return;
+	generator.hkInterval = 1;
+	generator.Reset();
+	while ( n_rt < PACKET_BATCH || n_hk < PACKET_BATCH ) {
+		int type = generator.Next( &header, &rt, &hk );
+		if ( type == GRIP_RT_ID && n_rt < PACKET_BATCH ) {
+			rtValues[n_rt] = rt;
+			InsertEPMTelemetryHeaderInfo( &rtPackets[n_rt], &header );
+			InsertGripRealtimeDataInfo( &rtPackets[n_rt], &rt );
+			n_rt++;
+		}
+		else if ( type == GRIP_HK_ID && n_hk < PACKET_BATCH ) {
+			hkValues[n_hk] = hk;
+			InsertEPMTelemetryHeaderInfo( &hkPackets[n_hk], &header );
+			InsertGripHealthAndStatusInfo( &hkPackets[n_hk], &hk );
+			n_hk++;
+		}
+	}
+	packetsGenerated = true;
+
+}
+
+static void BM_InsertRealtime( BenchmarkState *state ) {
+	static EPMTelemetryPacket packet;
+	GeneratePackets();
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( int p = 0; p < PACKET_BATCH; p++ ) InsertGripRealtimeDataInfo( &packet, &rtValues[p] );
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * PACKET_BATCH;
+	state->bytes = state->items * rtPacketLengthInBytes;
+}
+
+static void BM_ExtractRealtime( BenchmarkState *state ) {
+	static GripRealtimeDataInfo rt;
+	GeneratePackets();
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( int p = 0; p < PACKET_BATCH; p++ ) ExtractGripRealtimeDataInfo( &rt, &rtPackets[p] );
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * PACKET_BATCH;
+	state->bytes = state->items * rtPacketLengthInBytes;
+}
+
+static void BM_InsertHealthAndStatus( BenchmarkState *state ) {
+	static EPMTelemetryPacket packet;
+	GeneratePackets();
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( int p = 0; p < PACKET_BATCH; p++ ) InsertGripHealthAndStatusInfo( &packet, &hkValues[p] );
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * PACKET_BATCH;
+	state->bytes = state->items * hkPacketLengthInBytes;
+}
+
+static void BM_ExtractHealthAndStatus( BenchmarkState *state ) {
+	static GripHealthAndStatusInfo hk;
+	GeneratePackets();
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( int p = 0; p < PACKET_BATCH; p++ ) ExtractGripHealthAndStatusInfo( &hk, &hkPackets[p] );
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * PACKET_BATCH;
+	state->bytes = state->items * hkPacketLengthInBytes;
+}
+
+/*********************************************************************************/
+
+// The packet cache files, one set per simulated duration in hours.
+static const char *cacheRoot = "GripMMIBenchmarkCache";
+#define MAX_CACHE_HOURS	12
+static bool cacheWritten[MAX_CACHE_HOURS + 1];
+static int  cachePackets[MAX_CACHE_HOURS + 1];
+
+static void CacheFileRoot( char *root, int hours ) {
+	sprintf( root, "%s%02dh", cacheRoot, hours );
+}
+
+// Simulate the given number of hours of continuous acquisition. Without the pauses between
+//  epochs, 12 hours fill the buffers of the GripMMI exactly.
+static void WriteCache( int hours ) {
+
+	char root[MAX_PATHLENGTH];
+
+	if ( cacheWritten[hours] ) return;
+	GripPacketGenerator generator( 1 );
+	generator.epochPause = 0.0;
+	CacheFileRoot( root, hours );
+	cachePackets[hours] = generator.WriteCacheFiles( root, hours * 60.0 * 60.0 );
+	cacheWritten[hours] = true;
+
+}
+
+static void DeleteCaches( void ) {
+
+	char root[MAX_PATHLENGTH];
+	char filename[MAX_PATHLENGTH];
+
+	for ( int hours = 0; hours <= MAX_CACHE_HOURS; hours++ ) {
+		if ( !cacheWritten[hours] ) continue;
+		CacheFileRoot( root, hours );
+		CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_RT_SCIENCE_PACKET, root );
+		remove( filename );
+		CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_HK_BULK_PACKET, root );
+		remove( filename );
+		CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_UNKNOWN_PACKET, root );
+		remove( filename );
+	}
+
+}
+
+static void BM_GenerateCacheFiles( BenchmarkState *state ) {
+
+	char root[MAX_PATHLENGTH];
+	GripPacketGenerator generator( 1 );
+	int packets = 0;
+
+	generator.epochPause = 0.0;
+	CacheFileRoot( root, 0 );
+	cacheWritten[0] = true;
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) packets += generator.WriteCacheFiles( root, state->arg * 60.0 * 60.0 );
+	BenchmarkStop( state );
+	state->items = packets;
+	state->bytes = (double) packets * rtPacketLengthInBytes;
+
+}
+
+/*********************************************************************************/
+
+// The data buffers are those of the GripMMI (GripMMIGlobals.cpp) and they are filled by the
+//  same StoreGripRT() (GripMMIBuffers.cpp), visibility runs, time index and events included.
+static int ingestedHours = -1;
+
+// Read a whole RT packet cache into the buffers, the way GetGripRT() does: one _read() per packet.
+// Returns the number of packets read.
+static int IngestCache( int hours ) {
+
+	char root[MAX_PATHLENGTH];
+	char filename[MAX_PATHLENGTH];
+	EPMTelemetryPacket		packet;
+	EPMTelemetryHeaderInfo	epmHeader;
+	GripRealtimeDataInfo	rt;
+	int fid;
+	int packets_read = 0;
+
+	CacheFileRoot( root, hours );
+	CreateGripPacketCacheFilename( filename, sizeof( filename ), GRIP_RT_SCIENCE_PACKET, root );
+	if ( _sopen_s( &fid, filename, _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IWRITE | _S_IREAD ) ) {
+		fprintf( stderr, "Error opening packet file %s.\n", filename );
+		exit( -1 );
+	}
+
+	ResetBuffers();
+	while ( nFrames < MAX_FRAMES ) {
+		int bytes_read = _read( fid, &packet, rtPacketLengthInBytes );
+		if ( bytes_read < 0 ) {
+			fprintf( stderr, "Error reading from %s.\n", filename );
+			exit( -1 );
+		}
+		if ( rtPacketLengthInBytes != bytes_read ) break;
+		packets_read++;
+		ExtractEPMTelemetryHeaderInfo( &epmHeader, &packet );
+		if ( epmHeader.epmSyncMarker != EPM_TELEMETRY_SYNC_VALUE || epmHeader.TMIdentifier != GRIP_RT_ID ) {
+			fprintf( stderr, "Unrecognized packet from %s.\n", filename );
+			exit( -1 );
+		}
+		ExtractGripRealtimeDataInfo( &rt, &packet );
+		StoreGripRT( &rt, epmHeader.TMCounter );
+	}
+	_close( fid );
+	dex.QuaternionsToCannonicalRotations( RawManipulandumRotations, RawManipulandumQuaternion, nFrames );
+	ingestedHours = hours;
+	return( packets_read );
+
+}
+
+// Make sure that the buffers hold the given number of hours of data, for the benchmarks that use them.
+static void IngestHours( int hours ) {
+	if ( ingestedHours == hours ) return;
+	WriteCache( hours );
+	IngestCache( hours );
+}
+
+static void BM_IngestRT( BenchmarkState *state ) {
+
+	int packets = 0;
+
+	WriteCache( state->arg );
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) packets += IngestCache( state->arg );
+	BenchmarkStop( state );
+	state->items = packets;
+	state->bytes = (double) packets * rtPacketLengthInBytes;
+
+}
+
+/*********************************************************************************/
+
+// The per-sample filters, called for every frame of one hour of data as the GripMMI once did.
+static void BM_AnalogFilterSamples( BenchmarkState *state ) {
+
+	Vector3 v;
+
+	IngestHours( 1 );
+	dex.SetFilterConstant( 2.0 );
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( unsigned int frame = 0; frame < nFrames; frame++ ) {
+			if ( RawManipulandumPosition[frame][X] != MISSING_DOUBLE ) {
+				dex.CopyVector( v, RawManipulandumPosition[frame] );
+				dex.FilterManipulandumPosition( v );
+				dex.CopyVector( ManipulandumPosition[frame], v );
+			}
+			if ( RawManipulandumRotations[frame][X] != MISSING_DOUBLE ) {
+				dex.CopyVector( v, RawManipulandumRotations[frame] );
+				dex.FilterManipulandumRotations( v );
+				dex.CopyVector( ManipulandumRotations[frame], v );
+			}
+			dex.CopyVector( v, RawLoadForce[frame] );
+			dex.FilterLoadForce( v );
+			dex.CopyVector( LoadForce[frame], v );
+			dex.CopyVector( v, RawAcceleration[frame] );
+			dex.FilterAcceleration( v );
+			dex.CopyVector( Acceleration[frame], v );
+			for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+				if ( RawCenterOfPressure[ati][frame][X] != MISSING_DOUBLE ) {
+					dex.CopyVector( v, RawCenterOfPressure[ati][frame] );
+					dex.FilterCoP( ati, v );
+					dex.CopyVector( CenterOfPressure[ati][frame], v );
+				}
+				NormalForce[ati][frame] = dex.FilterNormalForce( RawNormalForce[ati][frame], ati );
+			}
+			GripForce[frame] = dex.FilterGripForce( RawGripForce[frame] );
+		}
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * nFrames;
+
+}
+
+// The filter bank, with the channels of GripMMIDesktop::InitializeFilterBank(), over one hour of data.
+// The argument is the number of threads.
+static void BM_FilterBank( BenchmarkState *state ) {
+
+	static DexFilterBank bank;
+	int i, ati;
+
+	IngestHours( 1 );
+	bank.ClearChannels();
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &RawManipulandumPosition[0][i], &ManipulandumPosition[0][i], 3 );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &RawManipulandumRotations[0][i], &ManipulandumRotations[0][i], 3, &RawManipulandumRotations[0][X] );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &RawLoadForce[0][i], &LoadForce[0][i], 3 );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &RawAcceleration[0][i], &Acceleration[0][i], 3 );
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &RawCenterOfPressure[ati][0][i], &CenterOfPressure[ati][0][i], 3 );
+	}
+	bank.AddChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &RawGripForce[0], &GripForce[0], 1 );
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		bank.AddChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &RawNormalForce[ati][0], &NormalForce[ati][0], 1 );
+	}
+	bank.SetFilterConstant( 2.0 );
+
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		bank.ResetState();
+		bank.Filter( 0, nFrames - 1, state->arg );
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * nFrames;
+
+}
+
+/*********************************************************************************/
+
+static Display	display = NULL;
+static View		view = NULL;
+
+static void CreatePlotView( void ) {
+	if ( view ) return;
+	display = CreateSoftDisplay();
+	DisplaySetSizePixels( display, PLOT_WIDTH, PLOT_HEIGHT );
+	DisplayInit( display );
+	// Draw directly, without keeping a list of what was drawn.
+	DisplayFreeCache( display );
+	view = CreateView( display );
+}
+
+// The frames shown in a window of the given number of minutes at the end of the data,
+//  and the down sampling that the GripMMI would use to plot them.
+static void PlotWindow( int minutes, int *first, int *last, int *step ) {
+	*last = nFrames - 1;
+	*first = *last - (int) ( minutes * 60.0 / RT_DEFAULT_SECONDS_PER_SLICE );
+	if ( *first < 0 ) *first = 0;
+	*step = 1;
+	while ( ( *last - *first ) / *step > MAX_PLOT_SAMPLES && *step < MAX_PLOT_STEP - 1 ) (*step)++;
+}
+
+// Autoscaling of the 3 components of the manipulandum position over the window.
+static void BM_AutoScaleAvailableDoubles( BenchmarkState *state ) {
+
+	int first, last, step;
+
+	IngestHours( 1 );
+	CreatePlotView();
+	PlotWindow( state->arg, &first, &last, &step );
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		for ( int c = X; c <= Z; c++ ) {
+			ViewAutoScaleInit( view );
+			ViewAutoScaleAvailableDoubles( view, &RawManipulandumPosition[0][c], first, last, sizeof( *RawManipulandumPosition ), MISSING_DOUBLE );
+		}
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * 3 * ( last - first + 1 );
+
+}
+
+// Erase and redraw the 3 components of the manipulandum position over the window.
+static void BM_PlotAvailableDoubles( BenchmarkState *state ) {
+
+	int first, last, step;
+
+	IngestHours( 1 );
+	CreatePlotView();
+	PlotWindow( state->arg, &first, &last, &step );
+	ViewSetXLimits( view, RealMarkerTime[first], RealMarkerTime[last] );
+	ViewAutoScaleInit( view );
+	for ( int c = X; c <= Z; c++ ) {
+		ViewAutoScaleAvailableDoubles( view, &RawManipulandumPosition[0][c], first, last, sizeof( *RawManipulandumPosition ), MISSING_DOUBLE );
+	}
+	BenchmarkStart( state );
+	for ( int i = 0; i < state->iterations; i++ ) {
+		ViewErase( view );
+		for ( int c = X; c <= Z; c++ ) {
+			ViewColor( view, RED + c );
+			ViewXYPlotAvailableDoubles( view, &RealMarkerTime[0], &RawManipulandumPosition[0][c], first, last, step,
+				sizeof( *RealMarkerTime ), sizeof( *RawManipulandumPosition ), MISSING_DOUBLE );
+		}
+	}
+	BenchmarkStop( state );
+	state->items = (double) state->iterations * 3 * ( ( last - first ) / step );
+
+}
+
+/*********************************************************************************/
+
+static Benchmark benchmarks[] = {
+	{ "BM_InsertRealtime",				BM_InsertRealtime,				0,	false, "us" },
+	{ "BM_ExtractRealtime",				BM_ExtractRealtime,				0,	false, "us" },
+	{ "BM_InsertHealthAndStatus",		BM_InsertHealthAndStatus,		0,	false, "us" },
+	{ "BM_ExtractHealthAndStatus",		BM_ExtractHealthAndStatus,		0,	false, "us" },
+	{ "BM_GenerateCacheFiles",			BM_GenerateCacheFiles,			1,	true,  "ms" },
+	{ "BM_IngestRT",					BM_IngestRT,					1,	true,  "ms" },
+	{ "BM_IngestRT",					BM_IngestRT,					6,	true,  "ms" },
+	{ "BM_IngestRT",					BM_IngestRT,					12,	true,  "ms" },
+	{ "BM_AnalogFilterSamples",			BM_AnalogFilterSamples,			0,	false, "ms" },
+	{ "BM_FilterBank",					BM_FilterBank,					1,	true,  "ms" },
+	{ "BM_FilterBank",					BM_FilterBank,					4,	true,  "ms" },
+	{ "BM_AutoScaleAvailableDoubles",	BM_AutoScaleAvailableDoubles,	10,	true,  "us" },
+	{ "BM_AutoScaleAvailableDoubles",	BM_AutoScaleAvailableDoubles,	60,	true,  "us" },
+	{ "BM_PlotAvailableDoubles",		BM_PlotAvailableDoubles,		10,	true,  "ms" },
+	{ "BM_PlotAvailableDoubles",		BM_PlotAvailableDoubles,		60,	true,  "ms" },
+};
+#define N_BENCHMARKS	( sizeof( benchmarks ) / sizeof( benchmarks[0] ) )
+
+// The results of one benchmark, as reported.
+typedef struct {
+	char		name[64];
+	int			iterations;
+	double		realTime;		// Per iteration, in the unit of the benchmark.
+	double		cpuTime;
+	double		bytesPerSecond;
+	double		itemsPerSecond;
+	const char	*unit;
+} BenchmarkResult;
+
+static double UnitMultiplier( const char *unit ) {
+	if ( !strcmp( unit, "ns" ) ) return( 1.0e9 );
+	if ( !strcmp( unit, "us" ) ) return( 1.0e6 );
+	return( 1.0e3 );
+}
+
+// Run a benchmark with more and more iterations until it lasts at least min_time seconds.
+static void RunBenchmark( Benchmark *benchmark, double min_time, BenchmarkResult *result ) {
+
+	BenchmarkState state;
+	int iterations = 1;
+
+	while ( true ) {
+		memset( &state, 0, sizeof( state ) );
+		state.iterations = iterations;
+		state.arg = benchmark->arg;
+		benchmark->routine( &state );
+		if ( state.realTime >= min_time || iterations >= 1000000000 ) break;
+		// Aim a bit beyond the minimum time, but do not grow by more than 10 times at once.
+		double multiplier = ( state.realTime > 0.0 ? 1.4 * min_time / state.realTime : 10.0 );
+		if ( multiplier > 10.0 ) multiplier = 10.0;
+		int next = (int) ( iterations * multiplier );
+		iterations = ( next > iterations ? next : iterations + 1 );
+	}
+
+	if ( benchmark->hasArg ) sprintf( result->name, "%s/%d", benchmark->name, benchmark->arg );
+	else strcpy( result->name, benchmark->name );
+	result->iterations = state.iterations;
+	result->unit = benchmark->unit;
+	result->realTime = state.realTime / state.iterations * UnitMultiplier( benchmark->unit );
+	result->cpuTime = state.cpuTime / state.iterations * UnitMultiplier( benchmark->unit );
+	result->bytesPerSecond = ( state.realTime > 0.0 ? state.bytes / state.realTime : 0.0 );
+	result->itemsPerSecond = ( state.realTime > 0.0 ? state.items / state.realTime : 0.0 );
+
+}
+
+static void PrintConsoleHeader( void ) {
+	printf( "%-36s %15s %15s %12s %s\n", "Benchmark", "Time", "CPU", "Iterations", "UserCounters..." );
+	printf( "------------------------------------------------------------------------------------------------------\n" );
+}
+
+static void PrintConsoleResult( BenchmarkResult *result ) {
+	printf( "%-36s %12.3f %-2s %12.3f %-2s %12d", result->name, result->realTime, result->unit, result->cpuTime, result->unit, result->iterations );
+	if ( result->bytesPerSecond > 0.0 ) printf( " bytes_per_second=%.3fM/s", result->bytesPerSecond / 1.0e6 );
+	if ( result->itemsPerSecond > 0.0 ) printf( " items_per_second=%.3fM/s", result->itemsPerSecond / 1.0e6 );
+	printf( "\n" );
+	fflush( stdout );
+}
+
+// Write the results in the JSON format of Google Benchmark.
+static void WriteJSON( FILE *fp, const char *executable, BenchmarkResult *results, int n ) {
+
+	char date[64];
+	char host[256] = "unknown";
+	time_t now = time( NULL );
+	SYSTEM_INFO info;
+
+	strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", localtime( &now ) );
+#ifndef _WIN32
+	gethostname( host, sizeof( host ) );
+#else
+	if ( getenv( "COMPUTERNAME" ) ) strncpy( host, getenv( "COMPUTERNAME" ), sizeof( host ) - 1 );
+#endif
+	GetSystemInfo( &info );
+
+	fprintf( fp, "{\n" );
+	fprintf( fp, "  \"context\": {\n" );
+	fprintf( fp, "    \"date\": \"%s\",\n", date );
+	fprintf( fp, "    \"host_name\": \"%s\",\n", host );
+	fprintf( fp, "    \"executable\": \"%s\",\n", executable );
+	fprintf( fp, "    \"num_cpus\": %u,\n", (unsigned int) info.dwNumberOfProcessors );
+#ifdef NDEBUG
+	fprintf( fp, "    \"library_build_type\": \"release\",\n" );
+#else
+	fprintf( fp, "    \"library_build_type\": \"debug\",\n" );
+#endif
+	fprintf( fp, "    \"grip_mmi_version\": \"%s\"\n", GripMMIVersion );
+	fprintf( fp, "  },\n" );
+	fprintf( fp, "  \"benchmarks\": [\n" );
+	for ( int i = 0; i < n; i++ ) {
+		fprintf( fp, "    {\n" );
+		fprintf( fp, "      \"name\": \"%s\",\n", results[i].name );
+		fprintf( fp, "      \"run_name\": \"%s\",\n", results[i].name );
+		fprintf( fp, "      \"run_type\": \"iteration\",\n" );
+		fprintf( fp, "      \"iterations\": %d,\n", results[i].iterations );
+		fprintf( fp, "      \"real_time\": %.6e,\n", results[i].realTime );
+		fprintf( fp, "      \"cpu_time\": %.6e,\n", results[i].cpuTime );
+		fprintf( fp, "      \"time_unit\": \"%s\"", results[i].unit );
+		if ( results[i].bytesPerSecond > 0.0 ) fprintf( fp, ",\n      \"bytes_per_second\": %.6e", results[i].bytesPerSecond );
+		if ( results[i].itemsPerSecond > 0.0 ) fprintf( fp, ",\n      \"items_per_second\": %.6e", results[i].itemsPerSecond );
+		fprintf( fp, "\n    }%s\n", ( i < n - 1 ? "," : "" ) );
+	}
+	fprintf( fp, "  ]\n" );
+	fprintf( fp, "}\n" );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	const char *filter = "";
+	double min_time = 0.5;
+	const char *out_filename = NULL;
+	bool json_console = false;
+	bool list_only = false;
+	LARGE_INTEGER frequency;
+
+	BenchmarkResult results[N_BENCHMARKS];
+	int n_results = 0;
+
+	for ( int arg = 1; arg < argc; arg++ ) {
+		if ( !strncmp( argv[arg], "--benchmark_filter=", 19 ) ) filter = argv[arg] + 19;
+		else if ( !strncmp( argv[arg], "--benchmark_min_time=", 21 ) ) min_time = atof( argv[arg] + 21 );
+		else if ( !strncmp( argv[arg], "--benchmark_out=", 16 ) ) out_filename = argv[arg] + 16;
+		else if ( !strcmp( argv[arg], "--benchmark_out_format=json" ) ) ;
+		else if ( !strcmp( argv[arg], "--benchmark_format=json" ) ) json_console = true;
+		else if ( !strcmp( argv[arg], "--benchmark_format=console" ) ) json_console = false;
+		else if ( !strcmp( argv[arg], "--benchmark_list_tests" ) || !strcmp( argv[arg], "--benchmark_list_tests=true" ) ) list_only = true;
+		else if ( !strncmp( argv[arg], "--benchmark_cache=", 18 ) ) cacheRoot = argv[arg] + 18;
+		else {
+			fprintf( stderr, "Unrecognized option: %s\n", argv[arg] );
+			return( -1 );
+		}
+	}
+
+	QueryPerformanceFrequency( &frequency );
+	performanceFrequency = (double) frequency.QuadPart;
+
+	if ( !json_console && !list_only ) PrintConsoleHeader();
+	for ( unsigned int i = 0; i < N_BENCHMARKS; i++ ) {
+		char name[64];
+		if ( benchmarks[i].hasArg ) sprintf( name, "%s/%d", benchmarks[i].name, benchmarks[i].arg );
+		else strcpy( name, benchmarks[i].name );
+		if ( !strstr( name, filter ) ) continue;
+		if ( list_only ) {
+			printf( "%s\n", name );
+			continue;
+		}
+		RunBenchmark( &benchmarks[i], min_time, &results[n_results] );
+		if ( !json_console ) PrintConsoleResult( &results[n_results] );
+		n_results++;
+	}
+	DeleteCaches();
+	if ( list_only ) return( 0 );
+
+	if ( json_console ) WriteJSON( stdout, argv[0], results, n_results );
+	if ( out_filename ) {
+		FILE *fp = fopen( out_filename, "w" );
+		if ( !fp ) {
+			fprintf( stderr, "Could not open %s for writing.\n", out_filename );
+			return( -1 );
+		}
+		WriteJSON( fp, argv[0], results, n_results );
+		fclose( fp );
+	}
+	return( 0 );
+
+}
@@ -0,0 +1,181 @@
+///
+/// Module:	GripPoseRecompute (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Recompute the poses of a rigid body (the manipulandum or the wrist) from the marker
+///  positions of a whole acquisition, with DexPoseSolver.
+///
+/// The model file gives the position of each marker when the body is at the zero position
+///  and orientation, one marker per line: X Y Z.
+/// The marker file has one line per frame: the time, followed by X Y Z for each marker of
+///  the model, in the same order. A marker that was not seen has MISSING_DOUBLE (999999.999999)
+///  or nan as its X coordinate. Lines starting with # are skipped.
+///
+/// The output has one line per frame, separated by tabs: the time, the position, the
+///  orientation quaternion (X Y Z M), the RMS residual of the fit and the number of visible
+///  markers. Frames with fewer than 3 visible markers have MISSING_DOUBLE for their pose.
+///
+/// Usage: GripPoseRecompute <model file> <marker file> <output file> [<threads>]
+/// Returns 0 if all is well.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/DexPoseSolver.h"
+
+#define MAX_LINE			4096
+#define FRAMES_ALLOCATION	65536
+
+static FILE *OpenFile( const char *filename, const char *mode ) {
+	FILE *fp = fopen( filename, mode );
+	if ( !fp ) {
+		fprintf( stderr, "Could not open %s.\n", filename );
+		exit( -1 );
+	}
+	return( fp );
+}
+
+static bool IsComment( const char *line ) {
+	line += strspn( line, " \t" );
+	return( *line == '#' || *line == '\r' || *line == '\n' || *line == '\0' );
+}
+
+static int ReadModel( const char *filename, Vector3 model[] ) {
+
+	char line[MAX_LINE];
+	int n_markers = 0;
+	FILE *fp = OpenFile( filename, "r" );
+
+	while ( fgets( line, sizeof( line ), fp ) ) {
+		if ( IsComment( line ) ) continue;
+		if ( n_markers >= DEX_POSE_MAX_MARKERS ) {
+			fprintf( stderr, "%s: more than %d markers.\n", filename, DEX_POSE_MAX_MARKERS );
+			exit( -1 );
+		}
+		if ( sscanf( line, "%lf %lf %lf", &model[n_markers][X], &model[n_markers][Y], &model[n_markers][Z] ) != 3 ) {
+			fprintf( stderr, "%s: could not read marker %d.\n", filename, n_markers );
+			exit( -1 );
+		}
+		n_markers++;
+	}
+	fclose( fp );
+	return( n_markers );
+
+}
+
+// Read the marker positions into one array per coordinate per marker.
+// The arrays are grown as needed. Returns the number of frames.
+static int ReadMarkers( const char *filename, int n_markers, double **time, DexMarkerArrays *markers ) {
+
+	char line[MAX_LINE];
+	int n_frames = 0, allocated = 0, mrk;
+	FILE *fp = OpenFile( filename, "r" );
+
+	*time = NULL;
+	for ( mrk = 0; mrk < n_markers; mrk++ ) markers->x[mrk] = markers->y[mrk] = markers->z[mrk] = NULL;
+
+	while ( fgets( line, sizeof( line ), fp ) ) {
+
+		if ( IsComment( line ) ) continue;
+		if ( n_frames >= allocated ) {
+			allocated += FRAMES_ALLOCATION;
+			*time = (double *) realloc( *time, allocated * sizeof( double ) );
+			for ( mrk = 0; mrk < n_markers && *time; mrk++ ) {
+				if ( !( markers->x[mrk] = (double *) realloc( markers->x[mrk], allocated * sizeof( double ) ) ) ) break;
+				if ( !( markers->y[mrk] = (double *) realloc( markers->y[mrk], allocated * sizeof( double ) ) ) ) break;
+				if ( !( markers->z[mrk] = (double *) realloc( markers->z[mrk], allocated * sizeof( double ) ) ) ) break;
+			}
+			if ( !*time || mrk < n_markers ) {
+				fprintf( stderr, "Error allocating memory for %d frames.\n", allocated );
+				exit( -1 );
+			}
+		}
+
+		char *field = line, *end;
+		(*time)[n_frames] = strtod( field, &end );
+		bool complete = ( end != field );
+		for ( mrk = 0; mrk < n_markers && complete; mrk++ ) {
+			field = end;
+			markers->x[mrk][n_frames] = strtod( field, &end );
+			field = end;
+			markers->y[mrk][n_frames] = strtod( field, &end );
+			field = end;
+			markers->z[mrk][n_frames] = strtod( field, &end );
+			complete = ( end != field );
+		}
+		if ( !complete ) {
+			fprintf( stderr, "%s: frame %d does not have %d markers.\n", filename, n_frames, n_markers );
+			exit( -1 );
+		}
+		n_frames++;
+	}
+	fclose( fp );
+	return( n_frames );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	Vector3			model[DEX_POSE_MAX_MARKERS];
+	DexMarkerArrays	markers;
+	DexPoseArrays	poses;
+	DexPoseSolver	solver;
+	double			*time;
+	int				n_markers, n_frames, n_threads = 0, solved, i;
+
+	if ( argc < 4 ) {
+		printf( "Usage: %s <model file> <marker file> <output file> [<threads>]\n", argv[0] );
+		return( -1 );
+	}
+	if ( argc > 4 ) n_threads = atoi( argv[4] );
+
+	n_markers = ReadModel( argv[1], model );
+	if ( n_markers < DEX_POSE_MIN_MARKERS ) {
+		fprintf( stderr, "%s: need at least %d markers.\n", argv[1], DEX_POSE_MIN_MARKERS );
+		return( -1 );
+	}
+	solver.SetModel( model, n_markers );
+	n_frames = ReadMarkers( argv[2], n_markers, &time, &markers );
+	if ( n_frames == 0 ) {
+		fprintf( stderr, "%s: no frames.\n", argv[2] );
+		return( -1 );
+	}
+
+	for ( i = X; i <= Z; i++ ) poses.position[i] = (double *) malloc( n_frames * sizeof( double ) );
+	for ( i = X; i <= M; i++ ) poses.orientation[i] = (double *) malloc( n_frames * sizeof( double ) );
+	poses.residual = (double *) malloc( n_frames * sizeof( double ) );
+	poses.visible = (int *) malloc( n_frames * sizeof( int ) );
+	for ( i = X; i <= Z; i++ ) if ( !poses.position[i] ) poses.residual = NULL;
+	for ( i = X; i <= M; i++ ) if ( !poses.orientation[i] ) poses.residual = NULL;
+	if ( !poses.residual || !poses.visible ) {
+		fprintf( stderr, "Error allocating memory for %d frames.\n", n_frames );
+		return( -1 );
+	}
+
+	solved = solver.Solve( &markers, &poses, 0, n_frames - 1, n_threads );
+
+	FILE *fp = OpenFile( argv[3], "w" );
+	fprintf( fp, "Time\tPX\tPY\tPZ\tQX\tQY\tQZ\tQM\tResidual\tVisible\n" );
+	for ( int frame = 0; frame < n_frames; frame++ ) {
+		fprintf( fp, "%.6f", time[frame] );
+		for ( i = X; i <= Z; i++ ) fprintf( fp, "\t%.6f", poses.position[i][frame] );
+		for ( i = X; i <= M; i++ ) fprintf( fp, "\t%.8f", poses.orientation[i][frame] );
+		fprintf( fp, "\t%.6f\t%d\n", poses.residual[frame], poses.visible[frame] );
+	}
+	if ( fclose( fp ) ) {
+		fprintf( stderr, "Error writing %s.\n", argv[3] );
+		return( -1 );
+	}
+
+	printf( "%d markers, %d frames, %d poses computed.\n", n_markers, n_frames, solved );
+	return( 0 );
+
+}
@@ -0,0 +1,178 @@
+///
+/// Module:	GripPacketCheck (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check the packet cache files written by DexGroundMonitorClient during the loopback test.
+/// The packets come from the load generation mode of the CLWSemulator (sendLoadPackets()),
+///  so their contents are known in advance: RT packets with consecutive packet counts and
+///  slice values computed from them, and one HK packet after every 'hk' RT packets.
+/// Every packet is checked, then the rate at which the packets were sent, according to
+///  their timestamps, is compared to the requested rate.
+/// The latency file written by the client alongside the cache files is checked as well,
+///  if there is one: one record per RT packet, with times that make sense.
+///
+/// Usage: GripPacketCheck <cache file root> <RT packets> <RT packets per HK packet> [<RT packets per second>]
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Grip/GripPackets.h"
+#include "../Grip/GripLatency.h"
+
+// Tolerance on the measured rate, as a fraction of the requested rate.
+#define RATE_TOLERANCE	0.10
+
+int errors = 0;
+
+void fail( const char *what, int packet, double value, double expected ) {
+	// Only show the first few, to keep the log readable.
+	if ( errors++ < 20 ) printf( "  %s packet %d: %f (expected %f)\n", what, packet, value, expected );
+}
+
+// Read a whole cache file. Returns the number of packets of the given length,
+//  or -1 if the file is optional and does not exist.
+int readCache( const char *root, const char *extension, int packet_length, unsigned char **contents, bool optional = false ) {
+
+	char filename[MAX_PATHLENGTH];
+	FILE *fp;
+	long bytes;
+
+	sprintf( filename, "%s%s", root, extension );
+	fp = fopen( filename, "rb" );
+	if ( !fp && optional ) return( -1 );
+	if ( !fp ) {
+		printf( "Could not open %s.\n", filename );
+		exit( -1 );
+	}
+	fseek( fp, 0, SEEK_END );
+	bytes = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+	*contents = (unsigned char *) malloc( bytes + EPM_BUFFER_LENGTH );
+	if ( !*contents || fread( *contents, 1, bytes, fp ) != (size_t) bytes ) {
+		printf( "Could not read %s.\n", filename );
+		exit( -1 );
+	}
+	fclose( fp );
+	if ( bytes % packet_length ) printf( "  %s holds a partial packet (%ld bytes).\n", filename, bytes );
+	return( bytes / packet_length );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	EPMTelemetryPacket packet;
+	EPMTelemetryHeaderInfo header;
+	GripRealtimeDataInfo rt;
+	GripHealthAndStatusInfo hk;
+	unsigned char *rt_cache, *hk_cache, *latency_cache;
+
+	if ( argc < 4 ) {
+		printf( "Usage: %s <cache file root> <RT packets> <RT packets per HK packet> [<RT packets per second>]\n", argv[0] );
+		return( -1 );
+	}
+	const char *root = argv[1];
+	int expected_rt = atoi( argv[2] );
+	int hk_interval = atoi( argv[3] );
+	double rate = ( argc > 4 ? atof( argv[4] ) : 0.0 );
+	int expected_hk = ( hk_interval > 0 ? expected_rt / hk_interval : 0 );
+
+	int n_rt = readCache( root, ".rt.gpk", rtPacketLengthInBytes, &rt_cache );
+	int n_hk = readCache( root, ".hk.gpk", hkPacketLengthInBytes, &hk_cache );
+	printf( "RT packets: %d (expected %d)  HK packets: %d (expected %d)\n", n_rt, expected_rt, n_hk, expected_hk );
+	if ( n_rt != expected_rt ) fail( "RT count", n_rt, n_rt, expected_rt );
+	if ( n_hk != expected_hk ) fail( "HK count", n_hk, n_hk, expected_hk );
+
+	double first_time = 0.0, last_time = 0.0, previous_time = 0.0;
+	unsigned long acquisition = 0;
+
+	for ( int i = 0; i < n_rt; i++ ) {
+
+		memcpy( packet.buffer, rt_cache + i * rtPacketLengthInBytes, rtPacketLengthInBytes );
+		ExtractEPMTelemetryHeaderInfo( &header, &packet );
+		ExtractGripRealtimeDataInfo( &rt, &packet );
+
+		if ( header.epmSyncMarker != EPM_TELEMETRY_SYNC_VALUE ) fail( "RT sync", i, header.epmSyncMarker, EPM_TELEMETRY_SYNC_VALUE );
+		if ( header.TMIdentifier != GRIP_RT_ID ) fail( "RT identifier", i, header.TMIdentifier, GRIP_RT_ID );
+		// The TM counter runs over RT and HK packets together.
+		unsigned short tm = (unsigned short) ( i + ( hk_interval > 0 ? i / hk_interval : 0 ) );
+		if ( header.TMCounter != tm ) fail( "RT TM counter", i, header.TMCounter, tm );
+		if ( i == 0 ) acquisition = rt.acquisitionID;
+		else if ( rt.acquisitionID != acquisition ) fail( "RT acquisition", i, rt.acquisitionID, acquisition );
+		if ( rt.rtPacketCount != (unsigned long) i ) fail( "RT packet count", i, rt.rtPacketCount, i );
+
+		for ( int slice = 0; slice < RT_SLICES_PER_PACKET; slice++ ) {
+			int tick = i * RT_SLICES_PER_PACKET + slice;
+			double t = (double) tick * RT_DEFAULT_SECONDS_PER_SLICE;
+			double position = 300.0 + 300.0 * cos( t * Pi * 2.0 );
+			double force = - 14.0 + 8.5 * sin( t * Pi * 2.0 );
+			if ( rt.dataSlice[slice].poseTick != (unsigned long) tick ) fail( "RT pose tick", i, rt.dataSlice[slice].poseTick, tick );
+			if ( rt.dataSlice[slice].analogTick != (unsigned long) tick ) fail( "RT analog tick", i, rt.dataSlice[slice].analogTick, tick );
+			// Positions are sent in tenths (and extracted as sent) and forces in hundredths.
+			if ( fabs( rt.dataSlice[slice].position[X] - position * 10.0 ) > 1.0 ) fail( "RT position", i, rt.dataSlice[slice].position[X], position * 10.0 );
+			if ( fabs( rt.dataSlice[slice].ft[0].force[X] - force ) > 0.011 ) fail( "RT force", i, rt.dataSlice[slice].ft[0].force[X], force );
+			if ( !rt.dataSlice[slice].manipulandumVisibility ) fail( "RT visibility", i, 0, 1 );
+		}
+
+		double time = (double) rt.packetTimestamp;
+		if ( i == 0 ) first_time = time;
+		else if ( time < previous_time ) fail( "RT timestamp", i, time, previous_time );
+		previous_time = last_time = time;
+
+	}
+
+	for ( int j = 0; j < n_hk; j++ ) {
+
+		memcpy( packet.buffer, hk_cache + j * hkPacketLengthInBytes, hkPacketLengthInBytes );
+		ExtractEPMTelemetryHeaderInfo( &header, &packet );
+		ExtractGripHealthAndStatusInfo( &hk, &packet );
+
+		if ( header.epmSyncMarker != EPM_TELEMETRY_SYNC_VALUE ) fail( "HK sync", j, header.epmSyncMarker, EPM_TELEMETRY_SYNC_VALUE );
+		if ( header.TMIdentifier != GRIP_HK_ID ) fail( "HK identifier", j, header.TMIdentifier, GRIP_HK_ID );
+		unsigned short tm = (unsigned short) ( ( j + 1 ) * ( hk_interval + 1 ) - 1 );
+		if ( header.TMCounter != tm ) fail( "HK TM counter", j, header.TMCounter, tm );
+		if ( hk.user != 11 || hk.protocol != 201 || hk.task != 210 || hk.step != 10 ) fail( "HK script state", j, hk.protocol, 201 );
+
+	}
+
+	// One latency record for each RT packet, with the time stamp of the packet.
+	int n_latency = readCache( root, ".rt.lat", sizeof( GripLatencyRecord ), &latency_cache, true );
+	if ( n_latency >= 0 ) {
+		GripLatencyHistogram histogram[GRIP_LATENCY_STAGES];
+		for ( int stage = 0; stage < GRIP_LATENCY_STAGES; stage++ ) GripLatencyReset( &histogram[stage] );
+		if ( n_latency != n_rt ) fail( "Latency count", n_latency, n_latency, n_rt );
+		for ( int i = 0; i < n_latency && i < n_rt; i++ ) {
+			GripLatencyRecord record;
+			memcpy( &record, latency_cache + i * sizeof( record ), sizeof( record ) );
+			memcpy( packet.buffer, rt_cache + i * rtPacketLengthInBytes, rtPacketLengthInBytes );
+			ExtractEPMTelemetryHeaderInfo( &header, &packet );
+			if ( record.onboard != (double) EPMtoSeconds( &header ) ) fail( "Latency time stamp", i, record.onboard, (double) EPMtoSeconds( &header ) );
+			if ( record.tmCounter != header.TMCounter ) fail( "Latency TM counter", i, record.tmCounter, header.TMCounter );
+			if ( record.written < record.received ) fail( "Latency write time", i, record.written, record.received );
+			GripLatencyAdd( &histogram[GRIP_LATENCY_RECEIVE], record.received - record.onboard );
+			GripLatencyAdd( &histogram[GRIP_LATENCY_CACHE_WRITE], record.written - record.onboard );
+		}
+		printf( "Latency from the time stamp on board:\n" );
+		GripLatencyPrintSummary( stdout, GripLatencyStageName[GRIP_LATENCY_RECEIVE], &histogram[GRIP_LATENCY_RECEIVE] );
+		GripLatencyPrintSummary( stdout, GripLatencyStageName[GRIP_LATENCY_CACHE_WRITE], &histogram[GRIP_LATENCY_CACHE_WRITE] );
+	}
+
+	// Throughput, from the time stamps of the first and last RT packets.
+	// The time stamps have a resolution of a millisecond.
+	if ( n_rt > 1 && last_time > first_time ) {
+		double measured = ( n_rt - 1 ) / ( last_time - first_time );
+		printf( "Sent %d RT packets in %.3f s: %.1f RT packets/s, %.3f MB/s including HK.\n", n_rt, last_time - first_time, measured,
+			( n_rt * rtPacketLengthInBytes + n_hk * hkPacketLengthInBytes ) / ( last_time - first_time ) / 1.0e6 );
+		if ( rate > 0.0 && fabs( measured - rate ) > RATE_TOLERANCE * rate ) fail( "RT rate", n_rt, measured, rate );
+	}
+
+	if ( errors ) printf( "FAILED: %d errors.\n", errors );
+	else printf( "OK.\n" );
+	return( errors ? 1 : 0 );
+
+}
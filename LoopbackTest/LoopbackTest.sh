@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# Loopback test of the CLWS emulator and the ground monitor client (Linux build, see CMakeLists.txt).
+#
+# The emulator generates a known sequence of packets at a fixed rate (load generation mode)
+#  and the client stores them in its cache files, which are then checked packet by packet.
+#  The rate at which the packets went through is compared to the requested rate.
+#
+# Usage: LoopbackTest.sh <CLWSemulator> <DexGroundMonitorClient> <GripPacketCheck> [<RT packets/s> [<RT packets>]]
+#
+
+EMULATOR="$1"
+CLIENT="$2"
+CHECK="$3"
+RATE=${4:-500}
+COUNT=${5:-2000}
+HK=2
+# Pick a port that is unlikely to collide with another run.
+PORT=$(( 20000 + $$ % 10000 ))
+
+WORK=$(mktemp -d)
+EMULATOR_PID=
+cleanup() {
+	[ -n "$EMULATOR_PID" ] && kill $EMULATOR_PID 2>/dev/null
+	rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+echo "Sending $COUNT RT packets at $RATE per second on port $PORT."
+"$EMULATOR" -load -rate=$RATE -count=$COUNT -hk=$HK -port=$PORT > "$WORK/emulator.log" 2>&1 &
+EMULATOR_PID=$!
+# The client keeps trying to connect, but there is no point in starting before the emulator is listening.
+sleep 1
+
+# The client stops when the emulator closes the connection after the last packet.
+if ! timeout $(( COUNT / RATE + 30 )) "$CLIENT" -only -connections=1 "$WORK/loopback" localhost:$PORT < /dev/null > "$WORK/client.log" 2>&1; then
+	echo "Client did not finish normally."
+	tail -20 "$WORK/client.log"
+	exit 1
+fi
+grep "Packets received" "$WORK/client.log"
+
+"$CHECK" "$WORK/loopback" $COUNT $HK $RATE || exit 1
+
+# Reconnection. The emulator serves each new connection from the start, so a client that
+#  reconnects once should append a second copy of the packets to the same cache files and
+#  note one gap between them.
+echo "Reconnecting once."
+if ! timeout $(( 2 * COUNT / RATE + 30 )) "$CLIENT" -only -connections=2 "$WORK/reconnect" localhost:$PORT < /dev/null > "$WORK/reconnect.log" 2>&1; then
+	echo "Client did not finish normally after reconnecting."
+	tail -20 "$WORK/reconnect.log"
+	exit 1
+fi
+RT_BYTES=$(wc -c < "$WORK/loopback.rt.gpk")
+if [ $(wc -c < "$WORK/reconnect.rt.gpk") -ne $(( 2 * RT_BYTES )) ]; then
+	echo "The RT cache does not hold the packets from both connections."
+	exit 1
+fi
+if [ $(grep -vc "^#" "$WORK/reconnect.gaps.txt") -ne 1 ]; then
+	echo "Expected one gap in $WORK/reconnect.gaps.txt."
+	exit 1
+fi
+echo "Reconnected and appended to the same cache files."
@@ -3,18 +3,25 @@
 #include <stdio.h>
 #include <time.h>
 
+#define true  1
+#define false 0
+
+// The intensity profile of the antialiased lines is also used by the software
+//  rasterizer (SoftDisplay.c), which has to compile on machines without OpenGL.
+// Define NO_OPENGL to keep only the profile.
+#ifndef NO_OPENGL
 #include <windows.h>
 #include <mmsystem.h>
 #include <winerror.h>
 
-#define true  1
-#define false 0
-
 #include <gl/gl.h>
 #include <gl/glut.h>
+#endif
 
-#include <useful.h>
+#include "useful.h"
+#ifndef NO_OPENGL
 #include "OglDisplayInterface.h"
+#endif
 #include "AntialiasedGraphics.h"
 
 int wire = false;
@@ -33,12 +40,9 @@ float aa_colors_rgb[ AA_COLORS ][3] =
  };
 
 
-// Texture
-static GLuint Texture[ AA_COLORS ];
-
 /**************************************************************************************/
 
-int round( double x )
+local int aa_round( double x )
 {
     if(x > 0.0) return((int) (x + 0.5));
     else if(x < 0.0) return((int) (x - 0.5));
@@ -47,32 +51,53 @@ int round( double x )
 
 /**************************************************************************************/
 
+// Fill a table with the intensity (0-255) across the width of an antialiased line.
+// Entry 0 and entry size-1 are the edges of the line, size/2 is the center.
+void AAIntensityProfile( unsigned char profile[], int size )
+{
+  int j;
+  double delta, distance;
+
+  for ( j = 0; j < size; j++ ) {
+    // Intensity falls off as a gaussian around the center.
+    if ( gaussian ) {
+      delta = (double)( j - size / 2 ) / (double)( size / 2 );
+      distance = delta * delta;
+      profile[j] = (unsigned char) aa_round( 255.0 * exp( - 5.0 * distance ) );
+    }
+    // Intensity is a sin around the center.
+    // This was the original way, but it's not good because the gradiant
+    //  is too steep as it goes to zero.
+    else profile[j] = (unsigned char) aa_round( 255.0 * sin( PI * (double) j / (double) ( size - 1 ) ) );
+  }
+}
+
+#ifndef NO_OPENGL
+
+// Texture
+static GLuint Texture[ AA_COLORS ];
+
+/**************************************************************************************/
+
 // Setup 1D textures for antialisasing.
 void SetupAATextures( void )
 {
 	int i, j, k;
-  double delta, distance;
 	GLubyte bits[ AA_COLORS ][ 3 * AA_TEXTURE_SIZE ], c;
+	GLubyte profile[ AA_TEXTURE_SIZE ];
 
 	// Cre la texture LinesTexture
 	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 	for(i = 0; i < AA_COLORS; i++) glGenTextures(1, &(Texture[i]));
 
+	AAIntensityProfile( profile, AA_TEXTURE_SIZE );
+
 	// Copie les pixels du bitmap formats dans bits
 	for(i = 0; i < AA_COLORS; i++) {
 		for(j = 0; j < AA_TEXTURE_SIZE; j++) {
-      // Intensity falls off as a gaussian around the center.
-			if ( gaussian ) {
-        delta = (double)( j - AA_TEXTURE_SIZE / 2 ) / (double)( AA_TEXTURE_SIZE / 2 );
-        distance = delta * delta;
-        c = (GLubyte) round( 255.0 * exp( - 5.0 * distance ) );
-      }
-      // Intensity is a sin around the center.
-      // This was the original way, but it's not good because the gradiant
-      //  is too steep as it goes to zero.
-			else c = (GLubyte) round(255.0 * sin( PI * (double) j / (double) ( AA_TEXTURE_SIZE - 1)));
+			c = profile[j];
 			for(k = 0; k < 3; k++) {
-				bits[i][3*j + k] = round( c * aa_colors_rgb[i][k]);
+				bits[i][3*j + k] = aa_round( c * aa_colors_rgb[i][k]);
       }
 		}
 	}
@@ -209,8 +234,4 @@ void DrawAACircle( float x, float y, float radius, GLuint color )
 	glEnd();
 }
 
-
-
-
-
-
+#endif
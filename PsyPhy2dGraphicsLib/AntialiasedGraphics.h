@@ -12,8 +12,12 @@
 #define AA_COLORS   7
 
 
+void AAIntensityProfile( unsigned char profile[], int size );
+
+#ifndef NO_OPENGL
 void InitAntialiasing( void );
 void DrawAALine(GLfloat from_x, GLfloat from_y, GLfloat to_x, GLfloat to_y, GLuint color);
 void DrawAACircle( float x, float y, float radius, GLuint color );
 
-void EnableAntialiasing( void );
\ No newline at end of file
+void EnableAntialiasing( void );
+#endif
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <malloc.h>
 #include <math.h>
+#include <string.h>
 #include "useful.h"
 #include "Displays.h"
 #include "Views.h"
@@ -1078,3 +1079,241 @@ void ViewScatterPlotAvailableDoubles (View view, int symbol,
   }
 }
 
+/***************************************************************************/
+/*                               Run Plots                                 */
+/***************************************************************************/
+
+/*
+ * A value that stays the same for long stretches, such as the visibility
+ * of a marker, can be given as a list of runs of consecutive samples.
+ * runs[k][0] and runs[k][1] are the first and last samples of each run,
+ * in increasing order. Each run is drawn as a single bar that covers the
+ * same area as plotting SYMBOL_FILLED_SQUARE at every sample, so the
+ * picture is the same but it costs one rectangle per run instead of one
+ * per sample.
+ */
+
+void ViewPlotRuns (View view, double *xarray, unsigned xsize,
+		   int runs[][2], int n_runs, double y,
+		   int start, int end )
+{
+
+  Display	display = view->display;
+  float		radius = display->symbol_radius;
+  float		dy = UserToDisplayY(view, y);
+  double	x1, x2;
+  int		low = 0, high = n_runs, mid, first, last;
+
+  /* Binary search for the first run that ends at or after the start. */
+  while ( low < high ) {
+    mid = ( low + high ) / 2;
+    if ( runs[mid][1] < start ) low = mid + 1;
+    else high = mid;
+  }
+
+  for ( ; low < n_runs && runs[low][0] <= end; low++ ) {
+    first = max( runs[low][0], start );
+    last = min( runs[low][1], end );
+    x1 = *(double *)(((char *) xarray) + first * xsize);
+    x2 = *(double *)(((char *) xarray) + last * xsize);
+    FilledRectangle( display,
+      UserToDisplayX(view, x1) - radius, dy - radius,
+      UserToDisplayX(view, x2) + radius, dy + radius );
+  }
+
+}
+
+/***************************************************************************/
+/*                              Density Maps                               */
+/***************************************************************************/
+
+/*
+ * A two-dimensional histogram of XY data, drawn in pseudo-color.
+ * When thousands of samples land on the same few pixels, plotting each one
+ * only produces a blob and takes time in proportion to the number of samples.
+ * Here the samples are counted into a grid of bins instead, and the drawing
+ * costs at most one rectangle per bin, however long the record.
+ */
+
+DensityMap CreateDensityMap ( void ) {
+
+  DensityMap map = (DensityMap) calloc( 1, sizeof( struct _density_map ) );
+
+  if ( !map ) {
+    fprintf( stderr, "Error allocating space for DensityMap.\n" );
+    return( 0 );
+  }
+  map->first = 0;
+  map->last = -1;
+  return( map );
+
+}
+
+void DestroyDensityMap ( DensityMap map ) {
+
+  if ( !map ) return;
+  if ( map->count ) free( map->count );
+  free( map );
+
+}
+
+void DensityMapClear ( DensityMap map ) {
+
+  if ( map->count ) memset( map->count, 0, map->x_bins * map->y_bins * sizeof( *map->count ) );
+  map->first = 0;
+  map->last = -1;
+
+}
+
+/* Set the number of bins and the range of values that they cover.
+ * Nothing happens if they are the same as before, otherwise the counts start over.
+ */
+void DensityMapSetGrid ( DensityMap map, int x_bins, int y_bins,
+			 double left, double bottom, double right, double top ) {
+
+  if ( x_bins < 1 ) x_bins = 1;
+  if ( y_bins < 1 ) y_bins = 1;
+  if ( map->count && x_bins == map->x_bins && y_bins == map->y_bins &&
+       left == map->left && right == map->right && bottom == map->bottom && top == map->top ) return;
+
+  if ( map->x_bins * map->y_bins != x_bins * y_bins || !map->count ) {
+    if ( map->count ) free( map->count );
+    map->count = (unsigned long *) malloc( x_bins * y_bins * sizeof( *map->count ) );
+    if ( !map->count ) {
+      fprintf( stderr, "Error allocating %d x %d bins for DensityMap.\n", x_bins, y_bins );
+      x_bins = y_bins = 0;
+    }
+  }
+  map->x_bins = x_bins;
+  map->y_bins = y_bins;
+  map->left = left;
+  map->right = right;
+  map->bottom = bottom;
+  map->top = top;
+  DensityMapClear( map );
+
+}
+
+/* Add (weight = 1) or remove (weight = -1) the samples from start to end.
+ * Samples that fall outside the grid are ignored.
+ */
+void DensityMapAddDoubles ( DensityMap map, double *xarray, double *yarray,
+			    int start, int end,
+			    unsigned xsize, unsigned ysize,
+			    double na, int weight ) {
+
+  register int		i, bin_x, bin_y;
+  register double	*xpt, *ypt;
+  double	x_scale, y_scale;
+  unsigned long	*bin;
+
+  if ( !map->count ) return;
+  x_scale = map->x_bins / ( map->right - map->left );
+  y_scale = map->y_bins / ( map->top - map->bottom );
+
+  for (i = start; i <= end; i++ ) {
+    xpt = (double *)(((char *) xarray) + i * xsize);
+    ypt = (double *)(((char *) yarray) + i * ysize);
+    if ( *xpt == na || *ypt == na ) continue;
+    bin_x = (int) floor( ( *xpt - map->left ) * x_scale );
+    bin_y = (int) floor( ( *ypt - map->bottom ) * y_scale );
+    if ( bin_x < 0 || bin_x >= map->x_bins || bin_y < 0 || bin_y >= map->y_bins ) continue;
+    bin = &map->count[ bin_y * map->x_bins + bin_x ];
+    if ( weight > 0 ) (*bin)++;
+    else if ( *bin > 0 ) (*bin)--;
+  }
+
+}
+
+/* Make the map hold the samples from start to end, by adding and removing
+ * only the samples at the edges that have changed since the last call.
+ * This assumes that the samples themselves have not changed. If they have,
+ * call DensityMapClear() first.
+ */
+void DensityMapTrackDoubles ( DensityMap map, double *xarray, double *yarray,
+			      int start, int end,
+			      unsigned xsize, unsigned ysize,
+			      double na ) {
+
+  /* If the old and new ranges do not overlap, it is quicker to start over. */
+  if ( map->last < map->first || start > map->last || end < map->first ) {
+    DensityMapClear( map );
+    DensityMapAddDoubles( map, xarray, yarray, start, end, xsize, ysize, na, 1 );
+  }
+  else {
+    if ( start < map->first ) DensityMapAddDoubles( map, xarray, yarray, start, map->first - 1, xsize, ysize, na, 1 );
+    else if ( start > map->first ) DensityMapAddDoubles( map, xarray, yarray, map->first, start - 1, xsize, ysize, na, -1 );
+    if ( end > map->last ) DensityMapAddDoubles( map, xarray, yarray, map->last + 1, end, xsize, ysize, na, 1 );
+    else if ( end < map->last ) DensityMapAddDoubles( map, xarray, yarray, end + 1, map->last, xsize, ysize, na, -1 );
+  }
+  map->first = start;
+  map->last = end;
+
+}
+
+/* Draw the non-empty bins, colored on a logarithmic scale from the
+ * smallest count (blue) to the largest (red), or from a pale to the full
+ * shade of a single color if 'rgb' is given. Neighboring bins in a row
+ * that come out the same color are drawn as a single rectangle.
+ */
+local void plot_density_map ( View view, DensityMap map, float *rgb ) {
+
+  int		i, j, n, level, next_level;
+  unsigned long	most = 0, *row;
+  double	scale, dx, dy;
+  double	hold_min = view->user_min_depth, hold_max = view->user_max_depth;
+
+  if ( !map->count ) return;
+  for ( i = 0; i < map->x_bins * map->y_bins; i++ ) if ( map->count[i] > most ) most = map->count[i];
+  if ( most == 0 ) return;
+
+  scale = ( DENSITY_MAP_LEVELS - 1 ) / log( (double) most + 1.0 );
+  dx = ( map->right - map->left ) / map->x_bins;
+  dy = ( map->top - map->bottom ) / map->y_bins;
+  ViewSetDepthLimits( view, 0.0, DENSITY_MAP_LEVELS - 1 );
+
+  for ( j = 0; j < map->y_bins; j++ ) {
+    row = &map->count[ j * map->x_bins ];
+    for ( i = 0; i < map->x_bins; i += n ) {
+      if ( !row[i] ) {
+	n = 1;
+	continue;
+      }
+      level = (int) ( log( (double) row[i] + 1.0 ) * scale + 0.5 );
+      for ( n = 1; i + n < map->x_bins && row[i+n]; n++ ) {
+	next_level = (int) ( log( (double) row[i+n] + 1.0 ) * scale + 0.5 );
+	if ( next_level != level ) break;
+      }
+      if ( rgb ) {
+	/* From 20% of the color, mixed with white, up to the color itself. */
+	double shade = 0.2 + 0.8 * level / ( DENSITY_MAP_LEVELS - 1 );
+	ColorRGB( view->display, 
+		  (float) ( 1.0 - shade * ( 1.0 - rgb[0] ) ),
+		  (float) ( 1.0 - shade * ( 1.0 - rgb[1] ) ),
+		  (float) ( 1.0 - shade * ( 1.0 - rgb[2] ) ) );
+      }
+      else ViewSetSpectrumColor( view, level );
+      ViewFilledRectangle( view,
+	map->left + i * dx, map->bottom + j * dy,
+	map->left + ( i + n ) * dx, map->bottom + ( j + 1 ) * dy );
+    }
+  }
+
+  ViewSetDepthLimits( view, hold_min, hold_max );
+
+}
+
+void ViewPlotDensityMap ( View view, DensityMap map ) {
+  plot_density_map( view, map, NULL );
+}
+
+/* Shades of one color, so that the maps of two sets of data can be
+ * overlaid in the same view and still be told apart.
+ */
+void ViewPlotDensityMapRGB ( View view, DensityMap map, float r, float g, float b ) {
+  float rgb[3];
+  rgb[0] = r;
+  rgb[1] = g;
+  rgb[2] = b;
+  plot_density_map( view, map, rgb );
+}
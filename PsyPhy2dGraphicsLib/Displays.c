@@ -23,8 +23,10 @@
 #include <malloc.h>
 #include <string.h>
 #include <math.h>
+#ifdef _WIN32
 #include <crtdbg.h>
 #include <windows.h>
+#endif
 
 #include "useful.h"
 
@@ -94,10 +96,18 @@ Select default display at run time, if the machine has multiple
 displays and you want to be able to change on the run.
 */
 
+#ifdef _WIN32
 extern Display	OglDisplay;
 Display DefaultDisplay ( void ) {
   return( OglDisplay );  
 }
+#else
+// Without a window system, the only available display is the software rasterizer.
+extern Display	SoftDisplay;
+Display DefaultDisplay ( void ) {
+  return( SoftDisplay );  
+}
+#endif
 
 /****************************************************************************/
 
@@ -121,7 +131,11 @@ Display CreateDisplay( Display model ) {
 
 	display = malloc( sizeof( model ) );
 	if ( ! display ) {
+#ifdef _WIN32
 		MessageBox( NULL, "Unable to create display.", "Display Error", MB_OK );
+#else
+		fprintf( stderr, "Unable to create display.\n" );
+#endif
 		exit( -1 );
 	}
 	memcpy( display, model, sizeof( *display ));
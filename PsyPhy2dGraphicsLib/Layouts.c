@@ -12,7 +12,9 @@
 
 // Extra information about memory leaks.
 #define _CRTDBG_MAP_ALLOC
+#ifdef _WIN32
 #include <crtdbg.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
@@ -267,6 +267,20 @@ void OglSwap ( Display display ) {
 
 /***************************************************************************/
 
+// Copy an RGBA image, top row first, into the window with its top left corner
+//  at the top left of the display. This is how the images drawn by a SoftDisplay 
+//  are put on the screen. The image is not kept in the redraw cache.
+void OglDrawImage ( Display display, unsigned char *rgba, int width, int height ) {
+
+	glRasterPos2f( display->left, display->top );
+	glPixelZoom( 1.0, -1.0 );
+	glDrawPixels( width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba );
+	glPixelZoom( 1.0, 1.0 );
+
+}
+
+/***************************************************************************/
+
 void OglActivate( Display display ) {
 
 	register OglParams	*params = (OglParams *) display->parameters;
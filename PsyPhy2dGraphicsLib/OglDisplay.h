@@ -17,6 +17,7 @@ void DestroyOglDisplays( void );
 void	OglInit( Display display );
 void	OglActivate( Display display );
 void	OglSwap ( Display display );
+void	OglDrawImage ( Display display, unsigned char *rgba, int width, int height );
 
 void	OglClose( Display display );
 void	OglHardcopy ( Display display, char *filename );
@@ -0,0 +1,946 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                              SoftDisplay.c                                */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+ * A software rasterizer that implements the full Display interface.
+ * Everything is drawn into an RGBA buffer in memory, so that the graphs can be
+ * generated on a machine without a graphics card or a window system.
+ * Lines are antialiased with the same intensity profile as the OpenGL
+ * textures in AntiAliasedGraphics.c.
+ * Coordinates follow the OglDisplay conventions: pixels, origin at the bottom left.
+ */
+
+// Disable warnings about unsafe functions.
+// We use the 'unsafe' versions to maintain source-code compatibility with Visual C++ 6
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+
+#include "useful.h"
+#include "Graphics.h"
+#include "Displays.h"
+#include "SoftDisplay.h"
+
+#ifndef NO_OPENGL
+#define NO_OPENGL
+#endif
+#include "AntialiasedGraphics.h"
+
+#ifndef _WIN32
+#define _strdup strdup
+#endif
+
+/***************************************************************************/
+
+// Create a static version of a SoftDisplay.
+SoftParams	_soft_params = {"Soft 2D Display"};
+struct _display	_SoftDisplay = {
+  "Soft Display",
+    0, 0, SOFT_DISPLAY_WIDTH, SOFT_DISPLAY_WIDTH,
+    SoftPoint, SoftLine, SoftMoveTo, SoftLineTo,
+
+    SoftStartTrace, SoftContinueTrace, SoftEndTrace,
+
+    SoftText, SoftTextWidth, SoftTextHeight,
+    SoftRectangle, SoftFilledRectangle,
+    SoftCircle, SoftFilledCircle,
+
+    SoftStartPolygon,
+    SoftAddVertex,
+    SoftOutlinePolygon,
+    SoftFillPolygon,
+
+    SoftErase, SoftEraseRectangle,
+    SoftLineStyle, SoftLinePattern,
+    SoftColor, SoftColorRGB, SoftAlu,
+    SoftPenSize,
+    SoftInit, SoftActivate, SoftSwap, SoftClose, SoftHardcopy, SoftInput,
+    SOLID,						/* Line Pattern */
+    SET,						/* ALU */
+    FOREGROUND,					/* Color */
+    FALSE,						/* Black and White */
+    3,							/* Symbol Size (radius) */
+    -1, -1,						/* Desired Width and Height */
+	0, 0,						/* Desired Left and Top */
+    NULL, NULL, NO,				/* Redraw cache */
+	NULL,						/* Linked list next element */
+    &_soft_params
+};
+Display		SoftDisplay = &_SoftDisplay;	// Pointer to the static SoftDisplay.
+Display		_soft_display_list = NULL;		// Pointer to a list of dynamic SoftDisplays.
+
+/***************************************************************************/
+
+Display CreateSoftDisplay( void ) {
+
+	SoftParams	*params;
+	Display		display;
+
+	// Allocate memory for an new instance.
+	params = calloc( 1, sizeof( SoftParams ) );
+	if ( !params ) {
+		fprintf( stderr, "Error allocating memory for SoftParams.\n" );
+		exit( -100 );
+	}
+	params->name = "Dynamic SoftDisplay";
+	display = malloc( sizeof( *display ) );
+	if ( !display ) {
+		fprintf( stderr, "Error allocating memory for Display.\n" );
+		exit( -101 );
+	}
+	// Add newly created instance to the list of SoftDisplays.
+	memcpy( display, SoftDisplay, sizeof( *display ) );
+	display->parameters = params;
+	display->cache = display->last_cache = NULL;
+	display->cache_active = NO;
+	display->next = _soft_display_list;
+	_soft_display_list = display;
+
+	return( display );
+
+}
+
+void DestroySoftDisplays( void ) {
+
+	Display display = _soft_display_list;
+	Display display_to_kill;
+
+	while ( display ) {
+		SoftClose( display );
+		free( display->parameters );
+		display_to_kill = display;
+		display = display->next;
+		free( display_to_kill );
+	}
+	_soft_display_list = NULL;
+
+}
+
+/***************************************************************************/
+
+void	SoftInit ( Display display ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+
+  int width, height;
+
+  if ( display->desired_width < 0 ) width = SOFT_DISPLAY_WIDTH;
+  else width = (int) display->desired_width;
+  if ( display->desired_height < 0 ) height = ( width * 3 ) / 4;
+  else height = (int) display->desired_height;
+
+  // Allocate the image. If we are being initialized a second time, start over.
+  if ( params->pixels ) free( params->pixels );
+  params->pixels = malloc( (size_t) width * (size_t) height * 4 );
+  if ( !params->pixels ) {
+	fprintf( stderr, "Error allocating %d x %d image for %s.\n", width, height, display->name );
+	exit( -102 );
+  }
+  params->width = width;
+  params->height = height;
+
+  // Set the screen edges.
+  display->left = 0.0;
+  display->right = (float) width;
+  display->top = (float) height;
+  display->bottom = 0.0;
+
+  params->rgba[0] = params->rgba[1] = params->rgba[2] = 0;
+  params->rgba[3] = 255;
+  params->pen = 1.0;
+  params->alu = SET;
+  params->antialias = YES;
+  params->vertex_count = 0;
+  params->last_x = params->last_y = 0.0;
+
+  // The same gaussian falloff that is used for the OpenGL textures.
+  AAIntensityProfile( params->profile, SOFT_AA_PROFILE_SIZE );
+
+  // Initialize the redraw linked list.
+  DisplayInitCache( display );
+
+}
+
+void SoftActivate( Display display ) {}
+void SoftSwap ( Display display ) {}
+
+void SoftClose ( Display display ) {
+
+	register SoftParams	*params = (SoftParams *) display->parameters;
+
+	DisplayFreeCache( display );
+	if ( params->pixels ) free( params->pixels );
+	params->pixels = NULL;
+
+}
+
+int	SoftInput( Display display, float *x, float *y ) {
+  return( 0 );
+}
+
+/***************************************************************************/
+
+unsigned char *SoftDisplayPixels( Display display ) {
+	return( ((SoftParams *) display->parameters)->pixels );
+}
+
+int SoftDisplayWidth( Display display ) {
+	return( ((SoftParams *) display->parameters)->width );
+}
+
+int SoftDisplayHeight( Display display ) {
+	return( ((SoftParams *) display->parameters)->height );
+}
+
+void SoftDisplaySetAntialiasing( Display display, int on ) {
+	((SoftParams *) display->parameters)->antialias = on;
+}
+
+// Write the image as a binary PPM file. The format is trivial to produce and
+//  any image tool can convert it to PNG or JPEG afterwards.
+int SoftDisplayWritePPM( Display display, char *filename ) {
+
+	register SoftParams	*params = (SoftParams *) display->parameters;
+
+	FILE	*fp;
+	unsigned char *row, *src, *dst;
+	int		i, j;
+
+	fp = fopen( filename, "wb" );
+	if ( !fp ) {
+		fprintf( stderr, "Error opening %s for write.\n", filename );
+		return( FAILURE );
+	}
+	row = malloc( params->width * 3 );
+	if ( !row ) {
+		fprintf( stderr, "Error allocating memory for PPM output.\n" );
+		fclose( fp );
+		return( FAILURE );
+	}
+	fprintf( fp, "P6\n%d %d\n255\n", params->width, params->height );
+	for ( j = 0; j < params->height; j++ ) {
+		src = params->pixels + (size_t) j * params->width * 4;
+		dst = row;
+		for ( i = 0; i < params->width; i++ ) {
+			*dst++ = *src++;
+			*dst++ = *src++;
+			*dst++ = *src++;
+			src++;
+		}
+		fwrite( row, 3, params->width, fp );
+	}
+	free( row );
+	fclose( fp );
+	return( SUCCESS );
+
+}
+
+void SoftHardcopy ( Display display, char *filename ) {
+
+	fprintf( stderr, "%s open for write ...", filename );
+	if ( SoftDisplayWritePPM( display, filename ) == SUCCESS ) fprintf( stderr, "OK.\n" );
+
+}
+
+/***************************************************************************/
+
+/*
+ * Low level pixel operations.
+ * Pixel (i,j) covers the area from i to i+1 and from j to j+1 in display
+ * coordinates. The image itself is stored with the top row first.
+ */
+
+local void soft_blend( SoftParams *params, int i, int j, int coverage ) {
+
+	unsigned char	*pixel;
+	int				k, alpha;
+
+	if ( i < 0 || j < 0 || i >= params->width || j >= params->height ) return;
+	pixel = params->pixels + ( (size_t) ( params->height - 1 - j ) * params->width + i ) * 4;
+
+	if ( params->alu == XOR ) {
+		if ( coverage > 127 ) for ( k = 0; k < 3; k++ ) pixel[k] ^= 0xff;
+		return;
+	}
+	alpha = ( coverage * params->rgba[3] ) / 255;
+	if ( alpha >= 255 ) {
+		pixel[0] = params->rgba[0];
+		pixel[1] = params->rgba[1];
+		pixel[2] = params->rgba[2];
+	}
+	else if ( alpha > 0 ) {
+		for ( k = 0; k < 3; k++ ) pixel[k] += ( ( params->rgba[k] - pixel[k] ) * alpha ) / 255;
+	}
+	pixel[3] = 255;
+
+}
+
+// Fill all the pixels whose centers fall within the rectangle.
+// Very thin rectangles are widened to one pixel, so that nothing disappears.
+local void soft_fill( SoftParams *params, float x1, float y1, float x2, float y2 ) {
+
+	int		left, right, bottom, top, i, j;
+
+	left = (int) ceil( min( x1, x2 ) - 0.5 );
+	right = (int) floor( max( x1, x2 ) - 0.5 );
+	bottom = (int) ceil( min( y1, y2 ) - 0.5 );
+	top = (int) floor( max( y1, y2 ) - 0.5 );
+	if ( right < left ) right = left = (int) floor( ( x1 + x2 ) / 2.0 );
+	if ( top < bottom ) top = bottom = (int) floor( ( y1 + y2 ) / 2.0 );
+
+	if ( left < 0 ) left = 0;
+	if ( bottom < 0 ) bottom = 0;
+	if ( right >= params->width ) right = params->width - 1;
+	if ( top >= params->height ) top = params->height - 1;
+
+	for ( j = bottom; j <= top; j++ ) {
+		for ( i = left; i <= right; i++ ) soft_blend( params, i, j, 255 );
+	}
+
+}
+
+// Intensity of an antialiased line at a given distance from its center.
+// Inside the width of the pen the line is solid, then it falls off over
+//  the outer half of the texture profile.
+#define SOFT_AA_FRINGE	1.5
+
+local int soft_coverage( SoftParams *params, double distance ) {
+
+	double core = params->pen / 2.0 - 0.5;
+	double u;
+
+	if ( core < 0.0 ) core = 0.0;
+	if ( distance <= core ) return( 255 );
+	u = ( distance - core ) / SOFT_AA_FRINGE;
+	if ( u >= 1.0 ) return( 0 );
+	return( params->profile[ SOFT_AA_PROFILE_SIZE / 2 + (int) ( u * ( SOFT_AA_PROFILE_SIZE / 2 - 1 ) ) ] );
+
+}
+
+// Antialiased line. We step along the major axis one pixel at a time and
+//  spread the intensity across the minor axis according to the perpendicular
+//  distance to the line. This is Wu's approach with the gaussian profile.
+local void soft_aa_line( SoftParams *params, float x1, float y1, float x2, float y2 ) {
+
+	double	dx = x2 - x1, dy = y2 - y1;
+	double	length = sqrt( dx * dx + dy * dy );
+	double	reach, span, secant, slope, along, across, t, c;
+	int		i, j, from, to;
+	float	swap;
+
+	reach = max( params->pen / 2.0 - 0.5, 0.0 ) + SOFT_AA_FRINGE;
+
+	if ( length < 0.001 ) {
+		for ( j = (int) floor( y1 - reach ); j <= (int) floor( y1 + reach ); j++ ) {
+			for ( i = (int) floor( x1 - reach ); i <= (int) floor( x1 + reach ); i++ ) {
+				c = sqrt( ( i + 0.5 - x1 ) * ( i + 0.5 - x1 ) + ( j + 0.5 - y1 ) * ( j + 0.5 - y1 ) );
+				soft_blend( params, i, j, soft_coverage( params, c ) );
+			}
+		}
+		return;
+	}
+
+	if ( fabs( dx ) >= fabs( dy ) ) {
+		if ( x1 > x2 ) {
+			swap = x1; x1 = x2; x2 = swap;
+			swap = y1; y1 = y2; y2 = swap;
+		}
+		slope = ( y2 - y1 ) / ( x2 - x1 );
+		secant = length / fabs( dx );
+		span = reach * secant;
+		from = (int) floor( x1 );
+		to = (int) floor( x2 );
+		if ( from < 0 ) from = 0;
+		if ( to >= params->width ) to = params->width - 1;
+		for ( i = from; i <= to; i++ ) {
+			t = i + 0.5;
+			if ( t < x1 ) t = x1;
+			if ( t > x2 ) t = x2;
+			along = y1 + slope * ( t - x1 );
+			for ( j = (int) floor( along - span ); j <= (int) floor( along + span ); j++ ) {
+				across = fabs( j + 0.5 - along ) / secant;
+				soft_blend( params, i, j, soft_coverage( params, across ) );
+			}
+		}
+	}
+	else {
+		if ( y1 > y2 ) {
+			swap = x1; x1 = x2; x2 = swap;
+			swap = y1; y1 = y2; y2 = swap;
+		}
+		slope = ( x2 - x1 ) / ( y2 - y1 );
+		secant = length / fabs( dy );
+		span = reach * secant;
+		from = (int) floor( y1 );
+		to = (int) floor( y2 );
+		if ( from < 0 ) from = 0;
+		if ( to >= params->height ) to = params->height - 1;
+		for ( j = from; j <= to; j++ ) {
+			t = j + 0.5;
+			if ( t < y1 ) t = y1;
+			if ( t > y2 ) t = y2;
+			along = x1 + slope * ( t - y1 );
+			for ( i = (int) floor( along - span ); i <= (int) floor( along + span ); i++ ) {
+				across = fabs( i + 0.5 - along ) / secant;
+				soft_blend( params, i, j, soft_coverage( params, across ) );
+			}
+		}
+	}
+
+}
+
+// Plain Bresenham line with a square pen, used when antialiasing is turned off.
+local void soft_jaggy_line( SoftParams *params, float x1, float y1, float x2, float y2 ) {
+
+	int		i = (int) floor( x1 ), j = (int) floor( y1 );
+	int		i2 = (int) floor( x2 ), j2 = (int) floor( y2 );
+	int		di = abs( i2 - i ), dj = - abs( j2 - j );
+	int		si = i < i2 ? 1 : -1, sj = j < j2 ? 1 : -1;
+	int		error = di + dj, e2;
+	int		half = (int) ( params->pen / 2.0 ), a, b;
+
+	while ( 1 ) {
+		for ( b = - half; b <= half; b++ ) {
+			for ( a = - half; a <= half; a++ ) soft_blend( params, i + a, j + b, 255 );
+		}
+		if ( i == i2 && j == j2 ) break;
+		e2 = 2 * error;
+		if ( e2 >= dj ) { error += dj; i += si; }
+		if ( e2 <= di ) { error += di; j += sj; }
+	}
+
+}
+
+local void soft_line( SoftParams *params, float x1, float y1, float x2, float y2 ) {
+	if ( params->antialias && params->alu != XOR ) soft_aa_line( params, x1, y1, x2, y2 );
+	else soft_jaggy_line( params, x1, y1, x2, y2 );
+}
+
+// Even-odd scanline fill of the current polygon.
+local void soft_fill_polygon( SoftParams *params ) {
+
+	double	crossing[SOFT_MAX_POLY_POINTS], y, hold, x1, y1, x2, y2;
+	double	low, high;
+	int		n = params->vertex_count, crossings, i, j, k, from, to;
+
+	if ( n < 3 ) return;
+
+	low = high = params->vertex[0].y;
+	for ( k = 1; k < n; k++ ) {
+		if ( params->vertex[k].y < low ) low = params->vertex[k].y;
+		if ( params->vertex[k].y > high ) high = params->vertex[k].y;
+	}
+	from = (int) ceil( low - 0.5 );
+	to = (int) floor( high - 0.5 );
+	if ( from < 0 ) from = 0;
+	if ( to >= params->height ) to = params->height - 1;
+
+	for ( j = from; j <= to; j++ ) {
+		y = j + 0.5;
+		crossings = 0;
+		for ( k = 0; k < n; k++ ) {
+			x1 = params->vertex[k].x;
+			y1 = params->vertex[k].y;
+			x2 = params->vertex[ ( k + 1 ) % n ].x;
+			y2 = params->vertex[ ( k + 1 ) % n ].y;
+			if ( ( y1 <= y && y2 > y ) || ( y2 <= y && y1 > y ) ) {
+				crossing[crossings++] = x1 + ( y - y1 ) * ( x2 - x1 ) / ( y2 - y1 );
+			}
+		}
+		// Insertion sort. There are never very many crossings.
+		for ( k = 1; k < crossings; k++ ) {
+			hold = crossing[k];
+			for ( i = k - 1; i >= 0 && crossing[i] > hold; i-- ) crossing[i+1] = crossing[i];
+			crossing[i+1] = hold;
+		}
+		for ( k = 0; k + 1 < crossings; k += 2 ) {
+			for ( i = (int) ceil( crossing[k] - 0.5 ); i <= (int) floor( crossing[k+1] - 0.5 ); i++ ) {
+				soft_blend( params, i, j, 255 );
+			}
+		}
+	}
+
+}
+
+local DisplayCacheItem *soft_cache( Display display, Token token ) {
+
+	DisplayCacheItem *item = NULL;
+
+	if ( display->cache_active ) {
+		item = DisplayInsertCacheItem( display );
+		item->token = token;
+	}
+	return( item );
+
+}
+
+/***************************************************************************/
+
+void	SoftErase ( Display display ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+
+  // Erase to white, like the screen.
+  if ( params->pixels ) memset( params->pixels, 0xff, (size_t) params->width * params->height * 4 );
+  if ( display->cache_active ) {
+    DisplayInitCache( display );
+  }
+
+}
+
+void	SoftPoint ( Display display, float x, float y) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  soft_blend( params, (int) floor( x ), (int) floor( y ), 255 );
+
+  params->last_x = x;
+  params->last_y = y;
+
+  if ( ( item = soft_cache( display, point_token ) ) ) {
+    item->param.point.x = x;
+    item->param.point.y = y;
+  }
+
+}
+
+void	SoftLine	( Display display, float x1, float y1, float x2, float y2) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  soft_line( params, x1, y1, x2, y2 );
+
+  params->last_x = x2;
+  params->last_y = y2;
+
+  if ( ( item = soft_cache( display, line_token ) ) ) {
+    item->param.line.x1 = x1;
+    item->param.line.y1 = y1;
+    item->param.line.x2 = x2;
+    item->param.line.y2 = y2;
+  }
+
+}
+
+void	SoftMoveTo ( Display display, float x, float y) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  params->last_x = x;
+  params->last_y = y;
+
+  if ( ( item = soft_cache( display, moveto_token ) ) ) {
+    item->param.point.x = x;
+    item->param.point.y = y;
+  }
+
+}
+
+void	SoftLineTo	( Display display, float x2, float y2 ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  soft_line( params, params->last_x, params->last_y, x2, y2 );
+
+  if ( ( item = soft_cache( display, lineto_token ) ) ) {
+    item->param.point.x = x2;
+    item->param.point.y = y2;
+  }
+
+  params->last_x = x2;
+  params->last_y = y2;
+
+}
+
+/***************************************************************************/
+
+/*
+ * Traces are only generated when walking the cache, so they are not cached themselves.
+ */
+
+void	SoftStartTrace	( Display display, float x, float y ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  params->last_x = x;
+  params->last_y = y;
+
+}
+
+void	SoftContinueTrace	( Display display, float x, float y ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  soft_line( params, params->last_x, params->last_y, x, y );
+  params->last_x = x;
+  params->last_y = y;
+
+}
+
+void	SoftEndTrace	( Display display, float x, float y ) {
+  SoftContinueTrace( display, x, y );
+}
+
+/***************************************************************************/
+
+void	SoftRectangle	( Display display, float x1, float y1, float x2, float y2) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  soft_line( params, x1, y1, x1, y2 );
+  soft_line( params, x1, y2, x2, y2 );
+  soft_line( params, x2, y2, x2, y1 );
+  soft_line( params, x2, y1, x1, y1 );
+
+  params->last_x = x2;
+  params->last_y = y2;
+
+  if ( ( item = soft_cache( display, rectangle_token ) ) ) {
+    item->param.rectangle.left = x1;
+    item->param.rectangle.bottom = y1;
+    item->param.rectangle.right = x2;
+    item->param.rectangle.top = y2;
+  }
+
+}
+
+void	SoftFilledRectangle ( Display display, float x1, float y1, float x2, float y2) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  soft_fill( params, x1, y1, x2, y2 );
+
+  params->last_x = x2;
+  params->last_y = y2;
+
+  if ( ( item = soft_cache( display, filled_rectangle_token ) ) ) {
+    item->param.rectangle.left = x1;
+    item->param.rectangle.bottom = y1;
+    item->param.rectangle.right = x2;
+    item->param.rectangle.top = y2;
+  }
+
+}
+
+void	SoftEraseRectangle ( Display display, float x1, float y1, float x2, float y2) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+  unsigned char hold[4];
+  int	alu = params->alu;
+
+  /* Erase to white. */
+  memcpy( hold, params->rgba, sizeof( hold ) );
+  params->rgba[0] = params->rgba[1] = params->rgba[2] = params->rgba[3] = 255;
+  params->alu = SET;
+  soft_fill( params, x1, y1, x2, y2 );
+  memcpy( params->rgba, hold, sizeof( hold ) );
+  params->alu = alu;
+
+  params->last_x = x2;
+  params->last_y = y2;
+
+  if ( ( item = soft_cache( display, erase_rectangle_token ) ) ) {
+    item->param.rectangle.left = x1;
+    item->param.rectangle.bottom = y1;
+    item->param.rectangle.right = x2;
+    item->param.rectangle.top = y2;
+  }
+
+}
+
+/***************************************************************************/
+
+void	SoftCircle	(Display display, float x, float y, float radius ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+  int		segments, k;
+  double	angle, px, py, qx, qy;
+
+  // Enough segments that each one is a couple of pixels long.
+  segments = (int) ( Pi * radius );
+  if ( segments < 12 ) segments = 12;
+  if ( segments > SOFT_MAX_POLY_POINTS ) segments = SOFT_MAX_POLY_POINTS;
+  px = x + radius;
+  py = y;
+  for ( k = 1; k <= segments; k++ ) {
+    angle = 2.0 * Pi * k / segments;
+    qx = x + radius * cos( angle );
+    qy = y + radius * sin( angle );
+    soft_line( params, px, py, qx, qy );
+    px = qx;
+    py = qy;
+  }
+
+  if ( ( item = soft_cache( display, circle_token ) ) ) {
+    item->param.circle.x = x;
+    item->param.circle.y = y;
+    item->param.circle.radius = radius;
+  }
+
+}
+
+void	SoftFilledCircle	(Display display, float x, float y, float radius ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+  int		i, j, from, to;
+  double	dy, half;
+
+  from = (int) ceil( y - radius - 0.5 );
+  to = (int) floor( y + radius - 0.5 );
+  for ( j = from; j <= to; j++ ) {
+    dy = j + 0.5 - y;
+    half = sqrt( max( radius * radius - dy * dy, 0.0 ) );
+    for ( i = (int) ceil( x - half - 0.5 ); i <= (int) floor( x + half - 0.5 ); i++ ) {
+      soft_blend( params, i, j, 255 );
+    }
+  }
+
+  if ( ( item = soft_cache( display, filled_circle_token ) ) ) {
+    item->param.circle.x = x;
+    item->param.circle.y = y;
+    item->param.circle.radius = radius;
+  }
+
+}
+
+/***************************************************************************/
+
+void	SoftStartPolygon ( Display display ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  params->vertex_count = 0;
+  soft_cache( display, start_polygon_token );
+
+}
+
+void	SoftAddVertex ( Display display, float x, float y ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  if ( params->vertex_count < SOFT_MAX_POLY_POINTS ) {
+    params->vertex[ params->vertex_count ].x = x;
+    params->vertex[ params->vertex_count ].y = y;
+    params->vertex_count++;
+  }
+  if ( ( item = soft_cache( display, add_vertex_token ) ) ) {
+    item->param.point.x = x;
+    item->param.point.y = y;
+  }
+
+}
+
+void	SoftOutlinePolygon ( Display display ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  int i, n = params->vertex_count;
+
+  for ( i = 0; i < n && n > 1; i++ ) {
+    soft_line( params, params->vertex[i].x, params->vertex[i].y,
+      params->vertex[ ( i + 1 ) % n ].x, params->vertex[ ( i + 1 ) % n ].y );
+  }
+  soft_cache( display, outline_polygon_token );
+
+}
+
+void	SoftFillPolygon ( Display display ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+
+  soft_fill_polygon( params );
+  soft_cache( display, fill_polygon_token );
+
+}
+
+/***************************************************************************/
+
+/*
+ * A 5x7 bitmap font covering the printable ASCII characters.
+ * Each character is 5 columns, left to right, with the top row in bit 0.
+ */
+
+local unsigned char soft_font[95][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 },	/*   ! */
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7f, 0x14, 0x7f, 0x14 },	/* " # */
+	{ 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },	/* $ % */
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },	/* & ' */
+	{ 0x00, 0x1c, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1c, 0x00 },	/* ( ) */
+	{ 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },	/* * + */
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 },	/* , - */
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },	/* . / */
+	{ 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 },	/* 0 1 */
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 },	/* 2 3 */
+	{ 0x18, 0x14, 0x12, 0x7f, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },	/* 4 5 */
+	{ 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },	/* 6 7 */
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e },	/* 8 9 */
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },	/* : ; */
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },	/* < = */
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },	/* > ? */
+	{ 0x32, 0x49, 0x79, 0x41, 0x3e }, { 0x7e, 0x11, 0x11, 0x11, 0x7e },	/* @ A */
+	{ 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },	/* B C */
+	{ 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 },	/* D E */
+	{ 0x7f, 0x09, 0x09, 0x09, 0x01 }, { 0x3e, 0x41, 0x49, 0x49, 0x7a },	/* F G */
+	{ 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 },	/* H I */
+	{ 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 },	/* J K */
+	{ 0x7f, 0x40, 0x40, 0x40, 0x40 }, { 0x7f, 0x02, 0x0c, 0x02, 0x7f },	/* L M */
+	{ 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },	/* N O */
+	{ 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e },	/* P Q */
+	{ 0x7f, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },	/* R S */
+	{ 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f },	/* T U */
+	{ 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f },	/* V W */
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 },	/* X Y */
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },	/* Z [ */
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 },	/* \ ] */
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },	/* ^ _ */
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },	/* ` a */
+	{ 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },	/* b c */
+	{ 0x38, 0x44, 0x44, 0x48, 0x7f }, { 0x38, 0x54, 0x54, 0x54, 0x18 },	/* d e */
+	{ 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x0c, 0x52, 0x52, 0x52, 0x3e },	/* f g */
+	{ 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 },	/* h i */
+	{ 0x20, 0x40, 0x44, 0x3d, 0x00 }, { 0x7f, 0x10, 0x28, 0x44, 0x00 },	/* j k */
+	{ 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 },	/* l m */
+	{ 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },	/* n o */
+	{ 0x7c, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7c },	/* p q */
+	{ 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },	/* r s */
+	{ 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c },	/* t u */
+	{ 0x1c, 0x20, 0x40, 0x20, 0x1c }, { 0x3c, 0x40, 0x30, 0x40, 0x3c },	/* v w */
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c },	/* x y */
+	{ 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },	/* z { */
+	{ 0x00, 0x00, 0x7f, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 },	/* | } */
+	{ 0x08, 0x04, 0x08, 0x10, 0x08 }										/* ~   */
+};
+
+// Text is drawn with its baseline at y. Direction is respected, although
+//  only multiples of 90 degrees give clean results with a bitmap font.
+void	SoftText	( Display display, char *string, float x, float y, double dir ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+  double	c = cos( dir ), s = sin( dir ), u, v;
+  int		n, col, row, glyph;
+
+  for ( n = 0; string[n]; n++ ) {
+    glyph = string[n] - ' ';
+    if ( glyph < 0 || glyph >= 95 ) continue;
+    for ( col = 0; col < 5; col++ ) {
+      for ( row = 0; row < 7; row++ ) {
+        if ( !( soft_font[glyph][col] & ( 1 << row ) ) ) continue;
+        u = n * SOFT_FONT_WIDTH + col + 0.5;
+        v = 6 - row + 0.5;
+        soft_blend( params, (int) floor( x + u * c - v * s ), (int) floor( y + u * s + v * c ), 255 );
+      }
+    }
+  }
+
+  if ( ( item = soft_cache( display, text_token ) ) ) {
+    item->param.text.x = x;
+    item->param.text.y = y;
+    item->param.text.dir = dir;
+    item->param.text.string = _strdup( string );
+  }
+
+}
+
+float	SoftTextWidth ( Display display, char *string ) {
+  return( (float) ( SOFT_FONT_WIDTH * strlen( string ) ) );
+}
+
+float	SoftTextHeight ( Display display, char *string ) {
+  return( (float) SOFT_FONT_HEIGHT );
+}
+
+/***************************************************************************/
+
+void	SoftAlu	( Display display, int alu) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  params->alu = alu;
+  if ( ( item = soft_cache( display, alu_token ) ) ) item->param.alu = alu;
+
+}
+
+void	SoftLineStyle ( Display display, int style ) {}
+void	SoftLinePattern	( Display display, int pattern ) {}
+
+void	SoftPenSize ( Display display, float size) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  params->pen = ( size < 1.0 ? 1.0 : size );
+  if ( ( item = soft_cache( display, pen_token ) ) ) item->param.pen = (int) size;
+
+}
+
+/***************************************************************************/
+
+// Color
+
+local unsigned char SoftColorTable[][4] = {
+
+  {   0,   0,   0, 255 },	/* Black	*/
+  { 255,   0,   0, 255 },	/* Red		*/
+  {   0, 255,   0, 255 },	/* Green	*/
+  { 255, 255,   0, 255 },	/* Yellow	*/
+  {   0,   0, 255, 255 },	/* Blue		*/
+  { 255,   0, 255, 255 },	/* Magenta	*/
+  {   0, 255, 255, 255 },	/* Cyan		*/
+  { 255, 255, 255, 255 },	/* White	*/
+
+  {  32,  32,  32, 255 },	/* Grey1	*/
+  {  64,  64,  64, 255 },	/* Grey2	*/
+  {  96,  96,  96, 255 },	/* Grey3	*/
+  { 128, 128, 128, 255 },	/* Grey4	*/
+  { 160, 160, 160, 255 },	/* Grey5	*/
+  { 191, 191, 191, 255 },	/* Grey6	*/
+  { 223, 223, 223, 255 },	/* Grey7	*/
+  { 255, 255, 255, 255 },	/* Grey8	*/
+
+  {   0,   0,   0,   0 },	/* TRANSPARENT */
+
+};
+
+void	SoftColor ( Display display, int color) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  if ( color < 0 || color > TRANSPARENT_COLOR ) color = FOREGROUND;
+  memcpy( params->rgba, SoftColorTable[color], sizeof( params->rgba ) );
+
+  if ( ( item = soft_cache( display, color_token ) ) ) item->param.color = color;
+
+}
+
+void	SoftColorRGB ( Display display, float r, float g, float b ) {
+
+  register SoftParams	*params = (SoftParams *) display->parameters;
+  DisplayCacheItem *item;
+
+  params->rgba[0] = (unsigned char) ( 255.0 * min( max( r, 0.0 ), 1.0 ) + 0.5 );
+  params->rgba[1] = (unsigned char) ( 255.0 * min( max( g, 0.0 ), 1.0 ) + 0.5 );
+  params->rgba[2] = (unsigned char) ( 255.0 * min( max( b, 0.0 ), 1.0 ) + 0.5 );
+  params->rgba[3] = 255;
+
+  if ( ( item = soft_cache( display, rgb_token ) ) ) {
+    item->param.rgb.r = r;
+    item->param.rgb.g = g;
+    item->param.rgb.b = b;
+  }
+
+}
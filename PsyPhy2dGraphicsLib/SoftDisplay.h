@@ -0,0 +1,118 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                              SoftDisplay.h                                */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+	A Display that draws into an RGBA image in memory, without any help from
+	a graphics card or a window system. Useful for producing thumbnails and
+	reports in batch mode, on machines that have no screen at all.
+*/
+
+#ifndef	_SOFTDISPLAY_
+
+#include "Displays.h"
+#include "Graphics.h"
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern	Display SoftDisplay;
+
+Display CreateSoftDisplay( void );
+void DestroySoftDisplays( void );
+
+/* Access to the rendered image. Rows are stored from top to bottom, 4 bytes per pixel. */
+
+unsigned char *SoftDisplayPixels( Display display );
+int		SoftDisplayWidth( Display display );
+int		SoftDisplayHeight( Display display );
+int		SoftDisplayWritePPM( Display display, char *filename );
+void	SoftDisplaySetAntialiasing( Display display, int on );
+
+void	SoftInit( Display display );
+void	SoftActivate( Display display );
+void	SoftSwap ( Display display );
+
+void	SoftClose( Display display );
+void	SoftHardcopy ( Display display, char *filename );
+
+int		SoftInput( Display display, float *x, float *y );
+void	SoftPoint ( Display display, float x, float y);
+void	SoftLine	( Display display, float x1, float y1, float x2, float y2);
+void	SoftMoveTo ( Display display, float x1, float y1);
+void	SoftLineTo	( Display display, float x2, float y2 );
+
+void	SoftStartTrace	( Display display, float x, float y );
+void	SoftContinueTrace	( Display display, float x, float y );
+void	SoftEndTrace	( Display display, float x, float y );
+
+void	SoftText	( Display display, char *string,
+				  float x, float y, double dir );
+float	SoftTextWidth ( Display display, char *string );
+float	SoftTextHeight ( Display display, char *string );
+void	SoftRectangle	( Display display,
+						  float x1, float y1, float x2, float y2);
+void	SoftFilledRectangle ( Display display,
+							 float x1, float y1, float x2, float y2);
+void	SoftCircle	(Display display, float x, float y, float radius );
+void	SoftFilledCircle	(Display display, float x, float y, float radius );
+void	SoftEraseRectangle ( Display display,
+							float x1, float y1, float x2, float y2);
+void	SoftErase ( Display display);
+void	SoftAlu	( Display display, int alu);
+void	SoftLineStyle ( Display display, int style );
+void	SoftLinePattern	( Display display, int pattern );
+void	SoftColor ( Display display, int color);
+void	SoftColorRGB ( Display display, float r, float g, float b );
+void	SoftPenSize ( Display display, float size);
+void	SoftStartPolygon ( Display display );
+void	SoftAddVertex ( Display display, float x, float y );
+void	SoftOutlinePolygon ( Display display );
+void	SoftFillPolygon ( Display display );
+
+#ifdef __cplusplus
+}
+#endif
+
+#define SOFT_MAX_POLY_POINTS	255
+#define SOFT_AA_PROFILE_SIZE	256
+
+/* The built-in font is 5x7 pixels in a 6x10 cell. */
+#define SOFT_FONT_WIDTH		6
+#define SOFT_FONT_HEIGHT	10
+
+typedef struct {
+
+  char		*name;
+
+  int		width;
+  int		height;
+  unsigned char *pixels;
+
+  unsigned char rgba[4];
+  float		pen;
+  int		alu;
+  int		antialias;
+
+  struct {
+	float x;
+	float y;
+  } vertex[SOFT_MAX_POLY_POINTS];
+  int   vertex_count;
+
+  float last_x;
+  float last_y;
+
+  unsigned char profile[SOFT_AA_PROFILE_SIZE];
+
+} SoftParams;
+
+#define SOFT_DISPLAY_WIDTH	900
+
+#define _SOFTDISPLAY_
+#endif
@@ -0,0 +1,331 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                               SoftTiles.c                                 */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+ * Parallel rendering of independent Views into a SoftDisplay.
+ *
+ * Each worker thread starts with its own share of the tiles. It takes tiles
+ * from the front of its own queue and, when that is empty, steals from the
+ * back of the queue of another worker. The strip charts are not equally
+ * expensive (a trace with 3 components costs three times as much as one
+ * with a single component), so this keeps all of the cores busy until the end.
+ *
+ * Nothing in the Views and Displays code shared between tiles is modified
+ * while drawing, with the exception of the list of Views that is used to
+ * free them. All Views and Displays are therefore created before the workers
+ * are started.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "useful.h"
+#include "Graphics.h"
+#include "Displays.h"
+#include "Views.h"
+#include "SoftDisplay.h"
+#include "SoftTiles.h"
+#include "../Useful/Trace.h"
+
+/***************************************************************************/
+
+// Minimal portable locks and threads.
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION	SoftLock;
+#define SoftLockInit(l)		InitializeCriticalSection(l)
+#define SoftLockFree(l)		DeleteCriticalSection(l)
+#define SoftLockTake(l)		EnterCriticalSection(l)
+#define SoftLockGive(l)		LeaveCriticalSection(l)
+typedef HANDLE				SoftThread;
+#else
+typedef pthread_mutex_t		SoftLock;
+#define SoftLockInit(l)		pthread_mutex_init( l, NULL )
+#define SoftLockFree(l)		pthread_mutex_destroy(l)
+#define SoftLockTake(l)		pthread_mutex_lock(l)
+#define SoftLockGive(l)		pthread_mutex_unlock(l)
+typedef pthread_t			SoftThread;
+#endif
+
+int SoftProcessorCount( void ) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return( (int) info.dwNumberOfProcessors );
+#else
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return( n > 0 ? (int) n : 1 );
+#endif
+}
+
+/***************************************************************************/
+
+// Each worker owns a range of indices into a common array of tile numbers.
+// The owner takes from the head, thieves take from the tail.
+
+typedef struct {
+	SoftLock	lock;
+	int			head;
+	int			tail;
+} SoftQueue;
+
+typedef struct {
+	SoftTile	*tile;
+	int			*order;
+	SoftQueue	queue[SOFT_MAX_THREADS];
+	int			workers;
+} SoftPool;
+
+typedef struct {
+	SoftPool	*pool;
+	int			id;
+} SoftWorker;
+
+local int soft_take( SoftQueue *queue, int *order, int from_tail ) {
+
+	int which = -1;
+
+	SoftLockTake( &queue->lock );
+	if ( queue->head < queue->tail ) {
+		if ( from_tail ) which = order[ --queue->tail ];
+		else which = order[ queue->head++ ];
+	}
+	SoftLockGive( &queue->lock );
+	return( which );
+
+}
+
+local int soft_steal( SoftPool *pool, int thief ) {
+
+	int victim, k, largest, remaining, which;
+
+	// Rob whoever has the most left to do.
+	while ( 1 ) {
+		victim = -1;
+		largest = 0;
+		for ( k = 0; k < pool->workers; k++ ) {
+			if ( k == thief ) continue;
+			SoftLockTake( &pool->queue[k].lock );
+			remaining = pool->queue[k].tail - pool->queue[k].head;
+			SoftLockGive( &pool->queue[k].lock );
+			if ( remaining > largest ) {
+				largest = remaining;
+				victim = k;
+			}
+		}
+		if ( victim < 0 ) return( -1 );
+		// Someone else may have emptied the queue since we looked, so try again if needed.
+		if ( ( which = soft_take( &pool->queue[victim], pool->order, YES ) ) >= 0 ) return( which );
+	}
+
+}
+
+local void soft_render_one( SoftTile *tile ) {
+	// Erases and resets color, pen, etc.
+	DisplaySetDefaults( tile->display );
+	(*tile->render)( tile->view, tile->data );
+}
+
+local void soft_worker( SoftWorker *worker ) {
+
+	SoftPool	*pool = worker->pool;
+	int			which;
+
+	while ( ( which = soft_take( &pool->queue[worker->id], pool->order, NO ) ) >= 0 ||
+			( which = soft_steal( pool, worker->id ) ) >= 0 ) {
+		soft_render_one( &pool->tile[which] );
+	}
+
+}
+
+// The threads are started anew for each call of SoftRenderTiles(). The rendering routines
+//  may be traced, so each thread gives up its trace ring as it ends (see Trace.h).
+#ifdef _WIN32
+local DWORD WINAPI soft_thread( LPVOID arg ) {
+#else
+local void *soft_thread( void *arg ) {
+#endif
+	soft_worker( (SoftWorker *) arg );
+	TRACE_THREAD_END();
+	return( 0 );
+}
+
+/***************************************************************************/
+
+void SoftTileInit( SoftTile *tile, double left, double bottom, double right, double top, SoftTileRoutine render, void *data ) {
+
+	tile->left = left;
+	tile->bottom = bottom;
+	tile->right = right;
+	tile->top = top;
+	tile->render = render;
+	tile->data = data;
+	tile->display = NULL;
+	tile->view = NULL;
+
+}
+
+// Set up a tile that covers the same rectangle as a View of the target.
+void SoftTileFromView( SoftTile *tile, View view, SoftTileRoutine render, void *data ) {
+
+	Display display = view->display;
+	double width = display->right - display->left;
+	double height = display->top - display->bottom;
+
+	SoftTileInit( tile, 
+		( min( view->display_left, view->display_right ) - display->left ) / width,
+		( min( view->display_top, view->display_bottom ) - display->bottom ) / height,
+		( max( view->display_left, view->display_right ) - display->left ) / width,
+		( max( view->display_top, view->display_bottom ) - display->bottom ) / height,
+		render, data );
+
+}
+
+// Compute the pixel rectangle of a tile within the target.
+local void soft_tile_pixels( Display target, SoftTile *tile, int *left, int *bottom, int *width, int *height ) {
+
+	int target_width = SoftDisplayWidth( target );
+	int target_height = SoftDisplayHeight( target );
+
+	*left = (int) floor( tile->left * target_width + 0.5 );
+	*bottom = (int) floor( tile->bottom * target_height + 0.5 );
+	*width = (int) floor( tile->right * target_width + 0.5 ) - *left;
+	*height = (int) floor( tile->top * target_height + 0.5 ) - *bottom;
+	if ( *width < 1 ) *width = 1;
+	if ( *height < 1 ) *height = 1;
+
+}
+
+// Make sure that the tile has a private display of the right size and a view that covers it.
+local void soft_tile_prepare( Display target, SoftTile *tile ) {
+
+	int left, bottom, width, height;
+
+	soft_tile_pixels( target, tile, &left, &bottom, &width, &height );
+
+	if ( !tile->display ) tile->display = CreateSoftDisplay();
+	if ( tile->display->desired_width != width || tile->display->desired_height != height ) {
+		DisplaySetSizePixels( tile->display, width, height );
+		DisplayInit( tile->display );
+		// Tiles are redrawn from scratch each time, so there is no need for a redraw cache.
+		DisplayFreeCache( tile->display );
+		if ( tile->view ) DestroyView( tile->view );
+		tile->view = NULL;
+	}
+	if ( !tile->view ) tile->view = CreateView( tile->display );
+
+}
+
+// Copy the tile image into the target.
+local void soft_tile_composite( Display target, SoftTile *tile ) {
+
+	int left, bottom, width, height, row, target_row, columns;
+	int target_width = SoftDisplayWidth( target );
+	int target_height = SoftDisplayHeight( target );
+	unsigned char *dst = SoftDisplayPixels( target );
+	unsigned char *src = SoftDisplayPixels( tile->display );
+
+	soft_tile_pixels( target, tile, &left, &bottom, &width, &height );
+	if ( left < 0 || left >= target_width ) return;
+	columns = min( width, target_width - left );
+
+	for ( row = 0; row < height; row++ ) {
+		target_row = target_height - bottom - height + row;
+		if ( target_row < 0 || target_row >= target_height ) continue;
+		memcpy( dst + ( (size_t) target_row * target_width + left ) * 4,
+				src + (size_t) row * width * 4, (size_t) columns * 4 );
+	}
+
+}
+
+// Render all of the tiles, using up to n_threads threads, then composite them into the target.
+// If n_threads is 0 or less, one thread per processor is used.
+// The target must be a SoftDisplay that has been initialized.
+int SoftRenderTiles( Display target, SoftTile tile[], int n_tiles, int n_threads ) {
+
+	SoftPool	pool;
+	SoftWorker	worker[SOFT_MAX_THREADS];
+	SoftThread	thread[SOFT_MAX_THREADS];
+	int			order[256], *order_buffer = order;
+	int			k, w, share, started;
+
+	if ( n_tiles <= 0 ) return( SUCCESS );
+	if ( n_threads <= 0 ) n_threads = SoftProcessorCount();
+	if ( n_threads > n_tiles ) n_threads = n_tiles;
+	if ( n_threads > SOFT_MAX_THREADS ) n_threads = SOFT_MAX_THREADS;
+
+	for ( k = 0; k < n_tiles; k++ ) soft_tile_prepare( target, &tile[k] );
+
+	// Not worth starting threads for just one.
+	if ( n_threads == 1 ) {
+		for ( k = 0; k < n_tiles; k++ ) soft_render_one( &tile[k] );
+	}
+	else {
+
+		if ( n_tiles > sizeof( order ) / sizeof( *order ) ) {
+			order_buffer = malloc( n_tiles * sizeof( int ) );
+			if ( !order_buffer ) {
+				fprintf( stderr, "Error allocating memory for %d tiles.\n", n_tiles );
+				return( FAILURE );
+			}
+		}
+		for ( k = 0; k < n_tiles; k++ ) order_buffer[k] = k;
+
+		// Deal out contiguous shares of the tiles to each worker.
+		pool.tile = tile;
+		pool.order = order_buffer;
+		pool.workers = n_threads;
+		share = ( n_tiles + n_threads - 1 ) / n_threads;
+		for ( w = 0; w < n_threads; w++ ) {
+			SoftLockInit( &pool.queue[w].lock );
+			pool.queue[w].head = min( w * share, n_tiles );
+			pool.queue[w].tail = min( ( w + 1 ) * share, n_tiles );
+			worker[w].pool = &pool;
+			worker[w].id = w;
+		}
+
+		// The calling thread does its share too.
+		for ( started = 1; started < n_threads; started++ ) {
+			w = started;
+#ifdef _WIN32
+			thread[w] = CreateThread( NULL, 0, soft_thread, &worker[w], 0, NULL );
+			if ( !thread[w] ) {
+#else
+			if ( pthread_create( &thread[w], NULL, soft_thread, &worker[w] ) ) {
+#endif
+				// Its share of the tiles will be stolen by the others.
+				fprintf( stderr, "Could not start rendering thread %d.\n", w );
+				break;
+			}
+		}
+		soft_worker( &worker[0] );
+		for ( k = 1; k < started; k++ ) {
+#ifdef _WIN32
+			WaitForSingleObject( thread[k], INFINITE );
+			CloseHandle( thread[k] );
+#else
+			pthread_join( thread[k], NULL );
+#endif
+		}
+		for ( w = 0; w < n_threads; w++ ) SoftLockFree( &pool.queue[w].lock );
+		if ( order_buffer != order ) free( order_buffer );
+	}
+
+	for ( k = 0; k < n_tiles; k++ ) soft_tile_composite( target, &tile[k] );
+	return( SUCCESS );
+
+}
@@ -0,0 +1,55 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                               SoftTiles.h                                 */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+	Render independent Views in parallel with the software rasterizer.
+	Each tile is a rectangle of a SoftDisplay that gets its own private
+	SoftDisplay and View, so that the drawing routines of different tiles
+	never touch the same memory. The tiles are handed to a small pool of
+	worker threads that steal work from each other, then copied into the
+	target display once they are all done.
+*/
+
+#ifndef	_SOFTTILES_
+
+#include "Displays.h"
+#include "Views.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*SoftTileRoutine)( View view, void *data );
+
+typedef struct {
+
+	/* Filled in by the caller. Edges are relative to the target, as for ViewSetDisplayEdgesRelative(). */
+	double	left;
+	double	bottom;
+	double	right;
+	double	top;
+	SoftTileRoutine	render;
+	void	*data;
+
+	/* Maintained by SoftRenderTiles(). Set both to NULL before the first call. */
+	Display	display;
+	View	view;
+
+} SoftTile;
+
+#define SOFT_MAX_THREADS	64
+
+void	SoftTileInit( SoftTile *tile, double left, double bottom, double right, double top, SoftTileRoutine render, void *data );
+void	SoftTileFromView( SoftTile *tile, View view, SoftTileRoutine render, void *data );
+int		SoftRenderTiles( Display target, SoftTile tile[], int n_tiles, int n_threads );
+int		SoftProcessorCount( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#define _SOFTTILES_
+#endif
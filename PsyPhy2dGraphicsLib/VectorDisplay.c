@@ -0,0 +1,983 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                             VectorDisplay.c                               */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+ * A Display that writes SVG or PDF as the drawing is done.
+ *
+ * Nothing is kept in memory other than a fixed size output buffer, so
+ * exporting a 12 hour record costs no more memory than exporting a minute.
+ * Consecutive segments drawn with the same color and pen go into the same
+ * path, so that a trace comes out as one <path> element (SVG) or one stroke
+ * operator (PDF) rather than one element per sample. Within a path, all of
+ * the vertices that fall into the same column of the output resolution are
+ * reduced to the extremes and the last one, which is what the screen shows
+ * of them anyway.
+ *
+ * Coordinates follow the OglDisplay conventions: pixels, origin at the bottom left.
+ * One pixel becomes one point in the PDF and one user unit in the SVG.
+ *
+ * No window, graphics card or third party library is needed, so this works
+ * just as well on a Linux batch machine as on the ground station.
+ */
+
+// Disable warnings about unsafe functions.
+// We use the 'unsafe' versions to maintain source-code compatibility with Visual C++ 6
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+
+#include "useful.h"
+#include "Graphics.h"
+#include "Displays.h"
+#include "VectorDisplay.h"
+
+/***************************************************************************/
+
+// Create a static version of a VectorDisplay.
+VectorParams	_vector_params = {"Vector 2D Display"};
+struct _display	_VectorDisplay = {
+  "Vector Display",
+    0, 0, VECTOR_DISPLAY_WIDTH, VECTOR_DISPLAY_WIDTH,
+    VectorPoint, VectorLine, VectorMoveTo, VectorLineTo,
+
+    VectorStartTrace, VectorContinueTrace, VectorEndTrace,
+
+    VectorText, VectorTextWidth, VectorTextHeight,
+    VectorRectangle, VectorFilledRectangle,
+    VectorCircle, VectorFilledCircle,
+
+    VectorStartPolygon,
+    VectorAddVertex,
+    VectorOutlinePolygon,
+    VectorFillPolygon,
+
+    VectorErase, VectorEraseRectangle,
+    VectorLineStyle, VectorLinePattern,
+    VectorColor, VectorColorRGB, VectorAlu,
+    VectorPenSize,
+    VectorInit, VectorActivate, VectorSwap, VectorClose, VectorHardcopy, VectorInput,
+    SOLID,						/* Line Pattern */
+    SET,						/* ALU */
+    FOREGROUND,					/* Color */
+    FALSE,						/* Black and White */
+    3,							/* Symbol Size (radius) */
+    -1, -1,						/* Desired Width and Height */
+	0, 0,						/* Desired Left and Top */
+    NULL, NULL, NO,				/* Redraw cache */
+	NULL,						/* Linked list next element */
+    &_vector_params
+};
+Display		VectorDisplay = &_VectorDisplay;	// Pointer to the static VectorDisplay.
+Display		_vector_display_list = NULL;		// Pointer to a list of dynamic VectorDisplays.
+
+/***************************************************************************/
+
+Display CreateVectorDisplay( void ) {
+
+	VectorParams	*params;
+	Display			display;
+
+	// Allocate memory for an new instance.
+	params = calloc( 1, sizeof( VectorParams ) );
+	if ( !params ) {
+		fprintf( stderr, "Error allocating memory for VectorParams.\n" );
+		exit( -100 );
+	}
+	params->name = "Dynamic VectorDisplay";
+	display = malloc( sizeof( *display ) );
+	if ( !display ) {
+		fprintf( stderr, "Error allocating memory for Display.\n" );
+		exit( -101 );
+	}
+	// Add newly created instance to the list of VectorDisplays.
+	memcpy( display, VectorDisplay, sizeof( *display ) );
+	display->parameters = params;
+	display->cache = display->last_cache = NULL;
+	display->cache_active = NO;
+	display->next = _vector_display_list;
+	_vector_display_list = display;
+
+	return( display );
+
+}
+
+void DestroyVectorDisplays( void ) {
+
+	Display display = _vector_display_list;
+	Display display_to_kill;
+
+	while ( display ) {
+		VectorClose( display );
+		free( display->parameters );
+		display_to_kill = display;
+		display = display->next;
+		free( display_to_kill );
+	}
+	_vector_display_list = NULL;
+
+}
+
+/***************************************************************************/
+
+/*
+ * Buffered output.
+ * Numbers are formatted by hand with one decimal, which is plenty for pixels
+ * and a good deal faster than going through fprintf() for every vertex.
+ */
+
+local void vw_flush( VectorParams *params ) {
+
+	if ( params->fp && params->buffered ) {
+		if ( fwrite( params->buffer, 1, params->buffered, params->fp ) != params->buffered ) {
+			fprintf( stderr, "Error writing vector output.\n" );
+		}
+	}
+	params->written += (long) params->buffered;
+	params->buffered = 0;
+
+}
+
+local long vw_tell( VectorParams *params ) {
+	return( params->written + (long) params->buffered );
+}
+
+local void vw_putc( VectorParams *params, char c ) {
+	if ( params->buffered >= VECTOR_BUFFER_SIZE ) vw_flush( params );
+	params->buffer[ params->buffered++ ] = c;
+}
+
+local void vw_puts( VectorParams *params, const char *string ) {
+	while ( *string ) vw_putc( params, *string++ );
+}
+
+local void vw_number( VectorParams *params, double value ) {
+
+	char		digits[32];
+	int			n = 0;
+	long long	tenths;
+
+	if ( value != value ) value = 0.0;
+	if ( value > 1.0e9 ) value = 1.0e9;
+	if ( value < -1.0e9 ) value = -1.0e9;
+
+	// 1e10 tenths does not fit in a long on Windows.
+	tenths = (long long) floor( fabs( value ) * 10.0 + 0.5 );
+	if ( value < 0.0 && tenths ) vw_putc( params, '-' );
+	if ( tenths % 10 ) {
+		digits[n++] = (char) ( '0' + tenths % 10 );
+		digits[n++] = '.';
+	}
+	tenths /= 10;
+	do {
+		digits[n++] = (char) ( '0' + tenths % 10 );
+		tenths /= 10;
+	} while ( tenths );
+	while ( n ) vw_putc( params, digits[--n] );
+
+}
+
+local void vw_fraction( VectorParams *params, double value ) {
+
+	// Colors in PDF are fractions between 0 and 1, which we write with 3 decimals.
+	int	thousandths = (int) floor( value * 1000.0 + 0.5 );
+
+	if ( thousandths >= 1000 ) vw_putc( params, '1' );
+	else if ( thousandths <= 0 ) vw_putc( params, '0' );
+	else {
+		vw_putc( params, '.' );
+		vw_putc( params, (char) ( '0' + thousandths / 100 ) );
+		vw_putc( params, (char) ( '0' + ( thousandths / 10 ) % 10 ) );
+		vw_putc( params, (char) ( '0' + thousandths % 10 ) );
+	}
+
+}
+
+// Same thing for the signed entries of a rotation matrix.
+local void vw_cosine( VectorParams *params, double value ) {
+	if ( value <= -0.0005 ) vw_putc( params, '-' );
+	vw_fraction( params, fabs( value ) );
+}
+
+local void vw_hex_color( VectorParams *params, float rgb[3] ) {
+
+	local char hex[] = "0123456789abcdef";
+	int	k, level;
+
+	vw_putc( params, '#' );
+	for ( k = 0; k < 3; k++ ) {
+		level = (int) ( 255.0 * rgb[k] + 0.5 );
+		vw_putc( params, hex[ level >> 4 ] );
+		vw_putc( params, hex[ level & 0x0f ] );
+	}
+
+}
+
+// A point in display coordinates, converted to those of the output page.
+local void vw_point( Display display, VectorParams *params, double x, double y ) {
+
+	vw_number( params, x - display->left );
+	vw_putc( params, ' ' );
+	if ( params->format == VECTOR_FORMAT_SVG ) vw_number( params, display->top - y );
+	else vw_number( params, y - display->bottom );
+
+}
+
+/***************************************************************************/
+
+/*
+ * Paths.
+ * A path stays open as long as the things drawn are of the same kind and
+ * use the same color and pen. Anything else closes it first.
+ */
+
+local void vector_flush_column( Display display, VectorParams *params );
+
+local void vector_end_path( Display display, VectorParams *params ) {
+
+	if ( params->path == VECTOR_NO_PATH ) return;
+	vector_flush_column( display, params );
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_puts( params, "\" " );
+		if ( params->path == VECTOR_FILL_PATH ) {
+			vw_puts( params, "fill=\"" );
+			vw_hex_color( params, params->path_rgb );
+			vw_puts( params, "\"/>\n" );
+		}
+		else {
+			vw_puts( params, "stroke=\"" );
+			vw_hex_color( params, params->path_rgb );
+			vw_puts( params, "\" stroke-width=\"" );
+			vw_number( params, params->path_pen );
+			vw_puts( params, "\"/>\n" );
+		}
+	}
+	else {
+		vw_puts( params, params->path == VECTOR_FILL_PATH ? "f\n" : "S\n" );
+	}
+	params->path = VECTOR_NO_PATH;
+
+}
+
+local void vector_begin_path( Display display, VectorParams *params, int kind ) {
+
+	int same_color = !memcmp( params->rgb, params->path_rgb, sizeof( params->rgb ) );
+
+	if ( params->path == kind && same_color && ( kind == VECTOR_FILL_PATH || params->pen == params->path_pen ) ) return;
+	vector_end_path( display, params );
+
+	params->path = kind;
+	memcpy( params->path_rgb, params->rgb, sizeof( params->rgb ) );
+	params->path_pen = params->pen;
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_puts( params, kind == VECTOR_FILL_PATH ? "<path stroke=\"none\" d=\"" : "<path d=\"" );
+	}
+	else {
+		// Only set what the graphics state actually needs.
+		vw_fraction( params, params->rgb[0] ); vw_putc( params, ' ' );
+		vw_fraction( params, params->rgb[1] ); vw_putc( params, ' ' );
+		vw_fraction( params, params->rgb[2] );
+		if ( kind == VECTOR_FILL_PATH ) vw_puts( params, " rg\n" );
+		else {
+			vw_puts( params, " RG " );
+			vw_number( params, params->pen );
+			vw_puts( params, " w\n" );
+		}
+	}
+	// Forces a move to the first point.
+	params->subpath = NO;
+	params->column = LONG_MIN;
+	params->column_count = 0;
+
+}
+
+local void vector_move( Display display, VectorParams *params, double x, double y ) {
+
+	vector_flush_column( display, params );
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_putc( params, 'M' );
+		vw_point( display, params, x, y );
+	}
+	else {
+		vw_point( display, params, x, y );
+		vw_puts( params, " m\n" );
+	}
+	params->last_x = (float) x;
+	params->last_y = (float) y;
+	params->subpath = YES;
+	params->column = ( params->resolution > 0.0 ? (long) floor( x / params->resolution ) : LONG_MIN );
+	params->column_count = 0;
+
+}
+
+local void vector_emit_line( Display display, VectorParams *params, double x, double y ) {
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_putc( params, 'L' );
+		vw_point( display, params, x, y );
+	}
+	else {
+		vw_point( display, params, x, y );
+		vw_puts( params, " l\n" );
+	}
+
+}
+
+// Output the extremes and the last vertex of the column that has been building up.
+local void vector_flush_column( Display display, VectorParams *params ) {
+
+	float	first, second;
+
+	if ( params->column_count == 0 ) return;
+
+	if ( params->column_min_first ) {
+		first = params->column_min_y;
+		second = params->column_max_y;
+	}
+	else {
+		first = params->column_max_y;
+		second = params->column_min_y;
+	}
+	// Extremes are only needed if they stick out beyond the ends of the column.
+	if ( first != params->column_first_y && first != params->column_last_y ) {
+		vector_emit_line( display, params, params->column_last_x, first );
+	}
+	if ( second != params->column_first_y && second != params->column_last_y ) {
+		vector_emit_line( display, params, params->column_last_x, second );
+	}
+	vector_emit_line( display, params, params->column_last_x, params->column_last_y );
+	params->column_count = 0;
+
+}
+
+// Extend the open stroke path to (x,y), decimating vertices that fall in the same column.
+local void vector_stroke_to( Display display, VectorParams *params, double x, double y ) {
+
+	long	column;
+
+	if ( params->resolution <= 0.0 ) {
+		vector_emit_line( display, params, x, y );
+	}
+	else {
+		column = (long) floor( x / params->resolution );
+		if ( column == params->column ) {
+			if ( params->column_count == 0 ) {
+				// The vertex that took us into the column has already been written.
+				params->column_first_y = params->last_y;
+				params->column_min_y = params->column_max_y = params->last_y;
+				params->column_min_first = YES;
+			}
+			if ( y < params->column_min_y ) {
+				params->column_min_y = (float) y;
+				params->column_min_first = NO;
+			}
+			if ( y > params->column_max_y ) {
+				params->column_max_y = (float) y;
+				params->column_min_first = YES;
+			}
+			params->column_last_x = (float) x;
+			params->column_last_y = (float) y;
+			params->column_count++;
+		}
+		else {
+			vector_flush_column( display, params );
+			vector_emit_line( display, params, x, y );
+			params->column = column;
+		}
+	}
+	params->last_x = (float) x;
+	params->last_y = (float) y;
+
+}
+
+// Start a stroke path, continuing the current subpath if we are already there.
+local void vector_stroke_from( Display display, VectorParams *params, double x, double y ) {
+
+	int was_open = ( params->path == VECTOR_STROKE_PATH );
+
+	vector_begin_path( display, params, VECTOR_STROKE_PATH );
+	if ( !was_open || !params->subpath || x != params->last_x || y != params->last_y ) {
+		vector_move( display, params, x, y );
+	}
+
+}
+
+local void vector_line( Display display, VectorParams *params, double x1, double y1, double x2, double y2 ) {
+	if ( params->invisible ) return;
+	vector_stroke_from( display, params, x1, y1 );
+	vector_stroke_to( display, params, x2, y2 );
+}
+
+local void vector_close_subpath( VectorParams *params ) {
+	vw_puts( params, params->format == VECTOR_FORMAT_SVG ? "Z" : "h\n" );
+}
+
+// Rectangles are always drawn in the same direction so that when they overlap
+//  within one filled path, the nonzero winding rule does not punch holes.
+local void vector_box( Display display, VectorParams *params, double x1, double y1, double x2, double y2 ) {
+
+	double	left = min( x1, x2 ), right = max( x1, x2 );
+	double	bottom = min( y1, y2 ), top = max( y1, y2 );
+
+	vector_move( display, params, left, bottom );
+	vector_emit_line( display, params, right, bottom );
+	vector_emit_line( display, params, right, top );
+	vector_emit_line( display, params, left, top );
+	vector_close_subpath( params );
+	params->subpath = NO;
+
+}
+
+// Circles are made of 4 cubic Bezier arcs, which both formats understand.
+#define VECTOR_KAPPA	0.5522847498
+
+local void vector_curve( Display display, VectorParams *params, double ax, double ay, double bx, double by, double cx, double cy ) {
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_putc( params, 'C' );
+		vw_point( display, params, ax, ay );
+		vw_putc( params, ' ' );
+		vw_point( display, params, bx, by );
+		vw_putc( params, ' ' );
+		vw_point( display, params, cx, cy );
+	}
+	else {
+		vw_point( display, params, ax, ay );
+		vw_putc( params, ' ' );
+		vw_point( display, params, bx, by );
+		vw_putc( params, ' ' );
+		vw_point( display, params, cx, cy );
+		vw_puts( params, " c\n" );
+	}
+
+}
+
+local void vector_circle( Display display, VectorParams *params, double x, double y, double r ) {
+
+	double k = VECTOR_KAPPA * r;
+
+	vector_move( display, params, x + r, y );
+	vector_curve( display, params, x + r, y + k, x + k, y + r, x, y + r );
+	vector_curve( display, params, x - k, y + r, x - r, y + k, x - r, y );
+	vector_curve( display, params, x - r, y - k, x - k, y - r, x, y - r );
+	vector_curve( display, params, x + k, y - r, x + r, y - k, x + r, y );
+	vector_close_subpath( params );
+	params->subpath = NO;
+
+}
+
+local void vector_polygon( Display display, VectorParams *params, int kind ) {
+
+	int k;
+
+	if ( params->vertex_count < 2 || params->invisible ) return;
+
+	// A polygon may wind either way, so it gets a path of its own.
+	vector_end_path( display, params );
+	vector_begin_path( display, params, kind );
+	vector_move( display, params, params->vertex[0].x, params->vertex[0].y );
+	for ( k = 1; k < params->vertex_count; k++ ) {
+		vector_emit_line( display, params, params->vertex[k].x, params->vertex[k].y );
+	}
+	vector_close_subpath( params );
+	vector_end_path( display, params );
+
+}
+
+/***************************************************************************/
+
+/*
+ * File level structure.
+ */
+
+int VectorDisplayFormatFromFilename( char *filename ) {
+
+	char	*dot = strrchr( filename, '.' );
+	char	extension[8];
+	int		k;
+
+	if ( !dot || strlen( dot ) >= sizeof( extension ) ) return( VECTOR_FORMAT_NONE );
+	for ( k = 0; dot[k]; k++ ) extension[k] = ( dot[k] >= 'A' && dot[k] <= 'Z' ? dot[k] - 'A' + 'a' : dot[k] );
+	extension[k] = 0;
+	if ( !strcmp( extension, ".svg" ) ) return( VECTOR_FORMAT_SVG );
+	if ( !strcmp( extension, ".pdf" ) ) return( VECTOR_FORMAT_PDF );
+	return( VECTOR_FORMAT_NONE );
+
+}
+
+local void vector_begin_file( Display display, VectorParams *params ) {
+
+	char	header[256];
+	double	width = fabs( display->right - display->left );
+	double	height = fabs( display->top - display->bottom );
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		sprintf( header,
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" viewBox=\"0 0 %.0f %.0f\">\n",
+			width, height, width, height );
+		vw_puts( params, header );
+		vw_puts( params, "<g fill=\"none\" stroke-linecap=\"round\" stroke-linejoin=\"round\" font-family=\"Courier New, monospace\">\n" );
+	}
+	else {
+		// Objects 1 to 3 are written first. The content stream is object 4, its length
+		//  is object 5 (because we do not know it in advance) and the font is object 6.
+		vw_puts( params, "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n" );
+		params->pdf_offset[1] = vw_tell( params );
+		vw_puts( params, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n" );
+		params->pdf_offset[2] = vw_tell( params );
+		vw_puts( params, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n" );
+		params->pdf_offset[3] = vw_tell( params );
+		sprintf( header,
+			"3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %.0f %.0f] /Contents 4 0 R "
+			"/Resources << /Font << /F1 6 0 R >> >> >>\nendobj\n", width, height );
+		vw_puts( params, header );
+		params->pdf_offset[4] = vw_tell( params );
+		vw_puts( params, "4 0 obj\n<< /Length 5 0 R >>\nstream\n" );
+		params->pdf_stream_start = vw_tell( params );
+		vw_puts( params, "1 J 1 j\n" );
+	}
+
+}
+
+local void vector_end_file( Display display, VectorParams *params ) {
+
+	char	line[128];
+	long	length, xref;
+	int		k;
+
+	vector_end_path( display, params );
+
+	if ( params->format == VECTOR_FORMAT_SVG ) {
+		vw_puts( params, "</g>\n</svg>\n" );
+	}
+	else {
+		length = vw_tell( params ) - params->pdf_stream_start;
+		vw_puts( params, "endstream\nendobj\n" );
+		params->pdf_offset[5] = vw_tell( params );
+		sprintf( line, "5 0 obj\n%ld\nendobj\n", length );
+		vw_puts( params, line );
+		params->pdf_offset[6] = vw_tell( params );
+		vw_puts( params, "6 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Courier /Encoding /WinAnsiEncoding >>\nendobj\n" );
+		xref = vw_tell( params );
+		vw_puts( params, "xref\n0 7\n0000000000 65535 f \n" );
+		for ( k = 1; k <= 6; k++ ) {
+			sprintf( line, "%010ld 00000 n \n", params->pdf_offset[k] );
+			vw_puts( params, line );
+		}
+		sprintf( line, "trailer\n<< /Size 7 /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", xref );
+		vw_puts( params, line );
+	}
+
+}
+
+int VectorDisplayOpen( Display display, char *filename ) {
+
+	register VectorParams	*params = (VectorParams *) display->parameters;
+	int format = VectorDisplayFormatFromFilename( filename );
+
+	VectorDisplayFinish( display );
+	if ( format == VECTOR_FORMAT_NONE ) {
+		fprintf( stderr, "%s: don't know how to write this type of file (use .svg or .pdf).\n", filename );
+		return( FAILURE );
+	}
+	params->fp = fopen( filename, "wb" );
+	if ( !params->fp ) {
+		fprintf( stderr, "Error opening %s for write.\n", filename );
+		return( FAILURE );
+	}
+	params->format = format;
+	params->buffered = 0;
+	params->written = 0;
+	params->path = VECTOR_NO_PATH;
+	vector_begin_file( display, params );
+	return( SUCCESS );
+
+}
+
+void VectorDisplayFinish( Display display ) {
+
+	register VectorParams	*params = (VectorParams *) display->parameters;
+
+	if ( !params->fp ) return;
+	vector_end_file( display, params );
+	vw_flush( params );
+	fclose( params->fp );
+	params->fp = NULL;
+	params->format = VECTOR_FORMAT_NONE;
+
+}
+
+void VectorDisplaySetResolution( Display display, double resolution ) {
+
+	register VectorParams	*params = (VectorParams *) display->parameters;
+
+	vector_end_path( display, params );
+	params->resolution = resolution;
+
+}
+
+/***************************************************************************/
+
+void	VectorInit ( Display display ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  int width, height;
+
+  if ( display->desired_width < 0 ) width = VECTOR_DISPLAY_WIDTH;
+  else width = (int) display->desired_width;
+  if ( display->desired_height < 0 ) height = ( width * 3 ) / 4;
+  else height = (int) display->desired_height;
+
+  // Set the screen edges.
+  display->left = 0.0;
+  display->right = (float) width;
+  display->top = (float) height;
+  display->bottom = 0.0;
+
+  params->rgb[0] = params->rgb[1] = params->rgb[2] = 0.0;
+  params->invisible = NO;
+  params->pen = 1.0;
+  params->vertex_count = 0;
+  params->last_x = params->last_y = 0.0;
+  params->path = VECTOR_NO_PATH;
+  params->resolution = 1.0;
+
+  // The output goes straight to the file, so there is no redraw cache.
+  DisplayFreeCache( display );
+
+}
+
+void VectorActivate( Display display ) {}
+
+// Make sure that everything so far is on the disk.
+void VectorSwap ( Display display ) {
+
+	register VectorParams	*params = (VectorParams *) display->parameters;
+
+	vw_flush( params );
+	if ( params->fp ) fflush( params->fp );
+
+}
+
+void VectorClose ( Display display ) {
+	VectorDisplayFinish( display );
+}
+
+// The hardcopy is made as the drawing is done, so this just
+//  says where the drawing that follows should go.
+void VectorHardcopy ( Display display, char *filename ) {
+	VectorDisplayOpen( display, filename );
+}
+
+int	VectorInput( Display display, float *x, float *y ) {
+  return( 0 );
+}
+
+/***************************************************************************/
+
+// The page starts out transparent, so erasing means painting it white.
+void	VectorErase ( Display display ) {
+  VectorEraseRectangle( display, display->left, display->bottom, display->right, display->top );
+
+}
+
+void	VectorEraseRectangle ( Display display, float x1, float y1, float x2, float y2) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  float	hold[3];
+  int	invisible = params->invisible;
+
+  memcpy( hold, params->rgb, sizeof( hold ) );
+  params->rgb[0] = params->rgb[1] = params->rgb[2] = 1.0;
+  params->invisible = NO;
+  VectorFilledRectangle( display, x1, y1, x2, y2 );
+  memcpy( params->rgb, hold, sizeof( hold ) );
+  params->invisible = invisible;
+
+}
+
+void	VectorPoint ( Display display, float x, float y) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  // A dot the size of the pen, as the screen shows it.
+  if ( params->invisible ) return;
+  vector_begin_path( display, params, VECTOR_FILL_PATH );
+  vector_box( display, params, x - params->pen / 2.0, y - params->pen / 2.0, x + params->pen / 2.0, y + params->pen / 2.0 );
+  params->last_x = x;
+  params->last_y = y;
+
+}
+
+void	VectorLine	( Display display, float x1, float y1, float x2, float y2) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  vector_line( display, params, x1, y1, x2, y2 );
+
+}
+
+void	VectorMoveTo ( Display display, float x, float y) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  // The move itself is only written if something is drawn from here.
+  vector_flush_column( display, params );
+  params->last_x = x;
+  params->last_y = y;
+  params->subpath = NO;
+
+}
+
+void	VectorLineTo	( Display display, float x2, float y2 ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  vector_line( display, params, params->last_x, params->last_y, x2, y2 );
+
+}
+
+/***************************************************************************/
+
+/*
+ * Traces come from walking the redraw cache of another display.
+ * They are nothing more than a MoveTo followed by LineTos.
+ */
+
+void	VectorStartTrace	( Display display, float x, float y ) {
+  VectorMoveTo( display, x, y );
+}
+
+void	VectorContinueTrace	( Display display, float x, float y ) {
+  VectorLineTo( display, x, y );
+}
+
+void	VectorEndTrace	( Display display, float x, float y ) {
+  VectorLineTo( display, x, y );
+}
+
+/***************************************************************************/
+
+void	VectorRectangle	( Display display, float x1, float y1, float x2, float y2) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( params->invisible ) return;
+  vector_begin_path( display, params, VECTOR_STROKE_PATH );
+  vector_box( display, params, x1, y1, x2, y2 );
+  params->last_x = x2;
+  params->last_y = y2;
+
+}
+
+void	VectorFilledRectangle ( Display display, float x1, float y1, float x2, float y2) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( params->invisible ) return;
+  vector_begin_path( display, params, VECTOR_FILL_PATH );
+  vector_box( display, params, x1, y1, x2, y2 );
+  params->last_x = x2;
+  params->last_y = y2;
+
+}
+
+void	VectorCircle	(Display display, float x, float y, float radius ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( params->invisible ) return;
+  vector_begin_path( display, params, VECTOR_STROKE_PATH );
+  vector_circle( display, params, x, y, radius );
+
+}
+
+void	VectorFilledCircle	(Display display, float x, float y, float radius ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( params->invisible ) return;
+  vector_begin_path( display, params, VECTOR_FILL_PATH );
+  vector_circle( display, params, x, y, radius );
+
+}
+
+/***************************************************************************/
+
+void	VectorStartPolygon ( Display display ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  params->vertex_count = 0;
+
+}
+
+void	VectorAddVertex ( Display display, float x, float y ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( params->vertex_count < VECTOR_MAX_POLY_POINTS ) {
+    params->vertex[ params->vertex_count ].x = x;
+    params->vertex[ params->vertex_count ].y = y;
+    params->vertex_count++;
+  }
+
+}
+
+void	VectorOutlinePolygon ( Display display ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  vector_polygon( display, params, VECTOR_STROKE_PATH );
+
+}
+
+void	VectorFillPolygon ( Display display ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  vector_polygon( display, params, VECTOR_FILL_PATH );
+
+}
+
+/***************************************************************************/
+
+// Text is drawn with its baseline at y, in a monospaced font
+//  with the same metrics as the SoftDisplay.
+void	VectorText	( Display display, char *string, float x, float y, double dir ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  double	c = cos( dir ), s = sin( dir );
+  char		*p;
+
+  if ( params->invisible || !*string ) return;
+  vector_end_path( display, params );
+
+  if ( params->format == VECTOR_FORMAT_SVG ) {
+    vw_puts( params, "<text x=\"" );
+    vw_number( params, x - display->left );
+    vw_puts( params, "\" y=\"" );
+    vw_number( params, display->top - y );
+    vw_puts( params, "\" font-size=\"" );
+    vw_number( params, VECTOR_FONT_SIZE );
+    vw_puts( params, "\" fill=\"" );
+    vw_hex_color( params, params->rgb );
+    vw_putc( params, '"' );
+    if ( dir != 0.0 ) {
+      // SVG angles go clockwise because Y points down.
+      vw_puts( params, " transform=\"rotate(" );
+      vw_number( params, - dir * 180.0 / Pi );
+      vw_putc( params, ' ' );
+      vw_point( display, params, x, y );
+      vw_puts( params, ")\"" );
+    }
+    vw_putc( params, '>' );
+    for ( p = string; *p; p++ ) {
+      if ( *p == '<' ) vw_puts( params, "&lt;" );
+      else if ( *p == '>' ) vw_puts( params, "&gt;" );
+      else if ( *p == '&' ) vw_puts( params, "&amp;" );
+      else if ( (unsigned char) *p >= ' ' && (unsigned char) *p < 0x7f ) vw_putc( params, *p );
+    }
+    vw_puts( params, "</text>\n" );
+  }
+  else {
+    vw_puts( params, "BT /F1 " );
+    vw_number( params, VECTOR_FONT_SIZE );
+    vw_puts( params, " Tf " );
+    vw_fraction( params, params->rgb[0] ); vw_putc( params, ' ' );
+    vw_fraction( params, params->rgb[1] ); vw_putc( params, ' ' );
+    vw_fraction( params, params->rgb[2] );
+    vw_puts( params, " rg " );
+    vw_cosine( params, c ); vw_putc( params, ' ' );
+    vw_cosine( params, s ); vw_putc( params, ' ' );
+    vw_cosine( params, - s ); vw_putc( params, ' ' );
+    vw_cosine( params, c ); vw_putc( params, ' ' );
+    vw_point( display, params, x, y );
+    vw_puts( params, " Tm (" );
+    for ( p = string; *p; p++ ) {
+      if ( *p == '(' || *p == ')' || *p == '\\' ) vw_putc( params, '\\' );
+      if ( (unsigned char) *p >= ' ' && (unsigned char) *p < 0x7f ) vw_putc( params, *p );
+    }
+    vw_puts( params, ") Tj ET\n" );
+  }
+
+}
+
+float	VectorTextWidth ( Display display, char *string ) {
+  return( (float) ( VECTOR_CHAR_WIDTH * strlen( string ) ) );
+}
+
+float	VectorTextHeight ( Display display, char *string ) {
+  return( (float) VECTOR_FONT_SIZE );
+}
+
+/***************************************************************************/
+
+// There is no XOR on paper.
+void	VectorAlu	( Display display, int alu) {}
+
+void	VectorLineStyle ( Display display, int style ) {}
+void	VectorLinePattern	( Display display, int pattern ) {}
+
+void	VectorPenSize ( Display display, float size) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+  params->pen = ( size < 1.0 ? 1.0f : size );
+
+}
+
+/***************************************************************************/
+
+// Color
+
+local float VectorColorTable[][3] = {
+
+  { 0.0f, 0.0f, 0.0f },	/* Black	*/
+  { 1.0f, 0.0f, 0.0f },	/* Red		*/
+  { 0.0f, 1.0f, 0.0f },	/* Green	*/
+  { 1.0f, 1.0f, 0.0f },	/* Yellow	*/
+  { 0.0f, 0.0f, 1.0f },	/* Blue		*/
+  { 1.0f, 0.0f, 1.0f },	/* Magenta	*/
+  { 0.0f, 1.0f, 1.0f },	/* Cyan		*/
+  { 1.0f, 1.0f, 1.0f },	/* White	*/
+
+  { 0.125f, 0.125f, 0.125f },	/* Grey1	*/
+  { 0.250f, 0.250f, 0.250f },	/* Grey2	*/
+  { 0.375f, 0.375f, 0.375f },	/* Grey3	*/
+  { 0.500f, 0.500f, 0.500f },	/* Grey4	*/
+  { 0.625f, 0.625f, 0.625f },	/* Grey5	*/
+  { 0.750f, 0.750f, 0.750f },	/* Grey6	*/
+  { 0.875f, 0.875f, 0.875f },	/* Grey7	*/
+  { 1.000f, 1.000f, 1.000f },	/* Grey8	*/
+
+};
+
+void	VectorColor ( Display display, int color) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  if ( color == TRANSPARENT_COLOR ) {
+    params->invisible = YES;
+    return;
+  }
+  if ( color < 0 || color >= TRANSPARENT_COLOR ) color = FOREGROUND;
+  memcpy( params->rgb, VectorColorTable[color], sizeof( params->rgb ) );
+  params->invisible = NO;
+
+}
+
+void	VectorColorRGB ( Display display, float r, float g, float b ) {
+
+  register VectorParams	*params = (VectorParams *) display->parameters;
+
+  params->rgb[0] = (float) min( max( r, 0.0 ), 1.0 );
+  params->rgb[1] = (float) min( max( g, 0.0 ), 1.0 );
+  params->rgb[2] = (float) min( max( b, 0.0 ), 1.0 );
+  params->invisible = NO;
+
+}
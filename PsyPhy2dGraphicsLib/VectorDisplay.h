@@ -0,0 +1,150 @@
+/*****************************************************************************/
+/*                                                                           */
+/*                             VectorDisplay.h                               */
+/*                                                                           */
+/*****************************************************************************/
+
+/*
+	A Display that streams its output to an SVG or PDF file as the drawing
+	is done, rather than building an image or a redraw list in memory.
+	Consecutive line segments of the same color are merged into a single
+	path and are decimated to the minimum and maximum in each column of the
+	output resolution, so that hours of data at 20 Hz produce a file whose
+	size depends on the width of the plot, not on the number of samples.
+*/
+
+#ifndef	_VECTORDISPLAY_
+
+#include <stdio.h>
+#include "Displays.h"
+#include "Graphics.h"
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern	Display VectorDisplay;
+
+Display CreateVectorDisplay( void );
+void DestroyVectorDisplays( void );
+
+/* Start writing to a file. The format is chosen from the extension (.svg or .pdf). */
+int		VectorDisplayOpen( Display display, char *filename );
+/* Finish the file. Also done by Close() and by opening another file. */
+void	VectorDisplayFinish( Display display );
+/* Segments closer than this along X (in display units) are decimated. Zero turns it off. */
+void	VectorDisplaySetResolution( Display display, double resolution );
+/* True if the filename has an extension that we know how to write. */
+int		VectorDisplayFormatFromFilename( char *filename );
+
+void	VectorInit( Display display );
+void	VectorActivate( Display display );
+void	VectorSwap ( Display display );
+
+void	VectorClose( Display display );
+void	VectorHardcopy ( Display display, char *filename );
+
+int		VectorInput( Display display, float *x, float *y );
+void	VectorPoint ( Display display, float x, float y);
+void	VectorLine	( Display display, float x1, float y1, float x2, float y2);
+void	VectorMoveTo ( Display display, float x1, float y1);
+void	VectorLineTo	( Display display, float x2, float y2 );
+
+void	VectorStartTrace	( Display display, float x, float y );
+void	VectorContinueTrace	( Display display, float x, float y );
+void	VectorEndTrace	( Display display, float x, float y );
+
+void	VectorText	( Display display, char *string,
+				  float x, float y, double dir );
+float	VectorTextWidth ( Display display, char *string );
+float	VectorTextHeight ( Display display, char *string );
+void	VectorRectangle	( Display display,
+						  float x1, float y1, float x2, float y2);
+void	VectorFilledRectangle ( Display display,
+							 float x1, float y1, float x2, float y2);
+void	VectorCircle	(Display display, float x, float y, float radius );
+void	VectorFilledCircle	(Display display, float x, float y, float radius );
+void	VectorEraseRectangle ( Display display,
+							float x1, float y1, float x2, float y2);
+void	VectorErase ( Display display);
+void	VectorAlu	( Display display, int alu);
+void	VectorLineStyle ( Display display, int style );
+void	VectorLinePattern	( Display display, int pattern );
+void	VectorColor ( Display display, int color);
+void	VectorColorRGB ( Display display, float r, float g, float b );
+void	VectorPenSize ( Display display, float size);
+void	VectorStartPolygon ( Display display );
+void	VectorAddVertex ( Display display, float x, float y );
+void	VectorOutlinePolygon ( Display display );
+void	VectorFillPolygon ( Display display );
+
+#ifdef __cplusplus
+}
+#endif
+
+#define VECTOR_FORMAT_NONE	0
+#define VECTOR_FORMAT_SVG	1
+#define VECTOR_FORMAT_PDF	2
+
+#define VECTOR_BUFFER_SIZE		65536
+#define VECTOR_MAX_POLY_POINTS	255
+
+/* Same metrics as the SoftDisplay, so that layouts look the same. */
+#define VECTOR_FONT_SIZE		10.0
+#define VECTOR_CHAR_WIDTH		6.0
+
+#define VECTOR_NO_PATH		0
+#define VECTOR_STROKE_PATH	1
+#define VECTOR_FILL_PATH	2
+
+typedef struct {
+
+  char		*name;
+
+  FILE		*fp;
+  int		format;
+  char		buffer[VECTOR_BUFFER_SIZE];
+  size_t	buffered;
+  long		written;		/* Bytes already flushed to the file. */
+
+  /* Byte offsets of the PDF objects, for the cross reference table. */
+  long		pdf_offset[8];
+  long		pdf_stream_start;
+
+  float		rgb[3];
+  int		invisible;
+  float		pen;
+
+  /* The path that is currently open, if any. */
+  int		path;
+  float		path_rgb[3];
+  float		path_pen;
+  float		last_x;
+  float		last_y;
+  int		subpath;		/* The current position is the end of the open path. */
+
+  /* Min/max decimation of the open stroke path. */
+  double	resolution;
+  long		column;
+  float		column_first_y;
+  float		column_min_y;
+  float		column_max_y;
+  int		column_min_first;
+  float		column_last_x;
+  float		column_last_y;
+  int		column_count;
+
+  struct {
+	float x;
+	float y;
+  } vertex[VECTOR_MAX_POLY_POINTS];
+  int   vertex_count;
+
+} VectorParams;
+
+#define VECTOR_DISPLAY_WIDTH	900
+
+#define _VECTORDISPLAY_
+#endif
@@ -11,7 +11,9 @@
 
 // Defines that increase the amount of info in the memory leak report.
 #define _CRTDBG_MAP_ALLOC
+#ifdef _WIN32
 #include <crtdbg.h>
+#endif
 #include <stdlib.h>
 
 #include <stdio.h>
@@ -47,6 +49,14 @@ View CreateView (Display display) {
 	return(view);
 }
 
+// Free a single View, taking it off the list of Views to be freed by DestroyViews().
+void DestroyView ( View view ) {
+	View *link = &_view_destroy_list;
+	while ( *link && *link != view ) link = &(*link)->next;
+	if ( *link ) *link = view->next;
+	free( view );
+}
+
 void DestroyViews ( void ) {
 	View view = _view_destroy_list;
 	View hold;
@@ -81,6 +81,7 @@ typedef struct _view {
 #define ViewHeight(v) 	(fabs(v->user_bottom - v->user_top))
 
 View CreateView (Display display);
+void DestroyView ( View view );
 void DestroyViews ( void );
 
 void ViewInit (View view);
@@ -269,6 +270,46 @@ void ViewScatterPlotAvailableDoubles (View view, int symbol,
 				     unsigned xsize, unsigned ysize,
 				     double NA );
 
+void ViewPlotRuns (View view, double *xarray, unsigned xsize,
+		   int runs[][2], int n_runs, double y,
+		   int start, int end );
+
+/* Two-dimensional histograms, drawn as pseudo-color density maps. */
+
+typedef struct _density_map {
+
+  int		x_bins;
+  int		y_bins;
+  double	left;
+  double	bottom;
+  double	right;
+  double	top;
+  unsigned long	*count;
+
+  /* The range of samples that are in the map. */
+  int		first;
+  int		last;
+
+} *DensityMap;
+
+#define DENSITY_MAP_LEVELS	64
+
+DensityMap CreateDensityMap ( void );
+void DestroyDensityMap ( DensityMap map );
+void DensityMapClear ( DensityMap map );
+void DensityMapSetGrid ( DensityMap map, int x_bins, int y_bins,
+			 double left, double bottom, double right, double top );
+void DensityMapAddDoubles ( DensityMap map, double *xarray, double *yarray,
+			    int start, int end,
+			    unsigned xsize, unsigned ysize,
+			    double na, int weight );
+void DensityMapTrackDoubles ( DensityMap map, double *xarray, double *yarray,
+			      int start, int end,
+			      unsigned xsize, unsigned ysize,
+			      double na );
+void ViewPlotDensityMap ( View view, DensityMap map );
+void ViewPlotDensityMapRGB ( View view, DensityMap map, float r, float g, float b );
+
 #ifdef __cplusplus
 }
 #endif
@@ -61,7 +61,10 @@
 #define HUGE HUGE_VAL
 #endif
 
+// __nan is a reserved name in the GNU C library, so the legacy NaN only exists on Windows.
+#ifdef _WIN32
 #define NaN (*((double *) &__nan))
+#endif
 #define ESC 0x1B
 
 #define max(x,y) (((x) > (y)) ? (x) : (y))
@@ -83,7 +86,9 @@ extern "C"
 #endif
 
 void *ealloc( size_t size );
+#ifdef _WIN32
 local unsigned long __nan = 0x7ff7ffff;
+#endif
 
 int open_pc ( char *filename, int flags );
 FILE *fopen_pc ( char *filename, char *flags );
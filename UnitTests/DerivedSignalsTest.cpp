@@ -0,0 +1,161 @@
+///
+/// Module:	DerivedSignalsTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check the signals computed by DexDerivedSignals on synthetic data whose derivatives
+///  and lag are known in advance.
+/// The position moves at constant velocity and the acceleration changes at a constant rate,
+///  so the finite differences must give the velocity and the jerk exactly.
+/// The grip force is a scaled copy of the load force, delayed by a few frames. The load
+///  force is irregular, so that the correlation is highest at that lag and no other.
+/// The data is long enough for the running sums of the correlation to be recomputed along the way.
+/// There is a break in the middle of the data, across which nothing may be computed, and
+///  the result must be the same whether the frames are processed all at once or a few at a time.
+///
+/// Usage: DerivedSignalsTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/DexDerivedSignals.h"
+
+#define FRAMES			10000
+#define PERIOD			DEX_DERIVED_SAMPLE_PERIOD
+#define LAG_FRAMES		3
+#define BREAK_FRAME		6000				// After the running sums have been refreshed once.
+#define LIGHT_FRAME		1234				// A frame with too little load force for the ratio.
+#define CHUNK			37					// Frames per update when processing a few at a time.
+#define MAX_ERROR		1.0e-9
+
+static const Vector3	velocity = { 100.0, -20.0, 0.0 };
+static const Vector3	jerk = { 0.5, 0.0, -1.5 };
+
+static double	time_column[FRAMES];
+static Vector3	position[FRAMES];
+static Vector3	acceleration[FRAMES];
+static double	grip_force[FRAMES];
+static double	load_force[FRAMES];
+
+// The outputs of the two runs.
+typedef struct {
+	Vector3	velocity[FRAMES];
+	Vector3	jerk[FRAMES];
+	double	ratio[FRAMES];
+	double	lag[FRAMES];
+} Outputs;
+
+static Outputs all_at_once, a_few_at_a_time;
+
+static void MakeData( void ) {
+
+	// A simple congruential generator, so that the data is the same everywhere.
+	unsigned int seed = 12345;
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		double t = frame * PERIOD;
+		time_column[frame] = t;
+		for ( int i = X; i <= Z; i++ ) {
+			position[frame][i] = velocity[i] * t;
+			acceleration[frame][i] = jerk[i] * t;
+		}
+		seed = seed * 1103515245 + 12345;
+		load_force[frame] = 1.0 + 4.0 * ( ( seed >> 16 ) & 0x7fff ) / 32767.0;
+	}
+	load_force[LIGHT_FRAME] = 0.5 * DEX_DERIVED_MIN_LOAD_FORCE;
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		grip_force[frame] = ( frame >= LAG_FRAMES ? 2.0 * load_force[frame - LAG_FRAMES] + 1.0 : 1.0 );
+	}
+
+}
+
+static void Derive( Outputs *out, int chunk ) {
+
+	static DexDerivedSignals derived;
+	static int break_frame[1] = { BREAK_FRAME };
+	static int n_breaks = 1;
+	DexDerivedColumns columns;
+
+	columns.time = time_column;
+	columns.position = position;
+	columns.acceleration = acceleration;
+	columns.grip_force = grip_force;
+	columns.load_force = load_force;
+	columns.velocity = out->velocity;
+	columns.jerk = out->jerk;
+	columns.ratio = out->ratio;
+	columns.lag = out->lag;
+	derived.SetColumns( &columns );
+	derived.SetSamplePeriod( PERIOD );
+	derived.SetBreaks( break_frame, &n_breaks );
+	for ( int first = 0; first < FRAMES; first += chunk ) {
+		int last = first + chunk - 1;
+		if ( last >= FRAMES ) last = FRAMES - 1;
+		derived.Update( first, last );
+	}
+
+}
+
+static int Report( const char *name, int errors ) {
+	printf( "  %-40s %s\n", name, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+}
+
+// Frames 0 and BREAK_FRAME have nothing before them to take a difference with.
+static int CheckDifferences( const char *name, Vector3 actual[], const Vector3 expected ) {
+	int errors = 0;
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		bool first = ( frame == 0 || frame == BREAK_FRAME );
+		for ( int i = X; i <= Z; i++ ) {
+			if ( first ) errors += ( actual[frame][i] != MISSING_DOUBLE );
+			else errors += ( fabs( actual[frame][i] - expected[i] ) > MAX_ERROR );
+		}
+	}
+	return( Report( name, errors ) );
+}
+
+static int CheckRatio( void ) {
+	int errors = 0;
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		if ( frame == LIGHT_FRAME ) errors += ( all_at_once.ratio[frame] != MISSING_DOUBLE );
+		else errors += ( fabs( all_at_once.ratio[frame] - grip_force[frame] / load_force[frame] ) > MAX_ERROR );
+	}
+	return( Report( "Grip/load ratio", errors ) );
+}
+
+// Once the window has filled up after the start and after the break, the lag must be exact.
+// Just after the break there are too few pairs for any lag.
+static int CheckLag( void ) {
+	int errors = 0;
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		int since = ( frame >= BREAK_FRAME ? frame - BREAK_FRAME : frame );
+		if ( since >= DEX_DERIVED_WINDOW + LAG_FRAMES ) errors += ( fabs( all_at_once.lag[frame] - LAG_FRAMES * PERIOD ) > MAX_ERROR );
+		else if ( frame >= BREAK_FRAME && since < DEX_DERIVED_MIN_PAIRS - 1 ) errors += ( all_at_once.lag[frame] != MISSING_DOUBLE );
+	}
+	return( Report( "Lag of the grip force", errors ) );
+}
+
+int main( int argc, char *argv[] ) {
+
+	int errors = 0;
+
+	MakeData();
+	Derive( &all_at_once, FRAMES );
+	Derive( &a_few_at_a_time, CHUNK );
+
+	errors += CheckDifferences( "Velocity", all_at_once.velocity, velocity );
+	errors += CheckDifferences( "Jerk", all_at_once.jerk, jerk );
+	errors += CheckRatio();
+	errors += CheckLag();
+	errors += Report( "Same result a few frames at a time", memcmp( &all_at_once, &a_few_at_a_time, sizeof( Outputs ) ) != 0 );
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
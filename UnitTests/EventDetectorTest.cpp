@@ -0,0 +1,223 @@
+///
+/// Module:	EventDetectorTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check the events found by DexEventDetector in a synthetic trial where the frame of each
+///  event is known in advance: a grip with a dip that stays between the two thresholds and
+///  a single peak, a load, a movement during which the manipulandum is briefly hidden,
+///  two collisions, each with a bounce that must not count again, and jumps of the center
+///  of pressure, only some of which happen while the object is held.
+/// A second trial is cut by a break while the object is held, which must end the grip.
+/// The lookup of events by time is checked against the event tables.
+///
+/// Usage: EventDetectorTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/DexAnalogMixin.h"
+#include "../Grip/DexEventDetector.h"
+
+#define FRAMES		1000
+#define PERIOD		0.05
+
+// Frames at which the events must be found, given the data made up below.
+#define GRIP_ON_FRAME		109		// 0.25 N more per frame from frame 100, so first above 2 N at 109.
+#define GRIP_PEAK_FRAME		300
+#define GRIP_PEAK			15.0
+#define GRIP_OFF_FRAME		437		// 0.25 N less per frame from frame 400, so first below 1 N at 437.
+#define LOAD_ON_FRAME		120
+#define LOAD_OFF_FRAME		430
+#define MOVE_ON_FRAME		600
+#define MOVE_OFF_FRAME		750
+#define HIDDEN_FRAME		650		// The manipulandum is not seen for a few frames from here.
+#define COLLISION_1_FRAME	800
+#define COLLISION_2_FRAME	900
+#define SLIP_1_FRAME		250		// The center of pressure jumps on two frames in a row.
+#define SLIP_2_FRAME		350
+#define LOOSE_JUMP_FRAME	500		// A jump while the object is not held.
+
+// The detector holds all the event tables, so it is too big for the stack.
+static DexEventDetector detector;
+
+static double GripForce( int frame ) {
+	if ( frame < 100 ) return( 0.0 );
+	if ( frame < 150 ) return( 0.25 * ( frame - 100 ) );
+	if ( frame < 160 ) return( 1.5 );					// Between the thresholds: still gripping.
+	if ( frame == GRIP_PEAK_FRAME ) return( GRIP_PEAK );
+	if ( frame < 400 ) return( 10.0 );
+	if ( frame < 450 ) return( 10.0 - 0.25 * ( frame - 400 ) );
+	return( 0.0 );
+}
+
+static double LoadForce( int frame ) {
+	if ( frame < LOAD_ON_FRAME ) return( 0.0 );
+	if ( frame < 420 ) return( 2.0 );
+	if ( frame < LOAD_OFF_FRAME ) return( 0.75 );		// Between the thresholds: still loaded.
+	return( 0.0 );
+}
+
+// Speed in position units per second. Above the 'on' threshold, then between the two.
+static double Speed( int frame ) {
+	if ( frame < MOVE_ON_FRAME ) return( 0.0 );
+	if ( frame < 700 ) return( 200.0 );
+	if ( frame < MOVE_OFF_FRAME ) return( 75.0 );
+	return( 0.0 );
+}
+
+static double Acceleration( int frame ) {
+	switch ( frame ) {
+	case COLLISION_1_FRAME:		return( 2.0 );
+	case COLLISION_1_FRAME + 1:	return( 1.3 );		// Between the thresholds.
+	case COLLISION_1_FRAME + 2:	return( 1.6 );		// The same collision, not a new one.
+	case COLLISION_2_FRAME:		return( 1.8 );
+	default:					return( 1.0 );
+	}
+}
+
+static double CenterOfPressure( int frame ) {
+	double cop = 0.01;
+	if ( frame >= SLIP_1_FRAME ) cop += 0.01;
+	if ( frame >= SLIP_1_FRAME + 1 ) cop += 0.01;
+	if ( frame >= SLIP_2_FRAME ) cop -= 0.01;
+	if ( frame >= LOOSE_JUMP_FRAME ) cop += 0.01;
+	return( cop );
+}
+
+static void Feed( int first_frame, int last_frame ) {
+
+	double x = 0.0;
+	Vector3 position, acceleration, load, cop[N_FORCE_TRANSDUCERS];
+
+	for ( int frame = 0; frame <= last_frame; frame++ ) {
+		x += Speed( frame ) * PERIOD;
+		if ( frame < first_frame ) continue;
+		position[X] = x;
+		position[Y] = 30.0;
+		position[Z] = -5.0;
+		if ( frame >= HIDDEN_FRAME && frame < HIDDEN_FRAME + 5 ) position[X] = MISSING_DOUBLE;
+		acceleration[X] = 0.0;
+		acceleration[Y] = Acceleration( frame );
+		acceleration[Z] = 0.0;
+		load[X] = 0.0;
+		load[Y] = 0.0;
+		load[Z] = LoadForce( frame );
+		for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+			cop[ati][X] = 0.0;
+			cop[ati][Y] = ( ati == 0 ? CenterOfPressure( frame ) : 0.01 );
+			cop[ati][Z] = 0.0;
+		}
+		detector.ProcessFrame( frame, frame * PERIOD, position, acceleration, GripForce( frame ), load, cop );
+	}
+
+}
+
+static int CheckEvents( const char *name, int type, int n, const int frame[] ) {
+	int errors = ( detector.Events( type ) != n );
+	for ( int i = 0; i < n && !errors; i++ ) errors += ( detector.Event( type, i )->frame != frame[i] );
+	printf( "  %-32s", name );
+	for ( int i = 0; i < detector.Events( type ); i++ ) printf( " %d", detector.Event( type, i )->frame );
+	printf( ": %s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+}
+
+static int CheckTrial( void ) {
+
+	static const int grip_on[] = { GRIP_ON_FRAME };
+	static const int grip_off[] = { GRIP_OFF_FRAME };
+	static const int grip_peak[] = { GRIP_PEAK_FRAME };
+	static const int load_on[] = { LOAD_ON_FRAME };
+	static const int load_off[] = { LOAD_OFF_FRAME };
+	static const int move_on[] = { MOVE_ON_FRAME };
+	static const int move_off[] = { MOVE_OFF_FRAME };
+	static const int collisions[] = { COLLISION_1_FRAME, COLLISION_2_FRAME };
+	static const int slips[] = { SLIP_1_FRAME, SLIP_2_FRAME };
+	int errors = 0;
+
+	detector.Reset();
+	Feed( 0, FRAMES - 1 );
+	printf( "Trial:\n" );
+	errors += CheckEvents( "Grip on", DEX_GRIP_ON, 1, grip_on );
+	errors += CheckEvents( "Grip off", DEX_GRIP_OFF, 1, grip_off );
+	errors += CheckEvents( "Grip peak", DEX_GRIP_PEAK, 1, grip_peak );
+	errors += CheckEvents( "Load on", DEX_LOAD_ON, 1, load_on );
+	errors += CheckEvents( "Load off", DEX_LOAD_OFF, 1, load_off );
+	errors += CheckEvents( "Movement on", DEX_MOVE_ON, 1, move_on );
+	errors += CheckEvents( "Movement off", DEX_MOVE_OFF, 1, move_off );
+	errors += CheckEvents( "Collisions", DEX_COLLISION, 2, collisions );
+	errors += CheckEvents( "Slips", DEX_SLIP, 2, slips );
+	if ( detector.Events( DEX_GRIP_PEAK ) == 1 && detector.Event( DEX_GRIP_PEAK, 0 )->value != GRIP_PEAK ) {
+		printf( "  The peak grip force is %f instead of %f.\n", detector.Event( DEX_GRIP_PEAK, 0 )->value, GRIP_PEAK );
+		errors++;
+	}
+	return( errors );
+
+}
+
+// A break while the object is held ends the grip and the load at the last frame before
+//  the break. Since the forces are still above the thresholds after the break, they both
+//  start again with the first frame after it.
+static int CheckBreak( void ) {
+
+	static const int grip_on[] = { GRIP_ON_FRAME, 201 };
+	static const int grip_off[] = { 200 };
+	static const int grip_peak[] = { 149 };		// The end of the ramp, before the dip.
+	static const int load_on[] = { LOAD_ON_FRAME, 201 };
+	static const int load_off[] = { 200 };
+	int errors = 0;
+
+	detector.Reset();
+	Feed( 0, 200 );
+	detector.Break();
+	Feed( 201, 220 );
+	printf( "Break:\n" );
+	errors += CheckEvents( "Grip on", DEX_GRIP_ON, 2, grip_on );
+	errors += CheckEvents( "Grip off", DEX_GRIP_OFF, 1, grip_off );
+	errors += CheckEvents( "Grip peak", DEX_GRIP_PEAK, 1, grip_peak );
+	errors += CheckEvents( "Load on", DEX_LOAD_ON, 2, load_on );
+	errors += CheckEvents( "Load off", DEX_LOAD_OFF, 1, load_off );
+	return( errors );
+
+}
+
+// Each event must be found by time, whether the time is just before, at or just after it.
+static int CheckLookup( void ) {
+
+	int errors = 0;
+
+	detector.Reset();
+	Feed( 0, FRAMES - 1 );
+	for ( int type = 0; type < DEX_EVENT_TYPES; type++ ) {
+		for ( int i = 0; i < detector.Events( type ); i++ ) {
+			double time = detector.Event( type, i )->time;
+			errors += ( detector.FindEventAfter( type, time - 0.001 ) != i );
+			errors += ( detector.FindEventAfter( type, time ) != i );
+			errors += ( detector.FindEventAfter( type, time + 0.001 ) != i + 1 );
+			errors += ( detector.FindEventBefore( type, time - 0.001 ) != i - 1 );
+			errors += ( detector.FindEventBefore( type, time ) != i );
+		}
+	}
+	printf( "Lookup by time: %s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	int errors = 0;
+
+	errors += CheckTrial();
+	errors += CheckBreak();
+	errors += CheckLookup();
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
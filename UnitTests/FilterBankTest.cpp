@@ -0,0 +1,195 @@
+///
+/// Module:	FilterBankTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check that DexFilterBank gives exactly the same result as the per-sample filters of
+///  DexAnalogMixin, applied frame by frame as GripMMI used to do when reading the packets.
+/// The data is irregular and the manipulandum, its orientation and the centers of pressure
+///  are each missing now and then, so that the skipped frames are checked as well.
+/// The bank is run on a short stretch of data, which it filters in the calling thread,
+///  on one longer than DEX_FILTER_THREAD_FRAMES, which it shares out between threads,
+///  and on the long one again in several calls, which must carry the state over.
+/// The outputs are compared with memcmp(), so they must be identical to the bit.
+///
+/// Usage: FilterBankTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/DexAnalogMixin.h"
+
+#define SHORT_FRAMES	5000
+#define LONG_FRAMES		( 2 * DEX_FILTER_THREAD_FRAMES + 12345 )
+#define THREADS			4
+#define CHUNK			( DEX_FILTER_THREAD_FRAMES / 3 + 17 )
+#define FILTER_CONSTANT	2.0
+
+// Unfiltered data, as decoded from the packets.
+static Vector3	raw_position[LONG_FRAMES];
+static Vector3	raw_rotations[LONG_FRAMES];
+static Vector3	raw_load_force[LONG_FRAMES];
+static Vector3	raw_acceleration[LONG_FRAMES];
+static Vector3	raw_cop[N_FORCE_TRANSDUCERS][LONG_FRAMES];
+static double	raw_grip_force[LONG_FRAMES];
+static double	raw_normal_force[N_FORCE_TRANSDUCERS][LONG_FRAMES];
+
+// The filtered data from each of the two paths.
+typedef struct {
+	Vector3	position[LONG_FRAMES];
+	Vector3	rotations[LONG_FRAMES];
+	Vector3	load_force[LONG_FRAMES];
+	Vector3	acceleration[LONG_FRAMES];
+	Vector3	cop[N_FORCE_TRANSDUCERS][LONG_FRAMES];
+	double	grip_force[LONG_FRAMES];
+	double	normal_force[N_FORCE_TRANSDUCERS][LONG_FRAMES];
+} Outputs;
+
+static Outputs per_sample, bank_output;
+
+static DexAnalogMixin dex;
+static DexFilterBank bank;
+
+// A simple congruential generator, so that the data is the same everywhere.
+static unsigned int seed = 12345;
+static double Random( double scale ) {
+	seed = seed * 1103515245 + 12345;
+	return( scale * ( ( ( seed >> 16 ) & 0x7fff ) / 32767.0 - 0.5 ) );
+}
+
+static void MakeData( void ) {
+
+	for ( int frame = 0; frame < LONG_FRAMES; frame++ ) {
+		double t = frame * 0.005;
+		for ( int i = X; i <= Z; i++ ) {
+			raw_position[frame][i] = 100.0 * sin( t + i ) + Random( 1.0 );
+			raw_rotations[frame][i] = 30.0 * cos( 0.3 * t + i ) + Random( 0.5 );
+			raw_load_force[frame][i] = 2.0 + Random( 3.0 );
+			raw_acceleration[frame][i] = ( i == Y ? 1.0 : 0.0 ) + Random( 0.2 );
+			for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) raw_cop[ati][frame][i] = Random( 0.02 );
+		}
+		raw_grip_force[frame] = 5.0 + Random( 8.0 );
+		for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) raw_normal_force[ati][frame] = 2.5 + Random( 4.0 );
+		// The manipulandum is hidden now and then, for a few frames.
+		if ( frame % 997 < 5 ) {
+			for ( int i = X; i <= Z; i++ ) raw_position[frame][i] = MISSING_DOUBLE;
+		}
+		// The orientation is skipped if its X component is missing, whatever the others.
+		if ( frame % 1231 < 3 ) raw_rotations[frame][X] = MISSING_DOUBLE;
+		// The CoP is missing when the grip is too light.
+		for ( int ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+			if ( ( frame + 100 * ati ) % 503 < 20 ) {
+				for ( int i = X; i <= Z; i++ ) raw_cop[ati][frame][i] = MISSING_DOUBLE;
+			}
+		}
+	}
+
+}
+
+// Both paths start from the same contents, so that the frames beyond the ones
+//  that are filtered must be left the same as well.
+static void Prepare( Outputs *out ) {
+	memset( out, 0, sizeof( *out ) );
+	memcpy( out->position, raw_position, sizeof( out->position ) );
+	memcpy( out->rotations, raw_rotations, sizeof( out->rotations ) );
+	memcpy( out->load_force, raw_load_force, sizeof( out->load_force ) );
+	memcpy( out->acceleration, raw_acceleration, sizeof( out->acceleration ) );
+	memcpy( out->cop, raw_cop, sizeof( out->cop ) );
+}
+
+// Filter in place, frame by frame, with the guards that were used when reading the packets.
+// Frames that are skipped keep the unfiltered value.
+static void FilterPerSample( Outputs *out, int frames ) {
+
+	int i, ati;
+
+	Prepare( out );
+	dex.SetFilterConstant( FILTER_CONSTANT );
+	for ( i = X; i <= Z; i++ ) {
+		dex.filteredManipulandumPosition[i] = 0.0;
+		dex.filteredManipulandumRotations[i] = 0.0;
+		dex.filteredLoadForce[i] = 0.0;
+		dex.filteredAcceleration[i] = 0.0;
+		for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) dex.filteredCoP[ati][i] = 0.0;
+	}
+	dex.filteredGripForce = 0.0;
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) dex.filteredNormalForce[ati] = 0.0;
+
+	for ( int frame = 0; frame < frames; frame++ ) {
+		if ( out->position[frame][X] != MISSING_DOUBLE ) dex.FilterManipulandumPosition( out->position[frame] );
+		if ( out->rotations[frame][X] != MISSING_DOUBLE ) dex.FilterManipulandumRotations( out->rotations[frame] );
+		dex.FilterLoadForce( out->load_force[frame] );
+		dex.FilterAcceleration( out->acceleration[frame] );
+		for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+			if ( out->cop[ati][frame][X] != MISSING_DOUBLE ) dex.FilterCoP( ati, out->cop[ati][frame] );
+			out->normal_force[ati][frame] = (float) dex.FilterNormalForce( raw_normal_force[ati][frame], ati );
+		}
+		out->grip_force[frame] = (float) dex.FilterGripForce( raw_grip_force[frame] );
+	}
+
+}
+
+// The same channels as GripMMIDesktop::InitializeFilterBank().
+static void DefineChannels( Outputs *out ) {
+
+	int i, ati;
+
+	bank.ClearChannels();
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &raw_position[0][i], &out->position[0][i], 3 );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &raw_rotations[0][i], &out->rotations[0][i], 3, &raw_rotations[0][X] );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &raw_load_force[0][i], &out->load_force[0][i], 3 );
+	for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &raw_acceleration[0][i], &out->acceleration[0][i], 3 );
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		for ( i = X; i <= Z; i++ ) bank.AddChannel( DEX_FILTER_VECTOR, &raw_cop[ati][0][i], &out->cop[ati][0][i], 3 );
+	}
+	bank.AddChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &raw_grip_force[0], &out->grip_force[0], 1 );
+	for ( ati = 0; ati < N_FORCE_TRANSDUCERS; ati++ ) {
+		bank.AddChannel( DEX_FILTER_SCALAR | DEX_FILTER_SINGLE, &raw_normal_force[ati][0], &out->normal_force[ati][0], 1 );
+	}
+	bank.SetFilterConstant( FILTER_CONSTANT );
+
+}
+
+// Filter the given number of frames in calls of at most chunk frames each.
+static void FilterBank( Outputs *out, int frames, int chunk, int n_threads ) {
+
+	Prepare( out );
+	DefineChannels( out );
+	bank.ResetState();
+	for ( int first = 0; first < frames; first += chunk ) {
+		int last = first + chunk - 1;
+		if ( last >= frames ) last = frames - 1;
+		bank.Filter( first, last, n_threads );
+	}
+
+}
+
+static int Compare( const char *name, int frames, int chunk, int n_threads ) {
+	FilterPerSample( &per_sample, frames );
+	FilterBank( &bank_output, frames, chunk, n_threads );
+	int errors = ( memcmp( &per_sample, &bank_output, sizeof( Outputs ) ) != 0 );
+	printf( "  %-40s %s\n", name, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+}
+
+int main( int argc, char *argv[] ) {
+
+	int errors = 0;
+
+	MakeData();
+
+	errors += Compare( "Short, in the calling thread", SHORT_FRAMES, SHORT_FRAMES, THREADS );
+	errors += Compare( "Long, in one thread", LONG_FRAMES, LONG_FRAMES, 1 );
+	errors += Compare( "Long, shared between threads", LONG_FRAMES, LONG_FRAMES, THREADS );
+	errors += Compare( "Long, in several calls", LONG_FRAMES, CHUNK, THREADS );
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
@@ -0,0 +1,287 @@
+///
+/// Module:	PoseSolverTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Compare the poses computed by DexPoseSolver with those of VectorsMixin::ComputeRigidBodyPose()
+///  on generated marker data: a model of 8 markers placed at random poses, with some of the
+///  markers hidden in each frame.
+///  - Without noise, both must find the pose that was used to place the markers.
+///  - With noise, the least-squares fit of DexPoseSolver must leave a residual no larger than
+///     that of the pose found by ComputeRigidBodyPose().
+///  - With collinear markers, the rotation about the line is undetermined and the quick
+///     solution (adjugate of Horn's matrix) breaks down, so the solver falls back on Jacobi
+///     rotations. Any rotation it finds must still fit the markers.
+///  - Frames with fewer than 3 visible markers must come out as missing.
+/// There are enough frames for the work to be shared out between threads.
+///
+/// Usage: PoseSolverTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Useful/VectorsMixin.h"
+#include "../Grip/DexPoseSolver.h"
+
+#define MARKERS			8
+#define FRAMES			5000
+#define THREADS			4
+#define NOISE			0.5			// mm
+#define MAX_ERROR		1.0e-6
+#define MAX_EXCESS		1.0e-9
+// ComputeRigidBodyPose() rounds to single precision here and there.
+#define MAX_REFERENCE_ANGLE		0.001	// degrees
+#define MAX_REFERENCE_DISTANCE	0.001	// mm
+
+static double marker_data[3][MARKERS][FRAMES];
+static double pose_data[8][FRAMES];
+static int visible_data[FRAMES];
+
+static DexMarkerArrays	markers;
+static DexPoseArrays	poses;
+
+static Quaternion	true_orientation[FRAMES];
+static Vector3		true_position[FRAMES];
+
+static VectorsMixin	vm;
+
+static double Random( double low, double high ) {
+	return( low + ( high - low ) * rand() / (double) RAND_MAX );
+}
+
+static double Gaussian( void ) {
+	double u = Random( 1.0e-12, 1.0 ), v = Random( 0.0, 1.0 );
+	return( sqrt( -2.0 * log( u ) ) * cos( 2.0 * Pi * v ) );
+}
+
+// VectorsMixin::RotateVector() rounds to single precision along the way, so the data is
+//  generated and checked with the rotation matrix, in double precision.
+static void Rotate( Vector3 result, const Quaternion q, const Vector3 v ) {
+	double w = q[M], x = q[X], y = q[Y], z = q[Z];
+	result[X] = ( 1.0 - 2.0 * ( y * y + z * z ) ) * v[X] + 2.0 * ( x * y - w * z ) * v[Y] + 2.0 * ( x * z + w * y ) * v[Z];
+	result[Y] = 2.0 * ( x * y + w * z ) * v[X] + ( 1.0 - 2.0 * ( x * x + z * z ) ) * v[Y] + 2.0 * ( y * z - w * x ) * v[Z];
+	result[Z] = 2.0 * ( x * z - w * y ) * v[X] + 2.0 * ( y * z + w * x ) * v[Y] + ( 1.0 - 2.0 * ( x * x + y * y ) ) * v[Z];
+}
+
+// Place the model markers at a random pose in each frame. Markers that are hidden
+//  get MISSING_DOUBLE. Frames that are multiples of 97 keep only 2 markers.
+static void Generate( Vector3 model[], int n_markers, double noise ) {
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+
+		Quaternion q;
+		for ( int i = X; i <= M; i++ ) q[i] = Random( -1.0, 1.0 );
+		vm.NormalizeQuaternion( q );
+		vm.CopyQuaternion( true_orientation[frame], q );
+		for ( int i = X; i <= Z; i++ ) true_position[frame][i] = Random( -500.0, 500.0 );
+
+		int hidden = ( frame % 97 == 0 ? n_markers - 2 : rand() % ( n_markers - 3 ) );
+		for ( int mrk = 0; mrk < n_markers; mrk++ ) {
+			Vector3 rotated;
+			Rotate( rotated, q, model[mrk] );
+			for ( int i = X; i <= Z; i++ ) marker_data[i][mrk][frame] = rotated[i] + true_position[frame][i] + noise * Gaussian();
+		}
+		for ( int h = 0; h < hidden; h++ ) marker_data[X][rand() % n_markers][frame] = MISSING_DOUBLE;
+	}
+
+}
+
+static int Visible( int n_markers, int frame, Vector3 model[], Vector3 sub_model[], Vector3 actual[] ) {
+	int count = 0;
+	for ( int mrk = 0; mrk < n_markers; mrk++ ) {
+		if ( marker_data[X][mrk][frame] == MISSING_DOUBLE ) continue;
+		vm.CopyVector( sub_model[count], model[mrk] );
+		for ( int i = X; i <= Z; i++ ) actual[count][i] = marker_data[i][mrk][frame];
+		count++;
+	}
+	return( count );
+}
+
+// Angle in degrees of the rotation from one orientation to the other.
+// It is taken from the relative rotation, conjugate( a ) * b, rather than from the acos of
+//  the dot product, which cannot resolve the small angles that we are looking at.
+static double AngleBetween( const Quaternion a, const Quaternion b ) {
+	double m = a[M] * b[M] + a[X] * b[X] + a[Y] * b[Y] + a[Z] * b[Z];
+	double x = a[M] * b[X] - a[X] * b[M] - a[Y] * b[Z] + a[Z] * b[Y];
+	double y = a[M] * b[Y] + a[X] * b[Z] - a[Y] * b[M] - a[Z] * b[X];
+	double z = a[M] * b[Z] - a[X] * b[Y] + a[Y] * b[X] - a[Z] * b[M];
+	return( 2.0 * atan2( sqrt( x * x + y * y + z * z ), fabs( m ) ) * 180.0 / Pi );
+}
+
+// RMS distance from the markers to the model placed at the given pose.
+static double Residual( Vector3 model[], Vector3 actual[], int count, const Vector3 position, const Quaternion orientation ) {
+	double sum = 0.0;
+	for ( int mrk = 0; mrk < count; mrk++ ) {
+		Vector3 rotated;
+		Rotate( rotated, orientation, model[mrk] );
+		for ( int i = X; i <= Z; i++ ) {
+			double d = actual[mrk][i] - rotated[i] - position[i];
+			sum += d * d;
+		}
+	}
+	return( sqrt( sum / count ) );
+}
+
+static void SolvedPose( int frame, Vector3 position, Quaternion orientation ) {
+	for ( int i = X; i <= Z; i++ ) position[i] = poses.position[i][frame];
+	for ( int i = X; i <= M; i++ ) orientation[i] = poses.orientation[i][frame];
+}
+
+// Frames with too few markers must be missing, and the others must have been solved.
+static int CheckMissing( int n_markers, Vector3 model[], int solved, const char *name ) {
+
+	Vector3 sub_model[DEX_POSE_MAX_MARKERS], actual[DEX_POSE_MAX_MARKERS];
+	int expected = 0, errors = 0;
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		int count = Visible( n_markers, frame, model, sub_model, actual );
+		if ( count != visible_data[frame] ) errors++;
+		if ( count >= DEX_POSE_MIN_MARKERS ) expected++;
+		else if ( poses.position[X][frame] != MISSING_DOUBLE || poses.orientation[M][frame] != MISSING_DOUBLE || poses.residual[frame] != MISSING_DOUBLE ) errors++;
+	}
+	if ( solved != expected ) errors++;
+	printf( "  %-10s %d of %d frames solved, %d expected: %s\n", name, solved, FRAMES, expected, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+
+}
+
+static int CheckExact( Vector3 model[] ) {
+
+	Vector3 sub_model[DEX_POSE_MAX_MARKERS], actual[DEX_POSE_MAX_MARKERS];
+	Vector3 position, reference_position;
+	Quaternion orientation, reference_orientation;
+	double worst_angle = 0.0, worst_reference_angle = 0.0, worst_distance = 0.0, worst_residual = 0.0;
+	int errors = 0;
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		int count = Visible( MARKERS, frame, model, sub_model, actual );
+		if ( count < DEX_POSE_MIN_MARKERS ) continue;
+		SolvedPose( frame, position, orientation );
+		vm.ComputeRigidBodyPose( reference_position, reference_orientation, sub_model, actual, count, NULL );
+
+		double angle = AngleBetween( orientation, true_orientation[frame] );
+		double reference_angle = AngleBetween( orientation, reference_orientation );
+		Vector3 delta;
+		vm.SubtractVectors( delta, position, reference_position );
+		double distance = vm.VectorNorm( delta );
+		if ( angle > worst_angle ) worst_angle = angle;
+		if ( reference_angle > worst_reference_angle ) worst_reference_angle = reference_angle;
+		if ( distance > worst_distance ) worst_distance = distance;
+		if ( poses.residual[frame] > worst_residual ) worst_residual = poses.residual[frame];
+	}
+	errors = ( worst_angle > MAX_ERROR || worst_residual > MAX_ERROR || worst_reference_angle > MAX_REFERENCE_ANGLE || worst_distance > MAX_REFERENCE_DISTANCE );
+	printf( "  %-10s largest differences: %.3g deg from the true pose, %.3g deg and %.3g mm from ComputeRigidBodyPose(), residual %.3g: %s\n",
+		"Exact", worst_angle, worst_reference_angle, worst_distance, worst_residual, ( errors ? "FAILED" : "OK" ) );
+	return( errors );
+
+}
+
+static int CheckNoisy( Vector3 model[] ) {
+
+	Vector3 sub_model[DEX_POSE_MAX_MARKERS], actual[DEX_POSE_MAX_MARKERS];
+	Vector3 position, reference_position;
+	Quaternion orientation, reference_orientation;
+	double worst_excess = -1.0e30, sum = 0.0, reference_sum = 0.0;
+	int errors = 0;
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		int count = Visible( MARKERS, frame, model, sub_model, actual );
+		if ( count < DEX_POSE_MIN_MARKERS ) continue;
+		SolvedPose( frame, position, orientation );
+		vm.ComputeRigidBodyPose( reference_position, reference_orientation, sub_model, actual, count, NULL );
+
+		double residual = Residual( sub_model, actual, count, position, orientation );
+		double reference_residual = Residual( sub_model, actual, count, reference_position, reference_orientation );
+		if ( fabs( residual - poses.residual[frame] ) > MAX_ERROR ) errors++;
+		if ( residual - reference_residual > worst_excess ) worst_excess = residual - reference_residual;
+		sum += residual;
+		reference_sum += reference_residual;
+	}
+	if ( worst_excess > MAX_EXCESS ) errors++;
+	printf( "  %-10s total residual %.3f mm, ComputeRigidBodyPose() %.3f mm: %s\n", "Noisy", sum, reference_sum, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+
+}
+
+static int CheckCollinear( Vector3 model[], int n_markers ) {
+
+	Vector3 sub_model[DEX_POSE_MAX_MARKERS], actual[DEX_POSE_MAX_MARKERS];
+	Vector3 position;
+	Quaternion orientation;
+	double worst_residual = 0.0;
+	int errors = 0;
+
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		int count = Visible( n_markers, frame, model, sub_model, actual );
+		if ( count < DEX_POSE_MIN_MARKERS ) continue;
+		SolvedPose( frame, position, orientation );
+		// A pose that is not a number gives a residual that is not a number, which is caught below.
+		double residual = Residual( sub_model, actual, count, position, orientation );
+		if ( !( residual <= worst_residual ) ) worst_residual = residual;
+	}
+	if ( !( worst_residual <= MAX_ERROR ) ) errors++;
+	printf( "  %-10s largest residual %.3g: %s\n", "Collinear", worst_residual, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+
+}
+
+static void Solve( DexPoseSolver &solver, int *solved ) {
+	for ( int frame = 0; frame < FRAMES; frame++ ) {
+		for ( int i = 0; i < 8; i++ ) pose_data[i][frame] = 0.0;
+		visible_data[frame] = -1;
+	}
+	*solved = solver.Solve( &markers, &poses, 0, FRAMES - 1, THREADS );
+}
+
+int main( int argc, char *argv[] ) {
+
+	// Roughly the shape of the manipulandum: markers on two faces, not all in one plane.
+	Vector3 model[MARKERS] = {
+		{ -30.0,  40.0, -10.0 }, {  30.0,  40.0, -10.0 }, { -30.0, -40.0, -10.0 }, {  30.0, -40.0, -10.0 },
+		{ -20.0,  25.0,  15.0 }, {  20.0,  25.0,  15.0 }, { -20.0, -25.0,  15.0 }, {  25.0, -20.0,  20.0 }
+	};
+	Vector3 line[MARKERS] = {
+		{ -60.0, -20.0, 10.0 }, { -40.0, -10.0, 10.0 }, { -20.0, 0.0, 10.0 }, { 0.0, 10.0, 10.0 },
+		{ 20.0, 20.0, 10.0 }, { 40.0, 30.0, 10.0 }, { 60.0, 40.0, 10.0 }, { 80.0, 50.0, 10.0 }
+	};
+
+	DexPoseSolver solver;
+	int errors = 0, solved;
+
+	for ( int mrk = 0; mrk < MARKERS; mrk++ ) {
+		markers.x[mrk] = marker_data[X][mrk];
+		markers.y[mrk] = marker_data[Y][mrk];
+		markers.z[mrk] = marker_data[Z][mrk];
+	}
+	for ( int i = X; i <= Z; i++ ) poses.position[i] = pose_data[i];
+	for ( int i = X; i <= M; i++ ) poses.orientation[i] = pose_data[3 + i];
+	poses.residual = pose_data[7];
+	poses.visible = visible_data;
+
+	srand( 2015 );
+
+	solver.SetModel( model, MARKERS );
+	Generate( model, MARKERS, 0.0 );
+	Solve( solver, &solved );
+	errors += CheckMissing( MARKERS, model, solved, "Exact" );
+	errors += CheckExact( model );
+
+	Generate( model, MARKERS, NOISE );
+	Solve( solver, &solved );
+	errors += CheckMissing( MARKERS, model, solved, "Noisy" );
+	errors += CheckNoisy( model );
+
+	solver.SetModel( line, MARKERS );
+	Generate( line, MARKERS, 0.0 );
+	Solve( solver, &solved );
+	errors += CheckMissing( MARKERS, line, solved, "Collinear" );
+	errors += CheckCollinear( line, MARKERS );
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
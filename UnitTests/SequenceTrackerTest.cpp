@@ -0,0 +1,211 @@
+///
+/// Module:	SequenceTrackerTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check the accounting of DexSequenceTracker on short, made up sequences of packet counts:
+///  an unbroken stream, duplicates, dropped packets, packets that arrive late and fill a hole,
+///  a late packet from before the start of the acquisition, a change of acquisition, a pause
+///  and a packet that comes back from further in the past than the tracker remembers.
+/// For each one, the counts per acquisition and the gap table must be exactly as expected.
+///
+/// Usage: SequenceTrackerTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../Grip/GripPackets.h"
+#include "../Grip/DexSequenceTracker.h"
+
+#define ACQUISITION_A	0x1001
+#define ACQUISITION_B	0x1002
+#define SECONDS_PER_PACKET	0.05
+
+// The tracker holds the whole gap table, so it is too big for the stack.
+static DexSequenceTracker tracker;
+static int frames;
+static unsigned short tmCounter;
+static double timestamp;
+
+static void Start( void ) {
+	tracker.Reset();
+	frames = 0;
+	tmCounter = 0;
+	timestamp = 1000.0;
+}
+
+// Feed one packet, as GripMMI does: a duplicate is not stored, anything else takes the next frame.
+static int Feed( unsigned long acquisition_id, unsigned long packet_count ) {
+	int result = tracker.Track( acquisition_id, packet_count, tmCounter++, timestamp, frames );
+	timestamp += SECONDS_PER_PACKET;
+	if ( result != DEX_SEQUENCE_DUPLICATE ) frames++;
+	return( result );
+}
+
+static void FeedRange( unsigned long acquisition_id, unsigned long first, unsigned long last ) {
+	for ( unsigned long count = first; count <= last; count++ ) Feed( acquisition_id, count );
+}
+
+static int Check( const char *what, int actual, int expected ) {
+	int error = ( actual != expected );
+	if ( error ) printf( "    %s is %d instead of %d.\n", what, actual, expected );
+	return( error );
+}
+
+static int CheckCounts( int received, int dropped, int duplicates, int out_of_order, int gaps ) {
+	int errors = 0;
+	errors += Check( "Received", tracker.Received(), received );
+	errors += Check( "Dropped", tracker.Dropped(), dropped );
+	errors += Check( "Duplicates", tracker.Duplicates(), duplicates );
+	errors += Check( "Out of order", tracker.OutOfOrder(), out_of_order );
+	errors += Check( "Gaps", tracker.Gaps(), gaps );
+	return( errors );
+}
+
+static int CheckGap( int index, int frame, int missing, int cause ) {
+	DexSequenceGap *gap = tracker.Gap( index );
+	int errors = 0;
+	if ( !gap ) {
+		printf( "    Gap %d is missing.\n", index );
+		return( 1 );
+	}
+	errors += Check( "Gap frame", gap->frame, frame );
+	errors += Check( "Gap missing", gap->missing, missing );
+	errors += Check( "Gap cause", gap->cause, cause );
+	return( errors );
+}
+
+static int Report( const char *name, int errors ) {
+	printf( "  %-32s %s\n", name, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+}
+
+static int Contiguous( void ) {
+	int errors = 0;
+	Start();
+	for ( unsigned long count = 1; count <= 100; count++ ) {
+		if ( Feed( ACQUISITION_A, count ) != DEX_SEQUENCE_CONTIGUOUS ) errors++;
+	}
+	errors += CheckCounts( 100, 0, 0, 0, 0 );
+	errors += Check( "First count", tracker.Acquisition( 0 )->first_count, 1 );
+	errors += Check( "Last count", tracker.Acquisition( 0 )->last_count, 100 );
+	return( Report( "Contiguous", errors ) );
+}
+
+static int Duplicates( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	errors += Check( "Repeat of the last", Feed( ACQUISITION_A, 10 ), DEX_SEQUENCE_DUPLICATE );
+	errors += Check( "Repeat of an earlier one", Feed( ACQUISITION_A, 5 ), DEX_SEQUENCE_DUPLICATE );
+	errors += Check( "Next", Feed( ACQUISITION_A, 11 ), DEX_SEQUENCE_CONTIGUOUS );
+	errors += CheckCounts( 11, 0, 2, 0, 0 );
+	errors += Check( "Frames", frames, 11 );
+	return( Report( "Duplicates", errors ) );
+}
+
+static int Dropped( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	errors += Check( "After the hole", Feed( ACQUISITION_A, 14 ), DEX_SEQUENCE_BREAK );
+	FeedRange( ACQUISITION_A, 15, 20 );
+	errors += CheckCounts( 17, 3, 0, 0, 1 );
+	errors += CheckGap( 0, 10, 3, DEX_GAP_DROPPED );
+	errors += Check( "Break before frame 10", tracker.BreakBefore( 10 ), true );
+	errors += Check( "Break before frame 11", tracker.BreakBefore( 11 ), false );
+	errors += Check( "Break between 5 and 15", tracker.BreakBetween( 5, 15 ), true );
+	errors += Check( "Break between 10 and 15", tracker.BreakBetween( 10, 15 ), false );
+	errors += Check( "Gap after frame 3", tracker.FindGapAfter( 3 ), 0 );
+	errors += Check( "Gap after frame 11", tracker.FindGapAfter( 11 ), 1 );
+	return( Report( "Dropped", errors ) );
+}
+
+// 12 arrives before 11. The hole left by 12 is counted as dropped, then given back by 11.
+// The gap keeps the count that was known when it was added.
+// The stream is broken on both sides of the late packet.
+static int LateFill( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	Feed( ACQUISITION_A, 12 );
+	errors += Check( "Dropped before the late one", tracker.Dropped(), 1 );
+	errors += Check( "Late one", Feed( ACQUISITION_A, 11 ), DEX_SEQUENCE_BREAK );
+	errors += Check( "After the late one", Feed( ACQUISITION_A, 13 ), DEX_SEQUENCE_BREAK );
+	errors += Check( "Late one again", Feed( ACQUISITION_A, 11 ), DEX_SEQUENCE_DUPLICATE );
+	errors += CheckCounts( 13, 0, 1, 1, 3 );
+	errors += CheckGap( 0, 10, 1, DEX_GAP_DROPPED );
+	errors += CheckGap( 1, 11, 0, DEX_GAP_OUT_OF_ORDER );
+	errors += CheckGap( 2, 12, 0, DEX_GAP_OUT_OF_ORDER );
+	return( Report( "Late fill", errors ) );
+}
+
+// A packet from before the first one seen of the acquisition was never counted as dropped.
+static int LateBeforeStart( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 100, 110 );
+	Feed( ACQUISITION_A, 95 );
+	errors += CheckCounts( 12, 0, 0, 1, 1 );
+	errors += Check( "Dropped in the acquisition", tracker.Acquisition( 0 )->dropped, 0 );
+	errors += Check( "First count", tracker.Acquisition( 0 )->first_count, 95 );
+	return( Report( "Late, before the start", errors ) );
+}
+
+// The packets lost between two acquisitions are counted from the TMCounter.
+static int NewAcquisition( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	tmCounter += 4;
+	errors += Check( "First of the new one", Feed( ACQUISITION_B, 1 ), DEX_SEQUENCE_BREAK );
+	FeedRange( ACQUISITION_B, 2, 5 );
+	errors += CheckCounts( 15, 4, 0, 0, 1 );
+	errors += CheckGap( 0, 10, 4, DEX_GAP_ACQUISITION );
+	errors += Check( "Acquisitions", tracker.Acquisitions(), 2 );
+	errors += Check( "Lost before the new one", tracker.Acquisition( 1 )->lost_before, 4 );
+	errors += Check( "Dropped in the new one", tracker.Acquisition( 1 )->dropped, 0 );
+	return( Report( "New acquisition", errors ) );
+}
+
+static int Pause( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	timestamp += 2.0 * tracker.pauseThreshold;
+	errors += Check( "After the pause", Feed( ACQUISITION_A, 11 ), DEX_SEQUENCE_BREAK );
+	errors += CheckCounts( 11, 0, 0, 0, 1 );
+	errors += CheckGap( 0, 10, 0, DEX_GAP_PAUSE );
+	return( Report( "Pause", errors ) );
+}
+
+// A packet from further back than the window is out of order, and its hole stays dropped.
+static int BeyondWindow( void ) {
+	int errors = 0;
+	Start();
+	FeedRange( ACQUISITION_A, 1, 10 );
+	Feed( ACQUISITION_A, 10 + DEX_SEQUENCE_WINDOW + 5 );
+	errors += Check( "Old one", Feed( ACQUISITION_A, 5 ), DEX_SEQUENCE_BREAK );
+	errors += CheckCounts( 12, DEX_SEQUENCE_WINDOW + 4, 0, 1, 2 );
+	return( Report( "Beyond the window", errors ) );
+}
+
+int main( int argc, char *argv[] ) {
+
+	int errors = 0;
+
+	errors += Contiguous();
+	errors += Duplicates();
+	errors += Dropped();
+	errors += LateFill();
+	errors += LateBeforeStart();
+	errors += NewAcquisition();
+	errors += Pause();
+	errors += BeyondWindow();
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
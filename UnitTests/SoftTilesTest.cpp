@@ -0,0 +1,136 @@
+///
+/// Module:	SoftTilesTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check that drawing a set of Views on tiles in parallel (SoftRenderTiles()) gives exactly
+///  the same image as drawing them one after the other on the calling thread.
+/// The tiles are laid out like the strip charts of the GripMMI and each one draws a trace
+///  of a different length, so that the work is unequal and the threads steal from each other.
+/// The parallel rendering is repeated several times, to give any race a chance to show.
+/// The image is then resized, which resizes the tiles, and must draw as if it were new.
+///
+/// Usage: SoftTilesTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../PsyPhy2dGraphicsLib/Graphics.h"
+#include "../PsyPhy2dGraphicsLib/Displays.h"
+#include "../PsyPhy2dGraphicsLib/Views.h"
+#include "../PsyPhy2dGraphicsLib/Layouts.h"
+#include "../PsyPhy2dGraphicsLib/SoftDisplay.h"
+#include "../PsyPhy2dGraphicsLib/SoftTiles.h"
+
+#define IMAGE_WIDTH		1200
+#define IMAGE_HEIGHT	800
+#define ROWS			8
+#define COLUMNS			3
+#define TILES			( ROWS * COLUMNS )
+#define MAX_SAMPLES		20000
+#define THREADS			8
+#define REPEATS			10
+
+static double trace[MAX_SAMPLES];
+
+// Each tile draws a box, axes and a trace whose length depends on the tile.
+static void DrawTile( View view, void *data ) {
+
+	int tile = *(int *) data;
+	int samples = MAX_SAMPLES / ( 1 + tile % 7 );
+
+	ViewColor( view, GREY6 );
+	ViewBox( view );
+	ViewSetXLimits( view, 0.0, samples - 1 );
+	ViewSetYLimits( view, -1.5, 1.5 );
+	ViewColor( view, BLACK );
+	ViewAxes( view );
+	ViewSelectColor( view, tile );
+	ViewPlotDoubles( view, &trace[tile], 0, samples - 1 - tile, 1, sizeof( *trace ) );
+
+}
+
+static void SetUpTiles( Display image, SoftTile tile[], int id[] ) {
+
+	Layout layout = CreateLayout( image, ROWS, COLUMNS );
+	LayoutSetDisplayEdgesRelative( layout, 0.0, 0.065, 1.0, 1.0 );
+	for ( int i = 0; i < TILES; i++ ) {
+		id[i] = i;
+		SoftTileFromView( &tile[i], LayoutViewN( layout, i ), DrawTile, &id[i] );
+	}
+
+}
+
+static void SizeImage( Display image, int width, int height ) {
+	DisplaySetSizePixels( image, width, height );
+	DisplayInit( image );
+	DisplayFreeCache( image );
+}
+
+static Display CreateImage( int width, int height ) {
+	Display image = CreateSoftDisplay();
+	SizeImage( image, width, height );
+	return( image );
+}
+
+int main( int argc, char *argv[] ) {
+
+	Display		serial_image, tiled_image, small_image;
+	SoftTile	serial_tile[TILES], tiled_tile[TILES], small_tile[TILES];
+	int			serial_id[TILES], tiled_id[TILES], small_id[TILES];
+	size_t		bytes = (size_t) IMAGE_WIDTH * IMAGE_HEIGHT * 4;
+	int			errors = 0;
+
+	for ( int i = 0; i < MAX_SAMPLES; i++ ) trace[i] = sin( i * 0.01 ) + 0.3 * sin( i * 0.37 );
+
+	serial_image = CreateImage( IMAGE_WIDTH, IMAGE_HEIGHT );
+	SetUpTiles( serial_image, serial_tile, serial_id );
+	Erase( serial_image );
+	SoftRenderTiles( serial_image, serial_tile, TILES, 1 );
+
+	tiled_image = CreateImage( IMAGE_WIDTH, IMAGE_HEIGHT );
+	SetUpTiles( tiled_image, tiled_tile, tiled_id );
+	for ( int repeat = 0; repeat < REPEATS; repeat++ ) {
+		Erase( tiled_image );
+		SoftRenderTiles( tiled_image, tiled_tile, TILES, THREADS );
+		if ( memcmp( SoftDisplayPixels( serial_image ), SoftDisplayPixels( tiled_image ), bytes ) ) {
+			int differences = 0;
+			for ( size_t k = 0; k < bytes; k++ ) differences += ( SoftDisplayPixels( serial_image )[k] != SoftDisplayPixels( tiled_image )[k] );
+			printf( "  Pass %d: %d bytes differ between the serial and tiled images.\n", repeat, differences );
+			errors++;
+		}
+	}
+
+	// Shrink the image that has been drawn on, and compare with one that is drawn at that size from the start.
+	small_image = CreateImage( IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2 );
+	for ( int i = 0; i < TILES; i++ ) {
+		small_id[i] = i;
+		SoftTileInit( &small_tile[i], tiled_tile[i].left, tiled_tile[i].bottom, tiled_tile[i].right, tiled_tile[i].top, DrawTile, &small_id[i] );
+	}
+	Erase( small_image );
+	SoftRenderTiles( small_image, small_tile, TILES, 1 );
+	SizeImage( tiled_image, IMAGE_WIDTH / 2, IMAGE_HEIGHT / 2 );
+	Erase( tiled_image );
+	SoftRenderTiles( tiled_image, tiled_tile, TILES, THREADS );
+	if ( memcmp( SoftDisplayPixels( small_image ), SoftDisplayPixels( tiled_image ), bytes / 4 ) ) {
+		printf( "  The resized image differs from one drawn at that size.\n" );
+		errors++;
+	}
+
+	// Make sure that something was drawn at all.
+	unsigned char *pixel = SoftDisplayPixels( serial_image );
+	int background = 0;
+	for ( size_t k = 0; k < bytes; k += 4 ) background += ( pixel[k] == pixel[0] && pixel[k+1] == pixel[1] && pixel[k+2] == pixel[2] );
+	if ( background == IMAGE_WIDTH * IMAGE_HEIGHT ) {
+		printf( "  The image is blank.\n" );
+		errors++;
+	}
+
+	printf( "%d tiles on %d threads, %d passes: %s\n", TILES, THREADS, REPEATS, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
@@ -0,0 +1,201 @@
+///
+/// Module:	VectorDisplayTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Draw the same page, a frame, a long trace, a filled circle, a filled polygon and a
+///  line of text, on a VectorDisplay to an SVG file and then to a PDF file, and check
+///  the structure of what was written.
+/// In the SVG, every path must be closed off and the text must be escaped.
+/// In the PDF, the cross reference table, the start of the table and the length of the
+///  content stream must all agree with where things actually are in the file.
+/// In both, the trace must have been decimated to a few vertices per column, however
+///  many samples it has.
+///
+/// Usage: VectorDisplayTest
+/// Returns 0 if all is well.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../PsyPhy2dGraphicsLib/Graphics.h"
+#include "../PsyPhy2dGraphicsLib/Displays.h"
+#include "../PsyPhy2dGraphicsLib/Views.h"
+#include "../PsyPhy2dGraphicsLib/VectorDisplay.h"
+
+#define PAGE_WIDTH		400
+#define PAGE_HEIGHT		300
+#define SAMPLES			20000
+#define MAX_FILE_SIZE	( 1024 * 1024 )
+
+// The white background, the frame, the trace, the circle and the polygon.
+#define STROKE_PATHS	2
+#define FILL_PATHS		3
+
+static double trace[SAMPLES];
+static char file_contents[MAX_FILE_SIZE + 1];
+
+static char text[] = "a<b & (c)";
+static char svg_text[] = ">a&lt;b &amp; (c)</text>";
+static char pdf_text[] = "(a<b & \\(c\\)) Tj";
+
+static void DrawPage( Display display, View view ) {
+
+	Erase( display );
+	Color( display, BLACK );
+	Rectangle( display, 10.0f, 10.0f, PAGE_WIDTH - 10.0f, PAGE_HEIGHT - 10.0f );
+	Color( display, RED );
+	ViewSetXLimits( view, 0.0, SAMPLES - 1 );
+	ViewSetYLimits( view, -1.5, 1.5 );
+	ViewPlotDoubles( view, trace, 0, SAMPLES - 1, 1, sizeof( *trace ) );
+	Color( display, BLUE );
+	FilledCircle( display, 50.0f, 50.0f, 20.0f );
+	Color( display, GREEN );
+	StartPolygon( display );
+	AddVertex( display, 300.0f, 30.0f );
+	AddVertex( display, 350.0f, 30.0f );
+	AddVertex( display, 325.0f, 70.0f );
+	FillPolygon( display );
+	Color( display, BLACK );
+	Text( display, text, 20.0f, PAGE_HEIGHT - 30.0f, 0.0 );
+
+}
+
+static long ReadFile( const char *filename ) {
+	FILE *fp = fopen( filename, "rb" );
+	long bytes;
+	if ( !fp ) {
+		printf( "  Cannot open %s.\n", filename );
+		return( 0 );
+	}
+	bytes = (long) fread( file_contents, 1, MAX_FILE_SIZE, fp );
+	fclose( fp );
+	file_contents[bytes] = 0;
+	return( bytes );
+}
+
+static int Count( const char *string ) {
+	int n = 0;
+	for ( const char *p = strstr( file_contents, string ); p; p = strstr( p + 1, string ) ) n++;
+	return( n );
+}
+
+static int EndsWith( long bytes, const char *string ) {
+	long length = (long) strlen( string );
+	return( bytes >= length && !strcmp( file_contents + bytes - length, string ) );
+}
+
+static int Check( const char *what, int ok ) {
+	if ( !ok ) printf( "    %s: FAILED\n", what );
+	return( ok ? 0 : 1 );
+}
+
+static int Report( const char *name, int errors ) {
+	printf( "  %-32s %s\n", name, ( errors ? "FAILED" : "OK" ) );
+	return( errors ? 1 : 0 );
+}
+
+static int CheckSVG( const char *filename ) {
+
+	long bytes = ReadFile( filename );
+	char size[64];
+	int errors = 0;
+
+	sprintf( size, "width=\"%d\" height=\"%d\"", PAGE_WIDTH, PAGE_HEIGHT );
+	errors += Check( "Header", !strncmp( file_contents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg ", 44 ) );
+	errors += Check( "Page size", strstr( file_contents, size ) != NULL );
+	errors += Check( "End", EndsWith( bytes, "</g>\n</svg>\n" ) );
+	errors += Check( "Stroked paths", Count( "<path d=\"" ) == STROKE_PATHS );
+	errors += Check( "Filled paths", Count( "<path stroke=\"none\" d=\"" ) == FILL_PATHS );
+	errors += Check( "Every path closed", Count( "<path" ) == Count( "/>\n" ) );
+	errors += Check( "Text", Count( "<text" ) == 1 && Count( "</text>\n" ) == 1 );
+	errors += Check( "Text escaped", strstr( file_contents, svg_text ) != NULL );
+	// One 'L' per vertex. At most 4 per column: the one that enters it, the extremes and the last.
+	int vertices = Count( "L" );
+	errors += Check( "Trace decimated", vertices > PAGE_WIDTH / 2 && vertices <= 4 * PAGE_WIDTH );
+	printf( "  %s: %ld bytes, %d vertices.\n", filename, bytes, vertices );
+	return( Report( "SVG", errors ) );
+
+}
+
+// The offset in the file of the given string, or -1.
+static long Offset( const char *string ) {
+	char *p = strstr( file_contents, string );
+	return( p ? (long) ( p - file_contents ) : -1 );
+}
+
+static int CheckPDF( const char *filename ) {
+
+	long bytes = ReadFile( filename );
+	char line[64];
+	long xref, start, length;
+	int errors = 0;
+
+	sprintf( line, "/MediaBox [0 0 %d %d]", PAGE_WIDTH, PAGE_HEIGHT );
+	errors += Check( "Header", !strncmp( file_contents, "%PDF-1.4\n", 9 ) );
+	errors += Check( "Page size", strstr( file_contents, line ) != NULL );
+	errors += Check( "End", EndsWith( bytes, "%%EOF\n" ) );
+
+	// The cross reference table must give the offset of each object.
+	xref = Offset( "xref\n0 7\n" );
+	errors += Check( "Cross reference table", xref > 0 );
+	if ( xref > 0 ) {
+		char *entry = file_contents + xref + strlen( "xref\n0 7\n0000000000 65535 f \n" );
+		for ( int k = 1; k <= 6; k++, entry += 20 ) {
+			long offset = atol( entry );
+			sprintf( line, "%d 0 obj\n", k );
+			errors += Check( line, offset > 0 && offset < bytes && !strncmp( file_contents + offset, line, strlen( line ) ) );
+		}
+		sprintf( line, "startxref\n%ld\n", xref );
+		errors += Check( "Start of the table", strstr( file_contents, line ) != NULL );
+	}
+
+	// The length of the content stream is written after it, as object 5.
+	start = Offset( "stream\n" ) + (long) strlen( "stream\n" );
+	length = ( Offset( "5 0 obj\n" ) > 0 ? atol( file_contents + Offset( "5 0 obj\n" ) + strlen( "5 0 obj\n" ) ) : -1 );
+	errors += Check( "Stream length", length > 0 && !strncmp( file_contents + start + length, "endstream\n", 10 ) );
+
+	errors += Check( "Stroked paths", Count( "\nS\n" ) == STROKE_PATHS );
+	errors += Check( "Filled paths", Count( "\nf\n" ) == FILL_PATHS );
+	errors += Check( "Text escaped", Count( pdf_text ) == 1 );
+	// One 'l' operator per vertex.
+	int vertices = Count( " l\n" );
+	errors += Check( "Trace decimated", vertices > PAGE_WIDTH / 2 && vertices <= 4 * PAGE_WIDTH );
+	printf( "  %s: %ld bytes, %d vertices.\n", filename, bytes, vertices );
+	return( Report( "PDF", errors ) );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	Display display;
+	View	view;
+	int		errors = 0;
+
+	for ( int i = 0; i < SAMPLES; i++ ) trace[i] = sin( i * 0.01 ) + 0.3 * sin( i * 0.37 );
+
+	display = CreateVectorDisplay();
+	DisplaySetSizePixels( display, PAGE_WIDTH, PAGE_HEIGHT );
+	DisplayInit( display );
+	view = CreateView( display );
+	ViewSetDisplayEdgesRelative( view, 0.05, 0.05, 0.95, 0.95 );
+
+	if ( VectorDisplayOpen( display, "VectorDisplayTest.svg" ) != SUCCESS ) errors++;
+	DrawPage( display, view );
+	VectorDisplayFinish( display );
+	errors += CheckSVG( "VectorDisplayTest.svg" );
+
+	if ( VectorDisplayOpen( display, "VectorDisplayTest.pdf" ) != SUCCESS ) errors++;
+	DrawPage( display, view );
+	VectorDisplayFinish( display );
+	errors += CheckPDF( "VectorDisplayTest.pdf" );
+
+	DestroyVectorDisplays();
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
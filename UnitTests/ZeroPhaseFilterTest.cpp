@@ -0,0 +1,113 @@
+///
+/// Module:	ZeroPhaseFilterTest (GripMMI)
+///
+/// Copyright (c) 2015 PsyPhy Consulting
+///
+
+/// Check the filters of DexZeroPhaseFilter.
+/// A sinusoid well below the cut-off frequency is passed through the recursive and the
+///  Butterworth filters, run forward and backward. The output must be in phase with the input.
+/// Polynomials of up to third degree must come through the Savitzky-Golay filter unchanged,
+///  including near the ends of the data and around a missing sample.
+/// The data is long enough to be cut into several chunks that are filtered in parallel.
+///
+/// Usage: ZeroPhaseFilterTest
+/// Returns 0 if all is well.
+
+#define _USE_MATH_DEFINES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../Useful/Useful.h"
+#include "../Grip/DexZeroPhaseFilter.h"
+
+#define FRAMES			( 4 * DEX_ZERO_PHASE_CHUNK + 1234 )
+#define SAMPLE_RATE		200.0
+#define FREQUENCY		0.5					// Hz, 400 samples per period.
+#define CUTOFF			5.0					// Hz
+#define PERIODS			100
+#define MAX_PHASE		1.0e-4				// radians
+#define MAX_ERROR		1.0e-9
+#define THREADS			4
+
+static double input[FRAMES];
+static double output[FRAMES];
+
+// Phase of the output relative to the input, from its projection on the sine and cosine
+//  over a whole number of periods in the middle of the data, away from the ends.
+static double PhaseShift( void ) {
+	int samples = (int) ( PERIODS * SAMPLE_RATE / FREQUENCY );
+	int first = ( FRAMES - samples ) / 2;
+	double s = 0.0, c = 0.0;
+	for ( int i = first; i < first + samples; i++ ) {
+		double angle = 2.0 * M_PI * FREQUENCY * i / SAMPLE_RATE;
+		s += output[i] * sin( angle );
+		c += output[i] * cos( angle );
+	}
+	return( atan2( c, s ) );
+}
+
+static int CheckPhase( DexZeroPhaseFilter &filter, const char *name ) {
+
+	for ( int i = 0; i < FRAMES; i++ ) input[i] = sin( 2.0 * M_PI * FREQUENCY * i / SAMPLE_RATE );
+	filter.ClearChannels();
+	filter.AddChannel( 0, input, output, 1 );
+	filter.Filter( 0, FRAMES - 1, FRAMES, THREADS );
+
+	double phase = PhaseShift();
+	int error = ( fabs( phase ) > MAX_PHASE );
+	printf( "  %-12s phase shift %10.3g rad: %s\n", name, phase, ( error ? "FAILED" : "OK" ) );
+	return( error );
+
+}
+
+static int CheckPolynomial( int half_width, int degree ) {
+
+	static const double coefficient[4] = { 0.3, -1.7, 2.2, -0.9 };
+	const int missing = FRAMES / 3;
+	double worst = 0.0;
+	DexZeroPhaseFilter filter;
+
+	// Scale the abscissa so that all the terms are of similar size.
+	for ( int i = 0; i < FRAMES; i++ ) {
+		double t = (double) i / FRAMES, p = 0.0;
+		for ( int d = degree; d >= 0; d-- ) p = p * t + coefficient[d];
+		input[i] = p;
+	}
+	input[missing] = MISSING_DOUBLE;
+
+	filter.SetSavitzkyGolay( half_width );
+	filter.AddChannel( 0, input, output, 1 );
+	filter.Filter( 0, FRAMES - 1, FRAMES, THREADS );
+
+	for ( int i = 0; i < FRAMES; i++ ) {
+		double difference = fabs( output[i] - input[i] );
+		if ( difference > worst ) worst = difference;
+	}
+	int error = ( worst > MAX_ERROR || output[missing] != MISSING_DOUBLE );
+	printf( "  Savitzky-Golay half width %2d, degree %d: largest error %10.3g: %s\n", half_width, degree, worst, ( error ? "FAILED" : "OK" ) );
+	return( error );
+
+}
+
+int main( int argc, char *argv[] ) {
+
+	DexZeroPhaseFilter	filter;
+	int errors = 0;
+
+	filter.SetRecursive( 10.0 );
+	errors += CheckPhase( filter, "Recursive" );
+	filter.SetButterworth( CUTOFF, SAMPLE_RATE );
+	errors += CheckPhase( filter, "Butterworth" );
+
+	for ( int degree = 0; degree <= 3; degree++ ) {
+		errors += CheckPolynomial( 5, degree );
+		errors += CheckPolynomial( 25, degree );
+	}
+
+	printf( "%s\n", ( errors ? "FAILED" : "OK" ) );
+	return( errors ? -1 : 0 );
+
+}
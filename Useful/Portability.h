@@ -0,0 +1,267 @@
+#pragma once
+
+//
+// Portability.h
+// Stand-ins for the few Windows, Winsock and CRT calls used by the console tools
+//  (CLWSemulator, DexGroundMonitorClient, GripPackets) so that they can be built on Linux.
+// On Windows this file defines nothing.
+//
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <sys/syscall.h>
+
+// Windows types. A DWORD and a LONG are 32 bits on Windows, whatever the compiler.
+typedef int				BOOL;
+typedef unsigned int	DWORD;
+typedef int				LONG;
+typedef long long		LONGLONG;
+typedef void			*LPVOID;
+typedef void			*HANDLE;
+typedef const char		*PCSTR;
+typedef int				errno_t;
+
+#ifndef TRUE
+#define TRUE	1
+#define FALSE	0
+#endif
+
+#define WINAPI
+#define __cdecl
+#define _tmain	main
+#define INFINITE	0xFFFFFFFF
+
+// fMessageBox() writes to stderr instead, so the type of box does not matter.
+#define MB_OK		0
+#define MB_ICONERROR	0x10
+
+#define _finite( x )	isfinite( x )
+
+// Sleep( 0 ) gives up the rest of the time slice, as on Windows.
+static inline void Sleep( DWORD milliseconds ) {
+	struct timespec delay;
+	if ( milliseconds == 0 ) {
+		sched_yield();
+		return;
+	}
+	delay.tv_sec = milliseconds / 1000;
+	delay.tv_nsec = ( milliseconds % 1000 ) * 1000000L;
+	nanosleep( &delay, NULL );
+}
+
+// The performance counter runs in nanoseconds from the monotonic clock.
+typedef union {
+	long long	QuadPart;
+} LARGE_INTEGER;
+
+static inline BOOL QueryPerformanceFrequency( LARGE_INTEGER *frequency ) {
+	frequency->QuadPart = 1000000000LL;
+	return( TRUE );
+}
+
+static inline BOOL QueryPerformanceCounter( LARGE_INTEGER *count ) {
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	count->QuadPart = (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+	return( TRUE );
+}
+
+// Time of day, as from _ftime32_s().
+struct __timeb32 {
+	int				time;
+	unsigned short	millitm;
+	short			timezone;
+	short			dstflag;
+};
+
+static inline errno_t _ftime32_s( struct __timeb32 *timeptr ) {
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, &now );
+	timeptr->time = (int) now.tv_sec;
+	timeptr->millitm = (unsigned short) ( now.tv_nsec / 1000000L );
+	timeptr->timezone = 0;
+	timeptr->dstflag = 0;
+	return( 0 );
+}
+
+// Low level file access. There is no binary mode and no sharing modes on Linux.
+#define _O_RDONLY	O_RDONLY
+#define _O_WRONLY	O_WRONLY
+#define _O_CREAT	O_CREAT
+#define _O_APPEND	O_APPEND
+#define _O_BINARY	0
+#define _SH_DENYNO	0
+#define _SH_DENYWR	0
+#define _S_IREAD	( S_IRUSR | S_IRGRP | S_IROTH )
+#define _S_IWRITE	( S_IWUSR )
+
+#define _open	open
+#define _read	read
+#define _write	write
+#define _close	close
+
+static inline errno_t _sopen_s( int *fid, const char *filename, int oflag, int shflag, int pmode ) {
+	*fid = open( filename, oflag, pmode );
+	return( *fid < 0 ? errno : 0 );
+}
+
+// Winsock.
+typedef int SOCKET;
+#define INVALID_SOCKET	( -1 )
+#define SOCKET_ERROR	( -1 )
+#define SD_SEND			SHUT_WR
+// A send() that times out (SO_SNDTIMEO) fails with EAGAIN.
+#define WSAETIMEDOUT	EAGAIN
+
+typedef struct {
+	int	unused;
+} WSADATA;
+
+#define MAKEWORD( low, high )	( (unsigned short) ( ( (low) & 0xff ) | ( ( (high) & 0xff ) << 8 ) ) )
+#define ZeroMemory( ptr, size )	memset( ( ptr ), 0, ( size ) )
+#define closesocket				close
+
+// Writing to a socket that the other side has closed raises SIGPIPE, which would kill the
+//  program. Winsock just returns an error, so the signal is ignored when the sockets are set up.
+static inline int WSAStartup( unsigned short version, WSADATA *data ) {
+	signal( SIGPIPE, SIG_IGN );
+	return( 0 );
+}
+static inline int WSACleanup( void ) {
+	return( 0 );
+}
+static inline int WSAGetLastError( void ) {
+	return( errno );
+}
+
+// Threads. Handles are only used for threads. CloseHandle() detaches the thread
+//  unless WaitForSingleObject() has already waited for it to finish.
+typedef DWORD ( WINAPI *LPTHREAD_START_ROUTINE )( LPVOID );
+
+typedef struct {
+	LPTHREAD_START_ROUTINE	routine;
+	LPVOID					parameter;
+} PortableThreadStart;
+
+typedef struct {
+	pthread_t	thread;
+	BOOL		joined;
+} PortableThread;
+
+static void *PortableThreadEntry( void *param ) {
+	PortableThreadStart start = *( (PortableThreadStart *) param );
+	free( param );
+	start.routine( start.parameter );
+	return( NULL );
+}
+
+static inline HANDLE CreateThread( void *attributes, size_t stack_size, LPTHREAD_START_ROUTINE routine, LPVOID parameter, DWORD flags, DWORD *id ) {
+	PortableThread *thread = (PortableThread *) malloc( sizeof( PortableThread ) );
+	PortableThreadStart *start = (PortableThreadStart *) malloc( sizeof( PortableThreadStart ) );
+	if ( thread && start ) {
+		start->routine = routine;
+		start->parameter = parameter;
+		thread->joined = FALSE;
+		if ( pthread_create( &thread->thread, NULL, PortableThreadEntry, start ) == 0 ) return( thread );
+	}
+	free( thread );
+	free( start );
+	return( NULL );
+}
+
+static inline DWORD WaitForSingleObject( HANDLE handle, DWORD milliseconds ) {
+	PortableThread *thread = (PortableThread *) handle;
+	if ( !thread->joined ) pthread_join( thread->thread, NULL );
+	thread->joined = TRUE;
+	return( 0 );
+}
+
+static inline BOOL CloseHandle( HANDLE handle ) {
+	PortableThread *thread = (PortableThread *) handle;
+	if ( !thread->joined ) pthread_detach( thread->thread );
+	free( handle );
+	return( TRUE );
+}
+
+typedef struct {
+	DWORD	dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+static inline void GetSystemInfo( SYSTEM_INFO *info ) {
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	info->dwNumberOfProcessors = ( n > 0 ? (DWORD) n : 1 );
+}
+
+// Locks and condition variables. Only infinite waits are supported.
+typedef pthread_mutex_t	CRITICAL_SECTION;
+typedef pthread_cond_t	CONDITION_VARIABLE;
+
+static inline void InitializeCriticalSection( CRITICAL_SECTION *section ) {
+	pthread_mutex_init( section, NULL );
+}
+static inline void EnterCriticalSection( CRITICAL_SECTION *section ) {
+	pthread_mutex_lock( section );
+}
+static inline void LeaveCriticalSection( CRITICAL_SECTION *section ) {
+	pthread_mutex_unlock( section );
+}
+static inline void InitializeConditionVariable( CONDITION_VARIABLE *condition ) {
+	pthread_cond_init( condition, NULL );
+}
+static inline BOOL SleepConditionVariableCS( CONDITION_VARIABLE *condition, CRITICAL_SECTION *section, DWORD milliseconds ) {
+	return( pthread_cond_wait( condition, section ) == 0 );
+}
+static inline void WakeAllConditionVariable( CONDITION_VARIABLE *condition ) {
+	pthread_cond_broadcast( condition );
+}
+
+static inline LONG InterlockedExchange( volatile LONG *target, LONG value ) {
+	return( __atomic_exchange_n( target, value, __ATOMIC_SEQ_CST ) );
+}
+static inline LONG InterlockedCompareExchange( volatile LONG *destination, LONG exchange, LONG comparand ) {
+	return( __sync_val_compare_and_swap( destination, comparand, exchange ) );
+}
+static inline LONG InterlockedIncrement( volatile LONG *addend ) {
+	return( __atomic_add_fetch( addend, 1, __ATOMIC_SEQ_CST ) );
+}
+static inline LONGLONG InterlockedExchangeAdd64( volatile LONGLONG *addend, LONGLONG value ) {
+	return( __atomic_fetch_add( addend, value, __ATOMIC_SEQ_CST ) );
+}
+static inline LONGLONG InterlockedExchange64( volatile LONGLONG *target, LONGLONG value ) {
+	return( __atomic_exchange_n( target, value, __ATOMIC_SEQ_CST ) );
+}
+static inline LONGLONG InterlockedCompareExchange64( volatile LONGLONG *destination, LONGLONG exchange, LONGLONG comparand ) {
+	return( __sync_val_compare_and_swap( destination, comparand, exchange ) );
+}
+
+static inline DWORD GetCurrentThreadId( void ) {
+	return( (DWORD) syscall( SYS_gettid ) );
+}
+static inline DWORD GetCurrentProcessId( void ) {
+	return( (DWORD) getpid() );
+}
+
+// rename() replaces an existing file atomically.
+#define MOVEFILE_REPLACE_EXISTING	0x1
+static inline BOOL MoveFileExA( const char *existing, const char *replacement, DWORD flags ) {
+	return( rename( existing, replacement ) == 0 );
+}
+
+#endif
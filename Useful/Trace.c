@@ -0,0 +1,142 @@
+// Recording of spans of time per thread, written out in the Chrome trace event format.
+// See Trace.h.
+
+// Disable warnings about unsafe functions.
+// We use the 'unsafe' versions to maintain source-code compatibility with Visual C++ 6
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <Windows.h>
+#define TRACE_THREAD_LOCAL	__declspec( thread )
+#else
+#include "Portability.h"
+#define TRACE_THREAD_LOCAL	__thread
+#endif
+
+#include "Trace.h"
+
+typedef struct {
+	const char	*name;
+	long long	time;		// Performance counter.
+	DWORD		threadID;
+	char		phase;		// As in the Chrome format: B(egin), E(nd) or i(nstant).
+} TraceRecord;
+
+// Only the thread that owns a ring writes to it, so it needs no lock. The count of events
+//  is only ever increased by that thread, after the event has been filled in.
+typedef struct {
+	volatile LONG	owned;
+	volatile LONG	count;
+	TraceRecord		event[TRACE_RING_EVENTS];
+} TraceRing;
+
+static TraceRing		*traceRing[TRACE_MAX_THREADS];
+static volatile LONG	traceRings = 0;
+static TRACE_THREAD_LOCAL TraceRing *threadRing = NULL;
+static TRACE_THREAD_LOCAL DWORD threadID = 0;
+
+// The first time that a thread records an event it takes a ring that has been given up by
+//  a thread that has ended, or else a new one. When all the slots for rings are taken by
+//  threads that are still running, further threads are not traced. They look again for
+//  a ring that has been given up at each event, but the count of rings stays at the limit.
+static TraceRing *GetThreadRing( void ) {
+
+	LONG slot, rings;
+	TraceRing *ring;
+
+	if ( threadRing ) return( threadRing );
+	threadID = GetCurrentThreadId();
+	rings = traceRings;
+	if ( rings > TRACE_MAX_THREADS ) rings = TRACE_MAX_THREADS;
+	for ( slot = 0; slot < rings; slot++ ) {
+		ring = traceRing[slot];
+		if ( ring && InterlockedCompareExchange( &ring->owned, 1, 0 ) == 0 ) {
+			threadRing = ring;
+			return( ring );
+		}
+	}
+	do {
+		slot = traceRings;
+		if ( slot >= TRACE_MAX_THREADS ) return( NULL );
+	} while ( InterlockedCompareExchange( &traceRings, slot + 1, slot ) != slot );
+	ring = (TraceRing *) calloc( 1, sizeof( TraceRing ) );
+	if ( !ring ) return( NULL );
+	ring->owned = 1;
+	traceRing[slot] = ring;
+	threadRing = ring;
+	return( ring );
+
+}
+
+void TraceThreadEnd( void ) {
+	if ( !threadRing ) return;
+	InterlockedExchange( &threadRing->owned, 0 );
+	threadRing = NULL;
+}
+
+void TraceEvent( const char *name, char phase ) {
+
+	TraceRing *ring = GetThreadRing();
+	TraceRecord *record;
+	LARGE_INTEGER now;
+
+	if ( !ring ) return;
+	QueryPerformanceCounter( &now );
+	record = &ring->event[ ring->count & ( TRACE_RING_EVENTS - 1 ) ];
+	record->name = name;
+	record->time = now.QuadPart;
+	record->threadID = threadID;
+	record->phase = phase;
+	ring->count++;
+
+}
+
+// Write a name as a JSON string. Function names may contain colons, but not quotes.
+static void WriteTraceName( FILE *fp, const char *name ) {
+	fputc( '"', fp );
+	for ( ; *name; name++ ) {
+		if ( *name == '"' || *name == '\\' ) fputc( '\\', fp );
+		fputc( *name, fp );
+	}
+	fputc( '"', fp );
+}
+
+int TraceWrite( const char *filename ) {
+
+	FILE *fp;
+	LARGE_INTEGER frequency;
+	double microseconds;
+	LONG rings, count, first, i;
+	int r, separator = 0;
+
+	fp = fopen( filename, "w" );
+	if ( !fp ) return( -1 );
+	QueryPerformanceFrequency( &frequency );
+	microseconds = 1000000.0 / (double) frequency.QuadPart;
+
+	rings = traceRings;
+	if ( rings > TRACE_MAX_THREADS ) rings = TRACE_MAX_THREADS;
+	fprintf( fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	for ( r = 0; r < rings; r++ ) {
+		TraceRing *ring = traceRing[r];
+		if ( !ring ) continue;
+		// Only the most recent events are still in the ring.
+		count = ring->count;
+		first = ( count > TRACE_RING_EVENTS ? count - TRACE_RING_EVENTS : 0 );
+		for ( i = first; i < count; i++ ) {
+			TraceRecord *record = &ring->event[ i & ( TRACE_RING_EVENTS - 1 ) ];
+			if ( separator ) fprintf( fp, ",\n" );
+			fprintf( fp, "{\"name\":" );
+			WriteTraceName( fp, record->name );
+			fprintf( fp, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u%s}", record->phase, (double) record->time * microseconds,
+				(unsigned int) GetCurrentProcessId(), (unsigned int) record->threadID, ( record->phase == 'i' ? ",\"s\":\"t\"" : "" ) );
+			separator = 1;
+		}
+	}
+	fprintf( fp, "\n]}\n" );
+	return( fclose( fp ) ? -1 : 0 );
+
+}
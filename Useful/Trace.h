@@ -0,0 +1,78 @@
+#pragma once
+
+//
+// Trace.h
+// Timing of the work done by the GripMMI tools, as spans of time on a timeline per thread.
+//
+// The spans are recorded with the macros below, which compile to nothing unless GRIP_TRACE
+//  is defined, so they can be left in the code. When tracing is compiled in, recording a
+//  span costs two reads of the performance counter and two writes to a ring buffer that
+//  belongs to the calling thread, without any locks. Each ring holds the last
+//  TRACE_RING_EVENTS events of its thread; older ones are overwritten.
+//
+// TRACE_WRITE( filename ) writes the events recorded so far in the Chrome trace event format
+//  (JSON), which can be opened in chrome://tracing or https://ui.perfetto.dev. It is meant to
+//  be called at the end, when the other threads are no longer recording.
+//
+// A thread that is about to end should call TRACE_THREAD_END(), so that its ring can be
+//  passed on to a thread started later. The events keep the ID of the thread that recorded them.
+//
+// Names must be string constants, because only the pointer is kept.
+//
+//  TRACE_SCOPE( "name" )		Span from here to the end of the enclosing block (C++ only).
+//  TRACE_FUNCTION()			Span covering the rest of the function, named after it (C++ only).
+//  TRACE_BEGIN( "name" )		Start and end of a span, for C code. The two must match.
+//  TRACE_END( "name" )
+//  TRACE_INSTANT( "name" )		A single instant.
+//  TRACE_THREAD_END()			Give up the ring of the calling thread.
+//
+
+#define TRACE_RING_EVENTS	65536		// Must be a power of 2.
+#define TRACE_MAX_THREADS	64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void TraceEvent( const char *name, char phase );
+void TraceThreadEnd( void );
+// Returns 0 on success.
+int  TraceWrite( const char *filename );
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef GRIP_TRACE
+
+#define TRACE_BEGIN( name )		TraceEvent( (name), 'B' )
+#define TRACE_END( name )		TraceEvent( (name), 'E' )
+#define TRACE_INSTANT( name )	TraceEvent( (name), 'i' )
+#define TRACE_THREAD_END()		TraceThreadEnd()
+#define TRACE_WRITE( filename )	TraceWrite( filename )
+
+#ifdef __cplusplus
+class TraceScope {
+public:
+	TraceScope( const char *name ) : name( name ) { TraceEvent( name, 'B' ); }
+	~TraceScope( void ) { TraceEvent( name, 'E' ); }
+private:
+	const char *name;
+};
+#define TRACE_SCOPE_NAME2( line )	traceScope##line
+#define TRACE_SCOPE_NAME( line )	TRACE_SCOPE_NAME2( line )
+#define TRACE_SCOPE( name )			TraceScope TRACE_SCOPE_NAME( __LINE__ )( name )
+#define TRACE_FUNCTION()			TRACE_SCOPE( __FUNCTION__ )
+#endif
+
+#else
+
+#define TRACE_BEGIN( name )		((void) 0)
+#define TRACE_END( name )		((void) 0)
+#define TRACE_INSTANT( name )	((void) 0)
+#define TRACE_THREAD_END()		((void) 0)
+#define TRACE_WRITE( filename )	((void) 0)
+#define TRACE_SCOPE( name )		((void) 0)
+#define TRACE_FUNCTION()		((void) 0)
+
+#endif
@@ -92,6 +92,7 @@ public:
 	void MatrixToQuaternion( Quaternion result, Matrix3x3 m );
 
 	void QuaternionToCannonicalRotations( Vector3 rotations, Quaternion q );
+	void QuaternionsToCannonicalRotations( Vector3 rotations[], const Quaternion q[], int n );
 
 	bool ComputeRigidBodyPose( Vector3 position, Quaternion orientation,
 								Vector3 model[], Vector3 actual[], 
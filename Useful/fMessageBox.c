@@ -4,11 +4,15 @@
 // We use the 'unsafe' versions to maintain source-code compatibility with Visual C++ 6
 #define _CRT_SECURE_NO_WARNINGS
 
-#include <Windows.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#ifdef _WIN32
+#include <Windows.h>
 #include <tchar.h>
+#else
+#include "Portability.h"
+#endif
 
 #include "fMessageBox.h"
  
@@ -25,6 +29,12 @@ int fMessageBox( int mb_type, const char *caption, const char *format, ... ) {
 	items = vsprintf(message, format, args);
 	va_end(args);
 	
+#ifdef _WIN32
 	return( MessageBox( NULL, message, caption, mb_type ) );
+#else
+	// No message boxes on Linux. The console tools that are built there just print the message.
+	fprintf( stderr, "%s: %s\n", caption, message );
+	return( 0 );
+#endif
 		
 }
\ No newline at end of file
@@ -4,11 +4,16 @@
 // We use the 'unsafe' versions to maintain source-code compatibility with Visual C++ 6
 #define _CRT_SECURE_NO_WARNINGS
 
-#include <Windows.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdarg.h>
+#ifdef _WIN32
+#include <Windows.h>
 #include <tchar.h>
+#else
+#include "Portability.h"
+#endif
 
 #include "fOutputDebugString.h"
  
@@ -28,7 +33,11 @@ int fOutputDebugString( const char *format, ... ) {
 	items = vsprintf(message, fmt, args);
 	va_end(args);
 
+#ifdef _WIN32
 	OutputDebugString( message );
+#else
+	fputs( message, stderr );
+#endif
 
 	return( items );
 